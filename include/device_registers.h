@@ -2,6 +2,9 @@
 #define DEVICE_REGISTERS_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "trace.h"
 
 /* Simulated hardware register addresses (offsets) */
 #define REG_MOTOR_CTRL      0x00
@@ -45,16 +48,135 @@
 /* Register file size */
 #define REGISTER_FILE_SIZE  0x24
 
-/* Simulated register file */
+/* Where a register file's window lives; fixed at init */
+typedef enum {
+    REG_BACKEND_SIM = 0,        /* In-process array */
+    REG_BACKEND_MMIO,           /* mmap of /dev/mem or a UIO device */
+    REG_BACKEND_SHM             /* POSIX shm shared with a hardware-in-the-loop simulator */
+} reg_backend_t;
+
+/*
+ * Register file. regs points at the active window: the sim array, or a
+ * mapping chosen at init. Every backend is accessed through the same
+ * volatile pointer, so the access path is one load or store with no
+ * backend dispatch, and the compiler neither elides nor reorders accesses.
+ * The simulated window points into the struct itself, so a register file
+ * must not be copied. With a trace attached, each write also emits a
+ * TRACE_REG_WRITE record tagged with trace_id.
+ */
 typedef struct {
-    uint32_t regs[REGISTER_FILE_SIZE / 4];
+    volatile uint32_t *regs;
+    uint32_t sim[REGISTER_FILE_SIZE / 4];
+    reg_backend_t backend;
+    void *map;                  /* Mapping to release, NULL for the sim array */
+    size_t map_len;
+    trace_t *trace;             /* NULL: writes are not traced */
+    uint16_t trace_id;
 } register_file_t;
 
-/* Register I/O functions */
+/* Offsets are word aligned and inside the block */
+#define REG_OFFSET_VALID(offset) \
+    ((offset) < REGISTER_FILE_SIZE && ((offset) & 3u) == 0)
+
+/* Compile-time offset check usable inside an expression */
+#define REG_CHECK_OFFSET(offset) \
+    ((void)sizeof(struct { _Static_assert(REG_OFFSET_VALID(offset), \
+                                          "invalid register offset"); int ok; }))
+
+/*
+ * Runtime-checked accessors: NULL files and bad offsets are ignored, and
+ * reads return all 1s. Always built; the inline accessors use them when
+ * REG_CHECKED is set (by default in DEBUG builds).
+ */
+uint32_t reg_read_checked(register_file_t *rf, uint32_t offset);
+void reg_write_checked(register_file_t *rf, uint32_t offset, uint32_t value);
+void reg_set_bits_checked(register_file_t *rf, uint32_t offset, uint32_t bits);
+void reg_clear_bits_checked(register_file_t *rf, uint32_t offset, uint32_t bits);
+
+static inline void reg_trace_write(register_file_t *rf, uint32_t op, uint32_t offset,
+                                   uint32_t value) {
+    if (rf->trace) {
+        trace_emit(rf->trace, TRACE_REG_WRITE, rf->trace_id, offset, value, op, 0);
+    }
+}
+
+#ifndef REG_CHECKED
+#ifdef DEBUG
+#define REG_CHECKED 1
+#else
+#define REG_CHECKED 0
+#endif
+#endif
+
+/* Accessors for offsets known only at run time; the caller keeps them valid */
+static inline uint32_t reg_read_at(register_file_t *rf, uint32_t offset) {
+#if REG_CHECKED
+    return reg_read_checked(rf, offset);
+#else
+    return rf->regs[offset / 4];
+#endif
+}
+
+static inline void reg_write_at(register_file_t *rf, uint32_t offset, uint32_t value) {
+#if REG_CHECKED
+    reg_write_checked(rf, offset, value);
+#else
+    rf->regs[offset / 4] = value;
+    reg_trace_write(rf, TRACE_REG_OP_WRITE, offset, value);
+#endif
+}
+
+static inline void reg_set_bits_at(register_file_t *rf, uint32_t offset, uint32_t bits) {
+#if REG_CHECKED
+    reg_set_bits_checked(rf, offset, bits);
+#else
+    rf->regs[offset / 4] |= bits;
+    reg_trace_write(rf, TRACE_REG_OP_SET, offset, bits);
+#endif
+}
+
+static inline void reg_clear_bits_at(register_file_t *rf, uint32_t offset, uint32_t bits) {
+#if REG_CHECKED
+    reg_clear_bits_checked(rf, offset, bits);
+#else
+    rf->regs[offset / 4] &= ~bits;
+    reg_trace_write(rf, TRACE_REG_OP_CLEAR, offset, bits);
+#endif
+}
+
+/* Backend setup. reg_init selects the simulated array, zeroed */
 void reg_init(register_file_t *rf);
-uint32_t reg_read(register_file_t *rf, uint32_t offset);
-void reg_write(register_file_t *rf, uint32_t offset, uint32_t value);
-void reg_set_bits(register_file_t *rf, uint32_t offset, uint32_t bits);
-void reg_clear_bits(register_file_t *rf, uint32_t offset, uint32_t bits);
+
+/*
+ * Map the physical register window at phys_addr through path: /dev/mem
+ * with the block's bus address, or /dev/uioN with N * page size to pick
+ * map N. -1 for a misaligned address, -3 when the device cannot be mapped.
+ */
+int reg_init_mmio(register_file_t *rf, const char *path, uint64_t phys_addr);
+
+/*
+ * Map the POSIX shm object `name` as the register window, creating (and
+ * zeroing) it if asked. Whoever creates the object removes it with
+ * shm_unlink. -3 when it cannot be opened or mapped, or is smaller than
+ * REGISTER_FILE_SIZE.
+ */
+int reg_init_shm(register_file_t *rf, const char *name, bool create);
+
+/* Release a mapping and fall back to a zeroed simulated window */
+void reg_cleanup(register_file_t *rf);
+reg_backend_t reg_backend(const register_file_t *rf);
+
+/* Record every write to this file in t (NULL stops tracing); kept across reg_cleanup */
+void reg_set_trace(register_file_t *rf, trace_t *t, uint16_t id);
+
+/* Register I/O; offset must be a constant (REG_*), checked at compile time */
+#define reg_read(rf, offset) \
+    (REG_CHECK_OFFSET(offset), reg_read_at((rf), (offset)))
+#define reg_write(rf, offset, value) \
+    (REG_CHECK_OFFSET(offset), reg_write_at((rf), (offset), (value)))
+#define reg_set_bits(rf, offset, bits) \
+    (REG_CHECK_OFFSET(offset), reg_set_bits_at((rf), (offset), (bits)))
+#define reg_clear_bits(rf, offset, bits) \
+    (REG_CHECK_OFFSET(offset), reg_clear_bits_at((rf), (offset), (bits)))
 
 #endif /* DEVICE_REGISTERS_H */
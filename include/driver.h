@@ -0,0 +1,99 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "device_registers.h"
+#include "motor_bank.h"
+#include "motion_profile.h"
+#include "sensor_array.h"
+#include "interrupt_handler.h"
+#include "fault_trip.h"
+#include "shared_mem.h"
+#include "event_loop.h"
+#include "log_queue.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Application cadences, independent of the control tick period */
+#define DRIVER_STATUS_INTERVAL_US   500000
+
+/* Axis 0's speed loop is fed by the array's velocity sensor */
+#define DRIVER_VELOCITY_SENSOR      1
+
+/* Axis 0's current sensor trips its drive on every sample at or above the limit */
+#define DRIVER_CURRENT_SENSOR       3
+#define DRIVER_CURRENT_TRIP_LIMIT   4500
+
+/*
+ * The driver proper: every component, wired the way the driver runs them,
+ * plus the control tick and command execution. The process around it
+ * decides where time comes from: main.c runs ticks off the event loop on
+ * wall time, the simulator steps them on virtual time (see sim_clock.h).
+ * lock serialises a tick against a command frame when those run on
+ * different threads; it inherits priority.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    register_file_t regs[MOTOR_BANK_MAX_AXES];  /* Axis 0's also serve sensors and IRQs */
+    motor_bank_t motors;
+    motion_profile_t profiles[MOTOR_BANK_MAX_AXES];
+    sensor_array_t sensors;
+    uint32_t sensor_interval_us[SENSOR_MAX];    /* 0 = not scheduled */
+    interrupt_controller_t irq;
+    fault_trip_t trip;
+    shared_mem_t *shm;
+    event_loop_t *loop;             /* NULL: ticks are stepped by the caller */
+    uint32_t period_us;
+    uint32_t print_divider;
+    unsigned long tick;
+    log_queue_t *log;               /* NULL: nothing is printed */
+    trace_t *trace;                 /* NULL when tracing is off */
+    uint32_t traced_state[MOTOR_BANK_MAX_AXES];
+    uint64_t traced_trips;
+    _Atomic uint64_t dump_request;  /* Trip count the trace should be frozen at */
+} driver_t;
+
+/*
+ * Set up axes axes ticking every period_us, with axis 0's registers on
+ * backend (sim, shm:/name, uio:/dev/uioN or mem:0xaddr) and status in shm.
+ * -1 for a bad axis count, period or backend name, -3 when the backend
+ * cannot be mapped.
+ */
+int driver_init(driver_t *drv, uint32_t axes, uint32_t period_us, const char *backend,
+                shared_mem_t *shm);
+void driver_cleanup(driver_t *drv);
+
+/* Attach the flight recorder to registers, IRQs, trips and commands (NULL detaches) */
+void driver_set_trace(driver_t *drv, trace_t *trace);
+
+/* Change the tick period (on the event loop too, when there is one) */
+int driver_set_period(driver_t *drv, uint32_t period_us);
+
+/* One control tick, saved to shm for a warm restart; returns the time spent in it */
+uint64_t driver_tick(driver_t *drv);
+
+/* Capture the driver's state into state, and save it to the segment (driver_tick does) */
+void driver_capture_state(driver_t *drv, shm_driver_state_t *state);
+int driver_save_state(driver_t *drv);
+
+/*
+ * Warm restart: put a saved state back on a freshly initialised driver with
+ * the same axis count (-1 otherwise). Lanes, speed loops, trips, sensor
+ * config and the tick period and count come back as they were; so do the
+ * axes' simulated registers, while mapped registers are left to the
+ * hardware. A move in flight is not: its axis ramps down where it is.
+ */
+int driver_restore_state(driver_t *drv, const shm_driver_state_t *state);
+
+/* Run one command; resp_data (SHM_RESP_WORDS, zeroed) receives its results */
+response_status_t driver_execute(driver_t *drv, const shm_command_t *cmd, int32_t *resp_data);
+
+/*
+ * Run a frame from the command ring (a plain command is a frame of one).
+ * Every op runs, in order, before the next tick; a frame is answered once,
+ * with each op's status and results.
+ */
+void driver_process(driver_t *drv, const shm_command_t *ops, int count);
+
+#endif /* DRIVER_H */
@@ -0,0 +1,70 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "interrupt_handler.h"
+#include "shared_mem.h"
+#include <stdint.h>
+#include <signal.h>
+
+/* Control tick period limits */
+#define EVENT_LOOP_DEFAULT_PERIOD_US    10000
+#define EVENT_LOOP_MIN_PERIOD_US        100
+#define EVENT_LOOP_MAX_PERIOD_US        1000000
+
+/* Events reported by event_loop_wait */
+#define LOOP_EVENT_TICK      (1 << 0)
+#define LOOP_EVENT_IRQ       (1 << 2)
+#define LOOP_EVENT_SHUTDOWN  (1 << 3)
+#define LOOP_EVENT_RESTART   (1 << 4)
+
+/* IRQ signals held between event_loop_wait and event_loop_deliver_irqs */
+#define EVENT_LOOP_MAX_SIGNALS          16
+
+/*
+ * Event-driven driver loop. On Linux it multiplexes a timerfd (absolute,
+ * drift-free control tick) and a signalfd (SIGUSR1/SIGUSR2 IRQs,
+ * SIGINT/SIGTERM shutdown, SIGHUP warm restart) with epoll. Commands never
+ * wake it: they wake the IPC thread's futex (cmd_ring.wake). With shm set,
+ * a flagged shutdown is reported on the next wakeup.
+ */
+typedef struct {
+    int epoll_fd;
+    int timer_fd;
+    int signal_fd;
+    uint32_t period_us;
+    uint64_t ticks;
+    uint64_t missed_ticks;
+    uint64_t next_deadline_ns;
+    uint64_t last_deadline_ns;
+    shared_mem_t *shm;
+    interrupt_controller_t *irq;
+    int irq_signals[EVENT_LOOP_MAX_SIGNALS];
+    uint32_t irq_signal_count;
+    sigset_t signals;
+    sigset_t saved_mask;
+} event_loop_t;
+
+/* Event loop functions */
+int event_loop_init(event_loop_t *loop, uint32_t period_us,
+                    shared_mem_t *shm, interrupt_controller_t *irq);
+void event_loop_cleanup(event_loop_t *loop);
+
+/* Change the tick period at runtime; the next deadline is one period out */
+int event_loop_set_period(event_loop_t *loop, uint32_t period_us);
+
+/*
+ * Block until at least one event is ready; returns LOOP_EVENT_* bits.
+ * IRQ signals are only collected here: LOOP_EVENT_IRQ means some are held
+ * for event_loop_deliver_irqs, which raises them on the controller. Raising
+ * one runs fast handlers such as the fault trip, which write motor lanes
+ * and registers, so the caller delivers under the driver lock.
+ */
+int event_loop_wait(event_loop_t *loop, uint32_t *events);
+
+/* Raise the IRQ signals held since the last call; returns how many */
+int event_loop_deliver_irqs(event_loop_t *loop);
+
+/* Monotonic clock helper (sim_clock_now_ns) */
+uint64_t event_loop_now_ns(void);
+
+#endif /* EVENT_LOOP_H */
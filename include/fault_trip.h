@@ -0,0 +1,69 @@
+#ifndef FAULT_TRIP_H
+#define FAULT_TRIP_H
+
+#include "interrupt_handler.h"
+#include "latency_hist.h"
+#include "motor_controller.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FAULT_TRIP_MAX_AXES     64
+
+/* What a tripped axis does to its drive */
+typedef enum {
+    FAULT_REACT_BRAKE = 0,      /* Drive off, brake on, speed command zeroed */
+    FAULT_REACT_COAST,          /* Drive off; the motor spins down freely */
+    FAULT_REACT_STOP            /* Drive stays on with a zero speed command */
+} fault_reaction_t;
+
+/*
+ * Fault trip: the hard-wired path from a fault to the drive. A trip writes
+ * the axis's reaction to its registers first, then latches the cause in
+ * REG_MOTOR_STATUS and puts the lane in FAULT. Should an update running
+ * underneath (the trip may come from a signal handler) overwrite the lane
+ * state, the latched status puts it back on the next update. Work per trip
+ * is a fixed handful of register accesses with no locks or allocation, so
+ * its cost is bounded. An axis is counted and timed once per fault; tripping
+ * it again only re-applies the reaction, until the fault is cleared.
+ */
+typedef struct {
+    motor_lanes_t lanes;
+    uint32_t axes;
+    fault_reaction_t reaction[FAULT_TRIP_MAX_AXES];
+    _Atomic uint64_t tripped;       /* Axes already reacted to */
+    _Atomic uint64_t trips;
+    _Atomic bool recording;         /* Owner of reaction_ns, against nested trips */
+    lat_hist_t reaction_ns;         /* Trip entry to drive written */
+    trace_t *trace;                 /* NULL: trips are not traced */
+} fault_trip_t;
+
+/* Setup; every axis starts with FAULT_REACT_BRAKE */
+int fault_trip_init(fault_trip_t *ft, const motor_lanes_t *lanes, uint32_t axes);
+int fault_trip_set_reaction(fault_trip_t *ft, uint32_t axis, fault_reaction_t reaction);
+
+/* Emit a TRACE_FAULT record for every new trip (NULL stops tracing) */
+int fault_trip_set_trace(fault_trip_t *ft, trace_t *trace);
+
+/* Trip one axis: 1 for a new trip, 0 when it was already tripped */
+int fault_trip_axis(fault_trip_t *ft, uint32_t axis, motor_fault_t fault);
+
+/*
+ * Forget an axis's trip once its fault has been reset. Without it, a fault
+ * that latches before the next trip call finds the old trip still marked
+ * and is taken for a repeat: the drive reacts, but the fault is neither
+ * counted nor recorded.
+ */
+int fault_trip_rearm(fault_trip_t *ft, uint32_t axis);
+
+/* Trip every axis with a fault latched in its status register */
+int fault_trip_scan(fault_trip_t *ft);
+
+/*
+ * Fast handler for INT_MOTOR_FAULT and INT_MOTOR_STALL (context is the
+ * fault_trip_t). A fault line with no latched cause behind it is an
+ * external trip and stops every axis.
+ */
+void fault_trip_irq(interrupt_source_t source, void *context);
+
+#endif /* FAULT_TRIP_H */
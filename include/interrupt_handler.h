@@ -4,8 +4,11 @@
 #include "device_registers.h"
 #include "motor_controller.h"
 #include "sensor_array.h"
+#include "shared_mem.h"
 #include <signal.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 /* Interrupt sources */
 typedef enum {
@@ -17,19 +20,125 @@ typedef enum {
     INT_COUNT
 } interrupt_source_t;
 
+/* Priority levels; 0 is the most urgent */
+#define IRQ_PRIORITY_LEVELS     4
+#define IRQ_PRIORITY_NONE       IRQ_PRIORITY_LEVELS /* Nothing being serviced */
+
+/* Upper bound on handlers run by one irq_process_pending call */
+#define IRQ_DISPATCH_BUDGET     32
+
+/* Storm detection: event rate is measured over fixed windows */
+#define IRQ_STORM_WINDOW_US     100000
+#define IRQ_STORM_HOLDOFF_US    10000   /* Minimum delivery spacing while throttled */
+
+/* Raise-latency and handler-time histograms cost three clock reads per IRQ */
+#ifndef IRQ_INSTRUMENT
+#define IRQ_INSTRUMENT          1
+#endif
+
+/* Handlers per source (fixed, so dispatch never allocates) */
+#define IRQ_MAX_HANDLERS        4
+
 /* Interrupt handler callback type */
 typedef void (*irq_handler_t)(interrupt_source_t source, void *context);
 
-/* Interrupt controller context */
+typedef struct {
+    irq_handler_t fn;
+    void *context;
+} irq_handler_entry_t;
+
+/*
+ * Handler chain for one source, contiguous so dispatch touches at most two
+ * cache lines. Chains are copy-on-write: registration fills the spare copy
+ * and swaps the published pointer, so dispatch never takes a lock.
+ */
+typedef struct {
+    _Alignas(64) uint32_t count;
+    irq_handler_entry_t entries[IRQ_MAX_HANDLERS];
+} irq_chain_t;
+
+/*
+ * Per-source coalescing. With max_events or max_delay_us set, a pending
+ * source is held back until that many events have merged or the oldest has
+ * waited that long. A source whose rate crosses storm_threshold events per
+ * window is throttled to one delivery per IRQ_STORM_HOLDOFF_US until it
+ * calms down to half that rate.
+ */
+typedef struct {
+    uint32_t max_events;
+    uint32_t max_delay_us;
+    uint32_t storm_threshold;
+    uint32_t delivered_events;      /* Event count at the last delivery */
+    uint32_t merged;                /* Events folded into the current delivery */
+    uint64_t held_since_ns;         /* First pass that held it, for unstamped raises */
+    uint64_t window_start_ns;
+    uint32_t window_events;         /* Event count when the window opened */
+    uint32_t storms;
+    uint64_t deliveries;
+    bool throttled;
+} irq_coalesce_t;
+
+/* Per-source counters */
+typedef struct {
+    uint32_t events;                /* Raises accepted (wraps) */
+    uint64_t deliveries;            /* Handler dispatches */
+    uint32_t storms;                /* Times the storm detector tripped */
+    bool throttled;
+} irq_source_stats_t;
+
+/*
+ * Interrupt controller context. The pending and enabled masks are lock-free
+ * atomics, so irq_signal_handler and irq_trigger may race with dispatch
+ * without losing bits. Sources are grouped into priority levels;
+ * dispatch services the most urgent level first and rescans after every
+ * handler, so an IRQ raised by a handler preempts lower-priority work.
+ * Each source may also have a bottom half that runs later, outside the
+ * dispatch loop, either from irq_run_deferred or on the worker thread.
+ * A fast handler, by contrast, runs inside irq_trigger or
+ * irq_signal_handler itself, before the IRQ is even pending.
+ */
 typedef struct {
     register_file_t *regs;
     motor_controller_t *motor;
     sensor_array_t *sensors;
-    irq_handler_t handlers[INT_COUNT];
-    void *handler_contexts[INT_COUNT];
-    uint32_t pending_irqs;
-    uint32_t enabled_irqs;
+    _Atomic(irq_chain_t *) chain[INT_COUNT];   /* Published chain per source */
+    irq_chain_t chain_buf[INT_COUNT][2];
+    uint32_t retired_gen[INT_COUNT];        /* dispatch_gen when the spare was retired */
+    _Atomic uint32_t dispatch_gen;          /* Odd while dispatch is running */
+    pthread_mutex_t reg_lock;               /* Serialises writers only */
+    _Atomic uint32_t pending_irqs;  /* Lock-free: set from signal handlers */
+    _Atomic uint32_t enabled_irqs;
     volatile sig_atomic_t signal_received;
+
+    /* Priority dispatch */
+    uint8_t priority[INT_COUNT];
+    uint32_t level_mask[IRQ_PRIORITY_LEVELS];
+    uint8_t active_level;           /* Level of the running handler */
+
+    /* Coalescing and storm control */
+    _Atomic uint32_t event_count[INT_COUNT];
+    irq_coalesce_t coalesce[INT_COUNT];
+    uint32_t timed_mask;            /* Sources with coalescing or storm detection */
+
+    /* Fast handlers, run synchronously by the raise */
+    irq_handler_t fast_handlers[INT_COUNT];
+    void *fast_contexts[INT_COUNT];
+
+    /* Deferred (bottom-half) work */
+    irq_handler_t deferred_handlers[INT_COUNT];
+    void *deferred_contexts[INT_COUNT];
+    _Atomic uint32_t deferred_pending;
+    pthread_mutex_t worker_lock;
+    pthread_cond_t worker_cond;
+    pthread_t worker;
+    bool worker_running;
+    bool worker_stop;
+
+    /* Instrumentation */
+    _Atomic uint64_t raised_ns[INT_COUNT];  /* Oldest undelivered raise, 0 if none */
+    shm_irq_stats_t *stats;                 /* local_stats or a shared memory region */
+    shm_irq_stats_t local_stats;
+    trace_t *trace;                         /* NULL: dispatch is not traced */
 } interrupt_controller_t;
 
 /* Global interrupt controller (needed for signal handlers) */
@@ -40,10 +149,32 @@ int irq_init(interrupt_controller_t *ic, register_file_t *regs,
              motor_controller_t *motor, sensor_array_t *sensors);
 void irq_cleanup(interrupt_controller_t *ic);
 
-/* Handler registration */
+/*
+ * Handler registration. Handlers on one source run in registration order.
+ * Safe from any thread, including during dispatch; returns -2 when the chain
+ * is full, or when the previous version of it is still being dispatched.
+ */
 int irq_register_handler(interrupt_controller_t *ic, interrupt_source_t source,
                          irq_handler_t handler, void *context);
+int irq_remove_handler(interrupt_controller_t *ic, interrupt_source_t source,
+                       irq_handler_t handler, void *context);
 int irq_unregister_handler(interrupt_controller_t *ic, interrupt_source_t source);
+int irq_handler_count(interrupt_controller_t *ic, interrupt_source_t source);
+int irq_register_deferred(interrupt_controller_t *ic, interrupt_source_t source,
+                          irq_handler_t handler, void *context);
+
+/*
+ * Fast handler: runs in the raising context, possibly a signal handler, so
+ * it must be async-signal-safe and bounded. Set it before enabling the
+ * source; NULL removes it. The normal chain still runs at dispatch.
+ */
+int irq_set_fast_handler(interrupt_controller_t *ic, interrupt_source_t source,
+                         irq_handler_t handler, void *context);
+
+/* Priorities (0 = most urgent); equal levels dispatch lowest source first */
+int irq_set_priority(interrupt_controller_t *ic, interrupt_source_t source,
+                     uint8_t priority);
+int irq_get_priority(interrupt_controller_t *ic, interrupt_source_t source);
 
 /* IRQ enable/disable */
 int irq_enable(interrupt_controller_t *ic, interrupt_source_t source);
@@ -51,6 +182,27 @@ int irq_disable(interrupt_controller_t *ic, interrupt_source_t source);
 void irq_enable_all(interrupt_controller_t *ic);
 void irq_disable_all(interrupt_controller_t *ic);
 
+/* Coalescing (0 disables each limit) and storm detection */
+int irq_set_coalesce(interrupt_controller_t *ic, interrupt_source_t source,
+                     uint32_t max_events, uint32_t max_delay_us);
+int irq_set_storm_threshold(interrupt_controller_t *ic, interrupt_source_t source,
+                            uint32_t events_per_window);
+int irq_get_merged(interrupt_controller_t *ic, interrupt_source_t source);
+int irq_get_source_stats(interrupt_controller_t *ic, interrupt_source_t source,
+                         irq_source_stats_t *stats);
+uint32_t irq_get_throttled_mask(interrupt_controller_t *ic);
+
+/*
+ * Counters and latency histograms. Dispatch records into local storage
+ * until irq_set_stats points it at another block (normally the shared
+ * memory status region); NULL switches back to local storage.
+ */
+int irq_set_stats(interrupt_controller_t *ic, shm_irq_stats_t *stats);
+const shm_irq_stats_t* irq_get_stats(interrupt_controller_t *ic);
+
+/* Emit a TRACE_IRQ record per delivery into trace (NULL stops tracing) */
+int irq_set_trace(interrupt_controller_t *ic, trace_t *trace);
+
 /* Trigger and process interrupts */
 void irq_trigger(interrupt_controller_t *ic, interrupt_source_t source);
 int irq_process_pending(interrupt_controller_t *ic);
@@ -60,8 +212,16 @@ bool irq_is_pending(interrupt_controller_t *ic, interrupt_source_t source);
 uint32_t irq_get_pending_mask(interrupt_controller_t *ic);
 void irq_clear(interrupt_controller_t *ic, interrupt_source_t source);
 
+/* Bottom halves: run inline, or hand them to a dedicated worker thread */
+int irq_run_deferred(interrupt_controller_t *ic);
+int irq_start_worker(interrupt_controller_t *ic);
+void irq_stop_worker(interrupt_controller_t *ic);
+
 /* Signal-based interrupt simulation */
 int irq_setup_signal_handler(interrupt_controller_t *ic);
 void irq_signal_handler(int signum);
 
+/* Raise the IRQ mapped to a signal from normal (non-handler) context */
+int irq_handle_signal(interrupt_controller_t *ic, int signum);
+
 #endif /* INTERRUPT_HANDLER_H */
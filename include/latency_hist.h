@@ -0,0 +1,36 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+
+/*
+ * HDR-style log-linear latency histogram. Values (ns) below 2^SUB_BITS get
+ * exact buckets; above that every power of two is split into 2^SUB_BITS
+ * linear sub-buckets, bounding relative error to 1/2^SUB_BITS (6.25%).
+ * Fixed size and pointer-free so it can live in shared memory.
+ */
+#define LAT_HIST_SUB_BITS   4
+#define LAT_HIST_SUB_COUNT  (1u << LAT_HIST_SUB_BITS)
+#define LAT_HIST_BUCKETS    (LAT_HIST_SUB_COUNT * (33 - LAT_HIST_SUB_BITS))
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint32_t min_ns;
+    uint32_t max_ns;
+    uint32_t buckets[LAT_HIST_BUCKETS];
+} lat_hist_t;
+
+/* Recording (single writer) */
+void lat_hist_reset(lat_hist_t *h);
+void lat_hist_record(lat_hist_t *h, uint64_t ns);
+
+/* Queries; per_10k is the percentile in hundredths (9900 = p99) */
+uint32_t lat_hist_percentile(const lat_hist_t *h, uint32_t per_10k);
+uint32_t lat_hist_mean(const lat_hist_t *h);
+
+/* Bucket mapping */
+uint32_t lat_hist_bucket_index(uint32_t ns);
+uint32_t lat_hist_bucket_floor(uint32_t index);
+
+#endif /* LATENCY_HIST_H */
@@ -0,0 +1,55 @@
+#ifndef LOG_QUEUE_H
+#define LOG_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Queue depth in lines (must be a power of two) */
+#ifndef LOG_QUEUE_DEPTH
+#define LOG_QUEUE_DEPTH     256
+#endif
+
+#if (LOG_QUEUE_DEPTH & (LOG_QUEUE_DEPTH - 1)) != 0
+#error "LOG_QUEUE_DEPTH must be a power of two"
+#endif
+
+/* Longest line kept; longer ones are truncated */
+#define LOG_LINE_MAX        128
+
+/* Slot turn follows the command ring: pos while free, pos + 1 once written */
+typedef struct {
+    _Atomic uint32_t turn;
+    char text[LOG_LINE_MAX];
+} log_slot_t;
+
+/*
+ * Lock-free multi-producer, single-consumer line queue. Real-time threads
+ * format into a slot and move on; only the logging thread touches stdio.
+ * A producer never blocks: with the queue full the line is dropped and
+ * counted.
+ */
+typedef struct {
+    _Alignas(64) _Atomic uint32_t head;
+    _Alignas(64) uint32_t tail;             /* Consumer only */
+    _Alignas(64) _Atomic uint32_t wake_seq; /* Futex word for the consumer */
+    _Atomic uint32_t waiters;
+    _Atomic uint64_t dropped;
+    _Alignas(64) log_slot_t slots[LOG_QUEUE_DEPTH];
+} log_queue_t;
+
+void log_queue_init(log_queue_t *q);
+
+/* Producer side: 0 when queued, -1 on bad arguments, -2 when dropped */
+int log_printf(log_queue_t *q, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Consumer side: write every queued line to out, returning the count */
+int log_queue_drain(log_queue_t *q, FILE *out);
+
+/* Sleep until a line is queued or timeout_ms passes; 1 if lines are ready */
+int log_queue_wait(log_queue_t *q, uint32_t timeout_ms);
+
+uint64_t log_queue_dropped(log_queue_t *q);
+
+#endif /* LOG_QUEUE_H */
@@ -0,0 +1,84 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include "motor_controller.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Longest move, in control ticks */
+#ifndef MOTION_TABLE_TICKS
+#define MOTION_TABLE_TICKS      4096
+#endif
+
+/* Motor speed is counts/tick * 100, capped at 10000 */
+#define MOTION_MAX_VELOCITY     100
+
+typedef enum {
+    MOTION_TRAPEZOID = 0,       /* Constant acceleration ramps */
+    MOTION_SCURVE               /* Jerk-limited ramps */
+} motion_shape_t;
+
+/*
+ * Move limits in control-tick units. accel_ticks is how long a ramp from
+ * rest to max_velocity takes; S-curves round each corner of that ramp over
+ * jerk_ticks.
+ */
+typedef struct {
+    uint32_t max_velocity;      /* counts per tick, 1..MOTION_MAX_VELOCITY */
+    uint32_t accel_ticks;
+    uint32_t jerk_ticks;
+} motion_limits_t;
+
+/* One planned move: the position change to apply on each tick */
+typedef struct {
+    int16_t delta[MOTION_TABLE_TICKS];
+    uint32_t length;
+    uint32_t pos;
+    uint32_t ramp_ticks;        /* Constant-acceleration ramp length, bounds blending */
+    int32_t sign;
+    int32_t target;
+    bool planned;
+    bool running;
+} motion_move_t;
+
+/*
+ * Per-axis motion engine. A move is planned once, when it is commanded;
+ * each tick then costs one table load. One further move can be queued.
+ * When it goes the same way, it starts while the current one is still
+ * decelerating, so the ramps overlap and the axis does not stop in between.
+ */
+typedef struct {
+    motion_limits_t limits;
+    motion_move_t moves[2];
+    uint8_t current;            /* Index of the move that started first */
+    uint32_t blend;             /* Ticks the queued move overlaps the current one */
+    int32_t setpoint;           /* Position commanded so far */
+    bool following;             /* Driving a motor lane */
+} motion_profile_t;
+
+/* Setup; position is where the axis is now */
+int motion_profile_init(motion_profile_t *mp, const motion_limits_t *limits,
+                        int32_t position);
+
+/*
+ * Plan a move to target. Starts at once when idle, otherwise queues behind
+ * the current move. -2 when a move is already queued, -3 when the move
+ * would take more than MOTION_TABLE_TICKS ticks.
+ */
+int motion_profile_move(motion_profile_t *mp, int32_t target, motion_shape_t shape);
+void motion_profile_abort(motion_profile_t *mp);
+
+/* Next tick's position change; returns 1 while a move runs, else 0 */
+int motion_profile_step(motion_profile_t *mp, int32_t *delta);
+
+bool motion_profile_active(motion_profile_t *mp);
+int32_t motion_profile_setpoint(motion_profile_t *mp);
+
+/*
+ * Drive one motor lane from the profile; call before motor_update_lanes.
+ * The lane runs at exactly the tick's delta, so its integrated position
+ * equals the setpoint. A lane in fault aborts the profile (-2).
+ */
+int motion_profile_follow(motion_profile_t *mp, const motor_lanes_t *l, uint32_t axis);
+
+#endif /* MOTION_PROFILE_H */
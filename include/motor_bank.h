@@ -0,0 +1,60 @@
+#ifndef MOTOR_BANK_H
+#define MOTOR_BANK_H
+
+#include "motor_controller.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MOTOR_BANK_MAX_AXES 64
+
+/*
+ * N axes driven by one process. State is kept as parallel arrays so
+ * motor_bank_update steps every axis in one pass (see motor_update_lanes).
+ * Axis i uses regs[i] from the register file array given at init.
+ */
+typedef struct {
+    register_file_t *regs;
+    uint32_t axes;
+    _Alignas(64) motor_state_t state[MOTOR_BANK_MAX_AXES];
+    _Alignas(64) motor_fault_t fault_code[MOTOR_BANK_MAX_AXES];
+    _Alignas(64) uint32_t target_speed[MOTOR_BANK_MAX_AXES];
+    _Alignas(64) uint32_t current_speed[MOTOR_BANK_MAX_AXES];
+    _Alignas(64) int32_t position[MOTOR_BANK_MAX_AXES];
+    _Alignas(64) motor_direction_t direction[MOTOR_BANK_MAX_AXES];
+    motor_pid_t pid[MOTOR_BANK_MAX_AXES];     /* Closed-loop axes only; not in the kernel */
+} motor_bank_t;
+
+/* Bank management; regs must hold `axes` register files */
+int motor_bank_init(motor_bank_t *bank, register_file_t *regs, uint32_t axes);
+uint32_t motor_bank_axes(motor_bank_t *bank);
+
+/* Lane view of the bank, for code that works on motor_lanes_t */
+motor_lanes_t motor_bank_lanes(motor_bank_t *bank);
+
+/* Per-axis commands (-1 for a bad axis, otherwise as motor_controller) */
+int motor_bank_start(motor_bank_t *bank, uint32_t axis, uint32_t speed,
+                     motor_direction_t dir);
+int motor_bank_stop(motor_bank_t *bank, uint32_t axis);
+int motor_bank_brake(motor_bank_t *bank, uint32_t axis);
+int motor_bank_set_speed(motor_bank_t *bank, uint32_t axis, uint32_t speed);
+int motor_bank_reset(motor_bank_t *bank, uint32_t axis);
+int motor_bank_inject_fault(motor_bank_t *bank, uint32_t axis, motor_fault_t fault);
+int motor_bank_clear_fault(motor_bank_t *bank, uint32_t axis);
+
+/* Closed-loop speed control (see motor_lane_close_loop) */
+int motor_bank_set_pid_gains(motor_bank_t *bank, uint32_t axis,
+                             const motor_pid_gains_t *gains);
+int motor_bank_set_closed_loop(motor_bank_t *bank, uint32_t axis, bool enable);
+int motor_bank_close_loop(motor_bank_t *bank, uint32_t axis, int32_t measured);
+
+/* Step every axis (call periodically) */
+int motor_bank_update(motor_bank_t *bank);
+
+/* Status functions */
+motor_state_t motor_bank_get_state(motor_bank_t *bank, uint32_t axis);
+motor_fault_t motor_bank_get_fault(motor_bank_t *bank, uint32_t axis);
+uint32_t motor_bank_get_speed(motor_bank_t *bank, uint32_t axis);
+int32_t motor_bank_get_position(motor_bank_t *bank, uint32_t axis);
+bool motor_bank_any_running(motor_bank_t *bank);
+
+#endif /* MOTOR_BANK_H */
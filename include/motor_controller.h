@@ -3,6 +3,7 @@
 
 #include "device_registers.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Motor states */
 typedef enum {
@@ -28,6 +29,32 @@ typedef enum {
     MOTOR_FAULT_OVERCURRENT
 } motor_fault_t;
 
+/* PID gains are Q16.16 fixed point, per control tick */
+#define MOTOR_PID_Q         16
+#define MOTOR_PID_ONE       (1 << MOTOR_PID_Q)
+
+typedef struct {
+    int32_t kp;
+    int32_t ki;
+    int32_t kd;
+} motor_pid_gains_t;
+
+/*
+ * Speed loop state. The integrator is kept in Q16.16 and only accumulates
+ * while the output is not saturated in the direction of the error (with a
+ * hard clamp to the output range), so it cannot wind up while the motor is
+ * stalled or accelerating at its limit. The derivative acts on the
+ * measurement, so setpoint steps do not kick the output.
+ */
+typedef struct {
+    motor_pid_gains_t gains;
+    int64_t integral;
+    int32_t prev_measured;
+    uint32_t output;            /* Last drive command */
+    bool primed;                /* prev_measured is valid */
+    bool enabled;
+} motor_pid_t;
+
 /* Motor controller context */
 typedef struct {
     register_file_t *regs;
@@ -37,8 +64,57 @@ typedef struct {
     uint32_t current_speed;
     int32_t position;
     motor_direction_t direction;
+    motor_pid_t pid;
 } motor_controller_t;
 
+/*
+ * Struct-of-arrays view of one or more axes, each with its own register
+ * file. A motor_controller_t is a single lane (its own fields); a
+ * motor_bank_t keeps many lanes in contiguous arrays. Every motor operation
+ * is implemented once, on lanes.
+ */
+typedef struct {
+    motor_state_t *state;
+    motor_fault_t *fault_code;
+    uint32_t *target_speed;
+    uint32_t *current_speed;
+    int32_t *position;
+    motor_direction_t *direction;
+    motor_pid_t *pid;
+    register_file_t *regs;          /* regs[i] belongs to lane i */
+} motor_lanes_t;
+
+/* Lane operations (axis indexes a lane; no bounds check) */
+int motor_lane_start(const motor_lanes_t *l, uint32_t axis, uint32_t speed,
+                     motor_direction_t dir);
+int motor_lane_stop(const motor_lanes_t *l, uint32_t axis);
+int motor_lane_brake(const motor_lanes_t *l, uint32_t axis);
+int motor_lane_set_speed(const motor_lanes_t *l, uint32_t axis, uint32_t speed);
+int motor_lane_reset(const motor_lanes_t *l, uint32_t axis);
+void motor_lane_inject_fault(const motor_lanes_t *l, uint32_t axis, motor_fault_t fault);
+int motor_lane_clear_fault(const motor_lanes_t *l, uint32_t axis);
+
+/*
+ * Closed-loop speed control. Call after motor_update_lanes with the
+ * measured speed: the ramped speed becomes the PID setpoint and the PID
+ * output is written to REG_MOTOR_SPEED as the drive command. -2 when the
+ * lane is open-loop.
+ */
+int motor_lane_set_closed_loop(const motor_lanes_t *l, uint32_t axis, bool enable);
+int motor_lane_close_loop(const motor_lanes_t *l, uint32_t axis, int32_t measured);
+
+/* Integer-only PID step; output is clamped to 0..max speed */
+void motor_pid_set_gains(motor_pid_t *pid, const motor_pid_gains_t *gains);
+void motor_pid_reset(motor_pid_t *pid);
+uint32_t motor_pid_step(motor_pid_t *pid, int32_t setpoint, int32_t measured);
+
+/*
+ * Batched state machine step for `count` lanes: a fault scan over the
+ * status registers, one branch-free ramp/integrate pass over the arrays,
+ * then the register write-back.
+ */
+void motor_update_lanes(const motor_lanes_t *l, uint32_t count);
+
 /* Motor controller functions */
 int motor_init(motor_controller_t *mc, register_file_t *regs);
 int motor_start(motor_controller_t *mc, uint32_t speed, motor_direction_t dir);
@@ -57,6 +133,11 @@ uint32_t motor_get_speed(motor_controller_t *mc);
 int32_t motor_get_position(motor_controller_t *mc);
 bool motor_is_running(motor_controller_t *mc);
 
+/* Closed-loop speed control, fed the measured speed each tick */
+int motor_set_pid_gains(motor_controller_t *mc, const motor_pid_gains_t *gains);
+int motor_set_closed_loop(motor_controller_t *mc, bool enable);
+int motor_close_loop(motor_controller_t *mc, int32_t measured);
+
 /* Fault injection for testing */
 void motor_inject_fault(motor_controller_t *mc, motor_fault_t fault);
 int motor_clear_fault(motor_controller_t *mc);
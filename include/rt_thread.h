@@ -0,0 +1,36 @@
+#ifndef RT_THREAD_H
+#define RT_THREAD_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define RT_THREAD_ANY_CPU       (-1)
+#define RT_THREAD_MAX_PRIORITY  99
+
+/*
+ * Scheduling for one driver thread. priority 0 keeps the default time-shared
+ * policy; 1..RT_THREAD_MAX_PRIORITY selects SCHED_FIFO at that priority.
+ * cpu pins the thread to one core, or RT_THREAD_ANY_CPU leaves it floating.
+ */
+typedef struct {
+    int cpu;
+    int priority;
+} rt_thread_attr_t;
+
+/*
+ * Apply attr to a running thread: 0 on success, -1 for an invalid attr,
+ * -3 when the system refused (no such core, or no CAP_SYS_NICE for
+ * SCHED_FIFO). The thread keeps running either way. Affinity is applied
+ * before the policy, so a refused priority still leaves the thread pinned.
+ */
+int rt_thread_set(pthread_t thread, const rt_thread_attr_t *attr);
+int rt_thread_apply(const rt_thread_attr_t *attr);     /* Calling thread */
+
+/*
+ * Lock all current and future pages and pre-fault stack_bytes of the
+ * calling thread's stack, so the control path takes no page faults.
+ * 0 on success, -3 when the lock was refused (e.g. RLIMIT_MEMLOCK).
+ */
+int rt_lock_memory(size_t stack_bytes);
+
+#endif /* RT_THREAD_H */
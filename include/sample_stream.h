@@ -0,0 +1,84 @@
+#ifndef SAMPLE_STREAM_H
+#define SAMPLE_STREAM_H
+
+#include "sensor_array.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define SAMPLE_STREAM_NAME "/motor_driver_stream"
+
+/* Stream depth in samples (must be a power of two) */
+#ifndef SAMPLE_STREAM_DEPTH
+#define SAMPLE_STREAM_DEPTH         4096
+#endif
+
+#if (SAMPLE_STREAM_DEPTH & (SAMPLE_STREAM_DEPTH - 1)) != 0
+#error "SAMPLE_STREAM_DEPTH must be a power of two"
+#endif
+
+#define SAMPLE_STREAM_MAX_READERS   8
+
+/*
+ * Stream slot. seq is a per-slot seqlock: 2 * pos + 1 while the writer is
+ * filling position pos, 2 * pos + 2 once it is complete. A reader that sees
+ * any other value knows the slot was recycled under it.
+ */
+typedef struct {
+    _Atomic uint64_t seq;
+    sensor_sample_t sample;
+} stream_slot_t;
+
+/* Registered reader; cursor and lost are published for monitoring only */
+typedef struct {
+    _Alignas(64) _Atomic int32_t owner;     /* Owning pid, 0 when free */
+    _Atomic uint64_t cursor;
+    _Atomic uint64_t lost;
+} stream_reader_slot_t;
+
+/*
+ * Single-writer, multi-reader broadcast ring in its own shared memory
+ * region. The driver never waits for readers: a reader that falls more
+ * than SAMPLE_STREAM_DEPTH samples behind skips ahead and counts the loss.
+ */
+typedef struct sample_stream {
+    uint32_t depth;
+    _Alignas(64) _Atomic uint64_t head;     /* Samples published so far */
+    _Atomic uint32_t wake_seq;              /* Futex word for sleeping readers */
+    _Atomic uint32_t waiters;
+    bool anonymous;                         /* From sample_stream_create_private */
+    _Alignas(64) stream_reader_slot_t readers[SAMPLE_STREAM_MAX_READERS];
+    _Alignas(64) stream_slot_t slots[SAMPLE_STREAM_DEPTH];
+} sample_stream_t;
+
+/* Process-local reader handle */
+typedef struct {
+    sample_stream_t *stream;
+    int index;
+    uint64_t cursor;
+    uint64_t lost;
+} sample_stream_reader_t;
+
+/* Region management; create initialises the region, open maps it as is */
+sample_stream_t* sample_stream_create(void);
+sample_stream_t* sample_stream_open(void);
+
+/* A region only this process (and its children) can see, e.g. for tests */
+sample_stream_t* sample_stream_create_private(void);
+void sample_stream_destroy(sample_stream_t *stream);
+void sample_stream_close(sample_stream_t *stream);
+
+/* Writer side (driver only) */
+int sample_stream_publish(sample_stream_t *stream, const sensor_sample_t *samples,
+                          uint32_t count);
+int sample_stream_reader_count(sample_stream_t *stream);
+
+/* Reader side; a new reader starts at the live head */
+int sample_stream_attach(sample_stream_t *stream, sample_stream_reader_t *reader);
+void sample_stream_detach(sample_stream_reader_t *reader);
+int sample_stream_read(sample_stream_reader_t *reader, sensor_sample_t *samples,
+                       uint32_t max);
+int sample_stream_wait(sample_stream_reader_t *reader, uint32_t timeout_ms);
+uint64_t sample_stream_available(sample_stream_reader_t *reader);
+
+#endif /* SAMPLE_STREAM_H */
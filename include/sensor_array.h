@@ -3,9 +3,60 @@
 
 #include "device_registers.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
-#define SENSOR_COUNT        4
-#define SENSOR_BUFFER_SIZE  16
+#define SENSOR_COUNT        4           /* Built-in channels, ids 0..3 */
+
+/* Capacity of the runtime sensor table; per-sensor bitmasks limit it to 32 */
+#ifndef SENSOR_MAX
+#define SENSOR_MAX          32
+#endif
+
+#if SENSOR_MAX < SENSOR_COUNT || SENSOR_MAX > 32
+#error "SENSOR_MAX must be between SENSOR_COUNT and 32"
+#endif
+
+/* Timing wheel size for sensor_array_tick (must be a power of two) */
+#ifndef SENSOR_WHEEL_SLOTS
+#define SENSOR_WHEEL_SLOTS  64
+#endif
+
+#if (SENSOR_WHEEL_SLOTS & (SENSOR_WHEEL_SLOTS - 1)) != 0
+#error "SENSOR_WHEEL_SLOTS must be a power of two"
+#endif
+#define SENSOR_BUFFER_SIZE  256         /* Inline (default) capacity */
+#define SENSOR_BUFFER_MAX   (1u << 20)  /* Largest configurable capacity */
+
+#if (SENSOR_BUFFER_SIZE & (SENSOR_BUFFER_SIZE - 1)) != 0
+#error "SENSOR_BUFFER_SIZE must be a power of two"
+#endif
+
+/* Sensor id recorded for samples pushed without a source sensor */
+#define SENSOR_ID_NONE      0xFF
+
+/* Per-sample flags */
+#define SENSOR_SAMPLE_CLAMPED   (1 << 0)    /* Value was clamped to the sensor range */
+#define SENSOR_SAMPLE_GAP       (1 << 1)    /* Earlier samples from this sensor were lost */
+#define SENSOR_SAMPLE_FILTERED  (1 << 2)    /* Output of the sensor's filter stage */
+
+/* Longest median/moving-average window */
+#define SENSOR_FILTER_TAPS      7
+
+/* Samples covered by the running min/max (must be a power of two) */
+#ifndef SENSOR_STATS_WINDOW
+#define SENSOR_STATS_WINDOW     64
+#endif
+
+#if (SENSOR_STATS_WINDOW & (SENSOR_STATS_WINDOW - 1)) != 0
+#error "SENSOR_STATS_WINDOW must be a power of two"
+#endif
+
+/* What a push does when the sample buffer is full */
+typedef enum {
+    SENSOR_OVERFLOW_DROP_NEWEST = 0,    /* Reject the new sample */
+    SENSOR_OVERFLOW_OVERWRITE_OLDEST    /* Evict the oldest sample */
+} sensor_overflow_policy_t;
 
 /* Sensor types */
 typedef enum {
@@ -23,6 +74,70 @@ typedef enum {
     SENSOR_STATE_ERROR
 } sensor_state_t;
 
+/* Spike rejection ahead of the smoothing filter */
+typedef enum {
+    SENSOR_SPIKE_NONE = 0,
+    SENSOR_SPIKE_MEDIAN,        /* Median of the last taps samples */
+    SENSOR_SPIKE_MEAN           /* Moving average of the last taps samples */
+} sensor_spike_t;
+
+/*
+ * Per-sensor filter stage, run on every sample in sensor_array_update:
+ * spike rejection, then an EMA with weight 2^-ema_shift (0 = off), then a
+ * one-stage CIC that emits the mean of every `decimate` samples (0 or 1 =
+ * every sample). All integer, with fixed-size state.
+ */
+typedef struct {
+    sensor_spike_t spike;
+    uint8_t taps;               /* 1..SENSOR_FILTER_TAPS, odd for the median */
+    uint8_t ema_shift;          /* 0..15 */
+    uint16_t decimate;
+} sensor_filter_t;
+
+/* Monotonic deque of (sample index, value) for a sliding min or max */
+typedef struct {
+    uint32_t index[SENSOR_STATS_WINDOW];
+    int32_t value[SENSOR_STATS_WINDOW];
+    uint32_t head;
+    uint32_t tail;
+} sensor_deque_t;
+
+/*
+ * Running statistics of the clamped samples, O(1) per sample: Welford mean
+ * and variance since the last reset, min/max over the last
+ * SENSOR_STATS_WINDOW samples, and how many samples exceeded threshold.
+ */
+typedef struct {
+    uint64_t count;
+    double mean;
+    double m2;
+    sensor_deque_t min;
+    sensor_deque_t max;
+    int32_t threshold;
+    uint64_t over_threshold;
+} sensor_stats_t;
+
+/* Copy of a sensor's statistics */
+typedef struct {
+    uint64_t count;
+    double mean;
+    double variance;            /* Population variance */
+    int32_t window_min;
+    int32_t window_max;
+    uint64_t over_threshold;
+} sensor_summary_t;
+
+/* Channel description for sensor_array_add */
+typedef struct {
+    sensor_type_t type;
+    int32_t min_value;
+    int32_t max_value;
+    uint32_t divider;           /* Sample every divider ticks; 0 = only on trigger */
+} sensor_config_t;
+
+/* Trip callback: runs inside sensor_array_update on the offending sample */
+typedef void (*sensor_trip_fn)(uint8_t sensor_id, int32_t value, void *context);
+
 /* Individual sensor */
 typedef struct {
     sensor_type_t type;
@@ -31,35 +146,184 @@ typedef struct {
     int32_t min_value;
     int32_t max_value;
     uint32_t sample_count;
+    uint32_t drop_count;        /* Samples from this sensor lost to overflow */
+
+    /* Rate scheduling (see sensor_array_tick) */
+    uint32_t divider;
+    uint64_t due_tick;
+    uint8_t wheel_next;         /* Next sensor in the same wheel slot, or SENSOR_ID_NONE */
+
+    /* Filter stage; off unless configured */
+    sensor_filter_t filter;
+    bool filter_on;
+    int32_t window[SENSOR_FILTER_TAPS];
+    int64_t window_sum;
+    uint8_t window_pos;
+    uint8_t window_fill;
+    int64_t ema;                /* Q16.16 */
+    bool ema_primed;
+    int64_t cic_sum;
+    uint16_t cic_count;
+    int32_t filtered;           /* Last filter output */
+    uint32_t filtered_count;
+
+    sensor_stats_t stats;
+
+    /* Protective trip on the raw reading; off while trip_fn is NULL */
+    int32_t trip_limit;
+    sensor_trip_fn trip_fn;
+    void *trip_context;
 } sensor_t;
 
-/* Sensor array context */
+/* One buffered sample (16 bytes when copied out) */
+typedef struct {
+    uint64_t timestamp_ns;      /* sim_clock_now_ns of the update that produced it */
+    int32_t value;
+    uint8_t sensor_id;          /* SENSOR_ID_NONE for untagged pushes */
+    uint8_t flags;              /* SENSOR_SAMPLE_* */
+} sensor_sample_t;
+
+/*
+ * Power-of-two sample ring with free-running head/tail indices masked on
+ * access. Lock-free for one producer (the driver) and one consumer thread:
+ * the consumer commits with a CAS on tail so that overwrite-oldest (which
+ * advances tail from the producer side) and buffer clears stay safe.
+ * Samples are stored as parallel arrays so filters can scan one field.
+ */
+typedef struct {
+    int32_t *values;
+    uint64_t *timestamps;
+    uint8_t *ids;
+    uint8_t *flags;
+    void *heap;                 /* Backing block for a resized ring, else NULL */
+    uint32_t capacity;
+    uint32_t mask;
+    sensor_overflow_policy_t policy;
+    uint32_t gap_mask;          /* Producer-only: sensors owed a GAP flag */
+    _Alignas(64) _Atomic uint32_t head;
+    _Alignas(64) _Atomic uint32_t tail;
+    _Atomic uint32_t dropped;
+} sensor_ring_t;
+
+/*
+ * Zero-copy view of buffered samples: at most two contiguous spans, the
+ * second one non-empty only when the data wraps around the end of the ring.
+ */
+typedef struct {
+    const int32_t *first;
+    uint32_t first_count;
+    const int32_t *second;
+    uint32_t second_count;
+} sensor_view_t;
+
+/* Struct-of-arrays span of buffered samples */
+typedef struct {
+    const int32_t *values;
+    const uint64_t *timestamps;
+    const uint8_t *ids;
+    const uint8_t *flags;
+    uint32_t count;
+} sensor_span_t;
+
+struct sample_stream;
+
+/*
+ * Sensor array context. The first `count` entries of sensors[] are live;
+ * init creates the SENSOR_COUNT built-in channels. Rate-divided sensors sit
+ * in a hashed timing wheel keyed by their next due tick, so a tick visits
+ * one slot and touches only the sensors filed there.
+ */
 typedef struct {
     register_file_t *regs;
-    sensor_t sensors[SENSOR_COUNT];
+    sensor_t sensors[SENSOR_MAX];
+    uint8_t count;
+    uint32_t sampling;              /* Bit per sensor in SENSOR_STATE_SAMPLING */
+    uint64_t tick;
+    uint8_t wheel[SENSOR_WHEEL_SLOTS];  /* First sensor per slot, or SENSOR_ID_NONE */
+    sensor_ring_t ring;
     int32_t buffer[SENSOR_BUFFER_SIZE];
-    uint8_t buffer_head;
-    uint8_t buffer_tail;
+    uint64_t buffer_ts[SENSOR_BUFFER_SIZE];
+    uint8_t buffer_ids[SENSOR_BUFFER_SIZE];
+    uint8_t buffer_flags[SENSOR_BUFFER_SIZE];
     bool continuous_mode;
+    struct sample_stream *stream;   /* Optional cross-process sample stream */
 } sensor_array_t;
 
 /* Sensor array functions */
 int sensor_array_init(sensor_array_t *sa, register_file_t *regs);
+void sensor_array_cleanup(sensor_array_t *sa);
 int sensor_array_enable(sensor_array_t *sa);
 int sensor_array_disable(sensor_array_t *sa);
 int sensor_array_trigger(sensor_array_t *sa);
+
+/*
+ * Runtime sensor table. sensor_array_add returns the new sensor's id, -1
+ * for a bad config, -2 when SENSOR_MAX sensors exist. A divider of N
+ * samples the sensor every Nth sensor_array_tick; 0 leaves it to
+ * sensor_array_trigger.
+ */
+int sensor_array_add(sensor_array_t *sa, const sensor_config_t *config);
+uint8_t sensor_array_count(sensor_array_t *sa);
+int sensor_set_rate(sensor_array_t *sa, uint8_t sensor_id, uint32_t divider);
+
+/*
+ * Advance one tick and start sampling the sensors that are due. Costs one
+ * wheel slot: sensors with dividers above SENSOR_WHEEL_SLOTS are looked at
+ * once per wheel turn, not every tick. -2 while the array is disabled.
+ */
+int sensor_array_tick(sensor_array_t *sa);
 int sensor_array_set_continuous(sensor_array_t *sa, bool enable);
+int sensor_array_set_stream(sensor_array_t *sa, struct sample_stream *stream);
+
+/*
+ * Filter stage (NULL turns it off). A filtered sensor publishes its filter
+ * outputs on the sample stream, flagged SENSOR_SAMPLE_FILTERED, instead of
+ * raw samples, so a decimating filter divides the stream rate by its
+ * factor. The sample buffer keeps raw samples.
+ */
+int sensor_set_filter(sensor_array_t *sa, uint8_t sensor_id, const sensor_filter_t *filter);
+
+/* Running statistics; the threshold defaults to the sensor's max_value */
+int sensor_get_stats(sensor_array_t *sa, uint8_t sensor_id, sensor_summary_t *out);
+int sensor_set_stats_threshold(sensor_array_t *sa, uint8_t sensor_id, int32_t threshold);
+int sensor_stats_reset(sensor_array_t *sa, uint8_t sensor_id);
+
+/*
+ * Trip: fn runs for every sample whose raw reading (before clamping) is at
+ * or above limit, before the sample is buffered or published. NULL fn
+ * disarms it.
+ */
+int sensor_set_trip(sensor_array_t *sa, uint8_t sensor_id, int32_t limit,
+                    sensor_trip_fn fn, void *context);
 
 /* Read sensor values */
 int32_t sensor_read(sensor_array_t *sa, uint8_t sensor_id);
+int32_t sensor_read_filtered(sensor_array_t *sa, uint8_t sensor_id);
+uint32_t sensor_filtered_count(sensor_array_t *sa, uint8_t sensor_id);
 int sensor_read_all(sensor_array_t *sa, int32_t *values, uint8_t count);
 
 /* Buffer operations */
+int sensor_buffer_configure(sensor_array_t *sa, uint32_t capacity,
+                            sensor_overflow_policy_t policy);
 int sensor_buffer_push(sensor_array_t *sa, int32_t value);
 int sensor_buffer_pop(sensor_array_t *sa, int32_t *value);
 int sensor_buffer_count(sensor_array_t *sa);
+uint32_t sensor_buffer_capacity(sensor_array_t *sa);
+uint32_t sensor_buffer_dropped(sensor_array_t *sa);
+uint32_t sensor_get_drop_count(sensor_array_t *sa, uint8_t sensor_id);
 void sensor_buffer_clear(sensor_array_t *sa);
 
+/* Bulk buffer operations */
+int sensor_buffer_push_bulk(sensor_array_t *sa, const int32_t *values, uint32_t count);
+int sensor_buffer_pop_bulk(sensor_array_t *sa, int32_t *values, uint32_t max);
+int sensor_buffer_peek_bulk(sensor_array_t *sa, sensor_view_t *view, uint32_t max);
+int sensor_buffer_consume(sensor_array_t *sa, uint32_t count);
+
+/* Tagged sample operations */
+int sensor_buffer_push_sample(sensor_array_t *sa, const sensor_sample_t *sample);
+int sensor_buffer_pop_sample(sensor_array_t *sa, sensor_sample_t *sample);
+int sensor_buffer_peek_samples(sensor_array_t *sa, sensor_span_t spans[2], uint32_t max);
+
 /* Status functions */
 sensor_state_t sensor_get_state(sensor_array_t *sa, uint8_t sensor_id);
 bool sensor_is_ready(sensor_array_t *sa);
@@ -3,10 +3,44 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
+#include "latency_hist.h"
 
 #define SHM_NAME "/motor_driver_shm"
-#define SHM_SIZE 4096
+
+/* Segment stamp; shm_attach only reuses a segment laid out by the same build */
+#define SHM_MAGIC           0x4D445348      /* "MDSH" */
+#define SHM_LAYOUT_VERSION  7
+
+/* Saved driver state format (shm_driver_state_t) */
+#define SHM_STATE_VERSION   1
+
+/* Command ring depth (must be a power of two) */
+#ifndef SHM_CMD_RING_DEPTH
+#define SHM_CMD_RING_DEPTH  64
+#endif
+
+#if (SHM_CMD_RING_DEPTH & (SHM_CMD_RING_DEPTH - 1)) != 0
+#error "SHM_CMD_RING_DEPTH must be a power of two"
+#endif
+
+/* Longest command frame; every op in a frame takes one ring slot */
+#ifndef SHM_FRAME_MAX_OPS
+#define SHM_FRAME_MAX_OPS   16
+#endif
+
+#if SHM_FRAME_MAX_OPS < 1 || SHM_FRAME_MAX_OPS > SHM_CMD_RING_DEPTH
+#error "SHM_FRAME_MAX_OPS must be between 1 and SHM_CMD_RING_DEPTH"
+#endif
+
+#define SHM_CACHE_LINE      64
+#define SHM_RESP_WORDS      8
+#define SHM_OP_RESP_WORDS   4       /* Result words kept per frame op */
+#define SHM_STATUS_SENSORS  4
+#define SHM_MAX_SENSORS     32
+#define SHM_IRQ_SOURCES     8       /* Room for every interrupt_source_t */
+#define SHM_MAX_AXES        64      /* Matches MOTOR_BANK_MAX_AXES */
 
 /* Command types for IPC */
 typedef enum {
@@ -16,9 +50,23 @@ typedef enum {
     CMD_MOTOR_SET_SPEED,
     CMD_SENSOR_READ,
     CMD_GET_STATUS,
-    CMD_RESET
+    CMD_RESET,
+    CMD_SET_TICK_PERIOD,    /* param1 = period in microseconds */
+    CMD_RESET_LOOP_STATS,
+    CMD_MOTOR_MOVE,         /* param1 = target position (int32), param2 = motion_shape_t */
+    CMD_SET_PID_GAIN,       /* param1 = SHM_PID_KP/KI/KD, param2 = Q16.16 gain (int32) */
+    CMD_SET_CLOSED_LOOP,    /* param1 = 1 for closed-loop speed control, 0 for open-loop */
+    CMD_SET_SENSOR_THRESHOLD, /* param1 = sensor id, param2 = threshold (int32) */
+    CMD_RESET_SENSOR_STATS,
+    CMD_SET_SENSOR_RATE,    /* param1 = sensor id, param2 = sample interval in us (0 = off) */
+    CMD_SET_FAULT_REACTION  /* param1 = fault_reaction_t for the axis */
 } command_type_t;
 
+/* Gain selectors for CMD_SET_PID_GAIN */
+#define SHM_PID_KP          0
+#define SHM_PID_KI          1
+#define SHM_PID_KD          2
+
 /* Response status */
 typedef enum {
     RESP_OK = 0,
@@ -27,56 +75,432 @@ typedef enum {
     RESP_INVALID_CMD
 } response_status_t;
 
-/* Shared memory structure */
+/* shm_command_t flags */
+#define SHM_CMD_NO_REPLY    (1u << 0)   /* Fire and forget: never completed */
+#define SHM_CMD_FRAME       (1u << 1)   /* Answered with one shm_frame_result_t */
+
+/* Command as seen by the driver */
 typedef struct {
-    pthread_mutex_t mutex;
-    pthread_cond_t cmd_ready;
-    pthread_cond_t resp_ready;
+    uint32_t seq_id;        /* Shared by every op of a frame */
+    command_type_t cmd;
+    uint32_t axis;          /* Motor axis the command addresses (0 by default) */
+    uint32_t param1;
+    uint32_t param2;
+    uint16_t frame_ops;     /* Ops in the frame this slot starts; 0 on the rest */
+    uint16_t flags;         /* SHM_CMD_* */
+} shm_command_t;
 
-    /* Command section */
+/* One op of a command frame, as submitted by a client */
+typedef struct {
     command_type_t cmd;
-    uint32_t cmd_param1;
-    uint32_t cmd_param2;
-    bool cmd_pending;
+    uint32_t axis;
+    uint32_t param1;
+    uint32_t param2;
+} shm_op_t;
 
-    /* Response section */
-    response_status_t resp_status;
-    int32_t resp_data[8];
-    bool resp_ready_flag;
+/* Aggregated answer to a frame: one status and result block per op */
+typedef struct {
+    response_status_t status;   /* First failing op's status, else RESP_OK */
+    uint32_t ops;
+    uint8_t op_status[SHM_FRAME_MAX_OPS];
+    int32_t data[SHM_FRAME_MAX_OPS][SHM_OP_RESP_WORDS];
+} shm_frame_result_t;
+
+/* Command ring slot; turn is the slot's publication sequence */
+typedef struct {
+    _Atomic uint32_t turn;
+    shm_command_t entry;
+} shm_cmd_slot_t;
+
+/*
+ * Lock-free multi-producer/single-consumer command ring. Clients claim a
+ * slot by advancing head, the driver drains from tail. head and tail live
+ * on separate cache lines so producers and the driver do not false-share.
+ */
+typedef struct {
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t head;
+    _Atomic uint32_t next_seq;  /* Frame id counter, kept apart from positions */
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t tail;
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t waiters;
+    _Atomic uint32_t wake;      /* Futex word the driver sleeps on for commands */
+    _Atomic uint32_t rejected;
+    uint32_t active_seq;     /* Last command handed to the driver */
+    _Alignas(SHM_CACHE_LINE) shm_cmd_slot_t slots[SHM_CMD_RING_DEPTH];
+} shm_cmd_ring_t;
+
+/*
+ * Completion slot, indexed by seq_id & (SHM_CMD_RING_DEPTH - 1). done_seq
+ * doubles as the slot's futex word: a client sleeps on it until it holds
+ * its own sequence id, so each waiter is woken only for its own response.
+ */
+typedef struct {
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t done_seq;
+    _Atomic uint32_t waiters;
+    response_status_t status;
+    int32_t data[SHM_RESP_WORDS];
+    shm_frame_result_t frame;   /* Frames only */
+} shm_resp_slot_t;
 
-    /* Status section */
+/* Subscription slots; the driver keeps one armed bit per slot */
+#define SHM_MAX_SUBS        32
+#define SHM_SUB_ANY         (-1)    /* SHM_SUB_STATE: fire on every state change */
+
+/* What a subscription watches; each fires on the edge into its condition */
+typedef enum {
+    SHM_SUB_STATE = 1,      /* index = axis; the axis enters state a */
+    SHM_SUB_FAULT,          /* index = axis; the fault code changes to a nonzero one */
+    SHM_SUB_POSITION,       /* index = axis; the position crosses a, either way */
+    SHM_SUB_SENSOR_BAND     /* index = sensor id; the value leaves [a, b] */
+} shm_sub_type_t;
+
+typedef struct {
+    shm_sub_type_t type;
+    uint32_t index;
+    int32_t a;
+    int32_t b;
+} shm_sub_spec_t;
+
+/* Latest notification of one subscription */
+typedef struct {
+    uint32_t count;         /* Notifications so far */
+    int32_t value;          /* State, fault code, position or sensor value that fired */
+    uint64_t tick;          /* Driver tick it fired on */
+} shm_sub_event_t;
+
+/*
+ * Slot lifecycle: free, claimed by a client, armed, primed by the driver,
+ * then draining once unsubscribed until the driver's next pass frees it,
+ * so a new subscriber never shares a slot with an evaluation of the old one.
+ */
+enum {
+    SHM_SUB_SLOT_FREE = 0,
+    SHM_SUB_SLOT_CLAIMED,
+    SHM_SUB_SLOT_ARMED,
+    SHM_SUB_SLOT_ACTIVE,
+    SHM_SUB_SLOT_DRAINING
+};
+
+/*
+ * One subscription. events is the subscriber's futex word: it changes on
+ * every notification and on unsubscribe, so a waiting client sleeps until
+ * something happens to its own subscription. gen is a seqlock over owner
+ * and spec, moved by every subscribe, so the driver never acts on a spec
+ * that was being replaced while it read it. The event payload sits under
+ * a seqlock; last is the driver's previous observation, for edge detection.
+ */
+typedef struct {
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t events;
+    _Atomic uint32_t waiters;
+    _Atomic uint32_t state;         /* SHM_SUB_SLOT_* */
+    _Atomic uint32_t gen;
+    int32_t owner;                  /* pid of the subscribing process */
+    shm_sub_spec_t spec;
+    int32_t last;                   /* Driver only */
+    _Atomic uint32_t event_seq;
+    uint32_t count;
+    int32_t value;
+    uint64_t tick;
+} shm_sub_slot_t;
+
+typedef struct {
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t armed;   /* Slots the driver evaluates */
+    _Atomic uint32_t draining;                          /* Slots waiting for it to let go */
+    shm_sub_slot_t slots[SHM_MAX_SUBS];
+} shm_sub_table_t;
+
+/* Driver status snapshot */
+typedef struct {
     uint32_t motor_state;
     uint32_t motor_speed;
     int32_t motor_position;
-    int32_t sensor_values[4];
+    int32_t sensor_values[SHM_STATUS_SENSORS];
     uint32_t fault_code;
+} shm_status_t;
+
+/* Per-axis motor status, struct-of-arrays like the motor bank */
+typedef struct {
+    uint32_t axes;
+    uint32_t state[SHM_MAX_AXES];
+    uint32_t speed[SHM_MAX_AXES];
+    int32_t position[SHM_MAX_AXES];
+    uint32_t fault_code[SHM_MAX_AXES];
+} shm_axes_status_t;
+
+/* Running sensor statistics (see sensor_summary_t), one entry per sensor */
+typedef struct {
+    uint32_t sensors;
+    uint64_t count[SHM_MAX_SENSORS];
+    double mean[SHM_MAX_SENSORS];
+    double variance[SHM_MAX_SENSORS];
+    int32_t window_min[SHM_MAX_SENSORS];
+    int32_t window_max[SHM_MAX_SENSORS];
+    uint64_t over_threshold[SHM_MAX_SENSORS];
+} shm_sensor_stats_t;
+
+/* Control loop phases with their own latency histogram */
+typedef enum {
+    LOOP_PHASE_MOTOR = 0,   /* motor_update */
+    LOOP_PHASE_SENSOR,      /* sensor_array_update (and trigger) */
+    LOOP_PHASE_IRQ,         /* irq_process_pending */
+    LOOP_PHASE_STATUS,      /* shm_update_status */
+    LOOP_PHASE_COMMAND,     /* draining and answering commands */
+    LOOP_PHASE_TICK,        /* whole control tick, state save included */
+    LOOP_PHASE_WAKEUP,      /* tick deadline to loop wakeup */
+    LOOP_PHASE_SAVE,        /* driver_save_state at the end of the tick */
+    LOOP_PHASE_COUNT
+} loop_phase_t;
+
+/* Control loop timing, written by the driver, readable by any client */
+typedef struct {
+    uint32_t period_us;
+    uint64_t ticks;
+    uint64_t missed_deadlines;  /* Timer expirations not serviced in time */
+    uint64_t overruns;          /* Ticks whose work exceeded the period */
+    lat_hist_t phases[LOOP_PHASE_COUNT];
+} shm_loop_stats_t;
+
+/* Per-source IRQ instrumentation, written by the dispatching thread */
+typedef struct {
+    uint64_t events[SHM_IRQ_SOURCES];       /* Raises seen while enabled */
+    uint64_t deliveries[SHM_IRQ_SOURCES];   /* Dispatches (coalesced raises count once) */
+    uint64_t storms[SHM_IRQ_SOURCES];
+    lat_hist_t raise_latency[SHM_IRQ_SOURCES];  /* Oldest undelivered raise to dispatch */
+    lat_hist_t handler_time[SHM_IRQ_SOURCES];   /* Whole handler chain */
+} shm_irq_stats_t;
+
+/* shm_axis_state_t flags */
+#define SHM_AXIS_PID_ENABLED    (1u << 0)
+#define SHM_AXIS_PID_PRIMED     (1u << 1)
+#define SHM_AXIS_TRIPPED        (1u << 2)   /* Fault already reacted to and counted */
+#define SHM_AXIS_MOVING         (1u << 3)   /* Was following a motion profile */
+
+/* One axis as the driver left it: lane, speed loop, trip config and drive registers */
+typedef struct {
+    uint32_t state;
+    uint32_t fault_code;
+    uint32_t direction;
+    uint32_t target_speed;
+    uint32_t current_speed;
+    int32_t position;
+    uint32_t flags;                 /* SHM_AXIS_* */
+    uint32_t reaction;              /* fault_reaction_t */
+    int32_t kp;
+    int32_t ki;
+    int32_t kd;
+    int32_t prev_measured;
+    int64_t integral;
+    uint32_t output;
+    uint32_t regs[4];               /* REG_MOTOR_CTRL..REG_MOTOR_POSITION */
+} shm_axis_state_t;
+
+/*
+ * Everything a restarted driver needs to carry on where the last one
+ * stopped. Only the first `axes` entries of axis[] are saved and covered by
+ * checksum, which runs from generation to the end of the last saved axis.
+ */
+typedef struct {
+    uint32_t version;               /* SHM_STATE_VERSION */
+    uint32_t checksum;
+    uint64_t generation;            /* Saves so far */
+    uint64_t tick;                  /* Next tick to run */
+    uint64_t trips;
+    uint32_t period_us;
+    uint32_t axes;
+    uint32_t sensors;
+    uint32_t sensor_interval_us[SHM_MAX_SENSORS];
+    int32_t sensor_threshold[SHM_MAX_SENSORS];
+    int32_t sensor_value[SHM_MAX_SENSORS];
+    shm_axis_state_t axis[SHM_MAX_AXES];
+} shm_driver_state_t;
+
+/*
+ * Two copies, written alternately by the driver alone. current names the
+ * last complete one, so a driver killed mid-save leaves the previous copy
+ * intact.
+ */
+typedef struct {
+    _Atomic uint32_t current;
+    shm_driver_state_t copy[2];
+} shm_state_store_t;
+
+/* Shared memory structure */
+typedef struct {
+    /* Stamp: SHM_MAGIC, SHM_LAYOUT_VERSION and sizeof(shared_mem_t), once initialised */
+    uint32_t magic;
+    uint32_t layout_version;
+    uint32_t size;
+
+    /* Command section */
+    shm_cmd_ring_t cmd_ring;
+
+    /* Response section */
+    shm_resp_slot_t resp_slots[SHM_CMD_RING_DEPTH];
+
+    /*
+     * Status section, published by the driver under a seqlock: status_seq is
+     * odd while an update is in progress. Readers never take a lock.
+     */
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t status_seq;
+    shm_status_t status;
+
+    /* Every axis, published under its own seqlock like status */
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t axes_seq;
+    shm_axes_status_t axes;
+
+    /* Sensor aggregates, same seqlock protocol */
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t sensor_stats_seq;
+    shm_sensor_stats_t sensor_stats;
+
+    /*
+     * Loop timing. Single writer; a concurrent copy may straddle one tick,
+     * but every counter it holds is individually valid.
+     */
+    _Alignas(SHM_CACHE_LINE) shm_loop_stats_t loop_stats;
+
+    /* IRQ counters and latencies, same single-writer rules as loop_stats */
+    _Alignas(SHM_CACHE_LINE) shm_irq_stats_t irq_stats;
+
+    /* Change subscriptions, evaluated by the driver every tick */
+    _Alignas(SHM_CACHE_LINE) shm_sub_table_t subs;
+
+    /* Driver state, saved every tick for a warm restart */
+    _Alignas(SHM_CACHE_LINE) shm_state_store_t saved;
+
+    /* The serving driver; commands wake its IPC thread on cmd_ring.wake, not a signal */
+    _Alignas(SHM_CACHE_LINE) int32_t driver_pid;
 
     /* Control flags */
-    bool shutdown_requested;
+    _Atomic bool shutdown_requested;
+    bool anonymous;                 /* From shm_create_private: no SHM_NAME */
 } shared_mem_t;
 
 /* Shared memory functions */
 shared_mem_t* shm_create(void);
+
+/* A segment only this process (and its children) can see, e.g. for a simulation */
+shared_mem_t* shm_create_private(void);
 shared_mem_t* shm_open_existing(void);
+
+/*
+ * Warm restart, driver side: map the segment a previous driver left behind
+ * without wiping it, so rings, completion slots, subscriptions and every
+ * client's mapping carry over. The segment holds no lock or condvar a
+ * dead process could leave behind; only the old driver's own words are
+ * reset (its wait registration and driver_pid), and a command it had taken
+ * off the ring but not answered is answered RESP_BUSY: it may or may not
+ * have run. NULL when there is no segment or its stamp is not this build's.
+ */
+shared_mem_t* shm_attach(void);
 void shm_destroy(shared_mem_t *shm);
 void shm_close(shared_mem_t *shm);
 
+/*
+ * Saved driver state (driver side). save copies the first state->axes axes
+ * into the copy not in use, checksums it and makes it current. load takes
+ * the current copy, or the other one when the current copy does not check
+ * out; -3 when neither holds a complete save of this SHM_STATE_VERSION.
+ */
+int shm_save_state(shared_mem_t *shm, const shm_driver_state_t *state);
+int shm_load_state(shared_mem_t *shm, shm_driver_state_t *out);
+
 /* Thread-safe operations */
 int shm_send_command(shared_mem_t *shm, command_type_t cmd,
                      uint32_t param1, uint32_t param2);
+int shm_submit_command(shared_mem_t *shm, command_type_t cmd,
+                       uint32_t param1, uint32_t param2, uint32_t *seq_id);
+int shm_submit_axis_command(shared_mem_t *shm, uint32_t axis, command_type_t cmd,
+                            uint32_t param1, uint32_t param2, uint32_t *seq_id);
 int shm_wait_response(shared_mem_t *shm, response_status_t *status,
                       int32_t *data, int data_count);
+
+/*
+ * Fire-and-forget command: queued like any other but never answered, so it
+ * costs no response slot and nobody waits for it.
+ */
+int shm_post_command(shared_mem_t *shm, uint32_t axis, command_type_t cmd,
+                     uint32_t param1, uint32_t param2);
+
+/*
+ * Command frame: up to SHM_FRAME_MAX_OPS ops in consecutive ring slots,
+ * claimed with a single CAS so no other client's commands land in between.
+ * The driver runs the whole frame in one pass, never split by a control
+ * tick, and answers it once. flags may hold SHM_CMD_NO_REPLY. Returns -2
+ * when the ring has no room for the whole frame.
+ */
+int shm_submit_frame(shared_mem_t *shm, const shm_op_t *ops, uint32_t count,
+                     uint32_t flags, uint32_t *seq_id);
+int shm_wait_frame(shared_mem_t *shm, uint32_t seq_id, shm_frame_result_t *result);
 int shm_get_command(shared_mem_t *shm, command_type_t *cmd,
                     uint32_t *param1, uint32_t *param2);
 int shm_try_get_command(shared_mem_t *shm, command_type_t *cmd,
                         uint32_t *param1, uint32_t *param2);
+int shm_poll_command(shared_mem_t *shm, shm_command_t *out);
+
+/*
+ * Take a whole frame (a single command is a frame of one): returns its op
+ * count, or -1 when nothing complete is queued. ops must hold
+ * SHM_FRAME_MAX_OPS entries. shm_poll_command takes one slot at a time.
+ */
+int shm_poll_frame(shared_mem_t *shm, shm_command_t *ops);
+int shm_pending_commands(shared_mem_t *shm);
+
+/* Block until a command is queued (0) or shutdown is requested (-2) */
+int shm_wait_commands(shared_mem_t *shm);
 int shm_send_response(shared_mem_t *shm, response_status_t status,
                       int32_t *data, int data_count);
 
-/* Status update */
+/* Per-request completion (keyed by the seq_id from shm_submit_command) */
+int shm_complete_command(shared_mem_t *shm, uint32_t seq_id,
+                         response_status_t status, int32_t *data, int data_count);
+int shm_wait_completion(shared_mem_t *shm, uint32_t seq_id,
+                        response_status_t *status, int32_t *data, int data_count);
+int shm_complete_frame(shared_mem_t *shm, uint32_t seq_id, const shm_frame_result_t *result);
+
+/* Status update (single writer: the driver) */
 int shm_update_status(shared_mem_t *shm, uint32_t motor_state,
                       uint32_t motor_speed, int32_t motor_position,
                       int32_t *sensor_values, uint32_t fault_code);
+int shm_publish_status(shared_mem_t *shm, const shm_status_t *status);
+
+/* Lock-free, torn-free status snapshot for any number of readers */
+int shm_read_status(shared_mem_t *shm, shm_status_t *out);
+
+/* Per-axis status (same seqlock protocol; only the first `axes` entries are copied) */
+int shm_publish_axes(shared_mem_t *shm, const shm_axes_status_t *axes);
+int shm_read_axes(shared_mem_t *shm, shm_axes_status_t *out);
+
+/* Sensor statistics (same seqlock protocol) */
+int shm_publish_sensor_stats(shared_mem_t *shm, const shm_sensor_stats_t *stats);
+int shm_read_sensor_stats(shared_mem_t *shm, shm_sensor_stats_t *out);
+
+/*
+ * Subscriptions (client side). shm_subscribe returns the subscription id,
+ * -1 for a bad spec, -2 when every slot is taken. Only the subscribing
+ * process may unsubscribe; others get -1. shm_wait_event sleeps
+ * until the notification count differs from seen, then copies the latest
+ * event; it returns -1 once the subscription is gone and -2 on shutdown.
+ */
+int shm_subscribe(shared_mem_t *shm, const shm_sub_spec_t *spec);
+int shm_unsubscribe(shared_mem_t *shm, int id);
+int shm_read_event(shared_mem_t *shm, int id, shm_sub_event_t *ev);
+int shm_wait_event(shared_mem_t *shm, int id, uint32_t seen, shm_sub_event_t *ev);
+
+/*
+ * Driver side, once per tick: check every armed subscription against the
+ * published axes and sensor values and wake the ones that fired. Slots
+ * unsubscribed since the last pass are freed first. Costs two loads when
+ * nothing is subscribed. Returns the number notified.
+ */
+int shm_eval_subscriptions(shared_mem_t *shm, const shm_axes_status_t *axes,
+                           const int32_t *sensors, uint32_t sensor_count, uint64_t tick);
+
+/* Loop timing statistics */
+void shm_reset_loop_stats(shared_mem_t *shm);
+int shm_read_loop_stats(shared_mem_t *shm, shm_loop_stats_t *out);
+
+/* IRQ statistics (recorded by irq_process_pending once attached) */
+void shm_reset_irq_stats(shared_mem_t *shm);
+int shm_read_irq_stats(shared_mem_t *shm, shm_irq_stats_t *out);
 
 /* Utility */
 bool shm_is_shutdown_requested(shared_mem_t *shm);
@@ -0,0 +1,39 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Driver time base. Every timestamp and interval the driver takes (sample
+ * times, IRQ latencies and coalescing windows, trip reactions, loop phases,
+ * trace records) comes from sim_clock_now_ns(): CLOCK_MONOTONIC normally,
+ * virtual time while a simulation holds the clock. Virtual time only moves
+ * when the simulation advances it, so a simulated run depends on its inputs
+ * alone, never on how fast the host is. The clock is process-wide: one
+ * simulation at a time. Async-signal-safe either way.
+ */
+extern _Atomic uint64_t sim_clock_virtual_ns;   /* 0: real time */
+
+static inline uint64_t sim_clock_now_ns(void) {
+    uint64_t now = atomic_load_explicit(&sim_clock_virtual_ns, memory_order_relaxed);
+    if (now) return now;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Freeze the clock at start_ns (> 0); -2 while a simulation already holds it */
+int sim_clock_start(uint64_t start_ns);
+
+/* Move virtual time forward; -1 when the clock is real */
+int sim_clock_advance(uint64_t ns);
+
+/* Back to CLOCK_MONOTONIC */
+void sim_clock_stop(void);
+bool sim_clock_is_virtual(void);
+
+#endif /* SIM_CLOCK_H */
@@ -0,0 +1,122 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "driver.h"
+#include "trace.h"
+#include <stdint.h>
+
+/* Script file: a sim_script_header_t, then count sim_input_t */
+#define SIM_MAGIC           0x4D49534D      /* "MSIM" */
+#define SIM_VERSION         1
+
+/* Virtual time at tick 0; nonzero, as 0 means real time to sim_clock */
+#define SIM_START_NS        1000000000ULL
+
+/* What a sim_input_t does */
+typedef enum {
+    SIM_INPUT_SENSOR = 1,   /* id = sensor, a = simulated value (int32) */
+    SIM_INPUT_COMMAND,      /* id = command_type_t, axis, a = param1, b = param2 */
+    SIM_INPUT_IRQ,          /* id = interrupt_source_t raised */
+    SIM_INPUT_FAULT         /* id = motor_fault_t injected on axis */
+} sim_input_type_t;
+
+/* One input, applied just before the tick it is stamped with */
+typedef struct {
+    uint32_t tick;
+    uint16_t type;          /* sim_input_type_t */
+    uint16_t id;
+    uint32_t axis;
+    uint32_t a;
+    uint32_t b;
+    uint32_t reserved;
+} sim_input_t;
+
+_Static_assert(sizeof(sim_input_t) == 24, "sim_input_t is stored as is in scripts");
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t input_size;
+    uint32_t count;
+} sim_script_header_t;
+
+/* A recorded or hand-written run: inputs in tick order */
+typedef struct {
+    sim_input_t *inputs;
+    uint32_t count;
+    uint32_t capacity;
+} sim_script_t;
+
+void sim_script_init(sim_script_t *s);
+void sim_script_free(sim_script_t *s);
+
+/* Append; -1 for an input stamped before the last one, -3 out of memory */
+int sim_script_add(sim_script_t *s, const sim_input_t *in);
+
+/* Script files; load replaces s's inputs, -3 when the file is not a script */
+int sim_script_save(const sim_script_t *s, const char *path);
+int sim_script_load(sim_script_t *s, const char *path);
+
+/*
+ * Append the commands a driver ran, from its trace or a fault dump. Each
+ * is stamped with the tick it ran ahead of, counting the first traced
+ * tick as 0. Only commands come back: everything else in a trace is the
+ * driver's own doing, which the replay recomputes.
+ */
+int sim_script_from_trace(sim_script_t *s, const trace_t *t);
+
+/*
+ * Simulation: the driver (see driver.h) on a private shm segment, with
+ * sim_clock held for the whole run. Every tick moves virtual time by the
+ * tick period and nothing waits on the host, so runs go as fast as the
+ * CPU allows. Logging is off, bottom halves run inline and no signal is
+ * routed to the driver, which leaves the inputs (played from a script or
+ * applied with sim_input) as the only thing a run depends on: the same
+ * inputs give the same digest, tick for tick.
+ */
+typedef struct {
+    driver_t drv;
+    const sim_script_t *script;     /* Played as its ticks come up; NULL for none */
+    uint32_t next;                  /* Next script input to apply */
+    sim_script_t *record;           /* Every applied input lands here; NULL for none */
+    uint64_t inputs;                /* Inputs applied so far */
+    uint64_t digest;                /* State after every tick, folded in */
+} sim_t;
+
+/* -1 for bad axes or period, -2 while another simulation holds the clock, -3 otherwise */
+int sim_init(sim_t *sim, uint32_t axes, uint32_t period_us);
+void sim_cleanup(sim_t *sim);
+
+/* Replay script from its first input; NULL stops playing */
+int sim_play(sim_t *sim, const sim_script_t *script);
+
+/* Record every input applied from now on into record (NULL stops) */
+int sim_record(sim_t *sim, sim_script_t *record);
+
+/* Apply one input ahead of the next tick: a command's response_status_t, else 0; -1 if invalid */
+int sim_input(sim_t *sim, const sim_input_t *in);
+
+/* Run ticks control ticks, with their script inputs; returns the ticks run */
+int sim_run(sim_t *sim, uint32_t ticks);
+
+/*
+ * Stand-in for axis 0's motor on simulated registers, run ahead of each
+ * tick: while the speed loop is closed, the velocity sensor closes 1/8 of
+ * the gap to the drive the last tick left. Does nothing on mapped
+ * registers, where the encoder reports the real speed.
+ */
+void sim_plant_step(driver_t *drv);
+
+/*
+ * Warm restart between two ticks: drop the driver as if its process had
+ * died and bring a new one up on the same segment from the state the last
+ * tick saved. -3 when there is no valid save.
+ */
+int sim_restart(sim_t *sim);
+
+/* Ticks run, virtual time now, and the state digest */
+unsigned long sim_ticks(const sim_t *sim);
+uint64_t sim_now_ns(const sim_t *sim);
+uint64_t sim_digest(const sim_t *sim);
+
+#endif /* SIMULATOR_H */
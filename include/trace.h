@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "sim_clock.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Default ring size in records (capacities must be powers of two) */
+#ifndef TRACE_DEFAULT_RECORDS
+#define TRACE_DEFAULT_RECORDS   65536
+#endif
+
+#if (TRACE_DEFAULT_RECORDS & (TRACE_DEFAULT_RECORDS - 1)) != 0
+#error "TRACE_DEFAULT_RECORDS must be a power of two"
+#endif
+
+#define TRACE_MAGIC             0x4352544Du     /* "MTRC" */
+#define TRACE_VERSION           1
+
+/* Record types; the meaning of a..d is listed per type */
+typedef enum {
+    TRACE_REG_WRITE = 1,    /* id = register file; a = offset, b = value, c = TRACE_REG_OP_* */
+    TRACE_STATE,            /* id = axis; a = old state, b = new state, c = fault code */
+    TRACE_IRQ,              /* id = source; a = raises merged, b = handler ns, c = priority */
+    TRACE_COMMAND,          /* id = command; a = axis, b = param1, c = param2, d = status */
+    TRACE_FAULT,            /* id = axis; a = fault, b = reaction, c = reaction ns */
+    TRACE_TICK,             /* id = 0; a = tick, b = duration ns, c = period us */
+    TRACE_TYPE_COUNT
+} trace_type_t;
+
+/* TRACE_REG_WRITE operations; value is the operand for set and clear */
+#define TRACE_REG_OP_WRITE      0
+#define TRACE_REG_OP_SET        1
+#define TRACE_REG_OP_CLEAR      2
+
+/*
+ * Fixed-size record. seq is index + 1 once the record is complete; it is
+ * zeroed while a writer fills the slot, so a reader can tell a finished
+ * record from one in flight or overwritten.
+ */
+typedef struct {
+    uint64_t time_ns;           /* sim_clock_now_ns */
+    _Atomic uint32_t seq;
+    uint16_t type;
+    uint16_t id;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+} trace_record_t;
+
+_Static_assert(sizeof(trace_record_t) == 32, "trace records must stay 32 bytes");
+
+/* File header; the records follow it */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    _Alignas(64) _Atomic uint64_t head;     /* Records claimed so far */
+    uint8_t reserved[56];
+} trace_header_t;
+
+/*
+ * Flight recorder: a ring of records in a memory-mapped file (or anonymous
+ * memory). Any thread, and signal handlers, can emit: a record costs a
+ * clock read, one atomic add and a 32-byte store, and the newest records
+ * overwrite the oldest. Because the file is mapped shared, the last
+ * records survive the driver crashing. Process-local handle.
+ */
+typedef struct {
+    trace_header_t *hdr;
+    trace_record_t *records;
+    uint64_t mask;
+    size_t map_len;
+    bool writable;
+} trace_t;
+
+/*
+ * Create a ring of capacity records (0 = TRACE_DEFAULT_RECORDS) in the file
+ * at path, truncating it, or in anonymous memory when path is NULL. -1 for
+ * a capacity that is not a power of two, -3 when the file cannot be mapped.
+ */
+int trace_open(trace_t *t, const char *path, uint32_t capacity);
+
+/* Map an existing trace or dump read-only; -3 if it is not a valid trace */
+int trace_open_file(trace_t *t, const char *path);
+void trace_close(trace_t *t);
+
+static inline void trace_emit(trace_t *t, uint16_t type, uint16_t id,
+                              uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint64_t now = sim_clock_now_ns();
+    uint64_t index = atomic_fetch_add_explicit(&t->hdr->head, 1, memory_order_relaxed);
+    trace_record_t *r = &t->records[index & t->mask];
+
+    atomic_store_explicit(&r->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    r->time_ns = now;
+    r->type = type;
+    r->id = id;
+    r->a = a;
+    r->b = b;
+    r->c = c;
+    r->d = d;
+
+    atomic_store_explicit(&r->seq, (uint32_t)(index + 1), memory_order_release);
+}
+
+/* Readable window: records [trace_first, trace_head) */
+uint64_t trace_head(const trace_t *t);
+uint64_t trace_first(const trace_t *t);
+
+/* Copy record index: 0, or -2 when it is in flight or was overwritten */
+int trace_read(const trace_t *t, uint64_t index, trace_record_t *out);
+
+/* Freeze the ring as it is now into a standalone file, readable like a trace */
+int trace_dump(const trace_t *t, const char *path);
+
+#endif /* TRACE_H */
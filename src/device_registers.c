@@ -1,36 +1,131 @@
 #include "device_registers.h"
-#include <string.h>
-#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 void reg_init(register_file_t *rf) {
     if (!rf) return;
-    memset(rf->regs, 0, sizeof(rf->regs));
+
+    /* Word by word: memset may not be used on volatile storage */
+    rf->regs = rf->sim;
+    for (uint32_t i = 0; i < REGISTER_FILE_SIZE / 4; i++) {
+        rf->regs[i] = 0;
+    }
+    rf->backend = REG_BACKEND_SIM;
+    rf->map = NULL;
+    rf->map_len = 0;
+    rf->trace = NULL;
+    rf->trace_id = 0;
+}
+
+/* Map len bytes of fd at offset, which need not be page aligned */
+static int map_window(register_file_t *rf, int fd, uint64_t offset, reg_backend_t backend) {
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t base = offset & ~(page - 1);
+    size_t delta = (size_t)(offset - base);
+    size_t len = delta + REGISTER_FILE_SIZE;
+
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)base);
+    close(fd);
+    if (map == MAP_FAILED) return -3;
+
+    rf->regs = (volatile uint32_t*)((char*)map + delta);
+    rf->backend = backend;
+    rf->map = map;
+    rf->map_len = len;
+
+    return 0;
+}
+
+int reg_init_mmio(register_file_t *rf, const char *path, uint64_t phys_addr) {
+    if (!rf || !path || (phys_addr & 3u) != 0) return -1;
+
+    int fd = open(path, O_RDWR | O_SYNC);
+    if (fd < 0) return -3;
+
+    return map_window(rf, fd, phys_addr, REG_BACKEND_MMIO);
+}
+
+int reg_init_shm(register_file_t *rf, const char *name, bool create) {
+    if (!rf || !name) return -1;
+
+    int fd = shm_open(name, create ? (O_CREAT | O_RDWR) : O_RDWR, 0666);
+    if (fd < 0) return -3;
+
+    if (create && ftruncate(fd, REGISTER_FILE_SIZE) < 0) {
+        close(fd);
+        return -3;
+    }
+
+    /* Touching a register past the end of a short object would raise SIGBUS */
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)REGISTER_FILE_SIZE) {
+        close(fd);
+        return -3;
+    }
+
+    int ret = map_window(rf, fd, 0, REG_BACKEND_SHM);
+    if (ret == 0 && create) {
+        /* An object left over from an earlier run keeps its contents */
+        for (uint32_t i = 0; i < REGISTER_FILE_SIZE / 4; i++) {
+            rf->regs[i] = 0;
+        }
+    }
+    return ret;
+}
+
+void reg_cleanup(register_file_t *rf) {
+    if (!rf) return;
+
+    if (rf->map) {
+        munmap(rf->map, rf->map_len);
+    }
+
+    trace_t *trace = rf->trace;
+    uint16_t id = rf->trace_id;
+    reg_init(rf);
+    reg_set_trace(rf, trace, id);
+}
+
+void reg_set_trace(register_file_t *rf, trace_t *t, uint16_t id) {
+    if (!rf) return;
+
+    rf->trace = t;
+    rf->trace_id = id;
+}
+
+reg_backend_t reg_backend(const register_file_t *rf) {
+    return rf ? rf->backend : REG_BACKEND_SIM;
 }
 
-uint32_t reg_read(register_file_t *rf, uint32_t offset) {
-    if (!rf || offset >= REGISTER_FILE_SIZE) {
+uint32_t reg_read_checked(register_file_t *rf, uint32_t offset) {
+    if (!rf || !REG_OFFSET_VALID(offset)) {
         return 0xFFFFFFFF;  /* Invalid read returns all 1s */
     }
     return rf->regs[offset / 4];
 }
 
-void reg_write(register_file_t *rf, uint32_t offset, uint32_t value) {
-    if (!rf || offset >= REGISTER_FILE_SIZE) {
+void reg_write_checked(register_file_t *rf, uint32_t offset, uint32_t value) {
+    if (!rf || !REG_OFFSET_VALID(offset)) {
         return;
     }
     rf->regs[offset / 4] = value;
+    reg_trace_write(rf, TRACE_REG_OP_WRITE, offset, value);
 }
 
-void reg_set_bits(register_file_t *rf, uint32_t offset, uint32_t bits) {
-    if (!rf || offset >= REGISTER_FILE_SIZE) {
+void reg_set_bits_checked(register_file_t *rf, uint32_t offset, uint32_t bits) {
+    if (!rf || !REG_OFFSET_VALID(offset)) {
         return;
     }
     rf->regs[offset / 4] |= bits;
+    reg_trace_write(rf, TRACE_REG_OP_SET, offset, bits);
 }
 
-void reg_clear_bits(register_file_t *rf, uint32_t offset, uint32_t bits) {
-    if (!rf || offset >= REGISTER_FILE_SIZE) {
+void reg_clear_bits_checked(register_file_t *rf, uint32_t offset, uint32_t bits) {
+    if (!rf || !REG_OFFSET_VALID(offset)) {
         return;
     }
     rf->regs[offset / 4] &= ~bits;
+    reg_trace_write(rf, TRACE_REG_OP_CLEAR, offset, bits);
 }
@@ -0,0 +1,645 @@
+#include "driver.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Limits for commanded moves: 50 counts/tick, 10-tick ramps, 4-tick jerk */
+static const motion_limits_t move_limits = { 50, 10, 4 };
+
+static const motor_pid_gains_t default_gains = {
+    MOTOR_PID_ONE / 2, MOTOR_PID_ONE / 20, 0        /* kp 0.5, ki 0.05, kd 0 */
+};
+
+_Static_assert(SENSOR_MAX <= SHM_MAX_SENSORS, "shm_sensor_stats_t is too small");
+
+/* Built-in channel rates: position and velocity 100 Hz, temperature 1 Hz, current 1 kHz */
+static const uint32_t default_sensor_interval_us[SENSOR_COUNT] = {
+    10000, 10000, 1000000, 1000
+};
+
+/* Over-current trip, straight from the sample */
+static void current_trip(uint8_t sensor_id, int32_t value, void *context) {
+    (void)sensor_id;
+    (void)value;
+    fault_trip_axis((fault_trip_t*)context, 0, MOTOR_FAULT_OVERCURRENT);
+}
+
+/* IRQ callback for motor faults; the fast handler has already reacted */
+static void motor_fault_handler(interrupt_source_t source, void *context) {
+    (void)source;
+    driver_t *drv = (driver_t*)context;
+    motor_bank_t *bank = &drv->motors;
+    for (uint32_t axis = 0; axis < motor_bank_axes(bank); axis++) {
+        if (motor_bank_get_state(bank, axis) == MOTOR_STATE_FAULT) {
+            log_printf(drv->log, "[IRQ] Motor fault detected on axis %u: %d\n", axis,
+                       motor_bank_get_fault(bank, axis));
+        }
+    }
+}
+
+/* Sensor ready bottom half: runs on the IRQ worker, never delays faults */
+static void sensor_ready_handler(interrupt_source_t source, void *context) {
+    (void)source;
+    driver_t *drv = (driver_t*)context;
+    log_printf(drv->log, "[IRQ] Sensor data ready, buffer count: %d\n",
+               sensor_buffer_count(&drv->sensors));
+}
+
+/* Put axis 0's registers on the backend named by spec */
+static int map_registers(register_file_t *rf, const char *spec) {
+    if (strcmp(spec, "sim") == 0) return 0;
+    if (strncmp(spec, "shm:", 4) == 0) return reg_init_shm(rf, spec + 4, false);
+    if (strncmp(spec, "uio:", 4) == 0) return reg_init_mmio(rf, spec + 4, 0);
+    if (strncmp(spec, "mem:", 4) == 0) {
+        return reg_init_mmio(rf, "/dev/mem", strtoull(spec + 4, NULL, 0));
+    }
+    return -1;
+}
+
+/* Turn each sensor's interval into a tick divider; the speed loop samples every tick */
+static void apply_sensor_rates(driver_t *drv) {
+    uint32_t period = drv->period_us;
+
+    for (uint8_t i = 0; i < sensor_array_count(&drv->sensors); i++) {
+        uint32_t divider = drv->sensor_interval_us[i] / period;
+        if (drv->sensor_interval_us[i] > 0 && divider == 0) divider = 1;
+        if (i == DRIVER_VELOCITY_SENSOR && drv->motors.pid[0].enabled) divider = 1;
+        sensor_set_rate(&drv->sensors, i, divider);
+    }
+}
+
+/* Recompute tick-based cadences after the period changes */
+static void apply_period(driver_t *drv) {
+    uint32_t period = drv->period_us;
+
+    drv->print_divider = DRIVER_STATUS_INTERVAL_US / period;
+    if (drv->print_divider == 0) drv->print_divider = 1;
+    apply_sensor_rates(drv);
+
+    drv->shm->loop_stats.period_us = period;
+}
+
+/* Close a timed phase: record its duration and return the end timestamp */
+static uint64_t phase_end(driver_t *drv, loop_phase_t phase, uint64_t start) {
+    uint64_t now = event_loop_now_ns();
+    lat_hist_record(&drv->shm->loop_stats.phases[phase], now - start);
+    return now;
+}
+
+int driver_init(driver_t *drv, uint32_t axes, uint32_t period_us, const char *backend,
+                shared_mem_t *shm) {
+    if (!drv || !backend || !shm) return -1;
+    if (axes == 0 || axes > MOTOR_BANK_MAX_AXES) return -1;
+    if (period_us < EVENT_LOOP_MIN_PERIOD_US || period_us > EVENT_LOOP_MAX_PERIOD_US) {
+        return -1;
+    }
+
+    memset(drv, 0, sizeof(*drv));
+    for (uint32_t i = 0; i < MOTOR_BANK_MAX_AXES; i++) {
+        reg_init(&drv->regs[i]);
+    }
+    int ret = map_registers(&drv->regs[0], backend);
+    if (ret < 0) return ret;
+
+    motor_bank_init(&drv->motors, drv->regs, axes);
+    for (uint32_t i = 0; i < axes; i++) {
+        motion_profile_init(&drv->profiles[i], &move_limits, 0);
+        motor_bank_set_pid_gains(&drv->motors, i, &default_gains);
+    }
+    sensor_array_init(&drv->sensors, &drv->regs[0]);
+    irq_init(&drv->irq, &drv->regs[0], NULL, &drv->sensors);
+
+    /* Faults reach the drives from the raise itself; the handlers below only report */
+    motor_lanes_t lanes = motor_bank_lanes(&drv->motors);
+    fault_trip_init(&drv->trip, &lanes, axes);
+    irq_set_fast_handler(&drv->irq, INT_MOTOR_FAULT, fault_trip_irq, &drv->trip);
+    irq_set_fast_handler(&drv->irq, INT_MOTOR_STALL, fault_trip_irq, &drv->trip);
+    sensor_set_trip(&drv->sensors, DRIVER_CURRENT_SENSOR, DRIVER_CURRENT_TRIP_LIMIT,
+                    current_trip, &drv->trip);
+
+    irq_register_handler(&drv->irq, INT_MOTOR_FAULT, motor_fault_handler, drv);
+    irq_register_handler(&drv->irq, INT_MOTOR_STALL, motor_fault_handler, drv);
+    irq_register_deferred(&drv->irq, INT_SENSOR_READY, sensor_ready_handler, drv);
+    irq_enable(&drv->irq, INT_MOTOR_FAULT);
+    irq_enable(&drv->irq, INT_MOTOR_STALL);
+    irq_enable(&drv->irq, INT_SENSOR_READY);
+
+    /* Throttle sensor-ready storms (e.g. a SIGUSR2 flood) above 10 kHz */
+    irq_set_storm_threshold(&drv->irq, INT_SENSOR_READY, 1000);
+
+    /* IRQ counters and latencies are recorded straight into shared memory */
+    drv->shm = shm;
+    irq_set_stats(&drv->irq, &shm->irq_stats);
+    sensor_array_enable(&drv->sensors);
+
+    memcpy(drv->sensor_interval_us, default_sensor_interval_us,
+           sizeof(default_sensor_interval_us));
+    drv->period_us = period_us;
+    apply_period(drv);
+
+    pthread_mutexattr_t lock_attr;
+    pthread_mutexattr_init(&lock_attr);
+    pthread_mutexattr_setprotocol(&lock_attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&drv->lock, &lock_attr);
+    pthread_mutexattr_destroy(&lock_attr);
+
+    atomic_init(&drv->dump_request, 0);
+    return 0;
+}
+
+void driver_cleanup(driver_t *drv) {
+    if (!drv) return;
+
+    sensor_array_disable(&drv->sensors);
+    sensor_array_cleanup(&drv->sensors);
+    irq_cleanup(&drv->irq);
+    driver_set_trace(drv, NULL);
+    reg_cleanup(&drv->regs[0]);
+    pthread_mutex_destroy(&drv->lock);
+}
+
+void driver_set_trace(driver_t *drv, trace_t *trace) {
+    if (!drv) return;
+
+    for (uint32_t i = 0; i < motor_bank_axes(&drv->motors); i++) {
+        reg_set_trace(&drv->regs[i], trace, (uint16_t)i);
+    }
+    irq_set_trace(&drv->irq, trace);
+    fault_trip_set_trace(&drv->trip, trace);
+    drv->trace = trace;
+}
+
+int driver_set_period(driver_t *drv, uint32_t period_us) {
+    if (!drv) return -1;
+
+    if (drv->loop) {
+        if (event_loop_set_period(drv->loop, period_us) < 0) return -1;
+        period_us = drv->loop->period_us;
+    } else if (period_us < EVENT_LOOP_MIN_PERIOD_US || period_us > EVENT_LOOP_MAX_PERIOD_US) {
+        return -1;
+    }
+
+    drv->period_us = period_us;
+    apply_period(drv);
+    return 0;
+}
+
+/* The command itself; driver_execute adds its trace record */
+static response_status_t execute_command(driver_t *drv, const shm_command_t *cmd,
+                                         int32_t *resp_data) {
+    motor_bank_t *bank = &drv->motors;
+    sensor_array_t *sa = &drv->sensors;
+    response_status_t status = RESP_OK;
+    uint32_t param1 = cmd->param1;
+    uint32_t param2 = cmd->param2;
+    uint32_t axis = cmd->axis;
+
+    /* Motor commands address one axis; the rest ignore the field */
+    bool motor_cmd = cmd->cmd == CMD_MOTOR_START || cmd->cmd == CMD_MOTOR_STOP ||
+                     cmd->cmd == CMD_MOTOR_SET_SPEED || cmd->cmd == CMD_GET_STATUS ||
+                     cmd->cmd == CMD_RESET || cmd->cmd == CMD_MOTOR_MOVE ||
+                     cmd->cmd == CMD_SET_PID_GAIN || cmd->cmd == CMD_SET_CLOSED_LOOP ||
+                     cmd->cmd == CMD_SET_FAULT_REACTION;
+    if (motor_cmd && axis >= motor_bank_axes(bank)) {
+        return RESP_ERROR;
+    }
+
+    /* Direct motor commands take the axis back from its profile */
+    motion_profile_t *mp = motor_cmd ? &drv->profiles[axis] : NULL;
+    if (cmd->cmd == CMD_MOTOR_START || cmd->cmd == CMD_MOTOR_STOP ||
+        cmd->cmd == CMD_MOTOR_SET_SPEED || cmd->cmd == CMD_RESET) {
+        motion_profile_abort(mp);
+    }
+
+    switch (cmd->cmd) {
+        case CMD_MOTOR_START:
+            if (motor_bank_start(bank, axis, param1, (motor_direction_t)param2) < 0) {
+                status = RESP_ERROR;
+            }
+            break;
+
+        case CMD_MOTOR_STOP:
+            if (motor_bank_stop(bank, axis) < 0) {
+                status = RESP_ERROR;
+            }
+            break;
+
+        case CMD_MOTOR_SET_SPEED:
+            if (motor_bank_set_speed(bank, axis, param1) < 0) {
+                status = RESP_ERROR;
+            }
+            break;
+
+        case CMD_MOTOR_MOVE: {
+            if (motor_bank_get_state(bank, axis) == MOTOR_STATE_FAULT) {
+                status = RESP_ERROR;
+                break;
+            }
+            /* Plan from where the axis is when nothing is in flight */
+            if (!motion_profile_active(mp)) {
+                motion_profile_init(mp, &move_limits, motor_bank_get_position(bank, axis));
+            }
+            int ret = motion_profile_move(mp, (int32_t)param1, (motion_shape_t)param2);
+            if (ret == -2) {
+                status = RESP_BUSY;
+            } else if (ret < 0) {
+                status = RESP_ERROR;
+            }
+            resp_data[0] = motion_profile_setpoint(mp);
+            break;
+        }
+
+        case CMD_SET_PID_GAIN: {
+            motor_pid_gains_t gains = bank->pid[axis].gains;
+            if (param1 == SHM_PID_KP) {
+                gains.kp = (int32_t)param2;
+            } else if (param1 == SHM_PID_KI) {
+                gains.ki = (int32_t)param2;
+            } else if (param1 == SHM_PID_KD) {
+                gains.kd = (int32_t)param2;
+            } else {
+                status = RESP_ERROR;
+            }
+            if (status == RESP_OK) {
+                motor_bank_set_pid_gains(bank, axis, &gains);
+            }
+            resp_data[0] = gains.kp;
+            resp_data[1] = gains.ki;
+            resp_data[2] = gains.kd;
+            break;
+        }
+
+        case CMD_SET_CLOSED_LOOP:
+            /* Only axis 0 has a speed measurement */
+            if (param1 && axis != 0) {
+                status = RESP_ERROR;
+            } else {
+                motor_bank_set_closed_loop(bank, axis, param1 != 0);
+                apply_sensor_rates(drv);
+            }
+            break;
+
+        case CMD_SET_SENSOR_THRESHOLD:
+            if (param1 >= sensor_array_count(sa) ||
+                sensor_set_stats_threshold(sa, (uint8_t)param1, (int32_t)param2) < 0) {
+                status = RESP_ERROR;
+            }
+            break;
+
+        case CMD_RESET_SENSOR_STATS:
+            for (uint8_t i = 0; i < sensor_array_count(sa); i++) {
+                sensor_stats_reset(sa, i);
+            }
+            break;
+
+        case CMD_SET_FAULT_REACTION:
+            if (fault_trip_set_reaction(&drv->trip, axis, (fault_reaction_t)param1) < 0) {
+                status = RESP_ERROR;
+            }
+            break;
+
+        case CMD_SET_SENSOR_RATE:
+            if (param1 >= sensor_array_count(sa)) {
+                status = RESP_ERROR;
+            } else {
+                drv->sensor_interval_us[param1] = param2;
+                apply_sensor_rates(drv);
+            }
+            break;
+
+        case CMD_SENSOR_READ:
+            sensor_read_all(sa, resp_data, 4);
+            break;
+
+        case CMD_GET_STATUS:
+            resp_data[0] = motor_bank_get_state(bank, axis);
+            resp_data[1] = (int32_t)motor_bank_get_speed(bank, axis);
+            resp_data[2] = motor_bank_get_position(bank, axis);
+            resp_data[3] = motor_bank_get_fault(bank, axis);
+            break;
+
+        case CMD_RESET:
+            motor_bank_reset(bank, axis);
+            fault_trip_rearm(&drv->trip, axis);
+            sensor_buffer_clear(sa);
+            break;
+
+        case CMD_SET_TICK_PERIOD:
+            if (driver_set_period(drv, param1) < 0) {
+                status = RESP_ERROR;
+            }
+            resp_data[0] = (int32_t)drv->period_us;
+            break;
+
+        case CMD_RESET_LOOP_STATS:
+            shm_reset_loop_stats(drv->shm);
+            shm_reset_irq_stats(drv->shm);
+            break;
+
+        default:
+            status = RESP_INVALID_CMD;
+            break;
+    }
+
+    return status;
+}
+
+/* The tick itself; driver_tick adds the state save, loop counters and trace record */
+static void control_tick(driver_t *drv, unsigned long tick, uint64_t start) {
+    motor_bank_t *bank = &drv->motors;
+    sensor_array_t *sensors = &drv->sensors;
+    uint64_t t = start;
+
+    /* Profiles set this tick's speed, then every axis steps in one batched pass */
+    motor_lanes_t lanes = motor_bank_lanes(bank);
+    for (uint32_t axis = 0; axis < motor_bank_axes(bank); axis++) {
+        motion_profile_t *mp = &drv->profiles[axis];
+        if (motion_profile_active(mp) || mp->following) {
+            motion_profile_follow(mp, &lanes, axis);
+        }
+    }
+    motor_bank_update(bank);
+
+    /* Faults the update latched trip now, not at interrupt dispatch */
+    for (uint32_t axis = 0; axis < motor_bank_axes(bank); axis++) {
+        if (motor_bank_get_state(bank, axis) == MOTOR_STATE_FAULT) {
+            irq_trigger(&drv->irq, INT_MOTOR_FAULT);
+            break;
+        }
+    }
+    t = phase_end(drv, LOOP_PHASE_MOTOR, t);
+
+    /* Sample the sensors that are due at their own rates */
+    bool closed_loop = bank->pid[0].enabled;
+    sensor_array_tick(sensors);
+    sensor_array_update(sensors);
+    t = phase_end(drv, LOOP_PHASE_SENSOR, t);
+
+    /* Drive axis 0 from its measured speed */
+    if (closed_loop) {
+        motor_bank_close_loop(bank, 0, sensor_read(sensors, DRIVER_VELOCITY_SENSOR));
+    }
+
+    /* Process interrupts */
+    irq_process_pending(&drv->irq);
+    if (!drv->irq.worker_running) {
+        irq_run_deferred(&drv->irq);  /* No worker: bottom halves run inline */
+    }
+    t = phase_end(drv, LOOP_PHASE_IRQ, t);
+
+    /* Update shared memory status */
+    int32_t sensor_vals[4];
+    sensor_read_all(sensors, sensor_vals, 4);
+    shm_update_status(drv->shm, motor_bank_get_state(bank, 0),
+                      motor_bank_get_speed(bank, 0), motor_bank_get_position(bank, 0),
+                      sensor_vals, motor_bank_get_fault(bank, 0));
+
+    shm_axes_status_t axes;
+    axes.axes = motor_bank_axes(bank);
+    for (uint32_t i = 0; i < axes.axes; i++) {
+        axes.state[i] = bank->state[i];
+        axes.speed[i] = bank->current_speed[i];
+        axes.position[i] = bank->position[i];
+        axes.fault_code[i] = bank->fault_code[i];
+        if (drv->trace && axes.state[i] != drv->traced_state[i]) {
+            trace_emit(drv->trace, TRACE_STATE, (uint16_t)i, drv->traced_state[i],
+                       axes.state[i], axes.fault_code[i], 0);
+            drv->traced_state[i] = axes.state[i];
+        }
+    }
+    shm_publish_axes(drv->shm, &axes);
+
+    /* Freeze the recorder around every new trip (written out by whoever owns the log) */
+    uint64_t trips = atomic_load(&drv->trip.trips);
+    if (drv->trace && trips != drv->traced_trips) {
+        drv->traced_trips = trips;
+        atomic_store(&drv->dump_request, trips);
+        log_printf(drv->log, "[TRACE] Fault trip %llu at tick %lu\n",
+                   (unsigned long long)trips, tick);
+    }
+
+    shm_sensor_stats_t sensor_stats;
+    sensor_stats.sensors = sensor_array_count(sensors);
+    for (uint8_t i = 0; i < sensor_stats.sensors; i++) {
+        sensor_summary_t sum;
+        sensor_get_stats(sensors, i, &sum);
+        sensor_stats.count[i] = sum.count;
+        sensor_stats.mean[i] = sum.mean;
+        sensor_stats.variance[i] = sum.variance;
+        sensor_stats.window_min[i] = sum.window_min;
+        sensor_stats.window_max[i] = sum.window_max;
+        sensor_stats.over_threshold[i] = sum.over_threshold;
+    }
+    shm_publish_sensor_stats(drv->shm, &sensor_stats);
+
+    /* Push to subscribers whose condition changed, instead of being polled */
+    int32_t values[SENSOR_MAX];
+    int sensor_count = sensor_read_all(sensors, values, SENSOR_MAX);
+    shm_eval_subscriptions(drv->shm, &axes, values,
+                           sensor_count > 0 ? (uint32_t)sensor_count : 0, tick);
+    t = phase_end(drv, LOOP_PHASE_STATUS, t);
+
+    /* Print status periodically */
+    if (tick % drv->print_divider == 0) {
+        log_printf(drv->log, "Tick %lu: State=%d Speed=%u Position=%d Temp=%d\n",
+                   tick, motor_bank_get_state(bank, 0), motor_bank_get_speed(bank, 0),
+                   motor_bank_get_position(bank, 0), sensor_read(sensors, 2));
+        uint32_t throttled = irq_get_throttled_mask(&drv->irq);
+        if (throttled) {
+            log_printf(drv->log, "[IRQ] Storm: throttled sources 0x%x\n", throttled);
+        }
+        const lat_hist_t *reaction = &drv->trip.reaction_ns;
+        if (reaction->count) {
+            log_printf(drv->log, "[TRIP] Fault reaction: p99 %u ns, max %u ns (%llu trips)\n",
+                       lat_hist_percentile(reaction, 9900), reaction->max_ns,
+                       (unsigned long long)atomic_load(&drv->trip.trips));
+        }
+        const lat_hist_t *fault = &drv->shm->irq_stats.raise_latency[INT_MOTOR_FAULT];
+        if (fault->count) {
+            log_printf(drv->log, "[IRQ] Fault response: p99 %u ns, max %u ns (%llu faults)\n",
+                       lat_hist_percentile(fault, 9900), fault->max_ns,
+                       (unsigned long long)fault->count);
+        }
+    }
+}
+
+response_status_t driver_execute(driver_t *drv, const shm_command_t *cmd, int32_t *resp_data) {
+    response_status_t status = execute_command(drv, cmd, resp_data);
+    if (drv->trace) {
+        trace_emit(drv->trace, TRACE_COMMAND, (uint16_t)cmd->cmd, cmd->axis,
+                   cmd->param1, cmd->param2, status);
+    }
+    return status;
+}
+
+void driver_process(driver_t *drv, const shm_command_t *ops, int count) {
+    uint16_t flags = ops[0].flags;
+
+    if (!(flags & SHM_CMD_FRAME)) {
+        int32_t resp_data[SHM_RESP_WORDS] = {0};
+        response_status_t status = driver_execute(drv, &ops[0], resp_data);
+        if (!(flags & SHM_CMD_NO_REPLY)) {
+            shm_complete_command(drv->shm, ops[0].seq_id, status, resp_data, SHM_RESP_WORDS);
+        }
+        return;
+    }
+
+    shm_frame_result_t result;
+    memset(&result, 0, sizeof(result));
+    result.status = RESP_OK;
+    result.ops = (uint32_t)count;
+
+    for (int i = 0; i < count; i++) {
+        int32_t resp_data[SHM_RESP_WORDS] = {0};
+        response_status_t status = driver_execute(drv, &ops[i], resp_data);
+        result.op_status[i] = (uint8_t)status;
+        memcpy(result.data[i], resp_data, sizeof(result.data[i]));
+        if (result.status == RESP_OK) result.status = status;
+    }
+
+    if (!(flags & SHM_CMD_NO_REPLY)) {
+        shm_complete_frame(drv->shm, ops[0].seq_id, &result);
+    }
+}
+
+uint64_t driver_tick(driver_t *drv) {
+    shm_loop_stats_t *stats = &drv->shm->loop_stats;
+    unsigned long tick = drv->tick;
+    uint64_t start = event_loop_now_ns();
+
+    control_tick(drv, tick, start);
+    stats->ticks++;
+    drv->tick++;
+
+    /* The save is part of the tick's budget: a crash resumes from it */
+    uint64_t t = event_loop_now_ns();
+    driver_save_state(drv);
+    phase_end(drv, LOOP_PHASE_SAVE, t);
+
+    uint64_t elapsed = phase_end(drv, LOOP_PHASE_TICK, start) - start;
+    if (elapsed > (uint64_t)drv->period_us * 1000) {
+        stats->overruns++;
+    }
+    if (drv->trace) {
+        trace_emit(drv->trace, TRACE_TICK, 0, (uint32_t)tick, (uint32_t)elapsed,
+                   drv->period_us, 0);
+    }
+
+    return elapsed;
+}
+
+void driver_capture_state(driver_t *drv, shm_driver_state_t *state) {
+    motor_bank_t *bank = &drv->motors;
+    sensor_array_t *sa = &drv->sensors;
+    uint64_t tripped = atomic_load(&drv->trip.tripped);
+
+    state->tick = drv->tick;
+    state->trips = atomic_load(&drv->trip.trips);
+    state->period_us = drv->period_us;
+    state->axes = motor_bank_axes(bank);
+    state->sensors = sensor_array_count(sa);
+
+    for (uint32_t i = 0; i < state->sensors; i++) {
+        state->sensor_interval_us[i] = drv->sensor_interval_us[i];
+        state->sensor_threshold[i] = sa->sensors[i].stats.threshold;
+        state->sensor_value[i] = sa->sensors[i].value;
+    }
+
+    for (uint32_t i = 0; i < state->axes; i++) {
+        shm_axis_state_t *ax = &state->axis[i];
+        const motor_pid_t *pid = &bank->pid[i];
+
+        ax->state = bank->state[i];
+        ax->fault_code = bank->fault_code[i];
+        ax->direction = bank->direction[i];
+        ax->target_speed = bank->target_speed[i];
+        ax->current_speed = bank->current_speed[i];
+        ax->position = bank->position[i];
+        ax->flags = (pid->enabled ? SHM_AXIS_PID_ENABLED : 0) |
+                    (pid->primed ? SHM_AXIS_PID_PRIMED : 0) |
+                    ((tripped >> i) & 1u ? SHM_AXIS_TRIPPED : 0) |
+                    (drv->profiles[i].following ? SHM_AXIS_MOVING : 0);
+        ax->reaction = drv->trip.reaction[i];
+        ax->kp = pid->gains.kp;
+        ax->ki = pid->gains.ki;
+        ax->kd = pid->gains.kd;
+        ax->prev_measured = pid->prev_measured;
+        ax->integral = pid->integral;
+        ax->output = pid->output;
+        ax->regs[0] = reg_read(&drv->regs[i], REG_MOTOR_CTRL);
+        ax->regs[1] = reg_read(&drv->regs[i], REG_MOTOR_STATUS);
+        ax->regs[2] = reg_read(&drv->regs[i], REG_MOTOR_SPEED);
+        ax->regs[3] = reg_read(&drv->regs[i], REG_MOTOR_POSITION);
+    }
+}
+
+int driver_save_state(driver_t *drv) {
+    if (!drv || !drv->shm) return -1;
+
+    shm_driver_state_t state;
+    driver_capture_state(drv, &state);
+    return shm_save_state(drv->shm, &state);
+}
+
+int driver_restore_state(driver_t *drv, const shm_driver_state_t *state) {
+    if (!drv || !state) return -1;
+
+    motor_bank_t *bank = &drv->motors;
+    sensor_array_t *sa = &drv->sensors;
+    if (state->axes != motor_bank_axes(bank)) return -1;
+
+    uint8_t sensors = sensor_array_count(sa);
+    for (uint32_t i = 0; i < state->sensors && i < sensors; i++) {
+        drv->sensor_interval_us[i] = state->sensor_interval_us[i];
+        sensor_set_stats_threshold(sa, (uint8_t)i, state->sensor_threshold[i]);
+        sensor_set_simulated_value(sa, (uint8_t)i, state->sensor_value[i]);
+    }
+
+    uint64_t tripped = 0;
+    for (uint32_t i = 0; i < state->axes; i++) {
+        const shm_axis_state_t *ax = &state->axis[i];
+        motor_pid_t *pid = &bank->pid[i];
+
+        bank->state[i] = (motor_state_t)ax->state;
+        bank->fault_code[i] = (motor_fault_t)ax->fault_code;
+        bank->direction[i] = (motor_direction_t)ax->direction;
+        bank->target_speed[i] = ax->target_speed;
+        bank->current_speed[i] = ax->current_speed;
+        bank->position[i] = ax->position;
+
+        pid->gains.kp = ax->kp;
+        pid->gains.ki = ax->ki;
+        pid->gains.kd = ax->kd;
+        pid->integral = ax->integral;
+        pid->prev_measured = ax->prev_measured;
+        pid->output = ax->output;
+        pid->primed = (ax->flags & SHM_AXIS_PID_PRIMED) != 0;
+        pid->enabled = (ax->flags & SHM_AXIS_PID_ENABLED) != 0;
+
+        fault_trip_set_reaction(&drv->trip, i, (fault_reaction_t)ax->reaction);
+        if (ax->flags & SHM_AXIS_TRIPPED) tripped |= 1ull << i;
+
+        /* A device keeps its own registers across our restart; the simulated one does not */
+        if (reg_backend(&drv->regs[i]) == REG_BACKEND_SIM) {
+            reg_write(&drv->regs[i], REG_MOTOR_CTRL, ax->regs[0]);
+            reg_write(&drv->regs[i], REG_MOTOR_STATUS, ax->regs[1]);
+            reg_write(&drv->regs[i], REG_MOTOR_SPEED, ax->regs[2]);
+            reg_write(&drv->regs[i], REG_MOTOR_POSITION, ax->regs[3]);
+        }
+
+        /* The plan itself is not saved: stop where the move had got to */
+        motion_profile_init(&drv->profiles[i], &move_limits, ax->position);
+        if (ax->flags & SHM_AXIS_MOVING) {
+            motor_bank_stop(bank, i);
+        }
+
+        drv->traced_state[i] = bank->state[i];
+    }
+
+    atomic_store(&drv->trip.tripped, tripped);
+    atomic_store(&drv->trip.trips, state->trips);
+    drv->traced_trips = state->trips;
+    drv->tick = (unsigned long)state->tick;
+
+    /* Also re-derives the sensor dividers for the restored rates and speed loop */
+    return driver_set_period(drv, state->period_us);
+}
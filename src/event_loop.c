@@ -0,0 +1,253 @@
+#include "event_loop.h"
+#include "sim_clock.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NSEC_PER_SEC    1000000000ULL
+#define NSEC_PER_USEC   1000ULL
+
+static int period_valid(uint32_t period_us) {
+    return period_us >= EVENT_LOOP_MIN_PERIOD_US &&
+           period_us <= EVENT_LOOP_MAX_PERIOD_US;
+}
+
+uint64_t event_loop_now_ns(void) {
+    return sim_clock_now_ns();
+}
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+static void drain_signals(event_loop_t *loop, uint32_t *events) {
+    struct signalfd_siginfo info;
+
+    while (read(loop->signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+        int signo = (int)info.ssi_signo;
+
+        if (signo == SIGINT || signo == SIGTERM) {
+            *events |= LOOP_EVENT_SHUTDOWN;
+        } else if (signo == SIGHUP) {
+            *events |= LOOP_EVENT_RESTART;
+        } else if ((signo == SIGUSR1 || signo == SIGUSR2) &&
+                   loop->irq_signal_count < EVENT_LOOP_MAX_SIGNALS) {
+            /* Raised later, under the caller's lock */
+            loop->irq_signals[loop->irq_signal_count++] = signo;
+            *events |= LOOP_EVENT_IRQ;
+        }
+    }
+}
+
+int event_loop_deliver_irqs(event_loop_t *loop) {
+    if (!loop) return -1;
+
+    int delivered = 0;
+    for (uint32_t i = 0; i < loop->irq_signal_count; i++) {
+        if (irq_handle_signal(loop->irq, loop->irq_signals[i]) == 0) delivered++;
+    }
+    loop->irq_signal_count = 0;
+
+    return delivered;
+}
+
+/* Absolute first deadline plus a fixed interval: the tick never drifts */
+static int arm_timer(event_loop_t *loop) {
+    uint64_t period_ns = (uint64_t)loop->period_us * NSEC_PER_USEC;
+    uint64_t first = event_loop_now_ns() + period_ns;
+    struct itimerspec its;
+
+    its.it_value.tv_sec = (time_t)(first / NSEC_PER_SEC);
+    its.it_value.tv_nsec = (long)(first % NSEC_PER_SEC);
+    its.it_interval.tv_sec = (time_t)(period_ns / NSEC_PER_SEC);
+    its.it_interval.tv_nsec = (long)(period_ns % NSEC_PER_SEC);
+    loop->next_deadline_ns = first;
+
+    return timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+int event_loop_init(event_loop_t *loop, uint32_t period_us,
+                    shared_mem_t *shm, interrupt_controller_t *irq) {
+    if (!loop || !period_valid(period_us)) return -1;
+
+    memset(loop, 0, sizeof(event_loop_t));
+    loop->epoll_fd = -1;
+    loop->timer_fd = -1;
+    loop->signal_fd = -1;
+    loop->period_us = period_us;
+    loop->shm = shm;
+    loop->irq = irq;
+
+    /* Route IRQ, shutdown and restart signals to the signalfd */
+    sigemptyset(&loop->signals);
+    sigaddset(&loop->signals, SIGUSR1);
+    sigaddset(&loop->signals, SIGUSR2);
+    sigaddset(&loop->signals, SIGINT);
+    sigaddset(&loop->signals, SIGTERM);
+    sigaddset(&loop->signals, SIGHUP);
+    if (pthread_sigmask(SIG_BLOCK, &loop->signals, &loop->saved_mask) != 0) {
+        return -1;
+    }
+
+    loop->signal_fd = signalfd(-1, &loop->signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->signal_fd < 0 || loop->timer_fd < 0 || loop->epoll_fd < 0) {
+        event_loop_cleanup(loop);
+        return -1;
+    }
+
+    if (arm_timer(loop) < 0) {
+        event_loop_cleanup(loop);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = loop->timer_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &ev) < 0) {
+        event_loop_cleanup(loop);
+        return -1;
+    }
+    ev.data.fd = loop->signal_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->signal_fd, &ev) < 0) {
+        event_loop_cleanup(loop);
+        return -1;
+    }
+
+    return 0;
+}
+
+void event_loop_cleanup(event_loop_t *loop) {
+    if (!loop) return;
+
+    if (loop->signal_fd >= 0) {
+        /* Consume anything still queued so unblocking cannot kill us */
+        uint32_t ignored = 0;
+        drain_signals(loop, &ignored);
+        close(loop->signal_fd);
+    }
+    if (loop->timer_fd >= 0) close(loop->timer_fd);
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+
+    loop->signal_fd = -1;
+    loop->timer_fd = -1;
+    loop->epoll_fd = -1;
+
+    pthread_sigmask(SIG_SETMASK, &loop->saved_mask, NULL);
+}
+
+int event_loop_set_period(event_loop_t *loop, uint32_t period_us) {
+    if (!loop || !period_valid(period_us)) return -1;
+
+    loop->period_us = period_us;
+    return arm_timer(loop);
+}
+
+int event_loop_wait(event_loop_t *loop, uint32_t *events) {
+    if (!loop || !events) return -1;
+
+    *events = 0;
+
+    struct epoll_event ready[2];
+    int n = epoll_wait(loop->epoll_fd, ready, 2, -1);
+
+    if (n < 0 && errno != EINTR) {
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (ready[i].data.fd == loop->timer_fd) {
+            uint64_t expirations = 0;
+            if (read(loop->timer_fd, &expirations, sizeof(expirations)) ==
+                    (ssize_t)sizeof(expirations) && expirations > 0) {
+                uint64_t period_ns = (uint64_t)loop->period_us * NSEC_PER_USEC;
+                loop->ticks += expirations;
+                loop->missed_ticks += expirations - 1;
+                loop->last_deadline_ns = loop->next_deadline_ns +
+                                         (expirations - 1) * period_ns;
+                loop->next_deadline_ns = loop->last_deadline_ns + period_ns;
+                *events |= LOOP_EVENT_TICK;
+            }
+        } else if (ready[i].data.fd == loop->signal_fd) {
+            drain_signals(loop, events);
+        }
+    }
+
+    if (loop->shm && shm_is_shutdown_requested(loop->shm)) {
+        *events |= LOOP_EVENT_SHUTDOWN;
+    }
+
+    return (int)*events;
+}
+
+#else
+/* Portable fallback: sleep to the next absolute deadline and poll */
+
+int event_loop_init(event_loop_t *loop, uint32_t period_us,
+                    shared_mem_t *shm, interrupt_controller_t *irq) {
+    if (!loop || !period_valid(period_us)) return -1;
+
+    memset(loop, 0, sizeof(event_loop_t));
+    loop->epoll_fd = -1;
+    loop->timer_fd = -1;
+    loop->signal_fd = -1;
+    loop->period_us = period_us;
+    loop->shm = shm;
+    loop->irq = irq;
+    loop->next_deadline_ns = event_loop_now_ns() + (uint64_t)period_us * NSEC_PER_USEC;
+
+    return 0;
+}
+
+void event_loop_cleanup(event_loop_t *loop) {
+    (void)loop;
+}
+
+int event_loop_deliver_irqs(event_loop_t *loop) {
+    return loop ? 0 : -1;   /* No signalfd, nothing is ever held */
+}
+
+int event_loop_set_period(event_loop_t *loop, uint32_t period_us) {
+    if (!loop || !period_valid(period_us)) return -1;
+
+    loop->period_us = period_us;
+    loop->next_deadline_ns = event_loop_now_ns() + (uint64_t)period_us * NSEC_PER_USEC;
+    return 0;
+}
+
+int event_loop_wait(event_loop_t *loop, uint32_t *events) {
+    if (!loop || !events) return -1;
+
+    *events = 0;
+    uint64_t period_ns = (uint64_t)loop->period_us * NSEC_PER_USEC;
+    uint64_t now = event_loop_now_ns();
+
+    if (now < loop->next_deadline_ns) {
+        uint64_t delta = loop->next_deadline_ns - now;
+        struct timespec ts;
+        ts.tv_sec = (time_t)(delta / NSEC_PER_SEC);
+        ts.tv_nsec = (long)(delta % NSEC_PER_SEC);
+        nanosleep(&ts, NULL);
+        now = event_loop_now_ns();
+    }
+
+    if (now >= loop->next_deadline_ns) {
+        uint64_t expirations = (now - loop->next_deadline_ns) / period_ns + 1;
+        loop->ticks += expirations;
+        loop->missed_ticks += expirations - 1;
+        loop->last_deadline_ns = loop->next_deadline_ns + (expirations - 1) * period_ns;
+        loop->next_deadline_ns = loop->last_deadline_ns + period_ns;
+        *events |= LOOP_EVENT_TICK;
+    }
+
+    if (loop->shm && shm_is_shutdown_requested(loop->shm)) {
+        *events |= LOOP_EVENT_SHUTDOWN;
+    }
+
+    return (int)*events;
+}
+#endif
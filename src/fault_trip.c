@@ -0,0 +1,133 @@
+#include "fault_trip.h"
+#include "sim_clock.h"
+#include <string.h>
+
+#define FAULT_STATUS_BITS   (MOTOR_STATUS_FAULT | MOTOR_STATUS_STALL | MOTOR_STATUS_OVERHEAT)
+
+static uint32_t fault_status_bit(motor_fault_t fault) {
+    switch (fault) {
+        case MOTOR_FAULT_STALL:     return MOTOR_STATUS_STALL;
+        case MOTOR_FAULT_OVERHEAT:  return MOTOR_STATUS_OVERHEAT;
+        default:                    return MOTOR_STATUS_FAULT;
+    }
+}
+
+static motor_fault_t status_fault(uint32_t status) {
+    if (status & MOTOR_STATUS_STALL) return MOTOR_FAULT_STALL;
+    if (status & MOTOR_STATUS_OVERHEAT) return MOTOR_FAULT_OVERHEAT;
+    return MOTOR_FAULT_OVERCURRENT;
+}
+
+int fault_trip_init(fault_trip_t *ft, const motor_lanes_t *lanes, uint32_t axes) {
+    if (!ft || !lanes || axes == 0 || axes > FAULT_TRIP_MAX_AXES) return -1;
+
+    memset(ft, 0, sizeof(*ft));
+    ft->lanes = *lanes;
+    ft->axes = axes;
+    atomic_init(&ft->tripped, 0);
+    atomic_init(&ft->trips, 0);
+    atomic_init(&ft->recording, false);
+    lat_hist_reset(&ft->reaction_ns);
+
+    return 0;
+}
+
+int fault_trip_set_reaction(fault_trip_t *ft, uint32_t axis, fault_reaction_t reaction) {
+    if (!ft || axis >= ft->axes || reaction > FAULT_REACT_STOP) return -1;
+
+    ft->reaction[axis] = reaction;
+    return 0;
+}
+
+int fault_trip_set_trace(fault_trip_t *ft, trace_t *trace) {
+    if (!ft) return -1;
+
+    ft->trace = trace;
+    return 0;
+}
+
+int fault_trip_axis(fault_trip_t *ft, uint32_t axis, motor_fault_t fault) {
+    if (!ft || axis >= ft->axes) return -1;
+
+    uint64_t start = sim_clock_now_ns();
+    register_file_t *regs = &ft->lanes.regs[axis];
+    uint64_t bit = 1ULL << axis;
+
+    /* A clear status means the last fault was reset, so this is a new one */
+    if (!(reg_read(regs, REG_MOTOR_STATUS) & FAULT_STATUS_BITS)) {
+        atomic_fetch_and(&ft->tripped, ~bit);
+    }
+    bool first = !(atomic_fetch_or(&ft->tripped, bit) & bit);
+
+    /* The drive first; everything else is bookkeeping */
+    uint32_t ctrl = reg_read(regs, REG_MOTOR_CTRL) & ~MOTOR_CTRL_ENABLE;
+    switch (ft->reaction[axis]) {
+        case FAULT_REACT_COAST:
+            reg_write(regs, REG_MOTOR_CTRL, ctrl);
+            break;
+        case FAULT_REACT_STOP:
+            reg_write(regs, REG_MOTOR_SPEED, 0);
+            break;
+        default:
+            reg_write(regs, REG_MOTOR_CTRL, ctrl | MOTOR_CTRL_BRAKE);
+            reg_write(regs, REG_MOTOR_SPEED, 0);
+            break;
+    }
+
+    if (!first) return 0;
+
+    reg_set_bits(regs, REG_MOTOR_STATUS, fault_status_bit(fault));
+    ft->lanes.target_speed[axis] = 0;
+    if (ft->reaction[axis] == FAULT_REACT_BRAKE) {
+        ft->lanes.current_speed[axis] = 0;
+    }
+    ft->lanes.fault_code[axis] = fault;
+    ft->lanes.state[axis] = MOTOR_STATE_FAULT;
+
+    atomic_fetch_add_explicit(&ft->trips, 1, memory_order_relaxed);
+    uint64_t reaction = sim_clock_now_ns() - start;
+    if (!atomic_exchange(&ft->recording, true)) {
+        lat_hist_record(&ft->reaction_ns, reaction);
+        atomic_store(&ft->recording, false);
+    }
+    if (ft->trace) {
+        trace_emit(ft->trace, TRACE_FAULT, (uint16_t)axis, fault, ft->reaction[axis],
+                   (uint32_t)reaction, 0);
+    }
+
+    return 1;
+}
+
+int fault_trip_rearm(fault_trip_t *ft, uint32_t axis) {
+    if (!ft || axis >= ft->axes) return -1;
+
+    atomic_fetch_and(&ft->tripped, ~(1ULL << axis));
+    return 0;
+}
+
+int fault_trip_scan(fault_trip_t *ft) {
+    if (!ft) return -1;
+
+    int latched = 0;
+    for (uint32_t axis = 0; axis < ft->axes; axis++) {
+        uint32_t status = reg_read(&ft->lanes.regs[axis], REG_MOTOR_STATUS);
+        if (status & FAULT_STATUS_BITS) {
+            fault_trip_axis(ft, axis, status_fault(status));
+            latched++;
+        }
+    }
+
+    return latched;
+}
+
+void fault_trip_irq(interrupt_source_t source, void *context) {
+    fault_trip_t *ft = (fault_trip_t*)context;
+
+    if (fault_trip_scan(ft) == 0) {
+        motor_fault_t fault = (source == INT_MOTOR_STALL) ? MOTOR_FAULT_STALL
+                                                          : MOTOR_FAULT_OVERCURRENT;
+        for (uint32_t axis = 0; axis < ft->axes; axis++) {
+            fault_trip_axis(ft, axis, fault);
+        }
+    }
+}
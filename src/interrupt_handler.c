@@ -1,10 +1,145 @@
 #include "interrupt_handler.h"
+#include "sim_clock.h"
 #include <string.h>
 #include <stdlib.h>
 
 /* Global interrupt controller pointer for signal handler */
 interrupt_controller_t *g_irq_controller = NULL;
 
+/* Faults first, periodic sensor data last */
+static const uint8_t default_priority[INT_COUNT] = {
+    [INT_MOTOR_FAULT]  = 0,
+    [INT_MOTOR_STALL]  = 0,
+    [INT_SENSOR_ERROR] = 1,
+    [INT_TIMER]        = 2,
+    [INT_SENSOR_READY] = 3,
+};
+
+#if ATOMIC_INT_LOCK_FREE != 2 || ATOMIC_LLONG_LOCK_FREE != 2
+#error "irq_signal_handler needs lock-free atomic ints and long longs"
+#endif
+
+_Static_assert(INT_COUNT <= SHM_IRQ_SOURCES, "shm_irq_stats_t is too small");
+
+/*
+ * Keep the oldest raise not yet delivered, so coalesced and held IRQs are
+ * timed from their first event. Coalesced sources are stamped even without
+ * IRQ_INSTRUMENT, since their max_delay runs from it. sim_clock_now_ns is
+ * async-signal-safe.
+ */
+static void stamp_raise(interrupt_controller_t *ic, int source) {
+#if !IRQ_INSTRUMENT
+    if (!(ic->timed_mask & (1u << source))) return;
+#endif
+    if (atomic_load_explicit(&ic->raised_ns[source], memory_order_relaxed) == 0) {
+        uint64_t expected = 0;
+        atomic_compare_exchange_strong(&ic->raised_ns[source], &expected, sim_clock_now_ns());
+    }
+}
+
+static void update_timed_mask(interrupt_controller_t *ic, interrupt_source_t source) {
+    irq_coalesce_t *c = &ic->coalesce[source];
+
+    if (c->max_events || c->max_delay_us || c->storm_threshold) {
+        ic->timed_mask |= 1u << source;
+    } else {
+        ic->timed_mask &= ~(1u << source);
+    }
+}
+
+/* Close the rate window once it has run its length */
+static void storm_check(irq_coalesce_t *c, uint32_t events_now, uint64_t now) {
+    uint64_t elapsed = now - c->window_start_ns;
+    if (!c->storm_threshold || elapsed < IRQ_STORM_WINDOW_US * 1000ULL) return;
+
+    /* Scale to one window so a long quiet stretch reads as a low rate */
+    uint64_t rate = (uint64_t)(events_now - c->window_events) *
+                    (IRQ_STORM_WINDOW_US * 1000ULL) / elapsed;
+
+    if (!c->throttled && rate >= c->storm_threshold) {
+        c->throttled = true;
+        c->storms++;
+    } else if (c->throttled && rate < c->storm_threshold / 2) {
+        c->throttled = false;
+    }
+
+    c->window_start_ns = now;
+    c->window_events = events_now;
+}
+
+/* Whether a pending coalesced source should be delivered now */
+static bool coalesce_due(interrupt_controller_t *ic, int source, uint64_t now) {
+    irq_coalesce_t *c = &ic->coalesce[source];
+    uint32_t events_now = atomic_load_explicit(&ic->event_count[source],
+                                               memory_order_relaxed);
+
+    storm_check(c, events_now, now);
+
+    /* Wait from the oldest undelivered raise, not from when dispatch saw it */
+    uint64_t since = atomic_load_explicit(&ic->raised_ns[source], memory_order_relaxed);
+    if (since == 0 || since > now) {
+        /* Raised before the source was timed, or stamped after `now` */
+        if (c->held_since_ns == 0) {
+            c->held_since_ns = now;
+        }
+        since = c->held_since_ns;
+    }
+
+    uint64_t waited = now - since;
+    if (c->throttled) {
+        uint32_t spacing = c->max_delay_us > IRQ_STORM_HOLDOFF_US ?
+                           c->max_delay_us : IRQ_STORM_HOLDOFF_US;
+        return waited >= spacing * 1000ULL;
+    }
+
+    if (!c->max_events && !c->max_delay_us) return true;
+    if (c->max_events && events_now - c->delivered_events >= c->max_events) return true;
+    if (c->max_delay_us && waited >= c->max_delay_us * 1000ULL) return true;
+
+    return false;
+}
+
+/* Most urgent source in `pending` at a level above `below`, or -1 */
+static int next_pending(interrupt_controller_t *ic, uint32_t pending, uint8_t below) {
+    for (uint8_t level = 0; level < below; level++) {
+        uint32_t ready = pending & ic->level_mask[level];
+        if (ready) {
+            return __builtin_ctz(ready);
+        }
+    }
+
+    return -1;
+}
+
+static void queue_deferred(interrupt_controller_t *ic, uint32_t bit) {
+    uint32_t before = atomic_fetch_or(&ic->deferred_pending, bit);
+
+    /* Only an empty queue can have an idle worker to wake */
+    if (before == 0 && ic->worker_running) {
+        pthread_mutex_lock(&ic->worker_lock);
+        pthread_cond_signal(&ic->worker_cond);
+        pthread_mutex_unlock(&ic->worker_lock);
+    }
+}
+
+static void *deferred_worker(void *arg) {
+    interrupt_controller_t *ic = (interrupt_controller_t*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&ic->worker_lock);
+        while (!ic->worker_stop && atomic_load(&ic->deferred_pending) == 0) {
+            pthread_cond_wait(&ic->worker_cond, &ic->worker_lock);
+        }
+        bool stop = ic->worker_stop;
+        pthread_mutex_unlock(&ic->worker_lock);
+
+        if (stop) break;
+        irq_run_deferred(ic);
+    }
+
+    return NULL;
+}
+
 int irq_init(interrupt_controller_t *ic, register_file_t *regs,
              motor_controller_t *motor, sensor_array_t *sensors) {
     if (!ic || !regs) return -1;
@@ -13,10 +148,29 @@ int irq_init(interrupt_controller_t *ic, register_file_t *regs,
     ic->regs = regs;
     ic->motor = motor;
     ic->sensors = sensors;
-    ic->enabled_irqs = 0;
-    ic->pending_irqs = 0;
+    atomic_init(&ic->enabled_irqs, 0);
+    atomic_init(&ic->pending_irqs, 0);
     ic->signal_received = 0;
 
+    ic->active_level = IRQ_PRIORITY_NONE;
+    for (int i = 0; i < INT_COUNT; i++) {
+        ic->priority[i] = default_priority[i];
+        ic->level_mask[default_priority[i]] |= 1u << i;
+    }
+
+    for (int i = 0; i < INT_COUNT; i++) {
+        atomic_init(&ic->event_count[i], 0);
+        atomic_init(&ic->chain[i], &ic->chain_buf[i][0]);
+        atomic_init(&ic->raised_ns[i], 0);
+    }
+    ic->stats = &ic->local_stats;
+    atomic_init(&ic->dispatch_gen, 0);
+    pthread_mutex_init(&ic->reg_lock, NULL);
+
+    atomic_init(&ic->deferred_pending, 0);
+    pthread_mutex_init(&ic->worker_lock, NULL);
+    pthread_cond_init(&ic->worker_cond, NULL);
+
     /* Clear IRQ registers */
     reg_write(regs, REG_IRQ_STATUS, 0);
     reg_write(regs, REG_IRQ_ENABLE, 0);
@@ -31,6 +185,10 @@ void irq_cleanup(interrupt_controller_t *ic) {
     if (!ic) return;
 
     irq_disable_all(ic);
+    irq_stop_worker(ic);
+    pthread_mutex_destroy(&ic->worker_lock);
+    pthread_cond_destroy(&ic->worker_cond);
+    pthread_mutex_destroy(&ic->reg_lock);
     g_irq_controller = NULL;
 
     /* Restore default signal handlers */
@@ -38,29 +196,243 @@ void irq_cleanup(interrupt_controller_t *ic) {
     signal(SIGUSR2, SIG_DFL);
 }
 
+/*
+ * Chain updates are copy-on-write. A writer fills the unpublished copy and
+ * swaps it in; the copy it replaced is reused only once every dispatch that
+ * could have loaded it has finished. dispatch_gen is odd while the outermost
+ * irq_process_pending runs, so a retired copy is free again as soon as the
+ * generation moves on from the odd value seen at retirement.
+ */
+static irq_chain_t *chain_spare(interrupt_controller_t *ic, interrupt_source_t source) {
+    irq_chain_t *cur = atomic_load_explicit(&ic->chain[source], memory_order_relaxed);
+    irq_chain_t *spare = (cur == &ic->chain_buf[source][0]) ?
+                         &ic->chain_buf[source][1] : &ic->chain_buf[source][0];
+
+    uint32_t retired = ic->retired_gen[source];
+    if (retired != 0 && atomic_load(&ic->dispatch_gen) == retired) {
+        return NULL;    /* A dispatch may still be walking it */
+    }
+
+    ic->retired_gen[source] = 0;
+    *spare = *cur;
+    return spare;
+}
+
+static void chain_publish(interrupt_controller_t *ic, interrupt_source_t source,
+                          irq_chain_t *chain) {
+    /* seq_cst store then load pairs with the generation bump in dispatch */
+    atomic_store(&ic->chain[source], chain);
+
+    uint32_t gen = atomic_load(&ic->dispatch_gen);
+    if (gen & 1u) {
+        ic->retired_gen[source] = gen;
+    }
+}
+
 int irq_register_handler(interrupt_controller_t *ic, interrupt_source_t source,
                          irq_handler_t handler, void *context) {
-    if (!ic || source >= INT_COUNT) return -1;
+    if (!ic || source >= INT_COUNT || !handler) return -1;
+
+    pthread_mutex_lock(&ic->reg_lock);
+
+    irq_chain_t *cur = atomic_load_explicit(&ic->chain[source], memory_order_relaxed);
+    for (uint32_t i = 0; i < cur->count; i++) {
+        if (cur->entries[i].fn == handler && cur->entries[i].context == context) {
+            pthread_mutex_unlock(&ic->reg_lock);
+            return 0;   /* Already registered */
+        }
+    }
+
+    irq_chain_t *next = NULL;
+    if (cur->count < IRQ_MAX_HANDLERS) {
+        next = chain_spare(ic, source);
+    }
+    if (!next) {
+        pthread_mutex_unlock(&ic->reg_lock);
+        return -2;
+    }
 
-    ic->handlers[source] = handler;
-    ic->handler_contexts[source] = context;
+    next->entries[next->count].fn = handler;
+    next->entries[next->count].context = context;
+    next->count++;
+    chain_publish(ic, source, next);
 
+    pthread_mutex_unlock(&ic->reg_lock);
+    return 0;
+}
+
+int irq_remove_handler(interrupt_controller_t *ic, interrupt_source_t source,
+                       irq_handler_t handler, void *context) {
+    if (!ic || source >= INT_COUNT || !handler) return -1;
+
+    pthread_mutex_lock(&ic->reg_lock);
+
+    irq_chain_t *cur = atomic_load_explicit(&ic->chain[source], memory_order_relaxed);
+    uint32_t found = cur->count;
+    for (uint32_t i = 0; i < cur->count; i++) {
+        if (cur->entries[i].fn == handler && cur->entries[i].context == context) {
+            found = i;
+            break;
+        }
+    }
+    if (found == cur->count) {
+        pthread_mutex_unlock(&ic->reg_lock);
+        return -3;  /* Not registered */
+    }
+
+    irq_chain_t *next = chain_spare(ic, source);
+    if (!next) {
+        pthread_mutex_unlock(&ic->reg_lock);
+        return -2;
+    }
+
+    /* Keep the remaining handlers in registration order */
+    memmove(&next->entries[found], &next->entries[found + 1],
+            (next->count - found - 1) * sizeof(irq_handler_entry_t));
+    next->count--;
+    chain_publish(ic, source, next);
+
+    pthread_mutex_unlock(&ic->reg_lock);
     return 0;
 }
 
 int irq_unregister_handler(interrupt_controller_t *ic, interrupt_source_t source) {
     if (!ic || source >= INT_COUNT) return -1;
 
-    ic->handlers[source] = NULL;
-    ic->handler_contexts[source] = NULL;
+    pthread_mutex_lock(&ic->reg_lock);
+
+    irq_chain_t *next = chain_spare(ic, source);
+    if (!next) {
+        pthread_mutex_unlock(&ic->reg_lock);
+        return -2;
+    }
+
+    next->count = 0;
+    chain_publish(ic, source, next);
 
+    pthread_mutex_unlock(&ic->reg_lock);
     return 0;
 }
 
+int irq_handler_count(interrupt_controller_t *ic, interrupt_source_t source) {
+    if (!ic || source >= INT_COUNT) return -1;
+    return (int)atomic_load(&ic->chain[source])->count;
+}
+
+int irq_register_deferred(interrupt_controller_t *ic, interrupt_source_t source,
+                          irq_handler_t handler, void *context) {
+    if (!ic || source >= INT_COUNT) return -1;
+
+    ic->deferred_handlers[source] = handler;
+    ic->deferred_contexts[source] = context;
+
+    return 0;
+}
+
+int irq_set_fast_handler(interrupt_controller_t *ic, interrupt_source_t source,
+                         irq_handler_t handler, void *context) {
+    if (!ic || source >= INT_COUNT) return -1;
+
+    ic->fast_contexts[source] = context;
+    ic->fast_handlers[source] = handler;
+
+    return 0;
+}
+
+int irq_set_priority(interrupt_controller_t *ic, interrupt_source_t source,
+                     uint8_t priority) {
+    if (!ic || source >= INT_COUNT || priority >= IRQ_PRIORITY_LEVELS) return -1;
+
+    ic->level_mask[ic->priority[source]] &= ~(1u << source);
+    ic->level_mask[priority] |= 1u << source;
+    ic->priority[source] = priority;
+
+    return 0;
+}
+
+int irq_get_priority(interrupt_controller_t *ic, interrupt_source_t source) {
+    if (!ic || source >= INT_COUNT) return -1;
+    return ic->priority[source];
+}
+
+int irq_set_coalesce(interrupt_controller_t *ic, interrupt_source_t source,
+                     uint32_t max_events, uint32_t max_delay_us) {
+    if (!ic || source >= INT_COUNT) return -1;
+
+    irq_coalesce_t *c = &ic->coalesce[source];
+    c->max_events = max_events;
+    c->max_delay_us = max_delay_us;
+    c->held_since_ns = 0;
+    update_timed_mask(ic, source);
+
+    return 0;
+}
+
+int irq_set_storm_threshold(interrupt_controller_t *ic, interrupt_source_t source,
+                            uint32_t events_per_window) {
+    if (!ic || source >= INT_COUNT) return -1;
+
+    irq_coalesce_t *c = &ic->coalesce[source];
+    c->storm_threshold = events_per_window;
+    c->throttled = false;
+    c->window_start_ns = sim_clock_now_ns();
+    c->window_events = atomic_load(&ic->event_count[source]);
+    update_timed_mask(ic, source);
+
+    return 0;
+}
+
+int irq_get_merged(interrupt_controller_t *ic, interrupt_source_t source) {
+    if (!ic || source >= INT_COUNT) return -1;
+    return (int)ic->coalesce[source].merged;
+}
+
+int irq_get_source_stats(interrupt_controller_t *ic, interrupt_source_t source,
+                         irq_source_stats_t *stats) {
+    if (!ic || source >= INT_COUNT || !stats) return -1;
+
+    irq_coalesce_t *c = &ic->coalesce[source];
+    stats->events = atomic_load(&ic->event_count[source]);
+    stats->deliveries = c->deliveries;
+    stats->storms = c->storms;
+    stats->throttled = c->throttled;
+
+    return 0;
+}
+
+uint32_t irq_get_throttled_mask(interrupt_controller_t *ic) {
+    if (!ic) return 0;
+
+    uint32_t mask = 0;
+    for (int i = 0; i < INT_COUNT; i++) {
+        if (ic->coalesce[i].throttled) mask |= 1u << i;
+    }
+
+    return mask;
+}
+
+int irq_set_stats(interrupt_controller_t *ic, shm_irq_stats_t *stats) {
+    if (!ic) return -1;
+
+    ic->stats = stats ? stats : &ic->local_stats;
+    return 0;
+}
+
+int irq_set_trace(interrupt_controller_t *ic, trace_t *trace) {
+    if (!ic) return -1;
+
+    ic->trace = trace;
+    return 0;
+}
+
+const shm_irq_stats_t* irq_get_stats(interrupt_controller_t *ic) {
+    return ic ? ic->stats : NULL;
+}
+
 int irq_enable(interrupt_controller_t *ic, interrupt_source_t source) {
     if (!ic || source >= INT_COUNT) return -1;
 
-    ic->enabled_irqs |= (1 << source);
+    atomic_fetch_or(&ic->enabled_irqs, 1u << source);
     reg_set_bits(ic->regs, REG_IRQ_ENABLE, (1 << source));
 
     return 0;
@@ -69,7 +441,7 @@ int irq_enable(interrupt_controller_t *ic, interrupt_source_t source) {
 int irq_disable(interrupt_controller_t *ic, interrupt_source_t source) {
     if (!ic || source >= INT_COUNT) return -1;
 
-    ic->enabled_irqs &= ~(1 << source);
+    atomic_fetch_and(&ic->enabled_irqs, ~(1u << source));
     reg_clear_bits(ic->regs, REG_IRQ_ENABLE, (1 << source));
 
     return 0;
@@ -78,14 +450,14 @@ int irq_disable(interrupt_controller_t *ic, interrupt_source_t source) {
 void irq_enable_all(interrupt_controller_t *ic) {
     if (!ic) return;
 
-    ic->enabled_irqs = (1 << INT_COUNT) - 1;
-    reg_write(ic->regs, REG_IRQ_ENABLE, ic->enabled_irqs);
+    atomic_store(&ic->enabled_irqs, (1u << INT_COUNT) - 1);
+    reg_write(ic->regs, REG_IRQ_ENABLE, (1u << INT_COUNT) - 1);
 }
 
 void irq_disable_all(interrupt_controller_t *ic) {
     if (!ic) return;
 
-    ic->enabled_irqs = 0;
+    atomic_store(&ic->enabled_irqs, 0);
     reg_write(ic->regs, REG_IRQ_ENABLE, 0);
 }
 
@@ -93,9 +465,14 @@ void irq_trigger(interrupt_controller_t *ic, interrupt_source_t source) {
     if (!ic || source >= INT_COUNT) return;
 
     /* Only trigger if enabled */
-    if (ic->enabled_irqs & (1 << source)) {
-        ic->pending_irqs |= (1 << source);
-        reg_set_bits(ic->regs, REG_IRQ_STATUS, (1 << source));
+    if (atomic_load(&ic->enabled_irqs) & (1u << source)) {
+        if (ic->fast_handlers[source]) {
+            ic->fast_handlers[source](source, ic->fast_contexts[source]);
+        }
+        stamp_raise(ic, source);
+        atomic_fetch_add_explicit(&ic->event_count[source], 1, memory_order_relaxed);
+        atomic_fetch_or(&ic->pending_irqs, 1u << source);
+        reg_set_bits(ic->regs, REG_IRQ_STATUS, (1u << source));
     }
 }
 
@@ -110,51 +487,224 @@ int irq_process_pending(interrupt_controller_t *ic) {
         irq_trigger(ic, INT_TIMER);
     }
 
-    /* Process all pending interrupts */
-    for (int i = 0; i < INT_COUNT; i++) {
-        if ((ic->pending_irqs & (1 << i)) && ic->handlers[i]) {
-            ic->handlers[i]((interrupt_source_t)i, ic->handler_contexts[i]);
+    /*
+     * Intake is one exchange of the whole mask. After every handler the
+     * scan folds in whatever arrived meanwhile, so an urgent IRQ raised
+     * during lower-priority work goes next. Called from inside a handler,
+     * only strictly more urgent levels run; the rest is handed back.
+     */
+    uint8_t outer = ic->active_level;
+    bool outermost = (outer == IRQ_PRIORITY_NONE);
+
+    /* Odd for the whole dispatch: chains loaded below stay in use until the end */
+    if (outermost) {
+        atomic_fetch_add(&ic->dispatch_gen, 1);
+    }
+
+    uint32_t work = atomic_exchange(&ic->pending_irqs, 0);
+    uint32_t held = 0;
+
+    /* The clock is only read when some source is coalesced or watched */
+    uint64_t now = ic->timed_mask ? sim_clock_now_ns() : 0;
+
+    for (int n = 0; n < IRQ_DISPATCH_BUDGET; n++) {
+        int source = next_pending(ic, work, outer);
+        if (source < 0) break;
+
+        uint32_t bit = 1u << source;
+        work &= ~bit;
+
+        if ((ic->timed_mask & bit) && !coalesce_due(ic, source, now)) {
+            held |= bit;
+            work |= atomic_exchange(&ic->pending_irqs, 0) & ~held;
+            continue;
+        }
+        held &= ~bit;
+        reg_clear_bits(ic->regs, REG_IRQ_STATUS, bit);
+
+        /* Every raise since the last delivery is merged into this one */
+        irq_coalesce_t *c = &ic->coalesce[source];
+        uint32_t events_now = atomic_load_explicit(&ic->event_count[source],
+                                                   memory_order_relaxed);
+        c->merged = events_now - c->delivered_events;
+        c->delivered_events = events_now;
+        c->held_since_ns = 0;
+        c->deliveries++;
+
+        /*
+         * A raise that lands between intake and here is merged into this
+         * delivery, so its retrigger finds no stamp: counted, not timed.
+         */
+        shm_irq_stats_t *st = ic->stats;
+        uint64_t raised = atomic_exchange(&ic->raised_ns[source], 0);
+#if IRQ_INSTRUMENT
+        uint64_t start = sim_clock_now_ns();
+        if (raised && start > raised) {
+            lat_hist_record(&st->raise_latency[source], start - raised);
+        }
+#else
+        (void)raised;
+#endif
+        st->events[source] = events_now;
+        st->deliveries[source] = c->deliveries;
+        st->storms[source] = c->storms;
+
+        /* Nested dispatch is included in the outer handler's time */
+        const irq_chain_t *chain = atomic_load(&ic->chain[source]);
+        uint32_t handler_ns = 0;
+        if (chain->count) {
+            ic->active_level = ic->priority[source];
+            for (uint32_t i = 0; i < chain->count; i++) {
+                chain->entries[i].fn((interrupt_source_t)source, chain->entries[i].context);
+            }
+            ic->active_level = outer;
+#if IRQ_INSTRUMENT
+            handler_ns = (uint32_t)(sim_clock_now_ns() - start);
+            lat_hist_record(&st->handler_time[source], handler_ns);
+#endif
+        }
+        if (ic->trace) {
+            trace_emit(ic->trace, TRACE_IRQ, (uint16_t)source, c->merged, handler_ns,
+                       ic->priority[source], 0);
+        }
+        if (ic->deferred_handlers[source]) {
+            queue_deferred(ic, bit);
+        }
+        if (chain->count || ic->deferred_handlers[source]) {
             processed++;
         }
+
+        work |= atomic_exchange(&ic->pending_irqs, 0);
+    }
+
+    /* Not ours to run (held, lower level, or over budget): leave it pending */
+    work |= held;
+    if (work) {
+        atomic_fetch_or(&ic->pending_irqs, work);
     }
 
-    /* Clear processed interrupts */
-    ic->pending_irqs = 0;
-    reg_write(ic->regs, REG_IRQ_STATUS, 0);
+    /* Re-raised bits may have been cleared in the register above */
+    reg_write(ic->regs, REG_IRQ_STATUS, atomic_load(&ic->pending_irqs));
+
+    if (outermost) {
+        atomic_fetch_add(&ic->dispatch_gen, 1);
+    }
 
     return processed;
 }
 
 bool irq_is_pending(interrupt_controller_t *ic, interrupt_source_t source) {
     if (!ic || source >= INT_COUNT) return false;
-    return (ic->pending_irqs & (1 << source)) != 0;
+    return (atomic_load(&ic->pending_irqs) & (1u << source)) != 0;
 }
 
 uint32_t irq_get_pending_mask(interrupt_controller_t *ic) {
-    return ic ? ic->pending_irqs : 0;
+    return ic ? atomic_load(&ic->pending_irqs) : 0;
 }
 
 void irq_clear(interrupt_controller_t *ic, interrupt_source_t source) {
     if (!ic || source >= INT_COUNT) return;
 
-    ic->pending_irqs &= ~(1 << source);
-    reg_clear_bits(ic->regs, REG_IRQ_STATUS, (1 << source));
+    atomic_fetch_and(&ic->pending_irqs, ~(1u << source));
+    atomic_store(&ic->raised_ns[source], 0);
+    reg_clear_bits(ic->regs, REG_IRQ_STATUS, (1u << source));
 }
 
 void irq_signal_handler(int signum) {
-    if (!g_irq_controller) return;
+    interrupt_controller_t *ic = g_irq_controller;
+    if (!ic) return;
 
     /* Mark that we received a signal - actual processing happens in main loop */
-    g_irq_controller->signal_received = 1;
+    ic->signal_received = 1;
 
-    /* Map signals to interrupt sources */
+    /* Map signals to interrupt sources; lock-free atomics are signal-safe */
+    int source = -1;
     if (signum == SIGUSR1) {
-        g_irq_controller->pending_irqs |= (1 << INT_MOTOR_FAULT);
+        source = INT_MOTOR_FAULT;
     } else if (signum == SIGUSR2) {
-        g_irq_controller->pending_irqs |= (1 << INT_SENSOR_READY);
+        source = INT_SENSOR_READY;
+    }
+
+    if (source >= 0 && (atomic_load(&ic->enabled_irqs) & (1u << source))) {
+        if (ic->fast_handlers[source]) {
+            ic->fast_handlers[source]((interrupt_source_t)source, ic->fast_contexts[source]);
+        }
+        stamp_raise(ic, source);
+        atomic_fetch_add_explicit(&ic->event_count[source], 1, memory_order_relaxed);
+        atomic_fetch_or(&ic->pending_irqs, 1u << source);
     }
 }
 
+int irq_run_deferred(interrupt_controller_t *ic) {
+    if (!ic) return -1;
+
+    uint32_t work = atomic_exchange(&ic->deferred_pending, 0);
+    int ran = 0;
+
+    /* Bottom halves run in the same priority order as their top halves */
+    for (uint8_t level = 0; level < IRQ_PRIORITY_LEVELS && work; level++) {
+        uint32_t ready = work & ic->level_mask[level];
+        while (ready) {
+            int source = __builtin_ctz(ready);
+            ready &= ready - 1;
+            work &= ~(1u << source);
+
+            if (ic->deferred_handlers[source]) {
+                ic->deferred_handlers[source]((interrupt_source_t)source,
+                                              ic->deferred_contexts[source]);
+                ran++;
+            }
+        }
+    }
+
+    return ran;
+}
+
+int irq_start_worker(interrupt_controller_t *ic) {
+    if (!ic) return -1;
+    if (ic->worker_running) return -2;
+
+    ic->worker_stop = false;
+
+    /* The worker inherits a fully blocked mask so signals stay on the loop */
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    int rc = pthread_create(&ic->worker, NULL, deferred_worker, ic);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (rc != 0) return -3;
+
+    ic->worker_running = true;
+    return 0;
+}
+
+void irq_stop_worker(interrupt_controller_t *ic) {
+    if (!ic || !ic->worker_running) return;
+
+    pthread_mutex_lock(&ic->worker_lock);
+    ic->worker_stop = true;
+    pthread_cond_signal(&ic->worker_cond);
+    pthread_mutex_unlock(&ic->worker_lock);
+
+    pthread_join(ic->worker, NULL);
+    ic->worker_running = false;
+}
+
+int irq_handle_signal(interrupt_controller_t *ic, int signum) {
+    if (!ic) return -1;
+
+    if (signum == SIGUSR1) {
+        irq_trigger(ic, INT_MOTOR_FAULT);
+    } else if (signum == SIGUSR2) {
+        irq_trigger(ic, INT_SENSOR_READY);
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
 int irq_setup_signal_handler(interrupt_controller_t *ic) {
     if (!ic) return -1;
 
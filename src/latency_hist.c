@@ -0,0 +1,73 @@
+#include "latency_hist.h"
+#include <string.h>
+
+void lat_hist_reset(lat_hist_t *h) {
+    if (!h) return;
+    memset(h, 0, sizeof(lat_hist_t));
+}
+
+uint32_t lat_hist_bucket_index(uint32_t ns) {
+    if (ns < LAT_HIST_SUB_COUNT) {
+        return ns;
+    }
+
+    uint32_t exp = 31u - (uint32_t)__builtin_clz(ns);
+    uint32_t shift = exp - LAT_HIST_SUB_BITS;
+    uint32_t sub = (ns >> shift) & (LAT_HIST_SUB_COUNT - 1);
+
+    return LAT_HIST_SUB_COUNT + shift * LAT_HIST_SUB_COUNT + sub;
+}
+
+uint32_t lat_hist_bucket_floor(uint32_t index) {
+    if (index < LAT_HIST_SUB_COUNT) {
+        return index;
+    }
+    if (index >= LAT_HIST_BUCKETS) {
+        index = LAT_HIST_BUCKETS - 1;
+    }
+
+    uint32_t k = index - LAT_HIST_SUB_COUNT;
+    uint32_t shift = k / LAT_HIST_SUB_COUNT;
+    uint32_t sub = k % LAT_HIST_SUB_COUNT;
+
+    return (LAT_HIST_SUB_COUNT + sub) << shift;
+}
+
+void lat_hist_record(lat_hist_t *h, uint64_t ns) {
+    if (!h) return;
+
+    uint32_t v = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+
+    if (h->count == 0 || v < h->min_ns) h->min_ns = v;
+    if (v > h->max_ns) h->max_ns = v;
+    h->count++;
+    h->sum_ns += v;
+    h->buckets[lat_hist_bucket_index(v)]++;
+}
+
+uint32_t lat_hist_percentile(const lat_hist_t *h, uint32_t per_10k) {
+    if (!h || h->count == 0) return 0;
+    if (per_10k > 10000) per_10k = 10000;
+
+    /* Smallest bucket whose cumulative count reaches the rank */
+    uint64_t rank = (h->count * per_10k + 9999) / 10000;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            /* Report the bucket's upper edge, clamped to the observed max */
+            uint32_t upper = (i + 1 < LAT_HIST_BUCKETS) ?
+                             lat_hist_bucket_floor(i + 1) - 1 : UINT32_MAX;
+            return upper > h->max_ns ? h->max_ns : upper;
+        }
+    }
+
+    return h->max_ns;
+}
+
+uint32_t lat_hist_mean(const lat_hist_t *h) {
+    if (!h || h->count == 0) return 0;
+    return (uint32_t)(h->sum_ns / h->count);
+}
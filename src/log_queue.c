@@ -0,0 +1,137 @@
+#include "log_queue.h"
+#include <limits.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define LOG_MASK ((uint32_t)LOG_QUEUE_DEPTH - 1)
+
+/* Futex wrappers; the queue is process-local */
+static void futex_wait_ms(_Atomic uint32_t *addr, uint32_t expected, uint32_t timeout_ms) {
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeout_ms / 1000);
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_PRIVATE, expected, &ts, NULL, 0);
+#else
+    (void)addr;
+    (void)expected;
+    (void)timeout_ms;
+    sched_yield();
+#endif
+}
+
+static void futex_wake_all(_Atomic uint32_t *addr) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)addr;
+#endif
+}
+
+void log_queue_init(log_queue_t *q) {
+    if (!q) return;
+
+    atomic_init(&q->head, 0);
+    q->tail = 0;
+    atomic_init(&q->wake_seq, 0);
+    atomic_init(&q->waiters, 0);
+    atomic_init(&q->dropped, 0);
+
+    for (uint32_t i = 0; i < LOG_QUEUE_DEPTH; i++) {
+        atomic_init(&q->slots[i].turn, i);
+        q->slots[i].text[0] = '\0';
+    }
+}
+
+int log_printf(log_queue_t *q, const char *fmt, ...) {
+    if (!q || !fmt) return -1;
+
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    log_slot_t *slot;
+
+    for (;;) {
+        slot = &q->slots[pos & LOG_MASK];
+        uint32_t turn = atomic_load_explicit(&slot->turn, memory_order_acquire);
+        int32_t diff = (int32_t)(turn - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+            return -2;  /* Queue full: the logger is behind */
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(slot->text, sizeof(slot->text), fmt, ap);
+    va_end(ap);
+
+    atomic_store_explicit(&slot->turn, pos + 1, memory_order_release);
+
+    /* Only a sleeping logger costs the producer a syscall */
+    atomic_fetch_add_explicit(&q->wake_seq, 1, memory_order_release);
+    if (atomic_load(&q->waiters) > 0) {
+        futex_wake_all(&q->wake_seq);
+    }
+
+    return 0;
+}
+
+int log_queue_drain(log_queue_t *q, FILE *out) {
+    if (!q || !out) return -1;
+
+    int count = 0;
+
+    for (;;) {
+        log_slot_t *slot = &q->slots[q->tail & LOG_MASK];
+        if (atomic_load_explicit(&slot->turn, memory_order_acquire) != q->tail + 1) {
+            break;  /* Empty, or producer still formatting */
+        }
+
+        fputs(slot->text, out);
+        atomic_store_explicit(&slot->turn, q->tail + LOG_QUEUE_DEPTH, memory_order_release);
+        q->tail++;
+        count++;
+    }
+
+    return count;
+}
+
+int log_queue_wait(log_queue_t *q, uint32_t timeout_ms) {
+    if (!q) return -1;
+
+    uint32_t seen = atomic_load_explicit(&q->wake_seq, memory_order_acquire);
+    log_slot_t *slot = &q->slots[q->tail & LOG_MASK];
+    if (atomic_load_explicit(&slot->turn, memory_order_acquire) == q->tail + 1) {
+        return 1;
+    }
+
+    atomic_fetch_add(&q->waiters, 1);
+    if (atomic_load(&q->wake_seq) == seen) {
+        futex_wait_ms(&q->wake_seq, seen, timeout_ms);
+    }
+    atomic_fetch_sub(&q->waiters, 1);
+
+    return atomic_load_explicit(&slot->turn, memory_order_acquire) == q->tail + 1;
+}
+
+uint64_t log_queue_dropped(log_queue_t *q) {
+    if (!q) return 0;
+
+    return atomic_load(&q->dropped);
+}
@@ -3,93 +3,265 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
 
-#include "device_registers.h"
-#include "motor_controller.h"
-#include "sensor_array.h"
-#include "interrupt_handler.h"
-#include "shared_mem.h"
+#include "driver.h"
+#include "sample_stream.h"
+#include "rt_thread.h"
+#include "simulator.h"
 
-/* Global running flag */
+/* Thread layout: control above IPC on SCHED_FIFO, logging time-shared */
+#define CONTROL_PRIORITY            80
+#define CONTROL_STACK_PREFAULT      (64 * 1024)
+#define LOG_FLUSH_INTERVAL_MS       100
+
+/* Flight recorder ring; each new fault trip freezes a copy next to it */
+#define TRACE_DEFAULT_PATH          "/tmp/motor_driver.trace"
+
+/* Back-off while a client is still writing the frame at the ring tail */
+#define IPC_RETRY_NS                50000
+
+/* Global running flag; g_restart turns the exit into a warm restart */
 static volatile sig_atomic_t g_running = 1;
+static volatile sig_atomic_t g_restart = 0;
+
+/* Every line printed while the driver runs goes through the logging thread */
+static log_queue_t g_log;
+static atomic_bool g_logging = true;
+
+/* Trace ring; the logging thread dumps it when the driver's dump_request moves */
+static trace_t g_trace;
+static const char *g_trace_path = TRACE_DEFAULT_PATH;
+
+/* A reattached segment stays for the clients still mapping it; a new one goes */
+static void release_shm(shared_mem_t *shm, bool attached) {
+    if (attached) {
+        shm_close(shm);
+    } else {
+        shm_destroy(shm);
+    }
+}
 
 /* Signal handler for graceful shutdown */
 static void shutdown_handler(int signum) {
-    (void)signum;
+    if (signum == SIGHUP) g_restart = 1;
     g_running = 0;
 }
 
-/* IRQ callback for motor faults */
-static void motor_fault_handler(interrupt_source_t source, void *context) {
-    (void)source;
-    motor_controller_t *mc = (motor_controller_t*)context;
-    printf("[IRQ] Motor fault detected: %d\n", motor_get_fault(mc));
-}
+/*
+ * IPC thread: sleeps until a client queues a command, then takes each frame
+ * off the ring and runs it under the driver lock, between control ticks.
+ * Holding the lock across the take means a warm restart, which execs with
+ * the lock held, never lands halfway through popping a frame.
+ */
+static void *ipc_thread(void *arg) {
+    driver_t *drv = (driver_t*)arg;
+    shm_command_t ops[SHM_FRAME_MAX_OPS];
+
+    while (shm_wait_commands(drv->shm) == 0) {
+        pthread_mutex_lock(&drv->lock);
+        int count = shm_poll_frame(drv->shm, ops);
+        if (count <= 0) {
+            /* Claimed but not yet published; never spin over the client */
+            pthread_mutex_unlock(&drv->lock);
+            struct timespec retry = { 0, IPC_RETRY_NS };
+            nanosleep(&retry, NULL);
+            continue;
+        }
+
+        /* Each one is answered unless posted without reply, even CMD_NONE */
+        uint64_t start = event_loop_now_ns();
+        driver_process(drv, ops, count);
+        lat_hist_record(&drv->shm->loop_stats.phases[LOOP_PHASE_COMMAND],
+                        event_loop_now_ns() - start);
+        pthread_mutex_unlock(&drv->lock);
+    }
 
-/* IRQ callback for sensor ready */
-static void sensor_ready_handler(interrupt_source_t source, void *context) {
-    (void)source;
-    sensor_array_t *sa = (sensor_array_t*)context;
-    printf("[IRQ] Sensor data ready, buffer count: %d\n", sensor_buffer_count(sa));
+    return NULL;
 }
 
-/* Process commands from shared memory */
-static void process_command(shared_mem_t *shm, motor_controller_t *mc,
-                           sensor_array_t *sa, command_type_t cmd,
-                           uint32_t param1, uint32_t param2) {
-    int32_t resp_data[8] = {0};
-    response_status_t status = RESP_OK;
-
-    switch (cmd) {
-        case CMD_MOTOR_START:
-            if (motor_start(mc, param1, (motor_direction_t)param2) < 0) {
-                status = RESP_ERROR;
-            }
-            break;
+/* Logging thread: the only place stdout is written while the driver runs */
+static void *log_thread(void *arg) {
+    driver_t *drv = (driver_t*)arg;
+    log_queue_t *q = drv->log;
+    uint64_t reported = 0;
+    uint64_t dumped = 0;
 
-        case CMD_MOTOR_STOP:
-            if (motor_stop(mc) < 0) {
-                status = RESP_ERROR;
-            }
-            break;
+    for (;;) {
+        bool last = !atomic_load(&g_logging);
+
+        log_queue_wait(q, LOG_FLUSH_INTERVAL_MS);
+        int lines = log_queue_drain(q, stdout);
 
-        case CMD_MOTOR_SET_SPEED:
-            if (motor_set_speed(mc, param1) < 0) {
-                status = RESP_ERROR;
+        uint64_t dropped = log_queue_dropped(q);
+        if (dropped != reported) {
+            printf("[LOG] %llu lines dropped\n", (unsigned long long)(dropped - reported));
+            reported = dropped;
+            lines++;
+        }
+        uint64_t dump = atomic_load(&drv->dump_request);
+        if (dump != dumped) {
+            char path[256];
+            snprintf(path, sizeof(path), "%s.fault-%llu", g_trace_path,
+                     (unsigned long long)dump);
+            if (trace_dump(&g_trace, path) == 0) {
+                printf("[TRACE] Dumped to %s\n", path);
+            } else {
+                printf("[TRACE] Dump to %s failed\n", path);
             }
-            break;
+            dumped = dump;
+            lines++;
+        }
 
-        case CMD_SENSOR_READ:
-            sensor_read_all(sa, resp_data, 4);
-            break;
+        if (lines > 0) fflush(stdout);
+        if (last) break;
+    }
 
-        case CMD_GET_STATUS:
-            resp_data[0] = motor_get_state(mc);
-            resp_data[1] = (int32_t)motor_get_speed(mc);
-            resp_data[2] = motor_get_position(mc);
-            resp_data[3] = motor_get_fault(mc);
-            break;
+    return NULL;
+}
 
-        case CMD_RESET:
-            motor_reset(mc);
-            sensor_buffer_clear(sa);
-            break;
+/*
+ * Simulation mode: replay a script, or the commands in a driver trace, on
+ * virtual time and report where it ends. ticks = 0 runs one status
+ * interval past the last input.
+ */
+static int simulate(const char *path, uint32_t axes, uint32_t period_us, uint32_t ticks) {
+    static sim_t sim;
+    sim_script_t script;
+    sim_script_init(&script);
+
+    if (sim_script_load(&script, path) < 0) {
+        trace_t t;
+        if (trace_open_file(&t, path) < 0) {
+            fprintf(stderr, "%s is neither a simulation script nor a trace\n", path);
+            return 1;
+        }
+        int ret = sim_script_from_trace(&script, &t);
+        trace_close(&t);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to read commands from %s\n", path);
+            sim_script_free(&script);
+            return 1;
+        }
+    }
 
-        default:
-            status = RESP_INVALID_CMD;
-            break;
+    if (sim_init(&sim, axes, period_us) < 0) {
+        fprintf(stderr, "Failed to start simulation (%u axes, %u us period)\n", axes,
+                period_us);
+        sim_script_free(&script);
+        return 1;
     }
+    if (ticks == 0) {
+        uint32_t last = script.count ? script.inputs[script.count - 1].tick : 0;
+        ticks = last + 1 + DRIVER_STATUS_INTERVAL_US / period_us;
+    }
+
+    printf("Simulating %u input(s) from %s over %u ticks of %u us\n", script.count, path,
+           ticks, period_us);
+    /* Host time, which the driver clock no longer is */
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    sim_play(&sim, &script);
+    sim_run(&sim, ticks);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    uint64_t wall = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ULL +
+                    (uint64_t)t1.tv_nsec - (uint64_t)t0.tv_nsec;
+
+    double simulated_s = (double)(sim_now_ns(&sim) - SIM_START_NS) / 1e9;
+    printf("Simulated %.3f s in %.3f s (%.0fx real time)\n", simulated_s, (double)wall / 1e9,
+           wall ? simulated_s * 1e9 / (double)wall : 0.0);
+    for (uint32_t i = 0; i < axes; i++) {
+        printf("Axis %u: State=%d Speed=%u Position=%d Fault=%d\n", i,
+               motor_bank_get_state(&sim.drv.motors, i), motor_bank_get_speed(&sim.drv.motors, i),
+               motor_bank_get_position(&sim.drv.motors, i),
+               motor_bank_get_fault(&sim.drv.motors, i));
+    }
+    printf("Fault trips: %llu\n", (unsigned long long)atomic_load(&sim.drv.trip.trips));
+    printf("Digest: %016llx\n", (unsigned long long)sim_digest(&sim));
 
-    shm_send_response(shm, status, resp_data, 8);
+    sim_cleanup(&sim);
+    sim_script_free(&script);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-p period_us] [-a axes] [-r backend] [-t trace] [-P prio] [-c cpu] [-i cpu] [-l cpu]\n",
+           prog);
+    printf("       %s -S script [-n ticks] [-p period_us] [-a axes]\n", prog);
+    printf("  -p  control tick period in microseconds (%u..%u, default %u)\n",
+           EVENT_LOOP_MIN_PERIOD_US, EVENT_LOOP_MAX_PERIOD_US,
+           EVENT_LOOP_DEFAULT_PERIOD_US);
+    printf("  -a  number of motor axes (1..%u, default 1)\n", MOTOR_BANK_MAX_AXES);
+    printf("  -r  axis 0 registers: sim, shm:/name, uio:/dev/uioN or mem:0xaddr (default sim)\n");
+    printf("  -t  trace ring file, or none (default %s)\n", TRACE_DEFAULT_PATH);
+    printf("  -P  control thread SCHED_FIFO priority, IPC runs at half (0..%d, default %d, 0 = off)\n",
+           RT_THREAD_MAX_PRIORITY, CONTROL_PRIORITY);
+    printf("  -c, -i, -l  pin the control, IPC and logging threads to a CPU (default unpinned)\n");
+    printf("  -S  simulate: replay a script or a trace's commands on virtual time, then exit\n");
+    printf("  -n  ticks to simulate (default: until the last input, plus %u ms)\n",
+           DRIVER_STATUS_INTERVAL_US / 1000);
 }
 
 int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
+    uint32_t period_us = EVENT_LOOP_DEFAULT_PERIOD_US;
+    uint32_t axes = 1;
+    const char *backend = "sim";
+    rt_thread_attr_t control_attr = { RT_THREAD_ANY_CPU, CONTROL_PRIORITY };
+    rt_thread_attr_t ipc_attr = { RT_THREAD_ANY_CPU, 0 };
+    rt_thread_attr_t log_attr = { RT_THREAD_ANY_CPU, 0 };
+    const char *script = NULL;
+    uint32_t run_ticks = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:a:r:t:P:c:i:l:S:n:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                period_us = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                axes = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                backend = optarg;
+                break;
+            case 't':
+                g_trace_path = strcmp(optarg, "none") == 0 ? NULL : optarg;
+                break;
+            case 'P':
+                control_attr.priority = atoi(optarg);
+                break;
+            case 'c':
+                control_attr.cpu = atoi(optarg);
+                break;
+            case 'i':
+                ipc_attr.cpu = atoi(optarg);
+                break;
+            case 'l':
+                log_attr.cpu = atoi(optarg);
+                break;
+            case 'S':
+                script = optarg;
+                break;
+            case 'n':
+                run_ticks = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (script) {
+        return simulate(script, axes, period_us, run_ticks);
+    }
+
+    ipc_attr.priority = control_attr.priority / 2;
+    if (control_attr.priority > 0 && ipc_attr.priority == 0) ipc_attr.priority = 1;
 
     printf("Embedded Motor Controller Driver\n");
     printf("================================\n\n");
-
     /* Setup shutdown signal handler */
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
@@ -97,110 +269,241 @@ int main(int argc, char *argv[]) {
     sigemptyset(&sa.sa_mask);
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    /*
+     * Shared memory for IPC; the driver publishes its status and statistics
+     * here. A segment left by a previous driver is reattached, not wiped, so
+     * its clients keep their mappings.
+     */
+    shared_mem_t *shm = shm_attach();
+    bool attached = shm != NULL;
+    if (!attached) shm = shm_create();
+    if (!shm) {
+        fprintf(stderr, "Failed to create shared memory\n");
+        return 1;
+    }
 
-    /* Initialize components */
-    register_file_t regs;
-    motor_controller_t motor;
-    sensor_array_t sensors;
-    interrupt_controller_t irq;
-
-    reg_init(&regs);
-    motor_init(&motor, &regs);
-    sensor_array_init(&sensors, &regs);
-    irq_init(&irq, &regs, &motor, &sensors);
-
-    /* Register interrupt handlers */
-    irq_register_handler(&irq, INT_MOTOR_FAULT, motor_fault_handler, &motor);
-    irq_register_handler(&irq, INT_MOTOR_STALL, motor_fault_handler, &motor);
-    irq_register_handler(&irq, INT_SENSOR_READY, sensor_ready_handler, &sensors);
+    /* Initialize components; axis 0 shares its register file with sensors and IRQs */
+    static driver_t drv;
+    int ret = driver_init(&drv, axes, period_us, backend, shm);
+    if (ret == -3) {
+        fprintf(stderr, "Failed to map registers (%s)\n", backend);
+    } else if (ret < 0) {
+        fprintf(stderr, "Invalid configuration: %u axes (1..%u), %u us period (%u..%u), registers %s\n",
+                axes, MOTOR_BANK_MAX_AXES, period_us, EVENT_LOOP_MIN_PERIOD_US,
+                EVENT_LOOP_MAX_PERIOD_US, backend);
+    }
+    if (ret < 0) {
+        release_shm(shm, attached);
+        return 1;
+    }
+    drv.log = &g_log;
+
+    /* Warm restart: pick up where the previous driver's last tick left off */
+    static shm_driver_state_t saved;
+    bool warm = attached && shm_load_state(shm, &saved) == 0 &&
+                driver_restore_state(&drv, &saved) == 0;
+    if (warm) {
+        printf("Warm restart: resuming at tick %lu (%u us period)\n", drv.tick, drv.period_us);
+    } else if (attached) {
+        printf("Reattached to shared memory, no usable saved state: starting cold\n");
+    }
 
-    /* Enable interrupts */
-    irq_enable(&irq, INT_MOTOR_FAULT);
-    irq_enable(&irq, INT_MOTOR_STALL);
-    irq_enable(&irq, INT_SENSOR_READY);
+    /* Always-on flight recorder: register writes, IRQ dispatch and trips */
+    trace_t *trace = NULL;
+    if (g_trace_path) {
+        if (trace_open(&g_trace, g_trace_path, 0) == 0) {
+            trace = &g_trace;
+            driver_set_trace(&drv, trace);
+        } else {
+            fprintf(stderr, "Failed to open trace %s, tracing off\n", g_trace_path);
+        }
+    }
 
     /* Setup signal-based interrupt handling */
-    irq_setup_signal_handler(&irq);
-
-    /* Create shared memory for IPC */
-    shared_mem_t *shm = shm_create();
-    if (!shm) {
-        fprintf(stderr, "Failed to create shared memory\n");
+    irq_setup_signal_handler(&drv.irq);
+
+    /*
+     * Publish every sample to stream readers. A region left by a previous
+     * driver is reused as is, so its head and its readers' cursors carry
+     * over; only a missing one is created (and initialised).
+     */
+    sample_stream_t *stream = sample_stream_open();
+    if (!stream) stream = sample_stream_create();
+    if (!stream) {
+        fprintf(stderr, "Failed to create sample stream\n");
+        driver_cleanup(&drv);
+        if (trace) trace_close(trace);
+        release_shm(shm, attached);
         return 1;
     }
-
-    /* Enable sensors */
-    sensor_array_enable(&sensors);
+    sensor_array_set_stream(&drv.sensors, stream);
 
     printf("Driver initialized. PID: %d\n", getpid());
-    printf("Send SIGUSR1 for motor fault, SIGUSR2 for sensor interrupt\n");
+    printf("Send SIGUSR1 for motor fault, SIGUSR2 for sensor interrupt, SIGHUP for a warm restart\n");
     printf("Press Ctrl+C to exit\n\n");
 
-    /* Demo: Start motor */
-    printf("Starting motor at 5000 RPM clockwise...\n");
-    motor_start(&motor, 5000, MOTOR_DIR_CW);
+    if (!warm) {
+        /* Demo: Start every axis */
+        printf("Starting %u motor axis(es) at 5000 RPM clockwise...\n", axes);
+        for (uint32_t i = 0; i < axes; i++) {
+            motor_bank_start(&drv.motors, i, 5000, MOTOR_DIR_CW);
+        }
+
+        /* Set some simulated sensor values */
+        sensor_set_simulated_value(&drv.sensors, 0, 100);   /* Position */
+        sensor_set_simulated_value(&drv.sensors, 1, 5000);  /* Velocity */
+        sensor_set_simulated_value(&drv.sensors, 2, 45);    /* Temperature */
+        sensor_set_simulated_value(&drv.sensors, 3, 2500);  /* Current */
+    }
+
+    /* Event-driven loop: control tick and IRQ signals; commands wake the IPC thread */
+    event_loop_t loop;
+    if (event_loop_init(&loop, drv.period_us, NULL, &drv.irq) < 0) {
+        fprintf(stderr, "Failed to initialize event loop (period %u us)\n", drv.period_us);
+        driver_cleanup(&drv);
+        sensor_array_set_stream(&drv.sensors, NULL);
+        sample_stream_destroy(stream);
+        if (trace) trace_close(trace);
+        release_shm(shm, attached);
+        return 1;
+    }
+    drv.loop = &loop;
 
-    /* Set some simulated sensor values */
-    sensor_set_simulated_value(&sensors, 0, 100);   /* Position */
-    sensor_set_simulated_value(&sensors, 1, 5000);  /* Velocity */
-    sensor_set_simulated_value(&sensors, 2, 45);    /* Temperature */
-    sensor_set_simulated_value(&sensors, 3, 2500);  /* Current */
+    /* Bottom halves run on their own thread, started after signals are routed */
+    if (irq_start_worker(&drv.irq) < 0) {
+        fprintf(stderr, "Failed to start IRQ worker\n");
+    }
 
-    /* Main loop */
-    int tick = 0;
+    printf("Control tick: %u us\n", loop.period_us);
+    fflush(stdout);
+
+    /* Helpers start before this thread goes real-time, so they do not inherit it */
+    log_queue_init(&g_log);
+    pthread_t logger, ipc;
+    bool logging = pthread_create(&logger, NULL, log_thread, &drv) == 0;
+    if (!logging || pthread_create(&ipc, NULL, ipc_thread, &drv) != 0) {
+        fprintf(stderr, "Failed to start driver threads\n");
+        if (logging) {
+            atomic_store(&g_logging, false);
+            pthread_join(logger, NULL);
+        }
+        /* Clients of a reattached segment must not wait on a driver that is gone */
+        shm_request_shutdown(shm);
+        driver_cleanup(&drv);   /* Stops the IRQ worker */
+        event_loop_cleanup(&loop);
+        sensor_array_set_stream(&drv.sensors, NULL);
+        sample_stream_destroy(stream);
+        if (trace) trace_close(trace);
+        release_shm(shm, attached);
+        return 1;
+    }
+    if (rt_thread_set(logger, &log_attr) < 0) {
+        fprintf(stderr, "Logging thread: affinity not applied\n");
+    }
+    if (rt_thread_set(ipc, &ipc_attr) < 0) {
+        fprintf(stderr, "IPC thread: scheduling not applied (priority %d, cpu %d)\n",
+                ipc_attr.priority, ipc_attr.cpu);
+    }
+    if (control_attr.priority > 0 && rt_lock_memory(CONTROL_STACK_PREFAULT) < 0) {
+        fprintf(stderr, "Control thread: memory not locked\n");
+    }
+    if (rt_thread_apply(&control_attr) < 0) {
+        fprintf(stderr, "Control thread: scheduling not applied (priority %d, cpu %d)\n",
+                control_attr.priority, control_attr.cpu);
+    }
+
+    shm_loop_stats_t *stats = &shm->loop_stats;
     while (g_running && !shm_is_shutdown_requested(shm)) {
-        /* Update motor state machine */
-        motor_update(&motor);
+        uint32_t events;
+        if (event_loop_wait(&loop, &events) < 0) {
+            perror("event_loop_wait");
+            break;
+        }
 
-        /* Trigger sensor sampling periodically */
-        if (tick % 10 == 0) {
-            sensor_array_trigger(&sensors);
+        if (events & LOOP_EVENT_SHUTDOWN) {
+            break;
         }
-        sensor_array_update(&sensors);
+        if (events & LOOP_EVENT_RESTART) {
+            g_restart = 1;
+            break;
+        }
+
+        pthread_mutex_lock(&drv.lock);
 
-        /* Check for and process interrupts */
-        if (motor_get_state(&motor) == MOTOR_STATE_FAULT) {
-            irq_trigger(&irq, INT_MOTOR_FAULT);
+        if (events & LOOP_EVENT_TICK) {
+            lat_hist_record(&stats->phases[LOOP_PHASE_WAKEUP],
+                            event_loop_now_ns() - loop.last_deadline_ns);
         }
-        irq_process_pending(&irq);
-
-        /* Update shared memory status */
-        int32_t sensor_vals[4];
-        sensor_read_all(&sensors, sensor_vals, 4);
-        shm_update_status(shm, motor_get_state(&motor), motor_get_speed(&motor),
-                         motor_get_position(&motor), sensor_vals, motor_get_fault(&motor));
-
-        /* Check for commands (non-blocking check) */
-        command_type_t cmd;
-        uint32_t p1, p2;
-        if (shm_try_get_command(shm, &cmd, &p1, &p2) == 0 && cmd != CMD_NONE) {
-            process_command(shm, &motor, &sensors, cmd, p1, p2);
+
+        /* Signal-raised IRQs are raised and serviced as soon as they arrive */
+        if (events & LOOP_EVENT_IRQ) {
+            event_loop_deliver_irqs(&loop);
+            irq_process_pending(&drv.irq);
         }
 
-        /* Print status every 50 ticks */
-        if (tick % 50 == 0) {
-            printf("Tick %d: State=%d Speed=%u Position=%d Temp=%d\n",
-                   tick, motor_get_state(&motor), motor_get_speed(&motor),
-                   motor_get_position(&motor), sensor_read(&sensors, 2));
-            fflush(stdout);
+        if (events & LOOP_EVENT_TICK) {
+            sim_plant_step(&drv);   /* Demo motor on simulated registers */
+            driver_tick(&drv);
+            stats->missed_deadlines = loop.missed_ticks;
         }
 
-        usleep(10000);  /* 10ms */
-        tick++;
+        pthread_mutex_unlock(&drv.lock);
+    }
+
+    /* Back to time-sharing for teardown */
+    rt_thread_attr_t teardown_attr = { RT_THREAD_ANY_CPU, 0 };
+    rt_thread_apply(&teardown_attr);
+
+    if (g_restart) {
+        /*
+         * Warm restart: the next image reattaches the segment and resumes
+         * from this save. With the lock held the IPC thread is asleep on
+         * the command futex or blocked on the lock, never mid-frame, and
+         * the segment holds no lock it could be cut off inside. Shutdown is
+         * never flagged, so clients just see a pause. The loop's signals
+         * stay blocked across exec and queue for the next image's signalfd.
+         * /proc/self/exe is this binary whatever argv[0] and PATH say.
+         */
+        pthread_mutex_lock(&drv.lock);
+        driver_save_state(&drv);
+        atomic_store(&g_logging, false);
+        pthread_join(logger, NULL);
+        printf("\nWarm restart at tick %lu...\n", drv.tick);
+        fflush(stdout);
+        execv("/proc/self/exe", argv);
+        perror("execv");
+        pthread_mutex_unlock(&drv.lock);
+    }
+
+    /* Release the IPC thread and drain the log */
+    shm_request_shutdown(shm);
+    pthread_join(ipc, NULL);
+    if (!g_restart) {
+        atomic_store(&g_logging, false);
+        pthread_join(logger, NULL);
     }
 
     printf("\nShutting down...\n");
 
     /* Cleanup */
-    motor_stop(&motor);
-    while (motor_is_running(&motor)) {
-        motor_update(&motor);
+    for (uint32_t i = 0; i < axes; i++) {
+        motor_bank_stop(&drv.motors, i);
+    }
+    while (motor_bank_any_running(&drv.motors)) {
+        motor_bank_update(&drv.motors);
         usleep(10000);
     }
 
-    sensor_array_disable(&sensors);
-    irq_cleanup(&irq);
+    driver_cleanup(&drv);
+    event_loop_cleanup(&loop);
+    sensor_array_set_stream(&drv.sensors, NULL);
+    sample_stream_destroy(stream);
     shm_destroy(shm);
+    if (trace) {
+        trace_close(trace);
+    }
 
     printf("Driver stopped.\n");
     return 0;
@@ -0,0 +1,258 @@
+#include "motion_profile.h"
+#include <string.h>
+
+/* Constant-acceleration move of distance D, in ticks and counts */
+typedef struct {
+    double d;
+    double a;
+    double vp;      /* Peak velocity */
+    double ta;      /* Ramp time */
+    double tc;      /* Cruise time */
+    double t;       /* Total time */
+} trapezoid_t;
+
+/* Newton's method; planning only, so no libm dependency */
+static double sqrt_pos(double x) {
+    if (x <= 0.0) return 0.0;
+
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; i++) {
+        double next = 0.5 * (r + x / r);
+        if (next >= r) break;
+        r = next;
+    }
+    return r;
+}
+
+static void plan_trapezoid(trapezoid_t *tp, const motion_limits_t *lim, double d) {
+    double vmax = (double)lim->max_velocity;
+
+    tp->d = d;
+    tp->a = vmax / (double)lim->accel_ticks;
+
+    if (d >= vmax * (double)lim->accel_ticks) {
+        tp->vp = vmax;
+        tp->ta = (double)lim->accel_ticks;
+        tp->tc = (d - vmax * tp->ta) / vmax;
+    } else {
+        /* Too short to reach max velocity: triangular profile */
+        tp->vp = sqrt_pos(d * tp->a);
+        tp->ta = tp->vp / tp->a;
+        tp->tc = 0.0;
+    }
+    tp->t = 2.0 * tp->ta + tp->tc;
+}
+
+static double trapezoid_at(const trapezoid_t *tp, double t) {
+    if (t <= 0.0) return 0.0;
+    if (t >= tp->t) return tp->d;
+
+    if (t < tp->ta) {
+        return 0.5 * tp->a * t * t;
+    }
+    if (t < tp->ta + tp->tc) {
+        return 0.5 * tp->a * tp->ta * tp->ta + tp->vp * (t - tp->ta);
+    }
+
+    double left = tp->t - t;
+    return tp->d - 0.5 * tp->a * left * left;
+}
+
+/*
+ * Fill a move's delta table. An S-curve is the trapezoid averaged over a
+ * jerk_ticks window: that turns each acceleration step into a linear ramp
+ * (constant jerk), keeps the distance, and adds jerk_ticks - 1 ticks.
+ */
+static int plan_move(const motion_limits_t *lim, motion_move_t *mv, int32_t start,
+                     int32_t target, motion_shape_t shape) {
+    int64_t dist = (int64_t)target - start;
+    int32_t sign = dist < 0 ? -1 : 1;
+    if (dist < 0) dist = -dist;
+
+    trapezoid_t tp;
+    plan_trapezoid(&tp, lim, (double)dist);
+
+    uint32_t window = 1;
+    if (shape == MOTION_SCURVE && lim->jerk_ticks > 1) {
+        window = lim->jerk_ticks;
+    }
+
+    uint64_t ramp_end = (uint64_t)tp.t;
+    if ((double)ramp_end < tp.t) ramp_end++;
+    uint64_t length = ramp_end + window - 1;
+    if (length > MOTION_TABLE_TICKS) return -3;
+
+    double sum = 0.0;
+    int64_t prev = 0;
+    for (uint32_t t = 1; t <= length; t++) {
+        sum += trapezoid_at(&tp, (double)t);
+        if (t > window) {
+            sum -= trapezoid_at(&tp, (double)(t - window));
+        }
+
+        int64_t p = (t == length) ? dist : (int64_t)(sum / window + 0.5);
+        mv->delta[t - 1] = (int16_t)((p - prev) * sign);
+        prev = p;
+    }
+
+    mv->length = (uint32_t)length;
+    mv->pos = 0;
+    mv->ramp_ticks = (uint32_t)tp.ta;
+    mv->sign = sign;
+    mv->target = target;
+    mv->planned = true;
+    mv->running = false;
+
+    return 0;
+}
+
+int motion_profile_init(motion_profile_t *mp, const motion_limits_t *limits,
+                        int32_t position) {
+    if (!mp || !limits) return -1;
+    if (limits->max_velocity == 0 || limits->max_velocity > MOTION_MAX_VELOCITY) return -1;
+    if (limits->accel_ticks == 0) return -1;
+
+    memset(mp, 0, sizeof(motion_profile_t));
+    mp->limits = *limits;
+    mp->setpoint = position;
+
+    return 0;
+}
+
+int motion_profile_move(motion_profile_t *mp, int32_t target, motion_shape_t shape) {
+    if (!mp) return -1;
+
+    motion_move_t *cur = &mp->moves[mp->current];
+    motion_move_t *next = &mp->moves[mp->current ^ 1];
+
+    if (!cur->planned) {
+        if (target == mp->setpoint) return 0;
+
+        mp->blend = 0;
+        return plan_move(&mp->limits, cur, mp->setpoint, target, shape);
+    }
+
+    if (next->planned) return -2;
+    if (target == cur->target) return 0;
+
+    int ret = plan_move(&mp->limits, next, cur->target, target, shape);
+    if (ret < 0) return ret;
+
+    /*
+     * Same direction and shape: start the next move while this one ramps
+     * down. Both ramps have the same slope, so the velocities add up to at
+     * most the current one and the distance is unchanged. An S-curve's
+     * averaging window is added to the lead because its ramps end late.
+     */
+    mp->blend = 0;
+    if (next->sign == cur->sign && next->length > 0) {
+        uint32_t window = (shape == MOTION_SCURVE && mp->limits.jerk_ticks > 1) ?
+                          mp->limits.jerk_ticks : 1;
+        uint32_t overlap = cur->ramp_ticks < next->ramp_ticks ?
+                           cur->ramp_ticks : next->ramp_ticks;
+        mp->blend = overlap + window - 1;
+    }
+
+    return 0;
+}
+
+void motion_profile_abort(motion_profile_t *mp) {
+    if (!mp) return;
+
+    mp->moves[0].planned = mp->moves[0].running = false;
+    mp->moves[1].planned = mp->moves[1].running = false;
+    mp->blend = 0;
+    mp->following = false;
+}
+
+int motion_profile_step(motion_profile_t *mp, int32_t *delta) {
+    if (!mp || !delta) return -1;
+
+    motion_move_t *cur = &mp->moves[mp->current];
+    motion_move_t *next = &mp->moves[mp->current ^ 1];
+
+    if (cur->planned && !cur->running) {
+        cur->running = true;
+    }
+    if (next->planned && !next->running && cur->length - cur->pos <= mp->blend) {
+        next->running = true;
+    }
+    if (!cur->running && !next->running) {
+        *delta = 0;
+        return 0;
+    }
+
+    int32_t d = 0;
+    if (cur->running) {
+        d += cur->delta[cur->pos++];
+        if (cur->pos == cur->length) {
+            cur->running = cur->planned = false;
+        }
+    }
+    if (next->running) {
+        d += next->delta[next->pos++];
+        if (next->pos == next->length) {
+            next->running = next->planned = false;
+        }
+    }
+
+    /* The queued move becomes current once the old one has finished */
+    if (!cur->planned && next->planned) {
+        mp->current ^= 1;
+        mp->blend = 0;
+    }
+
+    mp->setpoint += d;
+    *delta = d;
+    return 1;
+}
+
+bool motion_profile_active(motion_profile_t *mp) {
+    return mp && (mp->moves[0].planned || mp->moves[1].planned);
+}
+
+int32_t motion_profile_setpoint(motion_profile_t *mp) {
+    return mp ? mp->setpoint : 0;
+}
+
+int motion_profile_follow(motion_profile_t *mp, const motor_lanes_t *l, uint32_t axis) {
+    if (!mp || !l) return -1;
+
+    if (l->state[axis] == MOTOR_STATE_FAULT) {
+        motion_profile_abort(mp);
+        return -2;
+    }
+
+    int32_t d;
+    register_file_t *regs = &l->regs[axis];
+
+    if (motion_profile_step(mp, &d) == 1) {
+        motor_direction_t dir = d > 0 ? MOTOR_DIR_CW :
+                                d < 0 ? MOTOR_DIR_CCW : l->direction[axis];
+
+        if (!mp->following || dir != l->direction[axis]) {
+            uint32_t ctrl = MOTOR_CTRL_ENABLE;
+            if (dir == MOTOR_DIR_CW) ctrl |= MOTOR_CTRL_DIR_CW;
+            reg_write(regs, REG_MOTOR_CTRL, ctrl);
+            reg_set_bits(regs, REG_MOTOR_STATUS, MOTOR_STATUS_RUNNING);
+        }
+
+        /* Target equals current, so the ramp leaves the speed alone */
+        uint32_t speed = (uint32_t)(d < 0 ? -d : d) * 100;
+        l->direction[axis] = dir;
+        l->target_speed[axis] = speed;
+        l->current_speed[axis] = speed;
+        l->state[axis] = MOTOR_STATE_RUNNING;
+        mp->following = true;
+        return 1;
+    }
+
+    /* Move finished: let the lane wind down to idle */
+    if (mp->following) {
+        mp->following = false;
+        l->current_speed[axis] = 0;
+        motor_lane_stop(l, axis);
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "motor_bank.h"
+#include <string.h>
+
+motor_lanes_t motor_bank_lanes(motor_bank_t *bank) {
+    motor_lanes_t l = {
+        .state = bank->state,
+        .fault_code = bank->fault_code,
+        .target_speed = bank->target_speed,
+        .current_speed = bank->current_speed,
+        .position = bank->position,
+        .direction = bank->direction,
+        .pid = bank->pid,
+        .regs = bank->regs,
+    };
+    return l;
+}
+
+static bool valid_axis(motor_bank_t *bank, uint32_t axis) {
+    return bank && axis < bank->axes;
+}
+
+int motor_bank_init(motor_bank_t *bank, register_file_t *regs, uint32_t axes) {
+    if (!bank || !regs || axes == 0 || axes > MOTOR_BANK_MAX_AXES) return -1;
+
+    memset(bank, 0, sizeof(motor_bank_t));
+    bank->regs = regs;
+    bank->axes = axes;
+
+    for (uint32_t i = 0; i < axes; i++) {
+        bank->state[i] = MOTOR_STATE_IDLE;
+        bank->fault_code[i] = MOTOR_FAULT_NONE;
+
+        /* Clear motor registers */
+        reg_write(&regs[i], REG_MOTOR_CTRL, 0);
+        reg_write(&regs[i], REG_MOTOR_STATUS, 0);
+        reg_write(&regs[i], REG_MOTOR_SPEED, 0);
+        reg_write(&regs[i], REG_MOTOR_POSITION, 0);
+    }
+
+    return 0;
+}
+
+uint32_t motor_bank_axes(motor_bank_t *bank) {
+    return bank ? bank->axes : 0;
+}
+
+int motor_bank_start(motor_bank_t *bank, uint32_t axis, uint32_t speed,
+                     motor_direction_t dir) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_start(&l, axis, speed, dir);
+}
+
+int motor_bank_stop(motor_bank_t *bank, uint32_t axis) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_stop(&l, axis);
+}
+
+int motor_bank_brake(motor_bank_t *bank, uint32_t axis) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_brake(&l, axis);
+}
+
+int motor_bank_set_speed(motor_bank_t *bank, uint32_t axis, uint32_t speed) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_set_speed(&l, axis, speed);
+}
+
+int motor_bank_reset(motor_bank_t *bank, uint32_t axis) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_reset(&l, axis);
+}
+
+int motor_bank_inject_fault(motor_bank_t *bank, uint32_t axis, motor_fault_t fault) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    motor_lane_inject_fault(&l, axis, fault);
+    return 0;
+}
+
+int motor_bank_clear_fault(motor_bank_t *bank, uint32_t axis) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_clear_fault(&l, axis);
+}
+
+int motor_bank_set_pid_gains(motor_bank_t *bank, uint32_t axis,
+                             const motor_pid_gains_t *gains) {
+    if (!valid_axis(bank, axis) || !gains) return -1;
+
+    motor_pid_set_gains(&bank->pid[axis], gains);
+    return 0;
+}
+
+int motor_bank_set_closed_loop(motor_bank_t *bank, uint32_t axis, bool enable) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_set_closed_loop(&l, axis, enable);
+}
+
+int motor_bank_close_loop(motor_bank_t *bank, uint32_t axis, int32_t measured) {
+    if (!valid_axis(bank, axis)) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    return motor_lane_close_loop(&l, axis, measured);
+}
+
+int motor_bank_update(motor_bank_t *bank) {
+    if (!bank) return -1;
+
+    motor_lanes_t l = motor_bank_lanes(bank);
+    motor_update_lanes(&l, bank->axes);
+
+    return 0;
+}
+
+motor_state_t motor_bank_get_state(motor_bank_t *bank, uint32_t axis) {
+    return valid_axis(bank, axis) ? bank->state[axis] : MOTOR_STATE_FAULT;
+}
+
+motor_fault_t motor_bank_get_fault(motor_bank_t *bank, uint32_t axis) {
+    return valid_axis(bank, axis) ? bank->fault_code[axis] : MOTOR_FAULT_NONE;
+}
+
+uint32_t motor_bank_get_speed(motor_bank_t *bank, uint32_t axis) {
+    return valid_axis(bank, axis) ? bank->current_speed[axis] : 0;
+}
+
+int32_t motor_bank_get_position(motor_bank_t *bank, uint32_t axis) {
+    return valid_axis(bank, axis) ? bank->position[axis] : 0;
+}
+
+bool motor_bank_any_running(motor_bank_t *bank) {
+    if (!bank) return false;
+
+    for (uint32_t i = 0; i < bank->axes; i++) {
+        if (bank->state[i] == MOTOR_STATE_RUNNING || bank->state[i] == MOTOR_STATE_STARTING) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -5,6 +5,24 @@
 #define MAX_SPEED 10000
 #define SPEED_RAMP_RATE 500
 
+/* Lanes stepped per pass of the batched update */
+#define MOTOR_LANE_CHUNK 64
+
+/* A controller is one lane over its own fields */
+static motor_lanes_t single_lane(motor_controller_t *mc) {
+    motor_lanes_t l = {
+        .state = &mc->state,
+        .fault_code = &mc->fault_code,
+        .target_speed = &mc->target_speed,
+        .current_speed = &mc->current_speed,
+        .position = &mc->position,
+        .direction = &mc->direction,
+        .pid = &mc->pid,
+        .regs = mc->regs,
+    };
+    return l;
+}
+
 int motor_init(motor_controller_t *mc, register_file_t *regs) {
     if (!mc || !regs) return -1;
 
@@ -22,162 +40,344 @@ int motor_init(motor_controller_t *mc, register_file_t *regs) {
     return 0;
 }
 
-int motor_start(motor_controller_t *mc, uint32_t speed, motor_direction_t dir) {
-    if (!mc) return -1;
-    if (mc->state == MOTOR_STATE_FAULT) return -2;
+int motor_lane_start(const motor_lanes_t *l, uint32_t axis, uint32_t speed,
+                     motor_direction_t dir) {
+    if (l->state[axis] == MOTOR_STATE_FAULT) return -2;
     if (speed > MAX_SPEED) speed = MAX_SPEED;
 
-    mc->target_speed = speed;
-    mc->direction = dir;
-    mc->state = MOTOR_STATE_STARTING;
+    l->target_speed[axis] = speed;
+    l->direction[axis] = dir;
+    l->state[axis] = MOTOR_STATE_STARTING;
 
     uint32_t ctrl = MOTOR_CTRL_ENABLE;
     if (dir == MOTOR_DIR_CW) {
         ctrl |= MOTOR_CTRL_DIR_CW;
     }
-    reg_write(mc->regs, REG_MOTOR_CTRL, ctrl);
+    reg_write(&l->regs[axis], REG_MOTOR_CTRL, ctrl);
 
     return 0;
 }
 
-int motor_stop(motor_controller_t *mc) {
-    if (!mc) return -1;
-    if (mc->state == MOTOR_STATE_IDLE) return 0;
+int motor_lane_stop(const motor_lanes_t *l, uint32_t axis) {
+    if (l->state[axis] == MOTOR_STATE_IDLE) return 0;
 
-    mc->target_speed = 0;
-    mc->state = MOTOR_STATE_STOPPING;
+    l->target_speed[axis] = 0;
+    l->state[axis] = MOTOR_STATE_STOPPING;
 
-    reg_clear_bits(mc->regs, REG_MOTOR_CTRL, MOTOR_CTRL_ENABLE);
+    reg_clear_bits(&l->regs[axis], REG_MOTOR_CTRL, MOTOR_CTRL_ENABLE);
 
     return 0;
 }
 
-int motor_brake(motor_controller_t *mc) {
-    if (!mc) return -1;
+int motor_lane_brake(const motor_lanes_t *l, uint32_t axis) {
+    register_file_t *regs = &l->regs[axis];
 
-    mc->target_speed = 0;
-    mc->current_speed = 0;
-    mc->state = MOTOR_STATE_IDLE;
+    l->target_speed[axis] = 0;
+    l->current_speed[axis] = 0;
+    l->state[axis] = MOTOR_STATE_IDLE;
 
-    reg_set_bits(mc->regs, REG_MOTOR_CTRL, MOTOR_CTRL_BRAKE);
-    reg_clear_bits(mc->regs, REG_MOTOR_CTRL, MOTOR_CTRL_ENABLE);
-    reg_write(mc->regs, REG_MOTOR_SPEED, 0);
-    reg_clear_bits(mc->regs, REG_MOTOR_STATUS, MOTOR_STATUS_RUNNING);
+    reg_set_bits(regs, REG_MOTOR_CTRL, MOTOR_CTRL_BRAKE);
+    reg_clear_bits(regs, REG_MOTOR_CTRL, MOTOR_CTRL_ENABLE);
+    reg_write(regs, REG_MOTOR_SPEED, 0);
+    reg_clear_bits(regs, REG_MOTOR_STATUS, MOTOR_STATUS_RUNNING);
 
     return 0;
 }
 
-int motor_set_speed(motor_controller_t *mc, uint32_t speed) {
-    if (!mc) return -1;
-    if (mc->state == MOTOR_STATE_FAULT) return -2;
+int motor_lane_set_speed(const motor_lanes_t *l, uint32_t axis, uint32_t speed) {
+    if (l->state[axis] == MOTOR_STATE_FAULT) return -2;
     if (speed > MAX_SPEED) speed = MAX_SPEED;
 
-    mc->target_speed = speed;
+    l->target_speed[axis] = speed;
     return 0;
 }
 
-int motor_reset(motor_controller_t *mc) {
-    if (!mc) return -1;
+int motor_lane_reset(const motor_lanes_t *l, uint32_t axis) {
+    register_file_t *regs = &l->regs[axis];
 
-    reg_write(mc->regs, REG_MOTOR_CTRL, MOTOR_CTRL_RESET);
-    reg_write(mc->regs, REG_MOTOR_STATUS, 0);
-    reg_write(mc->regs, REG_MOTOR_SPEED, 0);
+    reg_write(regs, REG_MOTOR_CTRL, MOTOR_CTRL_RESET);
+    reg_write(regs, REG_MOTOR_STATUS, 0);
+    reg_write(regs, REG_MOTOR_SPEED, 0);
+    reg_write(regs, REG_MOTOR_POSITION, 0);
 
-    mc->state = MOTOR_STATE_IDLE;
-    mc->fault_code = MOTOR_FAULT_NONE;
-    mc->current_speed = 0;
-    mc->target_speed = 0;
+    l->state[axis] = MOTOR_STATE_IDLE;
+    l->fault_code[axis] = MOTOR_FAULT_NONE;
+    l->current_speed[axis] = 0;
+    l->target_speed[axis] = 0;
+    l->position[axis] = 0;
+    motor_pid_reset(&l->pid[axis]);
 
-    reg_clear_bits(mc->regs, REG_MOTOR_CTRL, MOTOR_CTRL_RESET);
+    reg_clear_bits(regs, REG_MOTOR_CTRL, MOTOR_CTRL_RESET);
 
     return 0;
 }
 
-int motor_update(motor_controller_t *mc) {
-    if (!mc) return -1;
+void motor_lane_inject_fault(const motor_lanes_t *l, uint32_t axis, motor_fault_t fault) {
+    register_file_t *regs = &l->regs[axis];
 
-    /* Check for faults in status register */
-    uint32_t status = reg_read(mc->regs, REG_MOTOR_STATUS);
-    if (status & (MOTOR_STATUS_FAULT | MOTOR_STATUS_STALL | MOTOR_STATUS_OVERHEAT)) {
-        if (mc->state != MOTOR_STATE_FAULT) {
-            mc->state = MOTOR_STATE_FAULT;
-            if (status & MOTOR_STATUS_STALL) mc->fault_code = MOTOR_FAULT_STALL;
-            else if (status & MOTOR_STATUS_OVERHEAT) mc->fault_code = MOTOR_FAULT_OVERHEAT;
-            else mc->fault_code = MOTOR_FAULT_OVERCURRENT;
-        }
+    l->fault_code[axis] = fault;
+    l->state[axis] = MOTOR_STATE_FAULT;
+
+    switch (fault) {
+        case MOTOR_FAULT_STALL:
+            reg_set_bits(regs, REG_MOTOR_STATUS, MOTOR_STATUS_STALL);
+            break;
+        case MOTOR_FAULT_OVERHEAT:
+            reg_set_bits(regs, REG_MOTOR_STATUS, MOTOR_STATUS_OVERHEAT);
+            break;
+        case MOTOR_FAULT_OVERCURRENT:
+            reg_set_bits(regs, REG_MOTOR_STATUS, MOTOR_STATUS_FAULT);
+            break;
+        default:
+            break;
+    }
+}
+
+int motor_lane_clear_fault(const motor_lanes_t *l, uint32_t axis) {
+    if (l->state[axis] != MOTOR_STATE_FAULT) return 0;
+
+    l->fault_code[axis] = MOTOR_FAULT_NONE;
+    l->state[axis] = MOTOR_STATE_RECOVERY;
+    reg_write(&l->regs[axis], REG_MOTOR_STATUS, 0);
+
+    return 0;
+}
+
+void motor_pid_set_gains(motor_pid_t *pid, const motor_pid_gains_t *gains) {
+    pid->gains = *gains;
+}
+
+void motor_pid_reset(motor_pid_t *pid) {
+    pid->integral = 0;
+    pid->prev_measured = 0;
+    pid->output = 0;
+    pid->primed = false;
+}
+
+uint32_t motor_pid_step(motor_pid_t *pid, int32_t setpoint, int32_t measured) {
+    const int64_t max = (int64_t)MAX_SPEED * MOTOR_PID_ONE;
+    int64_t error = (int64_t)setpoint - measured;
+
+    int64_t p = (int64_t)pid->gains.kp * error;
+    int64_t i = pid->integral + (int64_t)pid->gains.ki * error;
+    if (i > max) i = max;
+    if (i < 0) i = 0;
+
+    int64_t d = 0;
+    if (pid->primed) {
+        d = -(int64_t)pid->gains.kd * ((int64_t)measured - pid->prev_measured);
+    }
+
+    int64_t u = (p + i + d) / MOTOR_PID_ONE;
+
+    /* Conditional integration: keep the integrator if it would push past a limit */
+    if (u > MAX_SPEED) {
+        u = MAX_SPEED;
+        if (error < 0) pid->integral = i;
+    } else if (u < 0) {
+        u = 0;
+        if (error > 0) pid->integral = i;
+    } else {
+        pid->integral = i;
+    }
+
+    pid->prev_measured = measured;
+    pid->primed = true;
+    pid->output = (uint32_t)u;
+
+    return pid->output;
+}
+
+int motor_lane_set_closed_loop(const motor_lanes_t *l, uint32_t axis, bool enable) {
+    motor_pid_t *pid = &l->pid[axis];
+
+    if (enable && !pid->enabled) {
+        motor_pid_reset(pid);
+    }
+    pid->enabled = enable;
+
+    return 0;
+}
+
+int motor_lane_close_loop(const motor_lanes_t *l, uint32_t axis, int32_t measured) {
+    motor_pid_t *pid = &l->pid[axis];
+    if (!pid->enabled) return -2;
+
+    motor_state_t s = l->state[axis];
+    if (s != MOTOR_STATE_STARTING && s != MOTOR_STATE_RUNNING && s != MOTOR_STATE_STOPPING) {
+        /* Nothing is driven; start the next run from a clean integrator */
+        motor_pid_reset(pid);
         return 0;
     }
 
-    /* State machine */
-    switch (mc->state) {
-        case MOTOR_STATE_IDLE:
-            /* Nothing to do */
-            break;
+    uint32_t drive = motor_pid_step(pid, (int32_t)l->current_speed[axis], measured);
+    reg_write(&l->regs[axis], REG_MOTOR_SPEED, drive);
 
-        case MOTOR_STATE_STARTING:
-            /* Ramp up speed */
-            if (mc->current_speed < mc->target_speed) {
-                mc->current_speed += SPEED_RAMP_RATE;
-                if (mc->current_speed >= mc->target_speed) {
-                    mc->current_speed = mc->target_speed;
-                    mc->state = MOTOR_STATE_RUNNING;
-                }
-            } else {
-                mc->state = MOTOR_STATE_RUNNING;
-            }
-            reg_write(mc->regs, REG_MOTOR_SPEED, mc->current_speed);
-            reg_set_bits(mc->regs, REG_MOTOR_STATUS, MOTOR_STATUS_RUNNING);
-            break;
+    return 0;
+}
 
-        case MOTOR_STATE_RUNNING:
-            /* Adjust speed if target changed */
-            if (mc->current_speed < mc->target_speed) {
-                mc->current_speed += SPEED_RAMP_RATE;
-                if (mc->current_speed > mc->target_speed) {
-                    mc->current_speed = mc->target_speed;
-                }
-            } else if (mc->current_speed > mc->target_speed) {
-                mc->current_speed -= SPEED_RAMP_RATE;
-                if (mc->current_speed < mc->target_speed) {
-                    mc->current_speed = mc->target_speed;
-                }
-            }
-            reg_write(mc->regs, REG_MOTOR_SPEED, mc->current_speed);
+/*
+ * Ramp and integrate every lane with selects instead of a state switch, so
+ * the compiler can vectorise it (gcc does at -O3). Starting ramps only up,
+ * stopping ramps to zero, running follows the target; only running lanes
+ * move.
+ */
+static void ramp_kernel(motor_state_t *restrict state,
+                        const uint32_t *restrict target,
+                        uint32_t *restrict current,
+                        int32_t *restrict position,
+                        const motor_direction_t *restrict direction,
+                        uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t s = (uint32_t)state[i];
+        uint32_t cur = current[i];
+        uint32_t tgt = target[i];
+
+        /* 0 or 1 flags; bitwise ops keep the loop free of branches */
+        uint32_t starting = s == MOTOR_STATE_STARTING;
+        uint32_t running = s == MOTOR_STATE_RUNNING;
+        uint32_t stopping = s == MOTOR_STATE_STOPPING;
+        uint32_t active = starting | running | stopping;
+
+        uint32_t goal = stopping ? 0 : tgt;
+        goal = (starting & (cur > goal)) ? cur : goal;
+
+        uint32_t up = (goal - cur > SPEED_RAMP_RATE) ? cur + SPEED_RAMP_RATE : goal;
+        uint32_t down = (cur - goal > SPEED_RAMP_RATE) ? cur - SPEED_RAMP_RATE : goal;
+        uint32_t next = (cur < goal) ? up : down;
+        next = active ? next : cur;
+        current[i] = next;
+
+        int32_t step = (int32_t)(next / 100);
+        step = (direction[i] == MOTOR_DIR_CW) ? step : -step;
+        position[i] += step & -(int32_t)running;
+
+        /* State changes as masked blends; selects here defeat if-conversion */
+        uint32_t to_run = -(starting & (next >= tgt));
+        uint32_t to_idle = -((stopping & (next == 0)) | (s == MOTOR_STATE_RECOVERY));
+        s = (s & ~to_run) | (MOTOR_STATE_RUNNING & to_run);
+        s = (s & ~to_idle) | (MOTOR_STATE_IDLE & to_idle);
+        state[i] = (motor_state_t)s;
+    }
+}
 
-            /* Update position */
-            if (mc->direction == MOTOR_DIR_CW) {
-                mc->position += (int32_t)(mc->current_speed / 100);
-            } else {
-                mc->position -= (int32_t)(mc->current_speed / 100);
+void motor_update_lanes(const motor_lanes_t *l, uint32_t count) {
+    motor_state_t prev[MOTOR_LANE_CHUNK];
+
+    for (uint32_t base = 0; base < count; base += MOTOR_LANE_CHUNK) {
+        uint32_t n = count - base < MOTOR_LANE_CHUNK ? count - base : MOTOR_LANE_CHUNK;
+
+        /* Faults latched in the status register stop the lane until reset */
+        for (uint32_t i = base; i < base + n; i++) {
+            uint32_t status = reg_read(&l->regs[i], REG_MOTOR_STATUS);
+            if ((status & (MOTOR_STATUS_FAULT | MOTOR_STATUS_STALL | MOTOR_STATUS_OVERHEAT)) &&
+                l->state[i] != MOTOR_STATE_FAULT) {
+                l->state[i] = MOTOR_STATE_FAULT;
+                if (status & MOTOR_STATUS_STALL) l->fault_code[i] = MOTOR_FAULT_STALL;
+                else if (status & MOTOR_STATUS_OVERHEAT) l->fault_code[i] = MOTOR_FAULT_OVERHEAT;
+                else l->fault_code[i] = MOTOR_FAULT_OVERCURRENT;
             }
-            reg_write(mc->regs, REG_MOTOR_POSITION, (uint32_t)mc->position);
-            break;
+        }
 
-        case MOTOR_STATE_STOPPING:
-            /* Ramp down speed */
-            if (mc->current_speed > SPEED_RAMP_RATE) {
-                mc->current_speed -= SPEED_RAMP_RATE;
-            } else {
-                mc->current_speed = 0;
-                mc->state = MOTOR_STATE_IDLE;
-                reg_clear_bits(mc->regs, REG_MOTOR_STATUS, MOTOR_STATUS_RUNNING);
+        memcpy(prev, &l->state[base], n * sizeof(motor_state_t));
+        ramp_kernel(&l->state[base], &l->target_speed[base], &l->current_speed[base],
+                    &l->position[base], &l->direction[base], n);
+
+        /* Write back only what the old per-state update would have touched */
+        for (uint32_t k = 0; k < n; k++) {
+            uint32_t i = base + k;
+            register_file_t *regs = &l->regs[i];
+
+            switch (prev[k]) {
+                case MOTOR_STATE_STARTING:
+                    reg_write(regs, REG_MOTOR_SPEED, l->current_speed[i]);
+                    reg_set_bits(regs, REG_MOTOR_STATUS, MOTOR_STATUS_RUNNING);
+                    break;
+
+                case MOTOR_STATE_RUNNING:
+                    reg_write(regs, REG_MOTOR_SPEED, l->current_speed[i]);
+                    reg_write(regs, REG_MOTOR_POSITION, (uint32_t)l->position[i]);
+                    break;
+
+                case MOTOR_STATE_STOPPING:
+                    if (l->state[i] == MOTOR_STATE_IDLE) {
+                        reg_clear_bits(regs, REG_MOTOR_STATUS, MOTOR_STATUS_RUNNING);
+                    }
+                    reg_write(regs, REG_MOTOR_SPEED, l->current_speed[i]);
+                    break;
+
+                default:
+                    break;
             }
-            reg_write(mc->regs, REG_MOTOR_SPEED, mc->current_speed);
-            break;
+        }
+    }
+}
 
-        case MOTOR_STATE_FAULT:
-            /* Stay in fault until reset */
-            break;
+int motor_start(motor_controller_t *mc, uint32_t speed, motor_direction_t dir) {
+    if (!mc) return -1;
 
-        case MOTOR_STATE_RECOVERY:
-            /* Transition back to idle after recovery */
-            mc->state = MOTOR_STATE_IDLE;
-            break;
-    }
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_start(&l, 0, speed, dir);
+}
+
+int motor_stop(motor_controller_t *mc) {
+    if (!mc) return -1;
+
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_stop(&l, 0);
+}
+
+int motor_brake(motor_controller_t *mc) {
+    if (!mc) return -1;
+
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_brake(&l, 0);
+}
+
+int motor_set_speed(motor_controller_t *mc, uint32_t speed) {
+    if (!mc) return -1;
+
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_set_speed(&l, 0, speed);
+}
+
+int motor_reset(motor_controller_t *mc) {
+    if (!mc) return -1;
 
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_reset(&l, 0);
+}
+
+int motor_update(motor_controller_t *mc) {
+    if (!mc) return -1;
+
+    motor_lanes_t l = single_lane(mc);
+    motor_update_lanes(&l, 1);
+
+    return 0;
+}
+
+int motor_set_pid_gains(motor_controller_t *mc, const motor_pid_gains_t *gains) {
+    if (!mc || !gains) return -1;
+
+    motor_pid_set_gains(&mc->pid, gains);
     return 0;
 }
 
+int motor_set_closed_loop(motor_controller_t *mc, bool enable) {
+    if (!mc) return -1;
+
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_set_closed_loop(&l, 0, enable);
+}
+
+int motor_close_loop(motor_controller_t *mc, int32_t measured) {
+    if (!mc) return -1;
+
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_close_loop(&l, 0, measured);
+}
+
 motor_state_t motor_get_state(motor_controller_t *mc) {
     return mc ? mc->state : MOTOR_STATE_FAULT;
 }
@@ -202,31 +402,13 @@ bool motor_is_running(motor_controller_t *mc) {
 void motor_inject_fault(motor_controller_t *mc, motor_fault_t fault) {
     if (!mc) return;
 
-    mc->fault_code = fault;
-    mc->state = MOTOR_STATE_FAULT;
-
-    switch (fault) {
-        case MOTOR_FAULT_STALL:
-            reg_set_bits(mc->regs, REG_MOTOR_STATUS, MOTOR_STATUS_STALL);
-            break;
-        case MOTOR_FAULT_OVERHEAT:
-            reg_set_bits(mc->regs, REG_MOTOR_STATUS, MOTOR_STATUS_OVERHEAT);
-            break;
-        case MOTOR_FAULT_OVERCURRENT:
-            reg_set_bits(mc->regs, REG_MOTOR_STATUS, MOTOR_STATUS_FAULT);
-            break;
-        default:
-            break;
-    }
+    motor_lanes_t l = single_lane(mc);
+    motor_lane_inject_fault(&l, 0, fault);
 }
 
 int motor_clear_fault(motor_controller_t *mc) {
     if (!mc) return -1;
-    if (mc->state != MOTOR_STATE_FAULT) return 0;
-
-    mc->fault_code = MOTOR_FAULT_NONE;
-    mc->state = MOTOR_STATE_RECOVERY;
-    reg_write(mc->regs, REG_MOTOR_STATUS, 0);
 
-    return 0;
+    motor_lanes_t l = single_lane(mc);
+    return motor_lane_clear_fault(&l, 0);
 }
@@ -0,0 +1,79 @@
+/* CPU affinity and cpu_set_t are GNU extensions */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "rt_thread.h"
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/* Largest stack region rt_lock_memory will touch */
+#define RT_PREFAULT_MAX     (512 * 1024)
+
+static int attr_valid(const rt_thread_attr_t *attr) {
+    if (!attr) return 0;
+    if (attr->priority < 0 || attr->priority > RT_THREAD_MAX_PRIORITY) return 0;
+#ifdef __linux__
+    if (attr->cpu < RT_THREAD_ANY_CPU || attr->cpu >= CPU_SETSIZE) return 0;
+#else
+    if (attr->cpu < RT_THREAD_ANY_CPU) return 0;
+#endif
+    return 1;
+}
+
+int rt_thread_set(pthread_t thread, const rt_thread_attr_t *attr) {
+    if (!attr_valid(attr)) return -1;
+
+    if (attr->cpu != RT_THREAD_ANY_CPU) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(attr->cpu, &set);
+        if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+            return -3;
+        }
+#else
+        return -3;  /* No affinity control on this platform */
+#endif
+    }
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = attr->priority;
+    int policy = attr->priority > 0 ? SCHED_FIFO : SCHED_OTHER;
+    if (pthread_setschedparam(thread, policy, &param) != 0) {
+        return -3;
+    }
+
+    return 0;
+}
+
+int rt_thread_apply(const rt_thread_attr_t *attr) {
+    return rt_thread_set(pthread_self(), attr);
+}
+
+int rt_lock_memory(size_t stack_bytes) {
+#ifdef __linux__
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        return -3;
+    }
+#endif
+
+    /* Touch the stack now rather than on the first deep call in a tick */
+    if (stack_bytes > RT_PREFAULT_MAX) stack_bytes = RT_PREFAULT_MAX;
+    if (stack_bytes > 0) {
+        volatile unsigned char prefault[RT_PREFAULT_MAX];
+        for (size_t i = 0; i < stack_bytes; i += 4096) {
+            prefault[i] = 0;
+        }
+        prefault[stack_bytes - 1] = 0;
+        (void)prefault[0];
+    }
+
+    return 0;
+}
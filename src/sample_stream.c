@@ -0,0 +1,328 @@
+#include "sample_stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define STREAM_MASK ((uint64_t)SAMPLE_STREAM_DEPTH - 1)
+
+/* Futex wrappers; the region is process-shared so no FUTEX_PRIVATE_FLAG */
+static void futex_wait_ms(_Atomic uint32_t *addr, uint32_t expected, uint32_t timeout_ms) {
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeout_ms / 1000);
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, expected, &ts, NULL, 0);
+#else
+    (void)addr;
+    (void)expected;
+    (void)timeout_ms;
+    sched_yield();
+#endif
+}
+
+static void futex_wake_all(_Atomic uint32_t *addr) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)addr;
+#endif
+}
+
+static void stream_init(sample_stream_t *stream) {
+    stream->depth = SAMPLE_STREAM_DEPTH;
+    atomic_init(&stream->head, 0);
+    atomic_init(&stream->wake_seq, 0);
+    atomic_init(&stream->waiters, 0);
+    stream->anonymous = false;
+
+    for (int i = 0; i < SAMPLE_STREAM_MAX_READERS; i++) {
+        atomic_init(&stream->readers[i].owner, 0);
+        atomic_init(&stream->readers[i].cursor, 0);
+        atomic_init(&stream->readers[i].lost, 0);
+    }
+    for (uint32_t i = 0; i < SAMPLE_STREAM_DEPTH; i++) {
+        atomic_init(&stream->slots[i].seq, 0);
+        memset(&stream->slots[i].sample, 0, sizeof(sensor_sample_t));
+    }
+}
+
+#ifdef _WIN32
+/* Windows implementation using heap memory for simplicity */
+static sample_stream_t *g_stream = NULL;
+
+static int32_t current_pid(void) {
+    return 1;
+}
+
+static bool reader_alive(int32_t pid) {
+    (void)pid;
+    return true;
+}
+
+sample_stream_t* sample_stream_create(void) {
+    if (g_stream) {
+        return g_stream;
+    }
+
+    g_stream = (sample_stream_t*)calloc(1, sizeof(sample_stream_t));
+    if (!g_stream) return NULL;
+
+    stream_init(g_stream);
+    return g_stream;
+}
+
+sample_stream_t* sample_stream_open(void) {
+    return g_stream;
+}
+
+sample_stream_t* sample_stream_create_private(void) {
+    sample_stream_t *stream = (sample_stream_t*)calloc(1, sizeof(sample_stream_t));
+    if (!stream) return NULL;
+
+    stream_init(stream);
+    stream->anonymous = true;
+    return stream;
+}
+
+void sample_stream_destroy(sample_stream_t *stream) {
+    if (!stream || (stream != g_stream && !stream->anonymous)) return;
+
+    if (stream == g_stream) g_stream = NULL;
+    free(stream);
+}
+
+void sample_stream_close(sample_stream_t *stream) {
+    (void)stream;  /* Nothing to do for heap-based implementation */
+}
+
+#else
+/* POSIX implementation */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+static int32_t current_pid(void) {
+    return (int32_t)getpid();
+}
+
+/* A reader slot whose owner died can be reclaimed */
+static bool reader_alive(int32_t pid) {
+    return pid <= 0 || kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+sample_stream_t* sample_stream_create(void) {
+    int fd = shm_open(SAMPLE_STREAM_NAME, O_CREAT | O_RDWR, 0666);
+    if (fd < 0) return NULL;
+
+    if (ftruncate(fd, sizeof(sample_stream_t)) < 0) {
+        close(fd);
+        shm_unlink(SAMPLE_STREAM_NAME);
+        return NULL;
+    }
+
+    sample_stream_t *stream = mmap(NULL, sizeof(sample_stream_t),
+                                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (stream == MAP_FAILED) {
+        shm_unlink(SAMPLE_STREAM_NAME);
+        return NULL;
+    }
+
+    stream_init(stream);
+    return stream;
+}
+
+sample_stream_t* sample_stream_open(void) {
+    int fd = shm_open(SAMPLE_STREAM_NAME, O_RDWR, 0666);
+    if (fd < 0) return NULL;
+
+    sample_stream_t *stream = mmap(NULL, sizeof(sample_stream_t),
+                                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (stream == MAP_FAILED) return NULL;
+
+    /* Refuse a region built with a different depth */
+    if (stream->depth != SAMPLE_STREAM_DEPTH) {
+        munmap(stream, sizeof(sample_stream_t));
+        return NULL;
+    }
+
+    return stream;
+}
+
+sample_stream_t* sample_stream_create_private(void) {
+    sample_stream_t *stream = mmap(NULL, sizeof(sample_stream_t), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stream == MAP_FAILED) return NULL;
+
+    stream_init(stream);
+    stream->anonymous = true;
+    return stream;
+}
+
+void sample_stream_destroy(sample_stream_t *stream) {
+    if (!stream) return;
+
+    bool anonymous = stream->anonymous;
+    munmap(stream, sizeof(sample_stream_t));
+    if (!anonymous) shm_unlink(SAMPLE_STREAM_NAME);
+}
+
+void sample_stream_close(sample_stream_t *stream) {
+    if (stream) {
+        munmap(stream, sizeof(sample_stream_t));
+    }
+}
+#endif
+
+int sample_stream_publish(sample_stream_t *stream, const sensor_sample_t *samples,
+                          uint32_t count) {
+    if (!stream || (!samples && count > 0)) return -1;
+    if (count == 0) return 0;
+
+    uint64_t pos = atomic_load_explicit(&stream->head, memory_order_relaxed);
+
+    for (uint32_t i = 0; i < count; i++, pos++) {
+        stream_slot_t *slot = &stream->slots[pos & STREAM_MASK];
+
+        atomic_store_explicit(&slot->seq, 2 * pos + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        slot->sample = samples[i];
+
+        atomic_store_explicit(&slot->seq, 2 * pos + 2, memory_order_release);
+    }
+
+    /* Pairs with the waiters increment in sample_stream_wait */
+    atomic_store(&stream->head, pos);
+    if (atomic_load(&stream->waiters) > 0) {
+        atomic_fetch_add(&stream->wake_seq, 1);
+        futex_wake_all(&stream->wake_seq);
+    }
+
+    return (int)count;
+}
+
+int sample_stream_reader_count(sample_stream_t *stream) {
+    if (!stream) return 0;
+
+    int count = 0;
+    for (int i = 0; i < SAMPLE_STREAM_MAX_READERS; i++) {
+        if (atomic_load(&stream->readers[i].owner) != 0) count++;
+    }
+
+    return count;
+}
+
+int sample_stream_attach(sample_stream_t *stream, sample_stream_reader_t *reader) {
+    if (!stream || !reader) return -1;
+
+    for (int i = 0; i < SAMPLE_STREAM_MAX_READERS; i++) {
+        stream_reader_slot_t *rs = &stream->readers[i];
+        int32_t expected = 0;
+
+        /* Claim a free slot, or take over one whose owner is gone */
+        if (!atomic_compare_exchange_strong(&rs->owner, &expected, current_pid())) {
+            if (reader_alive(expected) ||
+                !atomic_compare_exchange_strong(&rs->owner, &expected, current_pid())) {
+                continue;
+            }
+        }
+
+        reader->stream = stream;
+        reader->index = i;
+        reader->cursor = atomic_load_explicit(&stream->head, memory_order_acquire);
+        reader->lost = 0;
+        atomic_store_explicit(&rs->cursor, reader->cursor, memory_order_relaxed);
+        atomic_store_explicit(&rs->lost, 0, memory_order_relaxed);
+
+        return 0;
+    }
+
+    return -2;  /* Every reader slot is taken */
+}
+
+void sample_stream_detach(sample_stream_reader_t *reader) {
+    if (!reader || !reader->stream) return;
+
+    atomic_store(&reader->stream->readers[reader->index].owner, 0);
+    reader->stream = NULL;
+}
+
+int sample_stream_read(sample_stream_reader_t *reader, sensor_sample_t *samples,
+                       uint32_t max) {
+    if (!reader || !reader->stream || !samples) return -1;
+
+    sample_stream_t *stream = reader->stream;
+    uint64_t head = atomic_load_explicit(&stream->head, memory_order_acquire);
+    uint32_t n = 0;
+
+    while (reader->cursor < head && n < max) {
+        /* Lapped: skip to the oldest sample that can still be intact */
+        if (head - reader->cursor > SAMPLE_STREAM_DEPTH) {
+            reader->lost += head - reader->cursor - SAMPLE_STREAM_DEPTH;
+            reader->cursor = head - SAMPLE_STREAM_DEPTH;
+        }
+
+        uint64_t pos = reader->cursor;
+        stream_slot_t *slot = &stream->slots[pos & STREAM_MASK];
+        uint64_t expected = 2 * pos + 2;
+
+        uint64_t before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        samples[n] = slot->sample;
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+        reader->cursor++;
+        if (before == expected && after == expected) {
+            n++;
+        } else {
+            /* Overwritten while we read it */
+            reader->lost++;
+            head = atomic_load_explicit(&stream->head, memory_order_acquire);
+        }
+    }
+
+    stream_reader_slot_t *rs = &stream->readers[reader->index];
+    atomic_store_explicit(&rs->cursor, reader->cursor, memory_order_relaxed);
+    atomic_store_explicit(&rs->lost, reader->lost, memory_order_relaxed);
+
+    return (int)n;
+}
+
+uint64_t sample_stream_available(sample_stream_reader_t *reader) {
+    if (!reader || !reader->stream) return 0;
+
+    uint64_t head = atomic_load_explicit(&reader->stream->head, memory_order_acquire);
+    uint64_t pending = head - reader->cursor;
+
+    return pending > SAMPLE_STREAM_DEPTH ? SAMPLE_STREAM_DEPTH : pending;
+}
+
+int sample_stream_wait(sample_stream_reader_t *reader, uint32_t timeout_ms) {
+    if (!reader || !reader->stream) return -1;
+
+    sample_stream_t *stream = reader->stream;
+    uint32_t seen = atomic_load(&stream->wake_seq);
+
+    atomic_fetch_add(&stream->waiters, 1);
+    if (atomic_load(&stream->head) == reader->cursor) {
+        futex_wait_ms(&stream->wake_seq, seen, timeout_ms);
+    }
+    atomic_fetch_sub(&stream->waiters, 1);
+
+    return sample_stream_available(reader) > 0 ? 0 : -2;  /* -2: timed out */
+}
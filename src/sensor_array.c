@@ -1,7 +1,312 @@
 #include "sensor_array.h"
+#include "sample_stream.h"
+#include "sim_clock.h"
 #include <string.h>
 #include <stdlib.h>
 
+static void ring_reset(sensor_ring_t *ring, sensor_overflow_policy_t policy) {
+    ring->mask = ring->capacity - 1;
+    ring->policy = policy;
+    ring->gap_mask = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+}
+
+static void ring_use_inline(sensor_array_t *sa, sensor_overflow_policy_t policy) {
+    sensor_ring_t *ring = &sa->ring;
+
+    ring->values = sa->buffer;
+    ring->timestamps = sa->buffer_ts;
+    ring->ids = sa->buffer_ids;
+    ring->flags = sa->buffer_flags;
+    ring->heap = NULL;
+    ring->capacity = SENSOR_BUFFER_SIZE;
+    ring_reset(ring, policy);
+}
+
+/* One block per resized ring, widest field first to keep it aligned */
+static int ring_use_heap(sensor_array_t *sa, uint32_t capacity,
+                         sensor_overflow_policy_t policy) {
+    size_t per_sample = sizeof(uint64_t) + sizeof(int32_t) + 2 * sizeof(uint8_t);
+    uint8_t *block = malloc((size_t)capacity * per_sample);
+    if (!block) return -3;
+
+    sensor_ring_t *ring = &sa->ring;
+    ring->timestamps = (uint64_t*)block;
+    ring->values = (int32_t*)(block + (size_t)capacity * sizeof(uint64_t));
+    ring->ids = (uint8_t*)(ring->values + capacity);
+    ring->flags = ring->ids + capacity;
+    ring->heap = block;
+    ring->capacity = capacity;
+    ring_reset(ring, policy);
+
+    return 0;
+}
+
+/* Account for `count` lost samples; sensor_id is SENSOR_ID_NONE if unknown */
+static void note_drop(sensor_array_t *sa, uint8_t sensor_id, uint32_t count) {
+    atomic_fetch_add_explicit(&sa->ring.dropped, count, memory_order_relaxed);
+    if (sensor_id < sa->count) {
+        sa->sensors[sensor_id].drop_count += count;
+        sa->ring.gap_mask |= 1u << sensor_id;
+    }
+    reg_set_bits(sa->regs, REG_SENSOR_STATUS, SENSOR_STATUS_OVERFLOW);
+}
+
+/* Attribute samples [from, from + count) the producer just evicted */
+static void note_evicted(sensor_array_t *sa, uint32_t from, uint32_t count) {
+    sensor_ring_t *ring = &sa->ring;
+    for (uint32_t i = 0; i < count; i++) {
+        note_drop(sa, ring->ids[(from + i) & ring->mask], 1);
+    }
+}
+
+/* Producer side */
+static int ring_push(sensor_array_t *sa, const sensor_sample_t *sample) {
+    sensor_ring_t *ring = &sa->ring;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= ring->capacity) {
+        if (ring->policy == SENSOR_OVERFLOW_DROP_NEWEST) {
+            note_drop(sa, sample->sensor_id, 1);
+            return -2;  /* Buffer full */
+        }
+
+        /* Evict the oldest sample; a failed CAS means the consumer freed it */
+        uint32_t oldest = tail;
+        if (atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + 1,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire)) {
+            note_evicted(sa, oldest, 1);
+        }
+    }
+
+    uint8_t flags = sample->flags;
+    if (sample->sensor_id < SENSOR_MAX &&
+        (ring->gap_mask & (1u << sample->sensor_id))) {
+        flags |= SENSOR_SAMPLE_GAP;
+        ring->gap_mask &= ~(1u << sample->sensor_id);
+    }
+
+    uint32_t slot = head & ring->mask;
+    ring->values[slot] = sample->value;
+    ring->timestamps[slot] = sample->timestamp_ns;
+    ring->ids[slot] = sample->sensor_id;
+    ring->flags[slot] = flags;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return 0;
+}
+
+/* Consumer side */
+static int ring_pop(sensor_ring_t *ring, sensor_sample_t *sample) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    for (;;) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head == tail) {
+            return -2;  /* Buffer empty */
+        }
+
+        uint32_t slot = tail & ring->mask;
+        sensor_sample_t s;
+        s.value = ring->values[slot];
+        s.timestamp_ns = ring->timestamps[slot];
+        s.sensor_id = ring->ids[slot];
+        s.flags = ring->flags[slot];
+
+        /* Commit only if the producer did not evict this slot meanwhile */
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            *sample = s;
+            return 0;
+        }
+    }
+}
+
+/* Readable window: returns the sample count and the first span's length */
+static uint32_t ring_window(sensor_ring_t *ring, uint32_t max,
+                            uint32_t *start, uint32_t *first) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t count = head - tail;
+
+    if (count > ring->capacity) count = ring->capacity;
+    if (count > max) count = max;
+
+    *start = tail & ring->mask;
+    *first = ring->capacity - *start;
+    if (*first > count) *first = count;
+
+    return count;
+}
+
+/* Clear a sensor's filter history, keeping its configuration */
+static void filter_reset(sensor_t *sensor) {
+    memset(sensor->window, 0, sizeof(sensor->window));
+    sensor->window_sum = 0;
+    sensor->window_pos = 0;
+    sensor->window_fill = 0;
+    sensor->ema = 0;
+    sensor->ema_primed = false;
+    sensor->cic_sum = 0;
+    sensor->cic_count = 0;
+    sensor->filtered = 0;
+    sensor->filtered_count = 0;
+}
+
+/* Divide rounding half away from zero */
+static int32_t div_round(int64_t num, int64_t den) {
+    return (int32_t)(num >= 0 ? (num + den / 2) / den : (num - den / 2) / den);
+}
+
+static int32_t spike_stage(sensor_t *sensor, int32_t x) {
+    const sensor_filter_t *f = &sensor->filter;
+    if (f->spike == SENSOR_SPIKE_NONE) return x;
+
+    /* Fixed window; the running sum makes the mean O(1) */
+    if (sensor->window_fill == f->taps) {
+        sensor->window_sum -= sensor->window[sensor->window_pos];
+    } else {
+        sensor->window_fill++;
+    }
+    sensor->window[sensor->window_pos] = x;
+    sensor->window_sum += x;
+    sensor->window_pos = (uint8_t)((sensor->window_pos + 1) % f->taps);
+
+    uint8_t n = sensor->window_fill;
+    if (f->spike == SENSOR_SPIKE_MEAN) {
+        return div_round(sensor->window_sum, n);
+    }
+
+    /* Median: insertion sort of at most SENSOR_FILTER_TAPS values */
+    int32_t sorted[SENSOR_FILTER_TAPS];
+    for (uint8_t i = 0; i < n; i++) {
+        int32_t v = sensor->window[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return sorted[n / 2];
+}
+
+/* Run one sample through the stage; true when it produces an output */
+static bool filter_step(sensor_t *sensor, int32_t x, int32_t *out) {
+    const sensor_filter_t *f = &sensor->filter;
+    int32_t y = spike_stage(sensor, x);
+
+    if (f->ema_shift > 0) {
+        int64_t xq = (int64_t)y * 65536;
+        if (!sensor->ema_primed) {
+            sensor->ema = xq;
+            sensor->ema_primed = true;
+        } else {
+            sensor->ema += (xq - sensor->ema) / ((int64_t)1 << f->ema_shift);
+        }
+        y = div_round(sensor->ema, 65536);
+    }
+
+    if (f->decimate > 1) {
+        sensor->cic_sum += y;
+        if (++sensor->cic_count < f->decimate) return false;
+
+        y = div_round(sensor->cic_sum, f->decimate);
+        sensor->cic_sum = 0;
+        sensor->cic_count = 0;
+    }
+
+    sensor->filtered = y;
+    sensor->filtered_count++;
+    *out = y;
+    return true;
+}
+
+/* Start over, keeping the threshold */
+static void stats_reset(sensor_stats_t *st) {
+    int32_t threshold = st->threshold;
+
+    memset(st, 0, sizeof(*st));
+    st->threshold = threshold;
+}
+
+/*
+ * Slide the window to sample `seq` and add value. Entries that cannot be
+ * the extreme of any window containing value are dropped from the back,
+ * so each entry is pushed and popped once: amortised O(1).
+ */
+static void deque_push(sensor_deque_t *dq, uint32_t seq, int32_t value, bool want_max) {
+    const uint32_t mask = SENSOR_STATS_WINDOW - 1;
+
+    while (dq->head != dq->tail && seq - dq->index[dq->head & mask] >= SENSOR_STATS_WINDOW) {
+        dq->head++;
+    }
+    while (dq->head != dq->tail) {
+        int32_t back = dq->value[(dq->tail - 1) & mask];
+        if (want_max ? back > value : back < value) break;
+        dq->tail--;
+    }
+
+    dq->index[dq->tail & mask] = seq;
+    dq->value[dq->tail & mask] = value;
+    dq->tail++;
+}
+
+static void stats_add(sensor_stats_t *st, int32_t value) {
+    uint32_t seq = (uint32_t)st->count;
+
+    st->count++;
+    double delta = value - st->mean;
+    st->mean += delta / (double)st->count;
+    st->m2 += delta * (value - st->mean);
+
+    deque_push(&st->min, seq, value, false);
+    deque_push(&st->max, seq, value, true);
+
+    if (value > st->threshold) {
+        st->over_threshold++;
+    }
+}
+
+/* Move an idle sensor to sampling; returns 1 if it started */
+static int start_sampling(sensor_array_t *sa, uint8_t id) {
+    sensor_t *sensor = &sa->sensors[id];
+    if (sensor->state != SENSOR_STATE_IDLE) return 0;
+
+    sensor->state = SENSOR_STATE_SAMPLING;
+    sensor->sample_count++;
+    sa->sampling |= 1u << id;
+
+    return 1;
+}
+
+/* File a sensor in the wheel slot of its due tick */
+static void wheel_insert(sensor_array_t *sa, uint8_t id) {
+    uint32_t slot = (uint32_t)(sa->sensors[id].due_tick & (SENSOR_WHEEL_SLOTS - 1));
+
+    sa->sensors[id].wheel_next = sa->wheel[slot];
+    sa->wheel[slot] = id;
+}
+
+static void wheel_remove(sensor_array_t *sa, uint8_t id) {
+    uint32_t slot = (uint32_t)(sa->sensors[id].due_tick & (SENSOR_WHEEL_SLOTS - 1));
+    uint8_t *link = &sa->wheel[slot];
+
+    while (*link != SENSOR_ID_NONE) {
+        if (*link == id) {
+            *link = sa->sensors[id].wheel_next;
+            break;
+        }
+        link = &sa->sensors[*link].wheel_next;
+    }
+    sa->sensors[id].wheel_next = SENSOR_ID_NONE;
+}
+
 int sensor_array_init(sensor_array_t *sa, register_file_t *regs) {
     if (!sa || !regs) return -1;
 
@@ -25,9 +330,15 @@ int sensor_array_init(sensor_array_t *sa, register_file_t *regs) {
     sa->sensors[3].min_value = 0;
     sa->sensors[3].max_value = 5000;
 
+    sa->count = SENSOR_COUNT;
     for (int i = 0; i < SENSOR_COUNT; i++) {
         sa->sensors[i].state = SENSOR_STATE_DISABLED;
+        sa->sensors[i].stats.threshold = sa->sensors[i].max_value;
+        sa->sensors[i].wheel_next = SENSOR_ID_NONE;
     }
+    memset(sa->wheel, SENSOR_ID_NONE, sizeof(sa->wheel));
+
+    ring_use_inline(sa, SENSOR_OVERFLOW_DROP_NEWEST);
 
     /* Clear sensor registers */
     reg_write(regs, REG_SENSOR_CTRL, 0);
@@ -37,10 +348,17 @@ int sensor_array_init(sensor_array_t *sa, register_file_t *regs) {
     return 0;
 }
 
+void sensor_array_cleanup(sensor_array_t *sa) {
+    if (!sa) return;
+
+    free(sa->ring.heap);
+    ring_use_inline(sa, SENSOR_OVERFLOW_DROP_NEWEST);
+}
+
 int sensor_array_enable(sensor_array_t *sa) {
     if (!sa) return -1;
 
-    for (int i = 0; i < SENSOR_COUNT; i++) {
+    for (int i = 0; i < sa->count; i++) {
         sa->sensors[i].state = SENSOR_STATE_IDLE;
     }
 
@@ -53,7 +371,7 @@ int sensor_array_enable(sensor_array_t *sa) {
 int sensor_array_disable(sensor_array_t *sa) {
     if (!sa) return -1;
 
-    for (int i = 0; i < SENSOR_COUNT; i++) {
+    for (int i = 0; i < sa->count; i++) {
         sa->sensors[i].state = SENSOR_STATE_DISABLED;
     }
 
@@ -69,16 +387,85 @@ int sensor_array_trigger(sensor_array_t *sa) {
 
     reg_set_bits(sa->regs, REG_SENSOR_CTRL, SENSOR_CTRL_TRIGGER);
 
-    for (int i = 0; i < SENSOR_COUNT; i++) {
-        if (sa->sensors[i].state == SENSOR_STATE_IDLE) {
-            sa->sensors[i].state = SENSOR_STATE_SAMPLING;
-            sa->sensors[i].sample_count++;
-        }
+    for (uint8_t i = 0; i < sa->count; i++) {
+        start_sampling(sa, i);
     }
 
     return 0;
 }
 
+int sensor_array_add(sensor_array_t *sa, const sensor_config_t *config) {
+    if (!sa || !config || config->min_value > config->max_value) return -1;
+    if (sa->count >= SENSOR_MAX) return -2;
+
+    uint8_t id = sa->count;
+    sensor_t *sensor = &sa->sensors[id];
+
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->type = config->type;
+    sensor->min_value = config->min_value;
+    sensor->max_value = config->max_value;
+    sensor->stats.threshold = config->max_value;
+    sensor->wheel_next = SENSOR_ID_NONE;
+    sensor->state = (reg_read(sa->regs, REG_SENSOR_CTRL) & SENSOR_CTRL_ENABLE) ?
+                    SENSOR_STATE_IDLE : SENSOR_STATE_DISABLED;
+    sa->count++;
+
+    sensor_set_rate(sa, id, config->divider);
+    return id;
+}
+
+uint8_t sensor_array_count(sensor_array_t *sa) {
+    return sa ? sa->count : 0;
+}
+
+int sensor_set_rate(sensor_array_t *sa, uint8_t sensor_id, uint32_t divider) {
+    if (!sa || sensor_id >= sa->count) return -1;
+
+    sensor_t *sensor = &sa->sensors[sensor_id];
+    if (sensor->divider > 0) {
+        wheel_remove(sa, sensor_id);
+    }
+
+    sensor->divider = divider;
+    if (divider > 0) {
+        sensor->due_tick = sa->tick + divider;
+        wheel_insert(sa, sensor_id);
+    }
+
+    return 0;
+}
+
+int sensor_array_tick(sensor_array_t *sa) {
+    if (!sa) return -1;
+    if (!(reg_read(sa->regs, REG_SENSOR_CTRL) & SENSOR_CTRL_ENABLE)) return -2;
+
+    uint64_t now = ++sa->tick;
+    uint32_t slot = (uint32_t)(now & (SENSOR_WHEEL_SLOTS - 1));
+    uint8_t id = sa->wheel[slot];
+    int started = 0;
+
+    /* Detach the slot, then file every sensor again under its next due tick */
+    sa->wheel[slot] = SENSOR_ID_NONE;
+    while (id != SENSOR_ID_NONE) {
+        sensor_t *sensor = &sa->sensors[id];
+        uint8_t next = sensor->wheel_next;
+
+        if (sensor->due_tick == now) {
+            started += start_sampling(sa, id);
+            sensor->due_tick += sensor->divider;
+        }
+        wheel_insert(sa, id);
+        id = next;
+    }
+
+    if (started > 0) {
+        reg_set_bits(sa->regs, REG_SENSOR_CTRL, SENSOR_CTRL_TRIGGER);
+    }
+
+    return started;
+}
+
 int sensor_array_set_continuous(sensor_array_t *sa, bool enable) {
     if (!sa) return -1;
 
@@ -92,14 +479,100 @@ int sensor_array_set_continuous(sensor_array_t *sa, bool enable) {
     return 0;
 }
 
+int sensor_array_set_stream(sensor_array_t *sa, struct sample_stream *stream) {
+    if (!sa) return -1;
+
+    sa->stream = stream;
+    return 0;
+}
+
+int sensor_set_filter(sensor_array_t *sa, uint8_t sensor_id, const sensor_filter_t *filter) {
+    if (!sa || sensor_id >= sa->count) return -1;
+
+    sensor_t *sensor = &sa->sensors[sensor_id];
+    if (!filter) {
+        sensor->filter_on = false;
+        filter_reset(sensor);
+        return 0;
+    }
+
+    if (filter->spike != SENSOR_SPIKE_NONE) {
+        if (filter->taps == 0 || filter->taps > SENSOR_FILTER_TAPS) return -1;
+        if (filter->spike == SENSOR_SPIKE_MEDIAN && (filter->taps & 1) == 0) return -1;
+    }
+    if (filter->ema_shift > 15) return -1;
+
+    sensor->filter = *filter;
+    sensor->filter_on = true;
+    filter_reset(sensor);
+
+    return 0;
+}
+
+int sensor_set_trip(sensor_array_t *sa, uint8_t sensor_id, int32_t limit,
+                    sensor_trip_fn fn, void *context) {
+    if (!sa || sensor_id >= sa->count) return -1;
+
+    sensor_t *sensor = &sa->sensors[sensor_id];
+    sensor->trip_limit = limit;
+    sensor->trip_context = context;
+    sensor->trip_fn = fn;
+
+    return 0;
+}
+
+int sensor_get_stats(sensor_array_t *sa, uint8_t sensor_id, sensor_summary_t *out) {
+    if (!sa || sensor_id >= sa->count || !out) return -1;
+
+    const sensor_stats_t *st = &sa->sensors[sensor_id].stats;
+    const uint32_t mask = SENSOR_STATS_WINDOW - 1;
+
+    memset(out, 0, sizeof(*out));
+    out->count = st->count;
+    out->over_threshold = st->over_threshold;
+    if (st->count > 0) {
+        out->mean = st->mean;
+        out->variance = st->m2 / (double)st->count;
+        out->window_min = st->min.value[st->min.head & mask];
+        out->window_max = st->max.value[st->max.head & mask];
+    }
+
+    return 0;
+}
+
+int sensor_set_stats_threshold(sensor_array_t *sa, uint8_t sensor_id, int32_t threshold) {
+    if (!sa || sensor_id >= sa->count) return -1;
+
+    sa->sensors[sensor_id].stats.threshold = threshold;
+    sa->sensors[sensor_id].stats.over_threshold = 0;
+    return 0;
+}
+
+int sensor_stats_reset(sensor_array_t *sa, uint8_t sensor_id) {
+    if (!sa || sensor_id >= sa->count) return -1;
+
+    stats_reset(&sa->sensors[sensor_id].stats);
+    return 0;
+}
+
+int32_t sensor_read_filtered(sensor_array_t *sa, uint8_t sensor_id) {
+    if (!sa || sensor_id >= sa->count) return 0;
+    return sa->sensors[sensor_id].filtered;
+}
+
+uint32_t sensor_filtered_count(sensor_array_t *sa, uint8_t sensor_id) {
+    if (!sa || sensor_id >= sa->count) return 0;
+    return sa->sensors[sensor_id].filtered_count;
+}
+
 int32_t sensor_read(sensor_array_t *sa, uint8_t sensor_id) {
-    if (!sa || sensor_id >= SENSOR_COUNT) return 0;
+    if (!sa || sensor_id >= sa->count) return 0;
     return sa->sensors[sensor_id].value;
 }
 
 int sensor_read_all(sensor_array_t *sa, int32_t *values, uint8_t count) {
     if (!sa || !values) return -1;
-    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    if (count > sa->count) count = sa->count;
 
     for (uint8_t i = 0; i < count; i++) {
         values[i] = sa->sensors[i].value;
@@ -108,52 +581,230 @@ int sensor_read_all(sensor_array_t *sa, int32_t *values, uint8_t count) {
     return count;
 }
 
-int sensor_buffer_push(sensor_array_t *sa, int32_t value) {
+int sensor_buffer_configure(sensor_array_t *sa, uint32_t capacity,
+                            sensor_overflow_policy_t policy) {
     if (!sa) return -1;
+    if (capacity < 2 || capacity > SENSOR_BUFFER_MAX) return -1;
+    if (capacity & (capacity - 1)) return -1;  /* Not a power of two */
 
-    uint8_t next = (sa->buffer_head + 1) % SENSOR_BUFFER_SIZE;
-    if (next == sa->buffer_tail) {
-        reg_set_bits(sa->regs, REG_SENSOR_STATUS, SENSOR_STATUS_OVERFLOW);
-        return -2;  /* Buffer full */
-    }
+    /* Not safe against a running consumer: configure before draining */
+    void *old = sa->ring.heap;
 
-    sa->buffer[sa->buffer_head] = value;
-    sa->buffer_head = next;
+    if (capacity > SENSOR_BUFFER_SIZE) {
+        if (ring_use_heap(sa, capacity, policy) != 0) return -3;
+    } else {
+        ring_use_inline(sa, policy);
+        sa->ring.capacity = capacity;
+        ring_reset(&sa->ring, policy);
+    }
+    free(old);
+    reg_clear_bits(sa->regs, REG_SENSOR_STATUS, SENSOR_STATUS_OVERFLOW);
 
     return 0;
 }
 
+int sensor_buffer_push(sensor_array_t *sa, int32_t value) {
+    if (!sa) return -1;
+
+    sensor_sample_t sample = {sim_clock_now_ns(), value, SENSOR_ID_NONE, 0};
+    return ring_push(sa, &sample);
+}
+
 int sensor_buffer_pop(sensor_array_t *sa, int32_t *value) {
     if (!sa || !value) return -1;
 
-    if (sa->buffer_head == sa->buffer_tail) {
-        return -2;  /* Buffer empty */
-    }
-
-    *value = sa->buffer[sa->buffer_tail];
-    sa->buffer_tail = (sa->buffer_tail + 1) % SENSOR_BUFFER_SIZE;
+    sensor_sample_t sample;
+    if (ring_pop(&sa->ring, &sample) != 0) return -2;  /* Buffer empty */
 
+    *value = sample.value;
     return 0;
 }
 
 int sensor_buffer_count(sensor_array_t *sa) {
     if (!sa) return 0;
 
-    if (sa->buffer_head >= sa->buffer_tail) {
-        return sa->buffer_head - sa->buffer_tail;
-    }
-    return SENSOR_BUFFER_SIZE - sa->buffer_tail + sa->buffer_head;
+    uint32_t tail = atomic_load_explicit(&sa->ring.tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&sa->ring.head, memory_order_acquire);
+    uint32_t count = head - tail;
+
+    return (int)(count > sa->ring.capacity ? sa->ring.capacity : count);
+}
+
+uint32_t sensor_buffer_capacity(sensor_array_t *sa) {
+    return sa ? sa->ring.capacity : 0;
+}
+
+uint32_t sensor_buffer_dropped(sensor_array_t *sa) {
+    return sa ? atomic_load_explicit(&sa->ring.dropped, memory_order_relaxed) : 0;
+}
+
+uint32_t sensor_get_drop_count(sensor_array_t *sa, uint8_t sensor_id) {
+    if (!sa || sensor_id >= sa->count) return 0;
+    return sa->sensors[sensor_id].drop_count;
 }
 
 void sensor_buffer_clear(sensor_array_t *sa) {
     if (!sa) return;
-    sa->buffer_head = 0;
-    sa->buffer_tail = 0;
+    atomic_store(&sa->ring.tail, atomic_load(&sa->ring.head));
     reg_clear_bits(sa->regs, REG_SENSOR_STATUS, SENSOR_STATUS_OVERFLOW);
 }
 
+int sensor_buffer_push_bulk(sensor_array_t *sa, const int32_t *values, uint32_t count) {
+    if (!sa || (!values && count > 0)) return -1;
+
+    sensor_ring_t *ring = &sa->ring;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t lost = 0;
+    uint64_t now = sim_clock_now_ns();
+
+    if (ring->policy == SENSOR_OVERFLOW_OVERWRITE_OLDEST) {
+        /* Only the newest `capacity` values can survive */
+        if (count > ring->capacity) {
+            lost = count - ring->capacity;
+            values += lost;
+            count = ring->capacity;
+        }
+
+        /* Evict just enough of the oldest samples to make room */
+        for (;;) {
+            uint32_t used = head - tail;
+            uint32_t free_slots = used >= ring->capacity ? 0 : ring->capacity - used;
+            if (count <= free_slots) break;
+
+            uint32_t evict = count - free_slots;
+            uint32_t oldest = tail;
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + evict,
+                                                      memory_order_acq_rel,
+                                                      memory_order_acquire)) {
+                note_evicted(sa, oldest, evict);
+                break;
+            }
+        }
+    } else {
+        uint32_t used = head - tail;
+        uint32_t free_slots = used >= ring->capacity ? 0 : ring->capacity - used;
+        if (count > free_slots) {
+            lost = count - free_slots;
+            count = free_slots;
+        }
+    }
+
+    if (lost > 0) {
+        note_drop(sa, SENSOR_ID_NONE, lost);
+    }
+
+    /* At most two copies: up to the end of the storage, then from the start */
+    uint32_t start = head & ring->mask;
+    uint32_t first = ring->capacity - start;
+    if (first > count) first = count;
+
+    memcpy(&ring->values[start], values, first * sizeof(int32_t));
+    memcpy(ring->values, values + first, (count - first) * sizeof(int32_t));
+    memset(&ring->ids[start], SENSOR_ID_NONE, first);
+    memset(ring->ids, SENSOR_ID_NONE, count - first);
+    memset(&ring->flags[start], 0, first);
+    memset(ring->flags, 0, count - first);
+    for (uint32_t i = 0; i < count; i++) {
+        ring->timestamps[(start + i) & ring->mask] = now;
+    }
+
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+
+    return (int)count;
+}
+
+int sensor_buffer_peek_bulk(sensor_array_t *sa, sensor_view_t *view, uint32_t max) {
+    if (!sa || !view) return -1;
+
+    sensor_ring_t *ring = &sa->ring;
+    uint32_t start, first;
+    uint32_t count = ring_window(ring, max, &start, &first);
+
+    view->first = &ring->values[start];
+    view->first_count = first;
+    view->second = ring->values;
+    view->second_count = count - first;
+
+    return (int)count;
+}
+
+int sensor_buffer_consume(sensor_array_t *sa, uint32_t count) {
+    if (!sa) return -1;
+    if (count == 0) return 0;
+
+    sensor_ring_t *ring = &sa->ring;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (count > head - tail) return -1;
+
+    /*
+     * Fails only if the producer evicted samples since the peek; the view
+     * may then hold overwritten data and must be discarded.
+     */
+    if (!atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + count,
+                                                 memory_order_acq_rel,
+                                                 memory_order_acquire)) {
+        return -2;
+    }
+
+    return 0;
+}
+
+int sensor_buffer_pop_bulk(sensor_array_t *sa, int32_t *values, uint32_t max) {
+    if (!sa || !values) return -1;
+
+    sensor_view_t view;
+    for (;;) {
+        int count = sensor_buffer_peek_bulk(sa, &view, max);
+        if (count <= 0) return count;
+
+        memcpy(values, view.first, view.first_count * sizeof(int32_t));
+        memcpy(values + view.first_count, view.second,
+               view.second_count * sizeof(int32_t));
+
+        if (sensor_buffer_consume(sa, (uint32_t)count) == 0) {
+            return count;
+        }
+        /* Evicted under us: retry from the new tail */
+    }
+}
+
+int sensor_buffer_push_sample(sensor_array_t *sa, const sensor_sample_t *sample) {
+    if (!sa || !sample) return -1;
+    return ring_push(sa, sample);
+}
+
+int sensor_buffer_pop_sample(sensor_array_t *sa, sensor_sample_t *sample) {
+    if (!sa || !sample) return -1;
+    return ring_pop(&sa->ring, sample);
+}
+
+int sensor_buffer_peek_samples(sensor_array_t *sa, sensor_span_t spans[2], uint32_t max) {
+    if (!sa || !spans) return -1;
+
+    sensor_ring_t *ring = &sa->ring;
+    uint32_t start, first;
+    uint32_t count = ring_window(ring, max, &start, &first);
+
+    spans[0].values = &ring->values[start];
+    spans[0].timestamps = &ring->timestamps[start];
+    spans[0].ids = &ring->ids[start];
+    spans[0].flags = &ring->flags[start];
+    spans[0].count = first;
+
+    spans[1].values = ring->values;
+    spans[1].timestamps = ring->timestamps;
+    spans[1].ids = ring->ids;
+    spans[1].flags = ring->flags;
+    spans[1].count = count - first;
+
+    return (int)count;
+}
+
 sensor_state_t sensor_get_state(sensor_array_t *sa, uint8_t sensor_id) {
-    if (!sa || sensor_id >= SENSOR_COUNT) return SENSOR_STATE_ERROR;
+    if (!sa || sensor_id >= sa->count) return SENSOR_STATE_ERROR;
     return sa->sensors[sensor_id].state;
 }
 
@@ -170,27 +821,63 @@ bool sensor_has_error(sensor_array_t *sa) {
 int sensor_array_update(sensor_array_t *sa) {
     if (!sa) return -1;
 
-    /* Process sensors in sampling state */
-    for (int i = 0; i < SENSOR_COUNT; i++) {
+    /* Every sample from one update shares its timestamp */
+    uint64_t now = sim_clock_now_ns();
+    sensor_sample_t published[SENSOR_MAX];
+    uint32_t n_published = 0;
+
+    /* Only sensors that were started since the last update */
+    uint32_t pending = sa->sampling;
+    sa->sampling = 0;
+    while (pending) {
+        int i = __builtin_ctz(pending);
+        pending &= pending - 1;
+
         if (sa->sensors[i].state == SENSOR_STATE_SAMPLING) {
+            uint8_t flags = 0;
+
             /* Simulate sampling complete */
             sa->sensors[i].state = SENSOR_STATE_IDLE;
 
+            /* Protective trips see the reading before it is clamped */
+            if (sa->sensors[i].trip_fn && sa->sensors[i].value >= sa->sensors[i].trip_limit) {
+                sa->sensors[i].trip_fn((uint8_t)i, sa->sensors[i].value,
+                                       sa->sensors[i].trip_context);
+            }
+
             /* Clamp value to valid range */
             if (sa->sensors[i].value < sa->sensors[i].min_value) {
                 sa->sensors[i].value = sa->sensors[i].min_value;
+                flags |= SENSOR_SAMPLE_CLAMPED;
             }
             if (sa->sensors[i].value > sa->sensors[i].max_value) {
                 sa->sensors[i].value = sa->sensors[i].max_value;
+                flags |= SENSOR_SAMPLE_CLAMPED;
             }
 
+            sensor_sample_t sample = {now, sa->sensors[i].value, (uint8_t)i, flags};
+            stats_add(&sa->sensors[i].stats, sample.value);
+
             /* Push to buffer if in continuous mode */
             if (sa->continuous_mode) {
-                sensor_buffer_push(sa, sa->sensors[i].value);
+                ring_push(sa, &sample);
+            }
+
+            /* Filtered sensors stream their filter outputs instead */
+            if (!sa->sensors[i].filter_on) {
+                published[n_published++] = sample;
+            } else if (filter_step(&sa->sensors[i], sample.value, &sample.value)) {
+                sample.flags |= SENSOR_SAMPLE_FILTERED;
+                published[n_published++] = sample;
             }
         }
     }
 
+    /* Every completed sample goes out on the stream in one batch */
+    if (sa->stream && n_published > 0) {
+        sample_stream_publish(sa->stream, published, n_published);
+    }
+
     /* Clear trigger bit after processing */
     reg_clear_bits(sa->regs, REG_SENSOR_CTRL, SENSOR_CTRL_TRIGGER);
 
@@ -203,6 +890,6 @@ int sensor_array_update(sensor_array_t *sa) {
 }
 
 void sensor_set_simulated_value(sensor_array_t *sa, uint8_t sensor_id, int32_t value) {
-    if (!sa || sensor_id >= SENSOR_COUNT) return;
+    if (!sa || sensor_id >= sa->count) return;
     sa->sensors[sensor_id].value = value;
 }
@@ -1,7 +1,131 @@
 #include "shared_mem.h"
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define CMD_RING_MASK (SHM_CMD_RING_DEPTH - 1)
+#define STATUS_READ_RETRIES 1000
+#define SEQLOCK_SPIN_LIMIT  100000
+
+/* Sequence id of the last command this thread sent via shm_send_command */
+static _Thread_local uint32_t t_last_seq = 0;
+
+/* Futex wrappers; the segment is process-shared so no FUTEX_PRIVATE_FLAG */
+static void futex_wait(_Atomic uint32_t *addr, uint32_t expected) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, expected, NULL, NULL, 0);
+#else
+    (void)addr;
+    (void)expected;
+    sched_yield();
+#endif
+}
+
+static void futex_wake_all(_Atomic uint32_t *addr) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)addr;
+#endif
+}
+
+/* Tell the CPU we are busy-waiting; stays on-core unlike sched_yield */
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+/*
+ * Seqlock: the writer makes the sequence odd while it updates the data and
+ * even again when done. Readers copy the data between read_begin and
+ * read_retry and try again if the sequence moved.
+ */
+static uint32_t seqlock_write_begin(_Atomic uint32_t *seq) {
+    uint32_t start = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, start + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return start;
+}
+
+static void seqlock_write_end(_Atomic uint32_t *seq, uint32_t start) {
+    atomic_store_explicit(seq, start + 2, memory_order_release);
+}
+
+/* false if the writer stays mid-update for the whole spin bound */
+static bool seqlock_read_begin(_Atomic uint32_t *seq, uint32_t *start) {
+    for (uint32_t spin = 0; spin < SEQLOCK_SPIN_LIMIT; spin++) {
+        uint32_t s = atomic_load_explicit(seq, memory_order_acquire);
+        if (!(s & 1)) {
+            *start = s;
+            return true;
+        }
+        cpu_relax();
+    }
+    return false;
+}
+
+/* true if the copy just taken may be torn */
+static bool seqlock_read_retry(_Atomic uint32_t *seq, uint32_t start) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(seq, memory_order_relaxed) != start;
+}
+
+static void cmd_ring_init(shm_cmd_ring_t *ring) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->next_seq, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->waiters, 0);
+    atomic_init(&ring->wake, 0);
+    atomic_init(&ring->rejected, 0);
+    ring->active_seq = 0;
+
+    for (uint32_t i = 0; i < SHM_CMD_RING_DEPTH; i++) {
+        atomic_init(&ring->slots[i].turn, i);
+        memset(&ring->slots[i].entry, 0, sizeof(ring->slots[i].entry));
+    }
+}
+
+static void resp_slots_init(shm_resp_slot_t *slots) {
+    for (uint32_t i = 0; i < SHM_CMD_RING_DEPTH; i++) {
+        atomic_init(&slots[i].done_seq, 0);
+        atomic_init(&slots[i].waiters, 0);
+        slots[i].status = RESP_OK;
+        memset(slots[i].data, 0, sizeof(slots[i].data));
+        memset(&slots[i].frame, 0, sizeof(slots[i].frame));
+    }
+}
+
+static void sub_table_init(shm_sub_table_t *subs) {
+    atomic_init(&subs->armed, 0);
+    atomic_init(&subs->draining, 0);
+
+    for (uint32_t i = 0; i < SHM_MAX_SUBS; i++) {
+        shm_sub_slot_t *slot = &subs->slots[i];
+        atomic_init(&slot->events, 0);
+        atomic_init(&slot->waiters, 0);
+        atomic_init(&slot->state, SHM_SUB_SLOT_FREE);
+        atomic_init(&slot->gen, 0);
+        slot->owner = 0;
+        memset(&slot->spec, 0, sizeof(slot->spec));
+        slot->last = 0;
+        atomic_init(&slot->event_seq, 0);
+        slot->count = 0;
+        slot->value = 0;
+        slot->tick = 0;
+    }
+}
 
 #ifdef _WIN32
 /* Windows implementation using heap memory for simplicity */
@@ -15,33 +139,38 @@ shared_mem_t* shm_create(void) {
     g_shared_mem = (shared_mem_t*)calloc(1, sizeof(shared_mem_t));
     if (!g_shared_mem) return NULL;
 
-    pthread_mutexattr_t mutex_attr;
-    pthread_mutexattr_init(&mutex_attr);
-    pthread_mutex_init(&g_shared_mem->mutex, &mutex_attr);
-    pthread_mutexattr_destroy(&mutex_attr);
-
-    pthread_condattr_t cond_attr;
-    pthread_condattr_init(&cond_attr);
-    pthread_cond_init(&g_shared_mem->cmd_ready, &cond_attr);
-    pthread_cond_init(&g_shared_mem->resp_ready, &cond_attr);
-    pthread_condattr_destroy(&cond_attr);
+    cmd_ring_init(&g_shared_mem->cmd_ring);
+    resp_slots_init(g_shared_mem->resp_slots);
+    sub_table_init(&g_shared_mem->subs);
 
     return g_shared_mem;
 }
 
+shared_mem_t* shm_create_private(void) {
+    shared_mem_t *shm = (shared_mem_t*)calloc(1, sizeof(shared_mem_t));
+    if (!shm) return NULL;
+
+    cmd_ring_init(&shm->cmd_ring);
+    resp_slots_init(shm->resp_slots);
+    sub_table_init(&shm->subs);
+    shm->anonymous = true;
+
+    return shm;
+}
+
 shared_mem_t* shm_open_existing(void) {
     return g_shared_mem;
 }
 
-void shm_destroy(shared_mem_t *shm) {
-    if (!shm || shm != g_shared_mem) return;
+shared_mem_t* shm_attach(void) {
+    return NULL;    /* The heap segment never outlives its driver */
+}
 
-    pthread_mutex_destroy(&shm->mutex);
-    pthread_cond_destroy(&shm->cmd_ready);
-    pthread_cond_destroy(&shm->resp_ready);
+void shm_destroy(shared_mem_t *shm) {
+    if (!shm || (shm != g_shared_mem && !shm->anonymous)) return;
 
+    if (shm == g_shared_mem) g_shared_mem = NULL;
     free(shm);
-    g_shared_mem = NULL;
 }
 
 void shm_close(shared_mem_t *shm) {
@@ -55,6 +184,47 @@ void shm_close(shared_mem_t *shm) {
 #include <fcntl.h>
 #include <unistd.h>
 
+/* Everything but the mapping: rings, slots and published state */
+static void segment_init(shared_mem_t *shm) {
+    cmd_ring_init(&shm->cmd_ring);
+    resp_slots_init(shm->resp_slots);
+    atomic_init(&shm->status_seq, 0);
+    memset(&shm->status, 0, sizeof(shm->status));
+    atomic_init(&shm->axes_seq, 0);
+    memset(&shm->axes, 0, sizeof(shm->axes));
+    atomic_init(&shm->sensor_stats_seq, 0);
+    memset(&shm->sensor_stats, 0, sizeof(shm->sensor_stats));
+    memset(&shm->loop_stats, 0, sizeof(shm->loop_stats));
+    memset(&shm->irq_stats, 0, sizeof(shm->irq_stats));
+    sub_table_init(&shm->subs);
+    memset(&shm->saved, 0, sizeof(shm->saved));
+    shm->driver_pid = (int32_t)getpid();
+    atomic_init(&shm->shutdown_requested, false);
+
+    shm->magic = SHM_MAGIC;
+    shm->layout_version = SHM_LAYOUT_VERSION;
+    shm->size = (uint32_t)sizeof(shared_mem_t);
+}
+
+/* What belonged to the driver that went away; everything clients hold is kept */
+static void segment_reclaim(shared_mem_t *shm) {
+    /* Only the old driver ever waited here; clients never sleep on wake */
+    atomic_store(&shm->cmd_ring.waiters, 0);
+
+    /* Taken off the ring but never answered: tell the client to retry */
+    uint32_t seq = shm->cmd_ring.active_seq;
+    if (seq != 0 &&
+        atomic_load(&shm->resp_slots[seq & CMD_RING_MASK].done_seq) != seq) {
+        shm_frame_result_t busy;
+        memset(&busy, 0, sizeof(busy));
+        busy.status = RESP_BUSY;
+        shm_complete_frame(shm, seq, &busy);
+    }
+
+    shm->driver_pid = (int32_t)getpid();
+    atomic_store(&shm->shutdown_requested, false);
+}
+
 shared_mem_t* shm_create(void) {
     int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
     if (fd < 0) return NULL;
@@ -74,26 +244,18 @@ shared_mem_t* shm_create(void) {
         return NULL;
     }
 
-    /* Initialize mutex with process-shared attribute */
-    pthread_mutexattr_t mutex_attr;
-    pthread_mutexattr_init(&mutex_attr);
-    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&shm->mutex, &mutex_attr);
-    pthread_mutexattr_destroy(&mutex_attr);
-
-    /* Initialize condition variables */
-    pthread_condattr_t cond_attr;
-    pthread_condattr_init(&cond_attr);
-    pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
-    pthread_cond_init(&shm->cmd_ready, &cond_attr);
-    pthread_cond_init(&shm->resp_ready, &cond_attr);
-    pthread_condattr_destroy(&cond_attr);
+    segment_init(shm);
+    shm->anonymous = false;
+    return shm;
+}
 
-    shm->cmd = CMD_NONE;
-    shm->cmd_pending = false;
-    shm->resp_ready_flag = false;
-    shm->shutdown_requested = false;
+shared_mem_t* shm_create_private(void) {
+    shared_mem_t *shm = mmap(NULL, sizeof(shared_mem_t), PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) return NULL;
 
+    segment_init(shm);
+    shm->anonymous = true;
     return shm;
 }
 
@@ -110,15 +272,38 @@ shared_mem_t* shm_open_existing(void) {
     return shm;
 }
 
+shared_mem_t* shm_attach(void) {
+    int fd = shm_open(SHM_NAME, O_RDWR, 0666);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size != (off_t)sizeof(shared_mem_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    shared_mem_t *shm = mmap(NULL, sizeof(shared_mem_t),
+                             PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (shm == MAP_FAILED) return NULL;
+
+    if (shm->magic != SHM_MAGIC || shm->layout_version != SHM_LAYOUT_VERSION ||
+        shm->size != (uint32_t)sizeof(shared_mem_t) || shm->anonymous) {
+        munmap(shm, sizeof(shared_mem_t));
+        return NULL;
+    }
+
+    segment_reclaim(shm);
+    return shm;
+}
+
 void shm_destroy(shared_mem_t *shm) {
     if (!shm) return;
 
-    pthread_mutex_destroy(&shm->mutex);
-    pthread_cond_destroy(&shm->cmd_ready);
-    pthread_cond_destroy(&shm->resp_ready);
-
+    bool anonymous = shm->anonymous;
     munmap(shm, sizeof(shared_mem_t));
-    shm_unlink(SHM_NAME);
+    if (!anonymous) shm_unlink(SHM_NAME);
 }
 
 void shm_close(shared_mem_t *shm) {
@@ -128,93 +313,279 @@ void shm_close(shared_mem_t *shm) {
 }
 #endif
 
-int shm_send_command(shared_mem_t *shm, command_type_t cmd,
+int shm_submit_command(shared_mem_t *shm, command_type_t cmd,
+                       uint32_t param1, uint32_t param2, uint32_t *seq_id) {
+    return shm_submit_axis_command(shm, 0, cmd, param1, param2, seq_id);
+}
+
+/*
+ * Claim n consecutive slots. The driver frees slots in order, so once the
+ * last of them is free for this lap, all of them are.
+ */
+static int claim_slots(shm_cmd_ring_t *ring, uint32_t n, uint32_t *claimed) {
+    uint32_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    for (;;) {
+        shm_cmd_slot_t *last = &ring->slots[(pos + n - 1) & CMD_RING_MASK];
+        uint32_t turn = atomic_load_explicit(&last->turn, memory_order_acquire);
+        int32_t diff = (int32_t)(turn - (pos + n - 1));
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + n,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&ring->rejected, 1, memory_order_relaxed);
+            return -2;  /* Ring full */
+        } else {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+
+    *claimed = pos;
+    return 0;
+}
+
+/* Wake the driver's command wait: bump the futex word, then wake its sleeper */
+static void cmd_wake(shared_mem_t *shm) {
+    atomic_fetch_add_explicit(&shm->cmd_ring.wake, 1, memory_order_release);
+    futex_wake_all(&shm->cmd_ring.wake);
+}
+
+/* Tell the driver: the futex, only if it is blocked in shm_get_command */
+static void notify_driver(shared_mem_t *shm) {
+    /*
+     * Publish, then look for a waiter; the consumer registers, then looks
+     * for a command. Without a full fence on both sides each can miss the
+     * other's store, and the driver sleeps with a command queued.
+     */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&shm->cmd_ring.waiters) > 0) {
+        cmd_wake(shm);
+    }
+}
+
+/* Fill and publish claimed slots; returns the frame's sequence id */
+static uint32_t publish_ops(shm_cmd_ring_t *ring, uint32_t pos, const shm_op_t *ops,
+                            uint32_t count, uint16_t flags) {
+    /*
+     * Ids come from their own counter, not the ring position, so every
+     * frame gets a distinct id across wrap. They are never 0 so 0 can
+     * mean "no request".
+     */
+    uint32_t seq;
+    do {
+        seq = atomic_fetch_add_explicit(&ring->next_seq, 1, memory_order_relaxed) + 1;
+    } while (seq == 0);
+
+    for (uint32_t i = 0; i < count; i++) {
+        shm_cmd_slot_t *slot = &ring->slots[(pos + i) & CMD_RING_MASK];
+        slot->entry.seq_id = seq;
+        slot->entry.cmd = ops[i].cmd;
+        slot->entry.axis = ops[i].axis;
+        slot->entry.param1 = ops[i].param1;
+        slot->entry.param2 = ops[i].param2;
+        slot->entry.frame_ops = (uint16_t)(i == 0 ? count : 0);
+        slot->entry.flags = flags;
+        atomic_store_explicit(&slot->turn, pos + i + 1, memory_order_release);
+    }
+
+    return seq;
+}
+
+int shm_submit_axis_command(shared_mem_t *shm, uint32_t axis, command_type_t cmd,
+                            uint32_t param1, uint32_t param2, uint32_t *seq_id) {
+    if (!shm || axis >= SHM_MAX_AXES) return -1;
+
+    uint32_t pos;
+    if (claim_slots(&shm->cmd_ring, 1, &pos) < 0) return -2;
+
+    shm_op_t op = { cmd, axis, param1, param2 };
+    uint32_t seq = publish_ops(&shm->cmd_ring, pos, &op, 1, 0);
+    if (seq_id) *seq_id = seq;
+
+    notify_driver(shm);
+    return 0;
+}
+
+int shm_post_command(shared_mem_t *shm, uint32_t axis, command_type_t cmd,
                      uint32_t param1, uint32_t param2) {
-    if (!shm) return -1;
+    if (!shm || axis >= SHM_MAX_AXES) return -1;
+
+    uint32_t pos;
+    if (claim_slots(&shm->cmd_ring, 1, &pos) < 0) return -2;
+
+    shm_op_t op = { cmd, axis, param1, param2 };
+    publish_ops(&shm->cmd_ring, pos, &op, 1, SHM_CMD_NO_REPLY);
 
-    pthread_mutex_lock(&shm->mutex);
+    notify_driver(shm);
+    return 0;
+}
 
-    /* Wait for previous command to be processed */
-    while (shm->cmd_pending) {
-        pthread_cond_wait(&shm->resp_ready, &shm->mutex);
+int shm_submit_frame(shared_mem_t *shm, const shm_op_t *ops, uint32_t count,
+                     uint32_t flags, uint32_t *seq_id) {
+    if (!shm || !ops || count == 0 || count > SHM_FRAME_MAX_OPS) return -1;
+    if (flags & ~SHM_CMD_NO_REPLY) return -1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (ops[i].axis >= SHM_MAX_AXES) return -1;
     }
 
-    shm->cmd = cmd;
-    shm->cmd_param1 = param1;
-    shm->cmd_param2 = param2;
-    shm->cmd_pending = true;
-    shm->resp_ready_flag = false;
+    uint32_t pos;
+    if (claim_slots(&shm->cmd_ring, count, &pos) < 0) return -2;
 
-    pthread_cond_signal(&shm->cmd_ready);
-    pthread_mutex_unlock(&shm->mutex);
+    uint32_t seq = publish_ops(&shm->cmd_ring, pos, ops, count,
+                               (uint16_t)(flags | SHM_CMD_FRAME));
+    if (seq_id) *seq_id = seq;
 
+    notify_driver(shm);
     return 0;
 }
 
+int shm_send_command(shared_mem_t *shm, command_type_t cmd,
+                     uint32_t param1, uint32_t param2) {
+    return shm_submit_command(shm, cmd, param1, param2, &t_last_seq);
+}
+
 int shm_wait_response(shared_mem_t *shm, response_status_t *status,
                       int32_t *data, int data_count) {
     if (!shm) return -1;
+    if (t_last_seq == 0) return -1;  /* Nothing sent from this thread */
 
-    pthread_mutex_lock(&shm->mutex);
+    return shm_wait_completion(shm, t_last_seq, status, data, data_count);
+}
 
-    while (!shm->resp_ready_flag) {
-        pthread_cond_wait(&shm->resp_ready, &shm->mutex);
-    }
+int shm_poll_command(shared_mem_t *shm, shm_command_t *out) {
+    if (!shm) return -1;
 
-    if (status) *status = shm->resp_status;
-    if (data && data_count > 0) {
-        int count = data_count > 8 ? 8 : data_count;
-        memcpy(data, shm->resp_data, count * sizeof(int32_t));
+    shm_cmd_ring_t *ring = &shm->cmd_ring;
+    uint32_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    shm_cmd_slot_t *slot = &ring->slots[pos & CMD_RING_MASK];
+    uint32_t turn = atomic_load_explicit(&slot->turn, memory_order_acquire);
+
+    if (turn != pos + 1) {
+        return -1;  /* Empty, or producer still filling the slot */
     }
 
-    shm->resp_ready_flag = false;
-    pthread_cond_signal(&shm->resp_ready);
+    if (out) *out = slot->entry;
+    ring->active_seq = slot->entry.seq_id;
 
-    pthread_mutex_unlock(&shm->mutex);
+    /* Hand the slot back to producers for the next lap */
+    atomic_store_explicit(&slot->turn, pos + SHM_CMD_RING_DEPTH, memory_order_release);
+    atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
 
     return 0;
 }
 
+int shm_poll_frame(shared_mem_t *shm, shm_command_t *ops) {
+    if (!shm || !ops) return -1;
+
+    shm_cmd_ring_t *ring = &shm->cmd_ring;
+    uint32_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    shm_cmd_slot_t *first = &ring->slots[pos & CMD_RING_MASK];
+
+    if (atomic_load_explicit(&first->turn, memory_order_acquire) != pos + 1) {
+        return -1;
+    }
+
+    /* A stray continuation slot (frame half taken by shm_poll_command) runs alone */
+    uint32_t count = first->entry.frame_ops;
+    if (count == 0 || count > SHM_FRAME_MAX_OPS) count = 1;
+
+    /* Nothing is taken until the producer has published every op */
+    for (uint32_t i = 1; i < count; i++) {
+        shm_cmd_slot_t *slot = &ring->slots[(pos + i) & CMD_RING_MASK];
+        if (atomic_load_explicit(&slot->turn, memory_order_acquire) != pos + i + 1) {
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        shm_cmd_slot_t *slot = &ring->slots[(pos + i) & CMD_RING_MASK];
+        ops[i] = slot->entry;
+        atomic_store_explicit(&slot->turn, pos + i + SHM_CMD_RING_DEPTH, memory_order_release);
+    }
+    ring->active_seq = ops[0].seq_id;
+    atomic_store_explicit(&ring->tail, pos + count, memory_order_relaxed);
+
+    return (int)count;
+}
+
+int shm_pending_commands(shared_mem_t *shm) {
+    if (!shm) return 0;
+
+    uint32_t head = atomic_load_explicit(&shm->cmd_ring.head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&shm->cmd_ring.tail, memory_order_acquire);
+    return (int)(head - tail);
+}
+
+int shm_wait_commands(shared_mem_t *shm) {
+    if (!shm) return -1;
+
+    if (shm_pending_commands(shm) > 0) return 0;
+
+    int ret = 0;
+    atomic_fetch_add(&shm->cmd_ring.waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);  /* Pairs with notify_driver */
+
+    for (;;) {
+        /* Snapshot the futex word first so a wake after the check is not lost */
+        uint32_t wake = atomic_load_explicit(&shm->cmd_ring.wake, memory_order_acquire);
+        if (shm_pending_commands(shm) > 0) break;
+        if (atomic_load(&shm->shutdown_requested)) {
+            ret = -2;
+            break;
+        }
+        futex_wait(&shm->cmd_ring.wake, wake);
+    }
+
+    atomic_fetch_sub(&shm->cmd_ring.waiters, 1);
+
+    return ret;
+}
+
 int shm_get_command(shared_mem_t *shm, command_type_t *cmd,
                     uint32_t *param1, uint32_t *param2) {
     if (!shm) return -1;
 
-    pthread_mutex_lock(&shm->mutex);
+    shm_command_t entry;
 
-    while (!shm->cmd_pending && !shm->shutdown_requested) {
-        pthread_cond_wait(&shm->cmd_ready, &shm->mutex);
-    }
+    if (shm_poll_command(shm, &entry) != 0) {
+        atomic_fetch_add(&shm->cmd_ring.waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);  /* Pairs with notify_driver */
 
-    if (shm->shutdown_requested) {
-        pthread_mutex_unlock(&shm->mutex);
-        return -2;
-    }
+        for (;;) {
+            uint32_t wake = atomic_load_explicit(&shm->cmd_ring.wake, memory_order_acquire);
+            if (shm_poll_command(shm, &entry) == 0) break;
+            if (atomic_load(&shm->shutdown_requested)) {
+                atomic_fetch_sub(&shm->cmd_ring.waiters, 1);
+                return -2;
+            }
+            futex_wait(&shm->cmd_ring.wake, wake);
+        }
 
-    if (cmd) *cmd = shm->cmd;
-    if (param1) *param1 = shm->cmd_param1;
-    if (param2) *param2 = shm->cmd_param2;
+        atomic_fetch_sub(&shm->cmd_ring.waiters, 1);
+    }
 
-    pthread_mutex_unlock(&shm->mutex);
+    if (cmd) *cmd = entry.cmd;
+    if (param1) *param1 = entry.param1;
+    if (param2) *param2 = entry.param2;
 
     return 0;
 }
 
 int shm_try_get_command(shared_mem_t *shm, command_type_t *cmd,
                         uint32_t *param1, uint32_t *param2) {
-    if (!shm) return -1;
+    shm_command_t entry;
 
-    pthread_mutex_lock(&shm->mutex);
-
-    if (!shm->cmd_pending) {
-        pthread_mutex_unlock(&shm->mutex);
+    if (shm_poll_command(shm, &entry) != 0) {
         return -1;  /* No command pending */
     }
 
-    if (cmd) *cmd = shm->cmd;
-    if (param1) *param1 = shm->cmd_param1;
-    if (param2) *param2 = shm->cmd_param2;
-
-    pthread_mutex_unlock(&shm->mutex);
+    if (cmd) *cmd = entry.cmd;
+    if (param1) *param1 = entry.param1;
+    if (param2) *param2 = entry.param2;
 
     return 0;
 }
@@ -223,20 +594,117 @@ int shm_send_response(shared_mem_t *shm, response_status_t status,
                       int32_t *data, int data_count) {
     if (!shm) return -1;
 
-    pthread_mutex_lock(&shm->mutex);
+    /* Respond to the command most recently taken off the ring */
+    return shm_complete_command(shm, shm->cmd_ring.active_seq,
+                                status, data, data_count);
+}
+
+int shm_complete_command(shared_mem_t *shm, uint32_t seq_id,
+                         response_status_t status, int32_t *data, int data_count) {
+    if (!shm || seq_id == 0) return -1;
+
+    shm_resp_slot_t *slot = &shm->resp_slots[seq_id & CMD_RING_MASK];
+
+    slot->status = status;
+    memset(slot->data, 0, sizeof(slot->data));
+    if (data && data_count > 0) {
+        int count = data_count > SHM_RESP_WORDS ? SHM_RESP_WORDS : data_count;
+        memcpy(slot->data, data, count * sizeof(int32_t));
+    }
+
+    atomic_store_explicit(&slot->done_seq, seq_id, memory_order_release);
+
+    /* Wake only this slot's waiter, and only if someone is asleep */
+    if (atomic_load(&slot->waiters) > 0) {
+        futex_wake_all(&slot->done_seq);
+    }
+
+    return 0;
+}
+
+/* Sleep until the slot holds seq_id: 0, -2 on shutdown, -3 if it was reused */
+static int wait_done(shared_mem_t *shm, shm_resp_slot_t *slot, uint32_t seq_id) {
+    for (;;) {
+        uint32_t done = atomic_load_explicit(&slot->done_seq, memory_order_acquire);
+
+        if (done == seq_id) {
+            return 0;
+        }
+        if ((int32_t)(done - seq_id) > 0) {
+            return -3;  /* Slot reused by a later request: response lost */
+        }
+        if (atomic_load(&shm->shutdown_requested)) {
+            return -2;
+        }
+
+        atomic_fetch_add(&slot->waiters, 1);
+        if (atomic_load(&slot->done_seq) == done &&
+            !atomic_load(&shm->shutdown_requested)) {
+            futex_wait(&slot->done_seq, done);
+        }
+        atomic_fetch_sub(&slot->waiters, 1);
+    }
+}
+
+int shm_wait_completion(shared_mem_t *shm, uint32_t seq_id,
+                        response_status_t *status, int32_t *data, int data_count) {
+    if (!shm || seq_id == 0) return -1;
+
+    shm_resp_slot_t *slot = &shm->resp_slots[seq_id & CMD_RING_MASK];
+    int ret = wait_done(shm, slot, seq_id);
+    if (ret < 0) return ret;
+
+    response_status_t resp_status = slot->status;
+    int32_t resp_data[SHM_RESP_WORDS];
+    memcpy(resp_data, slot->data, sizeof(resp_data));
 
-    shm->resp_status = status;
+    /* A later request landing on this slot mid-copy means the data is torn */
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->done_seq, memory_order_relaxed) != seq_id) {
+        return -3;
+    }
+
+    if (status) *status = resp_status;
     if (data && data_count > 0) {
-        int count = data_count > 8 ? 8 : data_count;
-        memcpy(shm->resp_data, data, count * sizeof(int32_t));
+        int count = data_count > SHM_RESP_WORDS ? SHM_RESP_WORDS : data_count;
+        memcpy(data, resp_data, count * sizeof(int32_t));
     }
 
-    shm->cmd_pending = false;
-    shm->resp_ready_flag = true;
-    pthread_cond_broadcast(&shm->resp_ready);
+    return 0;
+}
+
+int shm_complete_frame(shared_mem_t *shm, uint32_t seq_id, const shm_frame_result_t *result) {
+    if (!shm || seq_id == 0 || !result || result->ops > SHM_FRAME_MAX_OPS) return -1;
+
+    shm_resp_slot_t *slot = &shm->resp_slots[seq_id & CMD_RING_MASK];
+
+    slot->status = result->status;
+    memset(slot->data, 0, sizeof(slot->data));
+    slot->frame = *result;
+
+    atomic_store_explicit(&slot->done_seq, seq_id, memory_order_release);
+    if (atomic_load(&slot->waiters) > 0) {
+        futex_wake_all(&slot->done_seq);
+    }
+
+    return 0;
+}
+
+int shm_wait_frame(shared_mem_t *shm, uint32_t seq_id, shm_frame_result_t *result) {
+    if (!shm || seq_id == 0) return -1;
+
+    shm_resp_slot_t *slot = &shm->resp_slots[seq_id & CMD_RING_MASK];
+    int ret = wait_done(shm, slot, seq_id);
+    if (ret < 0) return ret;
 
-    pthread_mutex_unlock(&shm->mutex);
+    shm_frame_result_t copy = slot->frame;
 
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->done_seq, memory_order_relaxed) != seq_id) {
+        return -3;
+    }
+
+    if (result) *result = copy;
     return 0;
 }
 
@@ -245,38 +713,455 @@ int shm_update_status(shared_mem_t *shm, uint32_t motor_state,
                       int32_t *sensor_values, uint32_t fault_code) {
     if (!shm) return -1;
 
-    pthread_mutex_lock(&shm->mutex);
+    shm_status_t status = shm->status;  /* Only the writer mutates it */
 
-    shm->motor_state = motor_state;
-    shm->motor_speed = motor_speed;
-    shm->motor_position = motor_position;
-    shm->fault_code = fault_code;
+    status.motor_state = motor_state;
+    status.motor_speed = motor_speed;
+    status.motor_position = motor_position;
+    status.fault_code = fault_code;
 
     if (sensor_values) {
-        memcpy(shm->sensor_values, sensor_values, 4 * sizeof(int32_t));
+        memcpy(status.sensor_values, sensor_values, sizeof(status.sensor_values));
+    }
+
+    return shm_publish_status(shm, &status);
+}
+
+int shm_publish_status(shared_mem_t *shm, const shm_status_t *status) {
+    if (!shm || !status) return -1;
+
+    uint32_t seq = seqlock_write_begin(&shm->status_seq);
+    shm->status = *status;
+    seqlock_write_end(&shm->status_seq, seq);
+
+    return 0;
+}
+
+int shm_read_status(shared_mem_t *shm, shm_status_t *out) {
+    if (!shm || !out) return -1;
+
+    for (int attempt = 0; attempt < STATUS_READ_RETRIES; attempt++) {
+        uint32_t before;
+        if (!seqlock_read_begin(&shm->status_seq, &before)) break;
+
+        *out = shm->status;
+
+        if (!seqlock_read_retry(&shm->status_seq, before)) {
+            return 0;
+        }
+    }
+
+    return -2;  /* Writer stuck mid-update (e.g. driver died) */
+}
+
+/* Copy the first `axes` entries of each array */
+static void copy_axes(shm_axes_status_t *dst, const shm_axes_status_t *src) {
+    uint32_t n = src->axes < SHM_MAX_AXES ? src->axes : SHM_MAX_AXES;
+
+    dst->axes = n;
+    memcpy(dst->state, src->state, n * sizeof(uint32_t));
+    memcpy(dst->speed, src->speed, n * sizeof(uint32_t));
+    memcpy(dst->position, src->position, n * sizeof(int32_t));
+    memcpy(dst->fault_code, src->fault_code, n * sizeof(uint32_t));
+}
+
+int shm_publish_axes(shared_mem_t *shm, const shm_axes_status_t *axes) {
+    if (!shm || !axes) return -1;
+
+    uint32_t seq = seqlock_write_begin(&shm->axes_seq);
+    copy_axes(&shm->axes, axes);
+    seqlock_write_end(&shm->axes_seq, seq);
+
+    return 0;
+}
+
+int shm_read_axes(shared_mem_t *shm, shm_axes_status_t *out) {
+    if (!shm || !out) return -1;
+
+    for (int attempt = 0; attempt < STATUS_READ_RETRIES; attempt++) {
+        uint32_t before;
+        if (!seqlock_read_begin(&shm->axes_seq, &before)) break;
+
+        copy_axes(out, &shm->axes);
+
+        if (!seqlock_read_retry(&shm->axes_seq, before)) {
+            return 0;
+        }
+    }
+
+    return -2;
+}
+
+int shm_publish_sensor_stats(shared_mem_t *shm, const shm_sensor_stats_t *stats) {
+    if (!shm || !stats) return -1;
+
+    uint32_t seq = seqlock_write_begin(&shm->sensor_stats_seq);
+    shm->sensor_stats = *stats;
+    seqlock_write_end(&shm->sensor_stats_seq, seq);
+
+    return 0;
+}
+
+int shm_read_sensor_stats(shared_mem_t *shm, shm_sensor_stats_t *out) {
+    if (!shm || !out) return -1;
+
+    for (int attempt = 0; attempt < STATUS_READ_RETRIES; attempt++) {
+        uint32_t before;
+        if (!seqlock_read_begin(&shm->sensor_stats_seq, &before)) break;
+
+        *out = shm->sensor_stats;
+
+        if (!seqlock_read_retry(&shm->sensor_stats_seq, before)) {
+            return 0;
+        }
     }
 
-    pthread_mutex_unlock(&shm->mutex);
+    return -2;
+}
+
+void shm_reset_loop_stats(shared_mem_t *shm) {
+    if (!shm) return;
+
+    uint32_t period_us = shm->loop_stats.period_us;
+    memset(&shm->loop_stats, 0, sizeof(shm->loop_stats));
+    shm->loop_stats.period_us = period_us;
+}
 
+int shm_read_loop_stats(shared_mem_t *shm, shm_loop_stats_t *out) {
+    if (!shm || !out) return -1;
+
+    memcpy(out, &shm->loop_stats, sizeof(shm_loop_stats_t));
     return 0;
 }
 
+void shm_reset_irq_stats(shared_mem_t *shm) {
+    if (!shm) return;
+
+    memset(&shm->irq_stats, 0, sizeof(shm->irq_stats));
+}
+
+int shm_read_irq_stats(shared_mem_t *shm, shm_irq_stats_t *out) {
+    if (!shm || !out) return -1;
+
+    memcpy(out, &shm->irq_stats, sizeof(shm_irq_stats_t));
+    return 0;
+}
+
+/* Bytes of a save holding axes axes, and the part of it the checksum covers */
+static size_t state_size(uint32_t axes) {
+    return offsetof(shm_driver_state_t, axis) + (size_t)axes * sizeof(shm_axis_state_t);
+}
+
+/* FNV-1a over 32-bit words, from generation to the end of the last axis */
+static uint32_t state_checksum(const shm_driver_state_t *st) {
+    const uint8_t *p = (const uint8_t*)st + offsetof(shm_driver_state_t, generation);
+    size_t words = (state_size(st->axes) - offsetof(shm_driver_state_t, generation)) / 4;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < words; i++) {
+        uint32_t w;
+        memcpy(&w, p + i * 4, sizeof(w));
+        hash = (hash ^ w) * 16777619u;
+    }
+    return hash;
+}
+
+static bool state_valid(const shm_driver_state_t *st) {
+    return st->version == SHM_STATE_VERSION && st->axes >= 1 && st->axes <= SHM_MAX_AXES &&
+           st->sensors <= SHM_MAX_SENSORS && st->checksum == state_checksum(st);
+}
+
+int shm_save_state(shared_mem_t *shm, const shm_driver_state_t *state) {
+    if (!shm || !state || state->axes == 0 || state->axes > SHM_MAX_AXES ||
+        state->sensors > SHM_MAX_SENSORS) {
+        return -1;
+    }
+
+    shm_state_store_t *store = &shm->saved;
+    uint32_t cur = atomic_load_explicit(&store->current, memory_order_relaxed) & 1u;
+    shm_driver_state_t *dst = &store->copy[cur ^ 1u];
+
+    memcpy(dst, state, state_size(state->axes));
+    dst->version = SHM_STATE_VERSION;
+    dst->generation = store->copy[cur].generation + 1;
+    dst->checksum = state_checksum(dst);
+
+    atomic_store_explicit(&store->current, cur ^ 1u, memory_order_release);
+    return 0;
+}
+
+int shm_load_state(shared_mem_t *shm, shm_driver_state_t *out) {
+    if (!shm || !out) return -1;
+
+    shm_state_store_t *store = &shm->saved;
+    uint32_t cur = atomic_load_explicit(&store->current, memory_order_acquire) & 1u;
+
+    for (uint32_t i = 0; i < 2; i++) {
+        const shm_driver_state_t *src = &store->copy[cur ^ i];
+        if (state_valid(src)) {
+            memcpy(out, src, state_size(src->axes));
+            return 0;
+        }
+    }
+
+    return -3;
+}
+
+static bool sub_spec_valid(const shm_sub_spec_t *spec) {
+    switch (spec->type) {
+    case SHM_SUB_STATE:
+        return spec->index < SHM_MAX_AXES && spec->a >= SHM_SUB_ANY;
+    case SHM_SUB_FAULT:
+    case SHM_SUB_POSITION:
+        return spec->index < SHM_MAX_AXES;
+    case SHM_SUB_SENSOR_BAND:
+        return spec->index < SHM_MAX_SENSORS && spec->a <= spec->b;
+    default:
+        return false;
+    }
+}
+
+static bool sub_live(shm_sub_slot_t *slot) {
+    uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+    return state == SHM_SUB_SLOT_ARMED || state == SHM_SUB_SLOT_ACTIVE;
+}
+
+static void sub_kick(shm_sub_slot_t *slot) {
+    atomic_fetch_add_explicit(&slot->events, 1, memory_order_release);
+    if (atomic_load(&slot->waiters) > 0) {
+        futex_wake_all(&slot->events);
+    }
+}
+
+int shm_subscribe(shared_mem_t *shm, const shm_sub_spec_t *spec) {
+    if (!shm || !spec || !sub_spec_valid(spec)) return -1;
+
+    for (uint32_t i = 0; i < SHM_MAX_SUBS; i++) {
+        shm_sub_slot_t *slot = &shm->subs.slots[i];
+        uint32_t expected = SHM_SUB_SLOT_FREE;
+
+        if (!atomic_compare_exchange_strong(&slot->state, &expected, SHM_SUB_SLOT_CLAIMED)) {
+            continue;
+        }
+
+        uint32_t gen = seqlock_write_begin(&slot->gen);
+        slot->owner = (int32_t)getpid();
+        slot->spec = *spec;
+        seqlock_write_end(&slot->gen, gen);
+
+        atomic_store_explicit(&slot->event_seq, 0, memory_order_relaxed);
+        slot->count = 0;
+        slot->value = 0;
+        slot->tick = 0;
+
+        /* The driver primes its edge state on the first tick that sees it */
+        atomic_store_explicit(&slot->state, SHM_SUB_SLOT_ARMED, memory_order_release);
+        atomic_fetch_or(&shm->subs.armed, 1u << i);
+        return (int)i;
+    }
+
+    return -2;
+}
+
+int shm_unsubscribe(shared_mem_t *shm, int id) {
+    if (!shm || id < 0 || id >= SHM_MAX_SUBS) return -1;
+
+    shm_sub_slot_t *slot = &shm->subs.slots[id];
+    uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+    if (state != SHM_SUB_SLOT_ARMED && state != SHM_SUB_SLOT_ACTIVE) return -1;
+    if (slot->owner != (int32_t)getpid()) return -1;  /* Someone else's subscription */
+
+    atomic_fetch_and(&shm->subs.armed, ~(1u << id));
+    if (!atomic_compare_exchange_strong(&slot->state, &state, SHM_SUB_SLOT_DRAINING)) {
+        return -1;  /* Lost a race with another unsubscribe */
+    }
+    atomic_fetch_or(&shm->subs.draining, 1u << id);   /* The driver frees it */
+    sub_kick(slot);
+
+    return 0;
+}
+
+int shm_read_event(shared_mem_t *shm, int id, shm_sub_event_t *ev) {
+    if (!shm || !ev || id < 0 || id >= SHM_MAX_SUBS) return -1;
+
+    shm_sub_slot_t *slot = &shm->subs.slots[id];
+    if (!sub_live(slot)) return -1;
+
+    for (int attempt = 0; attempt < STATUS_READ_RETRIES; attempt++) {
+        uint32_t before;
+        if (!seqlock_read_begin(&slot->event_seq, &before)) break;
+
+        shm_sub_event_t copy = { slot->count, slot->value, slot->tick };
+
+        if (!seqlock_read_retry(&slot->event_seq, before)) {
+            *ev = copy;
+            return 0;
+        }
+    }
+
+    return -2;
+}
+
+int shm_wait_event(shared_mem_t *shm, int id, uint32_t seen, shm_sub_event_t *ev) {
+    if (!shm || !ev || id < 0 || id >= SHM_MAX_SUBS) return -1;
+
+    shm_sub_slot_t *slot = &shm->subs.slots[id];
+
+    for (;;) {
+        /* Snapshot the futex word first so a change after the check wakes us */
+        uint32_t events = atomic_load_explicit(&slot->events, memory_order_acquire);
+
+        int ret = shm_read_event(shm, id, ev);
+        if (ret < 0) return ret;
+        if (ev->count != seen) {
+            return 0;
+        }
+        if (atomic_load(&shm->shutdown_requested)) {
+            return -2;
+        }
+
+        atomic_fetch_add(&slot->waiters, 1);
+        if (atomic_load(&slot->events) == events &&
+            !atomic_load(&shm->shutdown_requested)) {
+            futex_wait(&slot->events, events);
+        }
+        atomic_fetch_sub(&slot->waiters, 1);
+    }
+}
+
+/*
+ * Reduce the watched quantity to what the edge test compares: the state or
+ * fault code itself, or which side of the threshold/band it is on. Returns
+ * false when the axis or sensor is not reported this tick.
+ */
+static bool sub_observe(const shm_sub_spec_t *spec, const shm_axes_status_t *axes,
+                        const int32_t *sensors, uint32_t sensor_count,
+                        int32_t *obs, int32_t *value) {
+    if (spec->type == SHM_SUB_SENSOR_BAND) {
+        if (!sensors || spec->index >= sensor_count) return false;
+        *value = sensors[spec->index];
+        *obs = *value < spec->a || *value > spec->b;
+        return true;
+    }
+
+    if (!axes || spec->index >= axes->axes) return false;
+
+    switch (spec->type) {
+    case SHM_SUB_STATE:
+        *value = (int32_t)axes->state[spec->index];
+        *obs = *value;
+        return true;
+    case SHM_SUB_FAULT:
+        *value = (int32_t)axes->fault_code[spec->index];
+        *obs = *value;
+        return true;
+    case SHM_SUB_POSITION:
+        *value = axes->position[spec->index];
+        *obs = *value >= spec->a;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool sub_fires(const shm_sub_spec_t *spec, int32_t last, int32_t obs) {
+    if (obs == last) return false;
+
+    switch (spec->type) {
+    case SHM_SUB_STATE:
+        return spec->a == SHM_SUB_ANY || obs == spec->a;
+    case SHM_SUB_FAULT:
+        return obs != 0;
+    case SHM_SUB_POSITION:
+        return true;
+    case SHM_SUB_SENSOR_BAND:
+        return obs != 0;
+    default:
+        return false;
+    }
+}
+
+int shm_eval_subscriptions(shared_mem_t *shm, const shm_axes_status_t *axes,
+                           const int32_t *sensors, uint32_t sensor_count, uint64_t tick) {
+    if (!shm) return -1;
+
+    /*
+     * Any pass that could still be using an unsubscribed slot has finished,
+     * since passes never overlap: hand those slots back for reuse.
+     */
+    if (atomic_load_explicit(&shm->subs.draining, memory_order_relaxed)) {
+        uint32_t drained = atomic_exchange(&shm->subs.draining, 0);
+        while (drained) {
+            uint32_t i = (uint32_t)__builtin_ctz(drained);
+            drained &= drained - 1;
+            atomic_store_explicit(&shm->subs.slots[i].state, SHM_SUB_SLOT_FREE,
+                                  memory_order_release);
+        }
+    }
+
+    uint32_t armed = atomic_load_explicit(&shm->subs.armed, memory_order_acquire);
+    int notified = 0;
+
+    while (armed) {
+        uint32_t i = (uint32_t)__builtin_ctz(armed);
+        armed &= armed - 1;
+
+        shm_sub_slot_t *slot = &shm->subs.slots[i];
+        uint32_t gen = atomic_load_explicit(&slot->gen, memory_order_acquire);
+        if (gen & 1) continue;  /* Being resubscribed; pick it up next tick */
+        uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+        if (state != SHM_SUB_SLOT_ARMED && state != SHM_SUB_SLOT_ACTIVE) continue;
+
+        /* Use the spec only if no subscribe overlapped the copy */
+        shm_sub_spec_t spec = slot->spec;
+        if (seqlock_read_retry(&slot->gen, gen)) continue;
+
+        int32_t obs, value;
+        if (!sub_observe(&spec, axes, sensors, sensor_count, &obs, &value)) continue;
+
+        /* A new subscription reports changes from now on, not the current value */
+        if (state == SHM_SUB_SLOT_ARMED) {
+            slot->last = obs;
+            atomic_compare_exchange_strong(&slot->state, &state, SHM_SUB_SLOT_ACTIVE);
+            continue;
+        }
+
+        bool fire = sub_fires(&spec, slot->last, obs);
+        slot->last = obs;
+        if (!fire) continue;
+
+        uint32_t seq = seqlock_write_begin(&slot->event_seq);
+        slot->count++;
+        slot->value = value;
+        slot->tick = tick;
+        seqlock_write_end(&slot->event_seq, seq);
+        sub_kick(slot);
+        notified++;
+    }
+
+    return notified;
+}
+
+
 bool shm_is_shutdown_requested(shared_mem_t *shm) {
     if (!shm) return true;
 
-    pthread_mutex_lock(&shm->mutex);
-    bool shutdown = shm->shutdown_requested;
-    pthread_mutex_unlock(&shm->mutex);
-
-    return shutdown;
+    return atomic_load(&shm->shutdown_requested);
 }
 
 void shm_request_shutdown(shared_mem_t *shm) {
     if (!shm) return;
 
-    pthread_mutex_lock(&shm->mutex);
-    shm->shutdown_requested = true;
-    pthread_cond_broadcast(&shm->cmd_ready);
-    pthread_cond_broadcast(&shm->resp_ready);
-    pthread_mutex_unlock(&shm->mutex);
+    atomic_store(&shm->shutdown_requested, true);
+    cmd_wake(shm);
+
+    /* Kick any client asleep on a completion slot */
+    for (uint32_t i = 0; i < SHM_CMD_RING_DEPTH; i++) {
+        if (atomic_load(&shm->resp_slots[i].waiters) > 0) {
+            futex_wake_all(&shm->resp_slots[i].done_seq);
+        }
+    }
+    for (uint32_t i = 0; i < SHM_MAX_SUBS; i++) {
+        sub_kick(&shm->subs.slots[i]);
+    }
 }
@@ -0,0 +1,29 @@
+#include "sim_clock.h"
+
+_Atomic uint64_t sim_clock_virtual_ns = 0;
+
+int sim_clock_start(uint64_t start_ns) {
+    if (start_ns == 0) return -1;
+
+    uint64_t expected = 0;
+    if (!atomic_compare_exchange_strong(&sim_clock_virtual_ns, &expected, start_ns)) {
+        return -2;
+    }
+
+    return 0;
+}
+
+int sim_clock_advance(uint64_t ns) {
+    if (atomic_load(&sim_clock_virtual_ns) == 0) return -1;
+
+    atomic_fetch_add(&sim_clock_virtual_ns, ns);
+    return 0;
+}
+
+void sim_clock_stop(void) {
+    atomic_store(&sim_clock_virtual_ns, 0);
+}
+
+bool sim_clock_is_virtual(void) {
+    return atomic_load(&sim_clock_virtual_ns) != 0;
+}
@@ -0,0 +1,303 @@
+#include "simulator.h"
+#include "sim_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_SCRIPT_MIN_CAPACITY     64
+
+/* FNV-1a, 64-bit */
+#define FNV_OFFSET                  0xcbf29ce484222325ULL
+#define FNV_PRIME                   0x100000001b3ULL
+
+static uint64_t fnv_word(uint64_t hash, uint32_t word) {
+    for (int i = 0; i < 4; i++) {
+        hash ^= (word >> (i * 8)) & 0xffu;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+void sim_script_init(sim_script_t *s) {
+    if (!s) return;
+    memset(s, 0, sizeof(*s));
+}
+
+void sim_script_free(sim_script_t *s) {
+    if (!s) return;
+    free(s->inputs);
+    memset(s, 0, sizeof(*s));
+}
+
+int sim_script_add(sim_script_t *s, const sim_input_t *in) {
+    if (!s || !in) return -1;
+    if (s->count > 0 && in->tick < s->inputs[s->count - 1].tick) return -1;
+
+    if (s->count == s->capacity) {
+        uint32_t capacity = s->capacity ? s->capacity * 2 : SIM_SCRIPT_MIN_CAPACITY;
+        sim_input_t *grown = realloc(s->inputs, (size_t)capacity * sizeof(*grown));
+        if (!grown) return -3;
+        s->inputs = grown;
+        s->capacity = capacity;
+    }
+
+    s->inputs[s->count++] = *in;
+    return 0;
+}
+
+int sim_script_save(const sim_script_t *s, const char *path) {
+    if (!s || !path) return -1;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -3;
+
+    sim_script_header_t hdr = { SIM_MAGIC, SIM_VERSION, sizeof(sim_input_t), s->count };
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+             (s->count == 0 || fwrite(s->inputs, sizeof(sim_input_t), s->count, f) == s->count);
+
+    if (fclose(f) != 0) ok = 0;
+    return ok ? 0 : -3;
+}
+
+int sim_script_load(sim_script_t *s, const char *path) {
+    if (!s || !path) return -1;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return -3;
+
+    sim_script_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != SIM_MAGIC ||
+        hdr.version != SIM_VERSION || hdr.input_size != sizeof(sim_input_t)) {
+        fclose(f);
+        return -3;
+    }
+
+    sim_script_free(s);
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        sim_input_t in;
+        if (fread(&in, sizeof(in), 1, f) != 1 || sim_script_add(s, &in) < 0) {
+            fclose(f);
+            sim_script_free(s);
+            return -3;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+int sim_script_from_trace(sim_script_t *s, const trace_t *t) {
+    if (!s || !t || !t->hdr) return -1;
+
+    uint64_t head = trace_head(t);
+    uint64_t first = trace_first(t);
+    uint32_t base = 0;
+    uint32_t tick = 0;
+    bool ticked = false;
+
+    for (uint64_t i = first; i < head; i++) {
+        trace_record_t r;
+        if (trace_read(t, i, &r) < 0) continue;
+
+        if (r.type == TRACE_TICK) {
+            if (!ticked) base = r.a;
+            ticked = true;
+            tick = r.a + 1 - base;
+        } else if (r.type == TRACE_COMMAND) {
+            sim_input_t in = { tick, SIM_INPUT_COMMAND, r.id, r.a, r.b, r.c, 0 };
+            int ret = sim_script_add(s, &in);
+            if (ret < 0) return ret;
+        }
+    }
+
+    return 0;
+}
+
+int sim_init(sim_t *sim, uint32_t axes, uint32_t period_us) {
+    if (!sim) return -1;
+
+    int ret = sim_clock_start(SIM_START_NS);
+    if (ret < 0) return ret;
+
+    memset(sim, 0, sizeof(*sim));
+    shared_mem_t *shm = shm_create_private();
+    if (!shm) {
+        sim_clock_stop();
+        return -3;
+    }
+
+    ret = driver_init(&sim->drv, axes, period_us, "sim", shm);
+    if (ret < 0) {
+        shm_destroy(shm);
+        sim_clock_stop();
+        return ret;
+    }
+
+    sim->digest = FNV_OFFSET;
+    return 0;
+}
+
+void sim_cleanup(sim_t *sim) {
+    if (!sim || !sim->drv.shm) return;
+
+    shared_mem_t *shm = sim->drv.shm;
+    driver_cleanup(&sim->drv);
+    shm_destroy(shm);
+    sim->drv.shm = NULL;
+    sim_clock_stop();
+}
+
+int sim_play(sim_t *sim, const sim_script_t *script) {
+    if (!sim) return -1;
+
+    sim->script = script;
+    sim->next = 0;
+    return 0;
+}
+
+int sim_record(sim_t *sim, sim_script_t *record) {
+    if (!sim) return -1;
+
+    sim->record = record;
+    return 0;
+}
+
+/* Apply in as it stands; the stamp is left to the caller */
+static int apply_input(sim_t *sim, const sim_input_t *in) {
+    driver_t *drv = &sim->drv;
+
+    switch (in->type) {
+        case SIM_INPUT_SENSOR:
+            if (in->id >= sensor_array_count(&drv->sensors)) return -1;
+            sensor_set_simulated_value(&drv->sensors, (uint8_t)in->id, (int32_t)in->a);
+            return 0;
+
+        case SIM_INPUT_COMMAND: {
+            shm_command_t cmd = {
+                .cmd = (command_type_t)in->id,
+                .axis = in->axis,
+                .param1 = in->a,
+                .param2 = in->b,
+                .flags = SHM_CMD_NO_REPLY,
+            };
+            int32_t resp_data[SHM_RESP_WORDS] = {0};
+            return (int)driver_execute(drv, &cmd, resp_data);
+        }
+
+        case SIM_INPUT_IRQ:
+            if (in->id >= INT_COUNT) return -1;
+            irq_trigger(&drv->irq, (interrupt_source_t)in->id);
+            return 0;
+
+        case SIM_INPUT_FAULT:
+            return motor_bank_inject_fault(&drv->motors, in->axis, (motor_fault_t)in->id);
+
+        default:
+            return -1;
+    }
+}
+
+int sim_input(sim_t *sim, const sim_input_t *in) {
+    if (!sim || !in || !sim->drv.shm) return -1;
+
+    int ret = apply_input(sim, in);
+    if (ret < 0) return ret;
+
+    sim->inputs++;
+    if (sim->record) {
+        sim_input_t stamped = *in;
+        stamped.tick = (uint32_t)sim->drv.tick;
+        sim_script_add(sim->record, &stamped);
+    }
+
+    return ret;
+}
+
+/* Fold the state every tick leaves behind into the digest */
+static void digest_tick(sim_t *sim) {
+    driver_t *drv = &sim->drv;
+    motor_bank_t *bank = &drv->motors;
+    uint64_t hash = fnv_word(sim->digest, (uint32_t)drv->tick);
+
+    for (uint32_t i = 0; i < bank->axes; i++) {
+        hash = fnv_word(hash, (uint32_t)bank->state[i]);
+        hash = fnv_word(hash, bank->current_speed[i]);
+        hash = fnv_word(hash, (uint32_t)bank->position[i]);
+        hash = fnv_word(hash, (uint32_t)bank->fault_code[i]);
+        hash = fnv_word(hash, reg_read(&drv->regs[i], REG_MOTOR_CTRL));
+    }
+
+    int32_t values[SENSOR_MAX];
+    int sensors = sensor_read_all(&drv->sensors, values, SENSOR_MAX);
+    for (int i = 0; i < sensors; i++) {
+        hash = fnv_word(hash, (uint32_t)values[i]);
+    }
+    hash = fnv_word(hash, (uint32_t)atomic_load(&drv->trip.trips));
+
+    sim->digest = hash;
+}
+
+int sim_run(sim_t *sim, uint32_t ticks) {
+    if (!sim || !sim->drv.shm) return -1;
+
+    driver_t *drv = &sim->drv;
+    const sim_script_t *script = sim->script;
+
+    for (uint32_t n = 0; n < ticks; n++) {
+        /* A script input that is invalid here is skipped, as a live driver would */
+        while (script && sim->next < script->count &&
+               script->inputs[sim->next].tick <= drv->tick) {
+            sim_input(sim, &script->inputs[sim->next++]);
+        }
+
+        sim_plant_step(drv);
+        driver_tick(drv);
+        digest_tick(sim);
+        sim_clock_advance((uint64_t)drv->period_us * 1000);
+    }
+
+    return (int)ticks;
+}
+
+void sim_plant_step(driver_t *drv) {
+    if (!drv || !drv->motors.pid[0].enabled) return;
+    if (reg_backend(&drv->regs[0]) != REG_BACKEND_SIM) return;
+
+    int32_t velocity = sensor_read(&drv->sensors, DRIVER_VELOCITY_SENSOR);
+    int32_t drive = (int32_t)reg_read(&drv->regs[0], REG_MOTOR_SPEED);
+    sensor_set_simulated_value(&drv->sensors, DRIVER_VELOCITY_SENSOR,
+                               velocity + (drive - velocity) / 8);
+}
+
+int sim_restart(sim_t *sim) {
+    if (!sim || !sim->drv.shm) return -1;
+
+    shared_mem_t *shm = sim->drv.shm;
+    shm_driver_state_t state;
+    int ret = shm_load_state(shm, &state);
+    if (ret < 0) return ret;
+
+    driver_cleanup(&sim->drv);
+    ret = driver_init(&sim->drv, state.axes, state.period_us, "sim", shm);
+    if (ret < 0) {
+        shm_destroy(shm);
+        sim->drv.shm = NULL;
+        sim_clock_stop();
+        return ret;
+    }
+
+    return driver_restore_state(&sim->drv, &state);
+}
+
+unsigned long sim_ticks(const sim_t *sim) {
+    return sim ? sim->drv.tick : 0;
+}
+
+uint64_t sim_now_ns(const sim_t *sim) {
+    (void)sim;
+    return sim_clock_now_ns();
+}
+
+uint64_t sim_digest(const sim_t *sim) {
+    return sim ? sim->digest : 0;
+}
@@ -0,0 +1,148 @@
+#include "trace.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t ring_bytes(uint32_t capacity) {
+    return sizeof(trace_header_t) + (size_t)capacity * sizeof(trace_record_t);
+}
+
+static void attach(trace_t *t, void *map, size_t len, bool writable) {
+    t->hdr = (trace_header_t*)map;
+    t->records = (trace_record_t*)((uint8_t*)map + sizeof(trace_header_t));
+    t->mask = (uint64_t)t->hdr->capacity - 1;
+    t->map_len = len;
+    t->writable = writable;
+}
+
+int trace_open(trace_t *t, const char *path, uint32_t capacity) {
+    if (!t) return -1;
+    if (capacity == 0) capacity = TRACE_DEFAULT_RECORDS;
+    if ((capacity & (capacity - 1)) != 0) return -1;
+
+    size_t len = ring_bytes(capacity);
+    void *map;
+
+    if (path) {
+        int fd = open(path, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return -3;
+        if (ftruncate(fd, (off_t)len) < 0) {
+            close(fd);
+            return -3;
+        }
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (map == MAP_FAILED) return -3;
+
+    /* The file starts zeroed: every record reads as never written */
+    trace_header_t *hdr = (trace_header_t*)map;
+    hdr->magic = TRACE_MAGIC;
+    hdr->version = TRACE_VERSION;
+    hdr->record_size = sizeof(trace_record_t);
+    hdr->capacity = capacity;
+    atomic_init(&hdr->head, 0);
+
+    attach(t, map, len, true);
+    return 0;
+}
+
+int trace_open_file(trace_t *t, const char *path) {
+    if (!t || !path) return -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -3;
+
+    struct stat st;
+    trace_header_t hdr;
+    if (fstat(fd, &st) < 0 || read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION ||
+        hdr.record_size != sizeof(trace_record_t) || hdr.capacity == 0 ||
+        (hdr.capacity & (hdr.capacity - 1)) != 0 ||
+        (size_t)st.st_size < ring_bytes(hdr.capacity)) {
+        close(fd);
+        return -3;
+    }
+
+    size_t len = ring_bytes(hdr.capacity);
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -3;
+
+    attach(t, map, len, false);
+    return 0;
+}
+
+void trace_close(trace_t *t) {
+    if (!t || !t->hdr) return;
+
+    munmap(t->hdr, t->map_len);
+    memset(t, 0, sizeof(*t));
+}
+
+uint64_t trace_head(const trace_t *t) {
+    if (!t || !t->hdr) return 0;
+
+    return atomic_load_explicit(&t->hdr->head, memory_order_acquire);
+}
+
+uint64_t trace_first(const trace_t *t) {
+    uint64_t head = trace_head(t);
+    uint64_t capacity = t && t->hdr ? t->mask + 1 : 0;
+
+    return head > capacity ? head - capacity : 0;
+}
+
+int trace_read(const trace_t *t, uint64_t index, trace_record_t *out) {
+    if (!t || !t->hdr || !out) return -1;
+
+    const trace_record_t *r = &t->records[index & t->mask];
+    uint32_t want = (uint32_t)(index + 1);
+
+    if (atomic_load_explicit(&r->seq, memory_order_acquire) != want) {
+        return -2;
+    }
+
+    out->time_ns = r->time_ns;
+    out->type = r->type;
+    out->id = r->id;
+    out->a = r->a;
+    out->b = r->b;
+    out->c = r->c;
+    out->d = r->d;
+
+    /* A writer lapping this slot mid-copy zeroes seq first */
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&r->seq, memory_order_relaxed) != want) {
+        return -2;
+    }
+
+    atomic_init(&out->seq, want);
+    return 0;
+}
+
+int trace_dump(const trace_t *t, const char *path) {
+    if (!t || !t->hdr || !path) return -1;
+
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -3;
+
+    /* Records written during the copy fail their seq check when decoded */
+    const uint8_t *src = (const uint8_t*)t->hdr;
+    size_t done = 0;
+    while (done < t->map_len) {
+        ssize_t n = write(fd, src + done, t->map_len - done);
+        if (n <= 0) {
+            close(fd);
+            return -3;
+        }
+        done += (size_t)n;
+    }
+
+    close(fd);
+    return 0;
+}
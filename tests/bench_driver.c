@@ -0,0 +1,428 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "device_registers.h"
+#include "motor_controller.h"
+#include "motor_bank.h"
+#include "sensor_array.h"
+#include "interrupt_handler.h"
+#include "shared_mem.h"
+#include "sample_stream.h"
+#include "event_loop.h"
+#include "latency_hist.h"
+#include "trace.h"
+
+/*
+ * Microbenchmarks for the driver hot paths. Each benchmark runs its
+ * operation in batches; batch time / batch size feeds a latency histogram
+ * for p50/p99, and the totals give ns/op and ops/s. Results are JSON.
+ */
+
+#define DEFAULT_ITERATIONS  1000000
+#define BATCH_SIZE          64
+
+/* Benchmark body: perform `count` operations */
+typedef void (*bench_fn_t)(void *ctx, uint32_t count);
+
+typedef struct {
+    const char *name;
+    uint64_t ops;
+    uint64_t total_ns;
+    uint32_t p50_ns;
+    uint32_t p99_ns;
+    uint32_t max_ns;
+} bench_result_t;
+
+static volatile uint32_t g_sink;
+
+static void run_bench(const char *name, bench_fn_t fn, void *ctx,
+                      uint64_t iterations, uint32_t batch, bench_result_t *out) {
+    lat_hist_t hist;
+    lat_hist_reset(&hist);
+
+    /* Warm caches and branch predictors */
+    fn(ctx, batch);
+
+    uint64_t done = 0;
+    uint64_t total = 0;
+    while (done < iterations) {
+        uint64_t start = event_loop_now_ns();
+        fn(ctx, batch);
+        uint64_t elapsed = event_loop_now_ns() - start;
+
+        lat_hist_record(&hist, elapsed / batch);
+        total += elapsed;
+        done += batch;
+    }
+
+    out->name = name;
+    out->ops = done;
+    out->total_ns = total;
+    out->p50_ns = lat_hist_percentile(&hist, 5000);
+    out->p99_ns = lat_hist_percentile(&hist, 9900);
+    out->max_ns = hist.max_ns;
+}
+
+/*============================================================================
+ * REGISTER BENCHMARKS
+ *===========================================================================*/
+
+static void bench_reg_read(void *ctx, uint32_t count) {
+    register_file_t *rf = (register_file_t*)ctx;
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        acc += reg_read(rf, REG_MOTOR_STATUS);
+    }
+    g_sink = acc;
+}
+
+static void bench_reg_write(void *ctx, uint32_t count) {
+    register_file_t *rf = (register_file_t*)ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        reg_write(rf, REG_MOTOR_SPEED, i);
+    }
+}
+
+/*============================================================================
+ * TRACE BENCHMARKS
+ *===========================================================================*/
+
+static void bench_trace_emit(void *ctx, uint32_t count) {
+    trace_t *t = (trace_t*)ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        trace_emit(t, TRACE_COMMAND, 1, i, 2, 3, 4);
+    }
+}
+
+/*============================================================================
+ * SENSOR BUFFER BENCHMARKS
+ *===========================================================================*/
+
+static void bench_sensor_push_pop(void *ctx, uint32_t count) {
+    sensor_array_t *sa = (sensor_array_t*)ctx;
+    int32_t value;
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sensor_buffer_push(sa, (int32_t)i);
+        sensor_buffer_pop(sa, &value);
+        acc += (uint32_t)value;
+    }
+    g_sink = acc;
+}
+
+/* One op is one sample moved through push_bulk/pop_bulk */
+static void bench_sensor_bulk(void *ctx, uint32_t count) {
+    sensor_array_t *sa = (sensor_array_t*)ctx;
+    int32_t in[BATCH_SIZE];
+    int32_t out[BATCH_SIZE];
+
+    for (uint32_t i = 0; i < BATCH_SIZE; i++) in[i] = (int32_t)i;
+    while (count > 0) {
+        uint32_t n = count < BATCH_SIZE ? count : BATCH_SIZE;
+        sensor_buffer_push_bulk(sa, in, n);
+        sensor_buffer_pop_bulk(sa, out, n);
+        count -= n;
+    }
+    g_sink = (uint32_t)out[0];
+}
+
+/*============================================================================
+ * IRQ BENCHMARKS
+ *===========================================================================*/
+
+static void bench_irq_handler(interrupt_source_t source, void *context) {
+    (void)source;
+    (*(uint32_t*)context)++;
+}
+
+static void bench_irq_dispatch(void *ctx, uint32_t count) {
+    interrupt_controller_t *ic = (interrupt_controller_t*)ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        irq_trigger(ic, INT_SENSOR_READY);
+        irq_process_pending(ic);
+    }
+}
+
+/*============================================================================
+ * MOTOR BENCHMARKS
+ *===========================================================================*/
+
+static void bench_motor_update(void *ctx, uint32_t count) {
+    motor_controller_t *mc = (motor_controller_t*)ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        motor_update(mc);
+    }
+}
+
+/* One op is a full MOTOR_BANK_MAX_AXES-axis update */
+static void bench_motor_bank(void *ctx, uint32_t count) {
+    motor_bank_t *bank = (motor_bank_t*)ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        motor_bank_update(bank);
+    }
+}
+
+/*============================================================================
+ * SHARED MEMORY BENCHMARKS
+ *===========================================================================*/
+
+static void bench_shm_ring(void *ctx, uint32_t count) {
+    shared_mem_t *shm = (shared_mem_t*)ctx;
+    shm_command_t cmd;
+    for (uint32_t i = 0; i < count; i++) {
+        shm_send_command(shm, CMD_GET_STATUS, i, 0);
+        shm_poll_command(shm, &cmd);
+    }
+}
+
+static void bench_shm_status_read(void *ctx, uint32_t count) {
+    shared_mem_t *shm = (shared_mem_t*)ctx;
+    shm_status_t st;
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        shm_read_status(shm, &st);
+        acc += st.motor_speed;
+    }
+    g_sink = acc;
+}
+
+/* One op is one sample published and read back by one reader */
+static void bench_stream(void *ctx, uint32_t count) {
+    sample_stream_reader_t *reader = (sample_stream_reader_t*)ctx;
+    sensor_sample_t in[BATCH_SIZE];
+    sensor_sample_t out[BATCH_SIZE];
+
+    memset(in, 0, sizeof(in));
+    while (count > 0) {
+        uint32_t n = count < BATCH_SIZE ? count : BATCH_SIZE;
+        sample_stream_publish(reader->stream, in, n);
+        sample_stream_read(reader, out, n);
+        count -= n;
+    }
+    g_sink = (uint32_t)out[0].value;
+}
+
+/* Echo server: answers every command until shutdown */
+static void serve_commands(shared_mem_t *shm) {
+    command_type_t cmd;
+    uint32_t p1, p2;
+    while (shm_get_command(shm, &cmd, &p1, &p2) == 0) {
+        int32_t data[1] = {(int32_t)p1};
+        shm_send_response(shm, RESP_OK, data, 1);
+    }
+}
+
+static void *server_thread(void *arg) {
+    serve_commands((shared_mem_t*)arg);
+    return NULL;
+}
+
+static void bench_shm_round_trip(void *ctx, uint32_t count) {
+    shared_mem_t *shm = (shared_mem_t*)ctx;
+    int32_t data[1];
+    for (uint32_t i = 0; i < count; i++) {
+        shm_send_command(shm, CMD_GET_STATUS, i, 0);
+        shm_wait_response(shm, NULL, data, 1);
+    }
+}
+
+/*
+ * Fresh segment per benchmark so one run cannot skew the next. Private, so
+ * a driver running on the same box keeps its own; a forked child still
+ * shares it.
+ */
+static shared_mem_t *fresh_shm(void) {
+    return shm_create_private();
+}
+
+/*============================================================================
+ * RUNNER
+ *===========================================================================*/
+
+static void print_json(FILE *out, bench_result_t *results, int count) {
+    fprintf(out, "{\n  \"benchmarks\": [\n");
+    for (int i = 0; i < count; i++) {
+        bench_result_t *r = &results[i];
+        double ns_per_op = r->ops ? (double)r->total_ns / (double)r->ops : 0.0;
+        double ops_per_sec = r->total_ns ? (double)r->ops * 1e9 / (double)r->total_ns : 0.0;
+
+        fprintf(out, "    {\"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.2f, "
+                "\"ops_per_sec\": %.0f, \"p50_ns\": %u, \"p99_ns\": %u, \"max_ns\": %u}%s\n",
+                r->name, (unsigned long long)r->ops, ns_per_op, ops_per_sec,
+                r->p50_ns, r->p99_ns, r->max_ns, (i + 1 < count) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static bool selected(const char *filter, const char *name) {
+    return !filter || strstr(name, filter) != NULL;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-n iterations] [-f filter] [-o output.json]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t iterations = DEFAULT_ITERATIONS;
+    const char *filter = NULL;
+    const char *output = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:o:h")) != -1) {
+        switch (opt) {
+            case 'n': iterations = strtoull(optarg, NULL, 10); break;
+            case 'f': filter = optarg; break;
+            case 'o': output = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (iterations < BATCH_SIZE) iterations = BATCH_SIZE;
+
+    /* Round trips are ~1000x slower than in-process ops */
+    uint64_t rt_iterations = iterations / 100 ? iterations / 100 : 1;
+
+    bench_result_t results[16];
+    int n = 0;
+
+    register_file_t rf;
+    reg_init(&rf);
+    if (selected(filter, "reg_read")) {
+        run_bench("reg_read", bench_reg_read, &rf, iterations, BATCH_SIZE, &results[n++]);
+    }
+    if (selected(filter, "reg_write")) {
+        run_bench("reg_write", bench_reg_write, &rf, iterations, BATCH_SIZE, &results[n++]);
+    }
+
+    trace_t trace;
+    if (trace_open(&trace, NULL, 0) == 0) {
+        if (selected(filter, "trace_emit")) {
+            run_bench("trace_emit", bench_trace_emit, &trace, iterations, BATCH_SIZE,
+                      &results[n++]);
+        }
+        if (selected(filter, "reg_write_traced")) {
+            reg_set_trace(&rf, &trace, 0);
+            run_bench("reg_write_traced", bench_reg_write, &rf, iterations, BATCH_SIZE,
+                      &results[n++]);
+            reg_set_trace(&rf, NULL, 0);
+        }
+        trace_close(&trace);
+    }
+
+    sensor_array_t sa;
+    sensor_array_init(&sa, &rf);
+    if (selected(filter, "sensor_push_pop")) {
+        run_bench("sensor_push_pop", bench_sensor_push_pop, &sa, iterations,
+                  BATCH_SIZE, &results[n++]);
+    }
+    if (selected(filter, "sensor_bulk")) {
+        run_bench("sensor_bulk", bench_sensor_bulk, &sa, iterations,
+                  BATCH_SIZE, &results[n++]);
+    }
+
+    if (selected(filter, "motor_update")) {
+        motor_controller_t mc;
+        motor_init(&mc, &rf);
+        motor_start(&mc, 5000, MOTOR_DIR_CW);
+        run_bench("motor_update", bench_motor_update, &mc, iterations,
+                  BATCH_SIZE, &results[n++]);
+    }
+
+    if (selected(filter, "motor_bank_update")) {
+        static register_file_t bank_regs[MOTOR_BANK_MAX_AXES];
+        static motor_bank_t bank;
+        for (uint32_t i = 0; i < MOTOR_BANK_MAX_AXES; i++) reg_init(&bank_regs[i]);
+        motor_bank_init(&bank, bank_regs, MOTOR_BANK_MAX_AXES);
+        for (uint32_t i = 0; i < MOTOR_BANK_MAX_AXES; i++) {
+            motor_bank_start(&bank, i, 5000 + i * 50, (motor_direction_t)(i & 1));
+        }
+        run_bench("motor_bank_update", bench_motor_bank, &bank, iterations / MOTOR_BANK_MAX_AXES,
+                  BATCH_SIZE / 8, &results[n++]);
+    }
+
+    if (selected(filter, "irq_dispatch")) {
+        motor_controller_t mc;
+        interrupt_controller_t ic;
+        uint32_t hits = 0;
+        motor_init(&mc, &rf);
+        irq_init(&ic, &rf, &mc, &sa);
+        irq_register_handler(&ic, INT_SENSOR_READY, bench_irq_handler, &hits);
+        irq_enable(&ic, INT_SENSOR_READY);
+        run_bench("irq_dispatch", bench_irq_dispatch, &ic, iterations,
+                  BATCH_SIZE, &results[n++]);
+        irq_cleanup(&ic);
+    }
+
+    if (selected(filter, "shm_ring")) {
+        shared_mem_t *shm = fresh_shm();
+        if (shm) {
+            run_bench("shm_ring", bench_shm_ring, shm, iterations, BATCH_SIZE, &results[n++]);
+            shm_destroy(shm);
+        }
+    }
+
+    if (selected(filter, "shm_status_read")) {
+        shared_mem_t *shm = fresh_shm();
+        if (shm) {
+            run_bench("shm_status_read", bench_shm_status_read, shm, iterations,
+                      BATCH_SIZE, &results[n++]);
+            shm_destroy(shm);
+        }
+    }
+
+    if (selected(filter, "stream_publish_read")) {
+        sample_stream_t *stream = sample_stream_create_private();
+        sample_stream_reader_t reader;
+        if (stream && sample_stream_attach(stream, &reader) == 0) {
+            run_bench("stream_publish_read", bench_stream, &reader, iterations,
+                      BATCH_SIZE, &results[n++]);
+            sample_stream_detach(&reader);
+        }
+        sample_stream_destroy(stream);
+    }
+
+    if (selected(filter, "shm_round_trip_thread")) {
+        shared_mem_t *shm = fresh_shm();
+        pthread_t server;
+        if (shm && pthread_create(&server, NULL, server_thread, shm) == 0) {
+            run_bench("shm_round_trip_thread", bench_shm_round_trip, shm, rt_iterations,
+                      1, &results[n++]);
+            shm_request_shutdown(shm);
+            pthread_join(server, NULL);
+            shm_destroy(shm);
+        }
+    }
+
+    if (selected(filter, "shm_ping_pong_process")) {
+        shared_mem_t *shm = fresh_shm();
+        pid_t child = shm ? fork() : -1;
+        if (child == 0) {
+            serve_commands(shm);    /* The inherited mapping, shared with the parent */
+            _exit(0);
+        } else if (child > 0) {
+            run_bench("shm_ping_pong_process", bench_shm_round_trip, shm, rt_iterations,
+                      1, &results[n++]);
+            shm_request_shutdown(shm);
+            waitpid(child, NULL, 0);
+            shm_destroy(shm);
+        }
+    }
+
+    FILE *out = stdout;
+    if (output) {
+        out = fopen(output, "w");
+        if (!out) {
+            perror(output);
+            return 1;
+        }
+    }
+    print_json(out, results, n);
+    if (out != stdout) fclose(out);
+
+    return 0;
+}
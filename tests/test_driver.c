@@ -1,13 +1,36 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* cpu_set_t for the RT thread tests */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "device_registers.h"
 #include "motor_controller.h"
+#include "motor_bank.h"
+#include "motion_profile.h"
 #include "sensor_array.h"
 #include "interrupt_handler.h"
+#include "fault_trip.h"
 #include "shared_mem.h"
+#include "sample_stream.h"
+#include "event_loop.h"
+#include "latency_hist.h"
+#include "log_queue.h"
+#include "rt_thread.h"
+#include "trace.h"
+#include "sim_clock.h"
+#include "simulator.h"
 
 /* Test framework macros */
 #define TEST_PASS 0
@@ -39,6 +62,9 @@
 static int tests_run = 0;
 static int tests_passed = 0;
 
+/* Shared memory segment used by multi-threaded client tests */
+static shared_mem_t *g_test_shm = NULL;
+
 /* IRQ callback counter for testing */
 static int irq_callback_count = 0;
 static void test_irq_callback(interrupt_source_t source, void *context) {
@@ -48,7 +74,7 @@ static void test_irq_callback(interrupt_source_t source, void *context) {
 }
 
 /*============================================================================
- * REGISTER TESTS (4 tests)
+ * REGISTER TESTS (6 tests)
  *===========================================================================*/
 
 int test_reg_init(void) {
@@ -94,17 +120,111 @@ int test_reg_invalid_offset(void) {
     register_file_t rf;
     reg_init(&rf);
 
+    /* Constant offsets are checked at compile time; run-time ones here */
+    uint32_t offset = 0xFF00;
+
     /* Reading invalid offset should return 0xFFFFFFFF */
-    ASSERT_EQ(reg_read(&rf, 0xFF00), 0xFFFFFFFF);
+    ASSERT_EQ(reg_read_checked(&rf, offset), 0xFFFFFFFF);
+    ASSERT_EQ(reg_read_checked(NULL, REG_MOTOR_CTRL), 0xFFFFFFFF);
+    ASSERT_EQ(reg_read_checked(&rf, REG_MOTOR_CTRL + 1), 0xFFFFFFFF);
 
     /* Writing to invalid offset should not crash */
-    reg_write(&rf, 0xFF00, 0x12345678);
+    reg_write_checked(&rf, offset, 0x12345678);
+    reg_set_bits_checked(NULL, REG_MOTOR_CTRL, 1);
+
+    /* Run-time offsets use the same registers as the constant forms */
+    reg_write_at(&rf, REG_SENSOR_DATA, 42);
+    ASSERT_EQ(reg_read(&rf, REG_SENSOR_DATA), 42);
+
+    return TEST_PASS;
+}
+
+int test_reg_shm_backend(void) {
+    static const char *name = "/motor_driver_test_regs";
+    register_file_t driver;
+    register_file_t sim;
+
+    /* The simulator creates the window; the driver maps the same one */
+    shm_unlink(name);
+    reg_init(&sim);
+    ASSERT_EQ(reg_init_shm(&driver, name, false), -3);
+    ASSERT_EQ(reg_init_shm(&sim, name, true), 0);
+    ASSERT_EQ(reg_init_shm(&driver, name, false), 0);
+    ASSERT_EQ(reg_backend(&driver), REG_BACKEND_SHM);
+    ASSERT_EQ(reg_read(&driver, REG_MOTOR_STATUS), 0);
+
+    reg_write(&driver, REG_MOTOR_SPEED, 4200);
+    reg_set_bits(&sim, REG_MOTOR_STATUS, MOTOR_STATUS_STALL);
+    ASSERT_EQ(reg_read(&sim, REG_MOTOR_SPEED), 4200);
+    ASSERT_EQ(reg_read(&driver, REG_MOTOR_STATUS), MOTOR_STATUS_STALL);
+
+    /* A motor on the shared window sees the latched fault */
+    motor_controller_t mc;
+    motor_init(&mc, &driver);
+    motor_start(&mc, 1000, MOTOR_DIR_CW);
+    reg_set_bits(&sim, REG_MOTOR_STATUS, MOTOR_STATUS_OVERHEAT);
+    motor_update(&mc);
+    ASSERT_EQ(motor_get_state(&mc), MOTOR_STATE_FAULT);
+    ASSERT_EQ(reg_read(&sim, REG_MOTOR_CTRL), MOTOR_CTRL_ENABLE | MOTOR_CTRL_DIR_CW);
+
+    reg_cleanup(&driver);
+    ASSERT_EQ(reg_backend(&driver), REG_BACKEND_SIM);
+    ASSERT_EQ(reg_read(&driver, REG_MOTOR_CTRL), 0);
+    reg_cleanup(&sim);
+
+    /* Creating over a leftover object starts from a zeroed window */
+    ASSERT_EQ(reg_init_shm(&sim, name, true), 0);
+    ASSERT_EQ(reg_read(&sim, REG_MOTOR_SPEED), 0);
+    ASSERT_EQ(reg_read(&sim, REG_MOTOR_STATUS), 0);
+    reg_cleanup(&sim);
+    shm_unlink(name);
+
+    /* An object too short for the window is refused, not mapped */
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQ(ftruncate(fd, 16), 0);
+    close(fd);
+    ASSERT_EQ(reg_init_shm(&driver, name, false), -3);
+    ASSERT_EQ(reg_backend(&driver), REG_BACKEND_SIM);
+    shm_unlink(name);
+
+    return TEST_PASS;
+}
+
+int test_reg_mmio_backend(void) {
+    /* A plain file stands in for /dev/mem; the block sits past the first page */
+    char path[] = "/tmp/motor_driver_mmioXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t phys = (uint64_t)page + 0x100;
+    ASSERT_EQ(ftruncate(fd, 2 * page), 0);
+
+    register_file_t rf;
+    reg_init(&rf);
+    ASSERT_EQ(reg_init_mmio(&rf, path, phys + 2), -1);
+    ASSERT_EQ(reg_init_mmio(&rf, "/nonexistent/mem", phys), -3);
+    ASSERT_EQ(reg_init_mmio(&rf, path, phys), 0);
+    ASSERT_EQ(reg_backend(&rf), REG_BACKEND_MMIO);
+
+    reg_write(&rf, REG_MOTOR_POSITION, 0xCAFEF00D);
+    uint32_t word = 0;
+    ASSERT_EQ(pread(fd, &word, sizeof(word), (off_t)(phys + REG_MOTOR_POSITION)), sizeof(word));
+    ASSERT_EQ(word, 0xCAFEF00D);
+
+    word = IRQ_MOTOR_STALL;
+    ASSERT_EQ(pwrite(fd, &word, sizeof(word), (off_t)(phys + REG_IRQ_STATUS)), sizeof(word));
+    ASSERT_EQ(reg_read(&rf, REG_IRQ_STATUS), IRQ_MOTOR_STALL);
+
+    reg_cleanup(&rf);
+    close(fd);
+    unlink(path);
 
     return TEST_PASS;
 }
 
 /*============================================================================
- * MOTOR CONTROLLER TESTS (12 tests)
+ * MOTOR CONTROLLER TESTS (16 tests)
  *===========================================================================*/
 
 int test_motor_init(void) {
@@ -327,8 +447,376 @@ int test_motor_max_speed(void) {
     return TEST_PASS;
 }
 
+#define BANK_AXES 8
+
+/* The bank must track N independent controllers driven the same way */
+int test_motor_bank_matches_single(void) {
+    static register_file_t bank_regs[BANK_AXES];
+    static register_file_t single_regs[BANK_AXES];
+    static motor_bank_t bank;
+    motor_controller_t mc[BANK_AXES];
+
+    for (uint32_t i = 0; i < BANK_AXES; i++) {
+        reg_init(&bank_regs[i]);
+        reg_init(&single_regs[i]);
+        motor_init(&mc[i], &single_regs[i]);
+    }
+    ASSERT_EQ(motor_bank_init(&bank, bank_regs, BANK_AXES), 0);
+
+    for (uint32_t i = 0; i < BANK_AXES; i++) {
+        motor_direction_t dir = (i & 1) ? MOTOR_DIR_CW : MOTOR_DIR_CCW;
+        motor_bank_start(&bank, i, 1000 + i * 1100, dir);
+        motor_start(&mc[i], 1000 + i * 1100, dir);
+    }
+
+    for (int tick = 0; tick < 60; tick++) {
+        if (tick == 10) {
+            motor_bank_set_speed(&bank, 2, 300);
+            motor_set_speed(&mc[2], 300);
+            motor_bank_inject_fault(&bank, 3, MOTOR_FAULT_STALL);
+            motor_inject_fault(&mc[3], MOTOR_FAULT_STALL);
+        }
+        if (tick == 20) {
+            motor_bank_stop(&bank, 5);
+            motor_stop(&mc[5]);
+            motor_bank_clear_fault(&bank, 3);
+            motor_clear_fault(&mc[3]);
+        }
+
+        ASSERT_EQ(motor_bank_update(&bank), 0);
+        for (uint32_t i = 0; i < BANK_AXES; i++) {
+            motor_update(&mc[i]);
+            ASSERT_EQ(motor_bank_get_state(&bank, i), motor_get_state(&mc[i]));
+            ASSERT_EQ(motor_bank_get_speed(&bank, i), motor_get_speed(&mc[i]));
+            ASSERT_EQ(motor_bank_get_position(&bank, i), motor_get_position(&mc[i]));
+            ASSERT_EQ(reg_read(&bank_regs[i], REG_MOTOR_POSITION),
+                      reg_read(&single_regs[i], REG_MOTOR_POSITION));
+        }
+    }
+
+    ASSERT_EQ(motor_bank_get_state(&bank, 5), MOTOR_STATE_IDLE);
+    ASSERT_EQ(motor_bank_get_state(&bank, 3), MOTOR_STATE_IDLE);
+    ASSERT_EQ(motor_bank_get_speed(&bank, 2), 300);
+    ASSERT_TRUE(motor_bank_get_position(&bank, 1) > 0);
+    ASSERT_TRUE(motor_bank_get_position(&bank, 0) < 0);
+
+    return TEST_PASS;
+}
+
+int test_motor_bank_axes(void) {
+    static register_file_t regs[BANK_AXES];
+    static motor_bank_t bank;
+
+    for (uint32_t i = 0; i < BANK_AXES; i++) reg_init(&regs[i]);
+    ASSERT_EQ(motor_bank_init(&bank, regs, 0), -1);
+    ASSERT_EQ(motor_bank_init(&bank, regs, MOTOR_BANK_MAX_AXES + 1), -1);
+    ASSERT_EQ(motor_bank_init(&bank, regs, BANK_AXES), 0);
+    ASSERT_EQ(motor_bank_axes(&bank), BANK_AXES);
+    ASSERT_EQ(motor_bank_start(&bank, BANK_AXES, 1000, MOTOR_DIR_CW), -1);
+
+    /* A latched fault on one axis leaves the others running */
+    for (uint32_t i = 0; i < BANK_AXES; i++) {
+        motor_bank_start(&bank, i, 5300, MOTOR_DIR_CW);
+    }
+    for (int i = 0; i < 20; i++) motor_bank_update(&bank);
+    reg_set_bits(&regs[4], REG_MOTOR_STATUS, MOTOR_STATUS_OVERHEAT);
+    motor_bank_update(&bank);
+    ASSERT_EQ(motor_bank_get_state(&bank, 4), MOTOR_STATE_FAULT);
+    ASSERT_EQ(motor_bank_get_fault(&bank, 4), MOTOR_FAULT_OVERHEAT);
+    ASSERT_EQ(motor_bank_get_state(&bank, 5), MOTOR_STATE_RUNNING);
+    ASSERT_EQ(motor_bank_start(&bank, 4, 1000, MOTOR_DIR_CW), -2);
+
+    /* Ramping down from a speed that is not a multiple of the ramp rate */
+    motor_bank_set_speed(&bank, 0, 0);
+    for (int i = 0; i < 20; i++) motor_bank_update(&bank);
+    ASSERT_EQ(motor_bank_get_speed(&bank, 0), 0);
+    ASSERT_EQ(reg_read(&regs[0], REG_MOTOR_SPEED), 0);
+
+    ASSERT_EQ(motor_bank_reset(&bank, 4), 0);
+    ASSERT_EQ(motor_bank_get_state(&bank, 4), MOTOR_STATE_IDLE);
+    ASSERT_EQ(motor_bank_get_position(&bank, 4), 0);
+    ASSERT_TRUE(motor_bank_any_running(&bank));
+
+    return TEST_PASS;
+}
+
+/* First-order motor model: speed lags the drive and loses 10% to load */
+static int32_t plant_step(int32_t speed, uint32_t drive) {
+    return speed + ((int32_t)(drive * 9 / 10) - speed) / 4;
+}
+
+int test_motor_pid_converges(void) {
+    static register_file_t regs[2];
+    static motor_bank_t bank;
+    const motor_pid_gains_t gains = { MOTOR_PID_ONE / 2, MOTOR_PID_ONE / 10, 0 };
+
+    reg_init(&regs[0]);
+    reg_init(&regs[1]);
+    motor_bank_init(&bank, regs, 2);
+    ASSERT_EQ(motor_bank_close_loop(&bank, 0, 0), -2);
+    ASSERT_EQ(motor_bank_set_pid_gains(&bank, 0, &gains), 0);
+    ASSERT_EQ(motor_bank_set_closed_loop(&bank, 0, true), 0);
+    ASSERT_EQ(motor_bank_set_closed_loop(&bank, 2, true), -1);
+
+    /* Open loop would settle at 90% of the target; the integrator removes that */
+    motor_bank_start(&bank, 0, 4000, MOTOR_DIR_CW);
+    int32_t speed = 0;
+    for (int tick = 0; tick < 300; tick++) {
+        motor_bank_update(&bank);
+        ASSERT_EQ(motor_bank_close_loop(&bank, 0, speed), 0);
+        uint32_t drive = reg_read(&regs[0], REG_MOTOR_SPEED);
+        ASSERT_TRUE(drive <= 10000);
+        speed = plant_step(speed, drive);
+    }
+    ASSERT_TRUE(abs(speed - 4000) <= 5);
+    ASSERT_TRUE(reg_read(&regs[0], REG_MOTOR_SPEED) > 4000);
+    ASSERT_EQ(motor_bank_get_speed(&bank, 0), 4000);
+
+    /* The integer step: kp 0.5 on an error of 100 with no integral is 50 */
+    motor_pid_t pid;
+    memset(&pid, 0, sizeof(pid));
+    motor_pid_set_gains(&pid, &(motor_pid_gains_t){ MOTOR_PID_ONE / 2, 0, MOTOR_PID_ONE });
+    ASSERT_EQ(motor_pid_step(&pid, 1100, 1000), 50);
+    ASSERT_EQ(motor_pid_step(&pid, 1100, 1040), 0);     /* 30 - 40 from kd, clamped */
+    ASSERT_EQ(motor_pid_step(&pid, 1100, 1040), 30);
+
+    /* Controller form runs the same lane code */
+    static motor_controller_t mc;
+    static register_file_t mc_regs;
+    reg_init(&mc_regs);
+    motor_init(&mc, &mc_regs);
+    ASSERT_EQ(motor_set_pid_gains(&mc, &(motor_pid_gains_t){ MOTOR_PID_ONE / 2, MOTOR_PID_ONE / 4, 0 }), 0);
+    ASSERT_EQ(motor_set_closed_loop(&mc, true), 0);
+    motor_start(&mc, 2000, MOTOR_DIR_CW);
+    motor_update(&mc);
+    ASSERT_EQ(motor_close_loop(&mc, 0), 0);
+    ASSERT_EQ(reg_read(&mc_regs, REG_MOTOR_SPEED), 375);   /* 0.5 * 500 + 0.25 * 500 */
+
+    return TEST_PASS;
+}
+
+int test_motor_pid_antiwindup(void) {
+    static register_file_t regs;
+    static motor_bank_t bank;
+    const motor_pid_gains_t gains = { MOTOR_PID_ONE / 2, MOTOR_PID_ONE / 10, 0 };
+
+    reg_init(&regs);
+    motor_bank_init(&bank, &regs, 1);
+    motor_bank_set_pid_gains(&bank, 0, &gains);
+    motor_bank_set_closed_loop(&bank, 0, true);
+    motor_bank_start(&bank, 0, 6000, MOTOR_DIR_CW);
+
+    /* Stalled: the output saturates but the integrator stays bounded */
+    for (int tick = 0; tick < 500; tick++) {
+        motor_bank_update(&bank);
+        motor_bank_close_loop(&bank, 0, 0);
+    }
+    ASSERT_EQ(reg_read(&regs, REG_MOTOR_SPEED), 10000);
+    ASSERT_TRUE(bank.pid[0].integral <= (int64_t)10000 * MOTOR_PID_ONE);
+
+    /* Released: no long saturated overshoot from a wound-up integrator */
+    int32_t speed = 0;
+    int32_t peak = 0;
+    for (int tick = 0; tick < 300; tick++) {
+        motor_bank_update(&bank);
+        motor_bank_close_loop(&bank, 0, speed);
+        speed = plant_step(speed, reg_read(&regs, REG_MOTOR_SPEED));
+        if (speed > peak) peak = speed;
+    }
+    ASSERT_TRUE(peak < 9000);
+    ASSERT_TRUE(abs(speed - 6000) <= 5);
+
+    /* Idle lanes are not driven and start the next run from scratch */
+    motor_bank_brake(&bank, 0);
+    ASSERT_EQ(motor_bank_close_loop(&bank, 0, 0), 0);
+    ASSERT_EQ(bank.pid[0].integral, 0);
+    ASSERT_EQ(reg_read(&regs, REG_MOTOR_SPEED), 0);
+
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * MOTION PROFILE TESTS (4 tests)
+ *============================================================================*/
+
+static const motion_limits_t test_limits = { 20, 8, 4 };
+
+/* Run a profile to completion, recording per-tick deltas */
+static int run_profile(motion_profile_t *mp, int32_t *deltas, int max_ticks) {
+    int n = 0;
+    int32_t d;
+    while (n < max_ticks && motion_profile_step(mp, &d) == 1) {
+        deltas[n++] = d;
+    }
+    return n;
+}
+
+int test_motion_trapezoid(void) {
+    static motion_profile_t mp;
+    static int32_t d[MOTION_TABLE_TICKS];
+
+    ASSERT_EQ(motion_profile_init(&mp, &test_limits, 100), 0);
+    ASSERT_EQ(motion_profile_move(&mp, 1100, MOTION_TRAPEZOID), 0);
+    ASSERT_TRUE(motion_profile_active(&mp));
+
+    int n = run_profile(&mp, d, MOTION_TABLE_TICKS);
+    int32_t sum = 0;
+    int32_t peak = 0;
+    for (int i = 0; i < n; i++) {
+        sum += d[i];
+        if (d[i] > peak) peak = d[i];
+        ASSERT_TRUE(d[i] >= 0 && d[i] <= 20);
+        /* 20 counts/tick over 8 ticks is 2.5 per tick per tick */
+        if (i > 0) ASSERT_TRUE(abs(d[i] - d[i - 1]) <= 3);
+    }
+    ASSERT_EQ(sum, 1000);
+    ASSERT_EQ(peak, 20);
+    ASSERT_EQ(motion_profile_setpoint(&mp), 1100);
+    ASSERT_TRUE(!motion_profile_active(&mp));
+    ASSERT_EQ(n, 58);   /* 8 + 42 cruise + 8 */
+
+    /* Short move: triangular, never reaches max velocity */
+    ASSERT_EQ(motion_profile_move(&mp, 1060, MOTION_TRAPEZOID), 0);
+    n = run_profile(&mp, d, MOTION_TABLE_TICKS);
+    sum = 0;
+    for (int i = 0; i < n; i++) {
+        ASSERT_TRUE(d[i] <= 0 && d[i] > -20);
+        sum += d[i];
+    }
+    ASSERT_EQ(sum, -40);
+    ASSERT_EQ(motion_profile_setpoint(&mp), 1060);
+
+    /* Too long for the table, or bad limits */
+    ASSERT_EQ(motion_profile_move(&mp, 1060 + 20 * MOTION_TABLE_TICKS, MOTION_TRAPEZOID), -3);
+    motion_limits_t bad = { MOTION_MAX_VELOCITY + 1, 8, 4 };
+    ASSERT_EQ(motion_profile_init(&mp, &bad, 0), -1);
+
+    return TEST_PASS;
+}
+
+int test_motion_scurve(void) {
+    static motion_profile_t trap;
+    static motion_profile_t scurve;
+    static int32_t dt[MOTION_TABLE_TICKS];
+    static int32_t ds[MOTION_TABLE_TICKS];
+
+    motion_profile_init(&trap, &test_limits, 0);
+    motion_profile_init(&scurve, &test_limits, 0);
+    ASSERT_EQ(motion_profile_move(&trap, -600, MOTION_TRAPEZOID), 0);
+    ASSERT_EQ(motion_profile_move(&scurve, -600, MOTION_SCURVE), 0);
+
+    int nt = run_profile(&trap, dt, MOTION_TABLE_TICKS);
+    int ns = run_profile(&scurve, ds, MOTION_TABLE_TICKS);
+    ASSERT_EQ(ns, nt + 3);
+    ASSERT_EQ(motion_profile_setpoint(&scurve), -600);
+
+    /* Acceleration builds up gradually instead of jumping straight to its limit */
+    for (int i = 1; i < ns; i++) {
+        ASSERT_TRUE(ds[i] <= 0 && ds[i] >= -20);
+        ASSERT_TRUE(abs(ds[i] - ds[i - 1]) <= 3);
+    }
+    ASSERT_TRUE(abs(ds[0]) < abs(dt[0]));
+    ASSERT_TRUE(abs(ds[1]) < abs(dt[1]));
+    ASSERT_TRUE(abs(ds[2]) < abs(dt[2]));
+
+    return TEST_PASS;
+}
+
+int test_motion_blend(void) {
+    static motion_profile_t mp;
+    static int32_t d[2 * MOTION_TABLE_TICKS];
+
+    /* Two moves the same way overlap their ramps and never stop */
+    motion_profile_init(&mp, &test_limits, 0);
+    ASSERT_EQ(motion_profile_move(&mp, 400, MOTION_TRAPEZOID), 0);
+    ASSERT_EQ(motion_profile_move(&mp, 900, MOTION_TRAPEZOID), 0);
+    ASSERT_EQ(motion_profile_move(&mp, 1000, MOTION_TRAPEZOID), -2);
+
+    int n = run_profile(&mp, d, 2 * MOTION_TABLE_TICKS);
+    int32_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += d[i];
+        ASSERT_TRUE(d[i] <= 21);
+        if (i > 0 && i < n - 1) ASSERT_TRUE(d[i] > 0);
+    }
+    ASSERT_EQ(sum, 900);
+    ASSERT_EQ(motion_profile_setpoint(&mp), 900);
+    ASSERT_EQ(n, 28 + 33 - 8);
+
+    /* Reversing runs the moves back to back through zero */
+    motion_profile_init(&mp, &test_limits, 0);
+    motion_profile_move(&mp, 300, MOTION_SCURVE);
+    motion_profile_move(&mp, 0, MOTION_SCURVE);
+    n = run_profile(&mp, d, 2 * MOTION_TABLE_TICKS);
+    int first_negative = -1;
+    for (int i = 0; i < n; i++) {
+        if (d[i] < 0 && first_negative < 0) first_negative = i;
+        if (first_negative >= 0) ASSERT_TRUE(d[i] <= 0);
+    }
+    ASSERT_TRUE(first_negative > 0);
+    ASSERT_EQ(d[first_negative - 1], 0);
+    ASSERT_EQ(motion_profile_setpoint(&mp), 0);
+
+    /* Abort drops both moves */
+    motion_profile_move(&mp, 500, MOTION_TRAPEZOID);
+    motion_profile_move(&mp, 800, MOTION_TRAPEZOID);
+    motion_profile_abort(&mp);
+    ASSERT_TRUE(!motion_profile_active(&mp));
+    ASSERT_EQ(run_profile(&mp, d, 10), 0);
+
+    return TEST_PASS;
+}
+
+int test_motion_follow_motor(void) {
+    static register_file_t regs[2];
+    static motor_bank_t bank;
+    static motion_profile_t mp[2];
+
+    reg_init(&regs[0]);
+    reg_init(&regs[1]);
+    motor_bank_init(&bank, regs, 2);
+    motor_lanes_t lanes = motor_bank_lanes(&bank);
+    motion_profile_init(&mp[0], &test_limits, 0);
+    motion_profile_init(&mp[1], &test_limits, 0);
+
+    /* The lane integrates exactly the planned position every tick */
+    motion_profile_move(&mp[0], 500, MOTION_SCURVE);
+    motion_profile_move(&mp[0], -200, MOTION_TRAPEZOID);
+    int ticks = 0;
+    while (motion_profile_active(&mp[0]) && ticks < 1000) {
+        ASSERT_EQ(motion_profile_follow(&mp[0], &lanes, 0), 1);
+        motor_bank_update(&bank);
+        ASSERT_EQ(motor_bank_get_position(&bank, 0), motion_profile_setpoint(&mp[0]));
+        ASSERT_EQ((int32_t)reg_read(&regs[0], REG_MOTOR_POSITION),
+                  motion_profile_setpoint(&mp[0]));
+        ASSERT_EQ(motor_bank_get_state(&bank, 0), MOTOR_STATE_RUNNING);
+        ticks++;
+    }
+    ASSERT_EQ(motor_bank_get_position(&bank, 0), -200);
+    ASSERT_EQ(bank.direction[0], MOTOR_DIR_CCW);
+
+    /* Finishing hands the lane back, which then goes idle */
+    ASSERT_EQ(motion_profile_follow(&mp[0], &lanes, 0), 0);
+    motor_bank_update(&bank);
+    ASSERT_EQ(motor_bank_get_state(&bank, 0), MOTOR_STATE_IDLE);
+    ASSERT_EQ(reg_read(&regs[0], REG_MOTOR_STATUS) & MOTOR_STATUS_RUNNING, 0);
+    ASSERT_EQ(motor_bank_get_position(&bank, 0), -200);
+
+    /* A fault on the axis aborts its move */
+    motion_profile_move(&mp[1], 400, MOTION_TRAPEZOID);
+    for (int i = 0; i < 5; i++) {
+        motion_profile_follow(&mp[1], &lanes, 1);
+        motor_bank_update(&bank);
+    }
+    motor_bank_inject_fault(&bank, 1, MOTOR_FAULT_STALL);
+    ASSERT_EQ(motion_profile_follow(&mp[1], &lanes, 1), -2);
+    ASSERT_TRUE(!motion_profile_active(&mp[1]));
+
+    return TEST_PASS;
+}
+
 /*============================================================================
- * SENSOR ARRAY TESTS (10 tests)
+ * SENSOR ARRAY TESTS (22 tests)
  *===========================================================================*/
 
 int test_sensor_init(void) {
@@ -463,8 +951,8 @@ int test_sensor_buffer_overflow(void) {
     sensor_array_init(&sa, &rf);
 
     /* Fill buffer to capacity */
-    for (int i = 0; i < SENSOR_BUFFER_SIZE - 1; i++) {
-        ASSERT_EQ(sensor_buffer_push(&sa, i), 0);
+    for (uint32_t i = 0; i < sensor_buffer_capacity(&sa); i++) {
+        ASSERT_EQ(sensor_buffer_push(&sa, (int32_t)i), 0);
     }
 
     /* Next push should fail with overflow */
@@ -509,215 +997,3131 @@ int test_sensor_value_clamping(void) {
     return TEST_PASS;
 }
 
-/*============================================================================
- * INTERRUPT HANDLER TESTS (6 tests)
- *===========================================================================*/
-
-int test_irq_init(void) {
+int test_sensor_buffer_configure(void) {
     register_file_t rf;
-    motor_controller_t mc;
     sensor_array_t sa;
-    interrupt_controller_t ic;
+    int32_t value;
 
     reg_init(&rf);
-    motor_init(&mc, &rf);
     sensor_array_init(&sa, &rf);
 
-    ASSERT_EQ(irq_init(&ic, &rf, &mc, &sa), 0);
-    ASSERT_EQ(irq_get_pending_mask(&ic), 0);
+    /* Capacity must be a power of two within limits */
+    ASSERT_EQ(sensor_buffer_configure(&sa, 1000, SENSOR_OVERFLOW_DROP_NEWEST), -1);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 1, SENSOR_OVERFLOW_DROP_NEWEST), -1);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 4096, SENSOR_OVERFLOW_DROP_NEWEST), 0);
+    ASSERT_EQ(sensor_buffer_capacity(&sa), 4096);
 
-    irq_cleanup(&ic);
+    /* Several laps around the ring keep FIFO order */
+    for (int32_t i = 0; i < 10000; i++) {
+        ASSERT_EQ(sensor_buffer_push(&sa, i), 0);
+        ASSERT_EQ(sensor_buffer_pop(&sa, &value), 0);
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_EQ(sensor_buffer_count(&sa), 0);
+
+    sensor_array_cleanup(&sa);
+    ASSERT_EQ(sensor_buffer_capacity(&sa), SENSOR_BUFFER_SIZE);
     return TEST_PASS;
 }
 
-int test_irq_enable_disable(void) {
+int test_sensor_buffer_overwrite_oldest(void) {
     register_file_t rf;
-    motor_controller_t mc;
     sensor_array_t sa;
-    interrupt_controller_t ic;
+    int32_t value;
 
     reg_init(&rf);
-    motor_init(&mc, &rf);
     sensor_array_init(&sa, &rf);
-    irq_init(&ic, &rf, &mc, &sa);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 4, SENSOR_OVERFLOW_OVERWRITE_OLDEST), 0);
 
-    irq_enable(&ic, INT_MOTOR_FAULT);
-    ASSERT_TRUE(reg_read(&rf, REG_IRQ_ENABLE) & (1 << INT_MOTOR_FAULT));
+    for (int32_t i = 0; i < 6; i++) {
+        ASSERT_EQ(sensor_buffer_push(&sa, i), 0);
+    }
 
-    irq_disable(&ic, INT_MOTOR_FAULT);
-    ASSERT_TRUE((reg_read(&rf, REG_IRQ_ENABLE) & (1 << INT_MOTOR_FAULT)) == 0);
+    /* The two oldest samples were evicted */
+    ASSERT_EQ(sensor_buffer_count(&sa), 4);
+    ASSERT_EQ(sensor_buffer_dropped(&sa), 2);
+    ASSERT_TRUE(reg_read(&rf, REG_SENSOR_STATUS) & SENSOR_STATUS_OVERFLOW);
+    for (int32_t i = 2; i < 6; i++) {
+        ASSERT_EQ(sensor_buffer_pop(&sa, &value), 0);
+        ASSERT_EQ(value, i);
+    }
 
-    irq_cleanup(&ic);
+    sensor_array_cleanup(&sa);
     return TEST_PASS;
 }
 
-int test_irq_trigger(void) {
+int test_sensor_drop_counters(void) {
     register_file_t rf;
-    motor_controller_t mc;
     sensor_array_t sa;
-    interrupt_controller_t ic;
 
     reg_init(&rf);
-    motor_init(&mc, &rf);
     sensor_array_init(&sa, &rf);
-    irq_init(&ic, &rf, &mc, &sa);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 4, SENSOR_OVERFLOW_DROP_NEWEST), 0);
+    sensor_array_enable(&sa);
+    sensor_array_set_continuous(&sa, true);
 
-    irq_enable(&ic, INT_SENSOR_READY);
-    irq_trigger(&ic, INT_SENSOR_READY);
+    /* First update fills the ring; the next two drop every sensor's sample */
+    sensor_array_trigger(&sa);
+    for (int i = 0; i < 3; i++) {
+        sensor_array_update(&sa);
+    }
 
-    ASSERT_TRUE(irq_is_pending(&ic, INT_SENSOR_READY));
-    ASSERT_TRUE(reg_read(&rf, REG_IRQ_STATUS) & (1 << INT_SENSOR_READY));
+    ASSERT_EQ(sensor_buffer_dropped(&sa), 2 * SENSOR_COUNT);
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        ASSERT_EQ(sensor_get_drop_count(&sa, i), 2);
+    }
 
-    irq_cleanup(&ic);
+    sensor_array_cleanup(&sa);
     return TEST_PASS;
 }
 
-int test_irq_handler_callback(void) {
+int test_sensor_buffer_bulk_wrap(void) {
     register_file_t rf;
-    motor_controller_t mc;
     sensor_array_t sa;
-    interrupt_controller_t ic;
+    sensor_view_t view;
+    int32_t values[8];
 
     reg_init(&rf);
-    motor_init(&mc, &rf);
     sensor_array_init(&sa, &rf);
-    irq_init(&ic, &rf, &mc, &sa);
-
-    irq_callback_count = 0;
-    irq_register_handler(&ic, INT_MOTOR_FAULT, test_irq_callback, NULL);
-    irq_enable(&ic, INT_MOTOR_FAULT);
-    irq_trigger(&ic, INT_MOTOR_FAULT);
-
-    irq_process_pending(&ic);
-    ASSERT_EQ(irq_callback_count, 1);
-
-    irq_cleanup(&ic);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 8, SENSOR_OVERFLOW_DROP_NEWEST), 0);
+
+    /* Advance the indices so the next batch straddles the end of storage */
+    for (int32_t i = 0; i < 6; i++) values[i] = i;
+    ASSERT_EQ(sensor_buffer_push_bulk(&sa, values, 6), 6);
+    ASSERT_EQ(sensor_buffer_pop_bulk(&sa, values, 6), 6);
+
+    for (int32_t i = 0; i < 5; i++) values[i] = 100 + i;
+    ASSERT_EQ(sensor_buffer_push_bulk(&sa, values, 5), 5);
+
+    /* Zero-copy view: two spans, nothing consumed yet */
+    ASSERT_EQ(sensor_buffer_peek_bulk(&sa, &view, 8), 5);
+    ASSERT_EQ(view.first_count, 2);
+    ASSERT_EQ(view.second_count, 3);
+    ASSERT_EQ(view.first[0], 100);
+    ASSERT_EQ(view.first[1], 101);
+    ASSERT_EQ(view.second[0], 102);
+    ASSERT_EQ(view.second[2], 104);
+    ASSERT_EQ(sensor_buffer_count(&sa), 5);
+
+    /* Consume part of the view, then copy out the rest */
+    ASSERT_EQ(sensor_buffer_consume(&sa, 2), 0);
+    ASSERT_EQ(sensor_buffer_consume(&sa, 4), -1);
+    ASSERT_EQ(sensor_buffer_pop_bulk(&sa, values, 8), 3);
+    ASSERT_EQ(values[0], 102);
+    ASSERT_EQ(values[2], 104);
+    ASSERT_EQ(sensor_buffer_pop_bulk(&sa, values, 8), 0);
+
+    sensor_array_cleanup(&sa);
     return TEST_PASS;
 }
 
-int test_irq_pending_mask(void) {
+int test_sensor_buffer_bulk_overflow(void) {
     register_file_t rf;
-    motor_controller_t mc;
     sensor_array_t sa;
-    interrupt_controller_t ic;
+    int32_t values[12];
+    int32_t out[8];
 
+    for (int32_t i = 0; i < 12; i++) values[i] = i;
+
+    /* Drop-newest keeps the head of the batch */
     reg_init(&rf);
-    motor_init(&mc, &rf);
     sensor_array_init(&sa, &rf);
-    irq_init(&ic, &rf, &mc, &sa);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 8, SENSOR_OVERFLOW_DROP_NEWEST), 0);
+    ASSERT_EQ(sensor_buffer_push_bulk(&sa, values, 6), 6);
+    ASSERT_EQ(sensor_buffer_push_bulk(&sa, values + 6, 6), 2);
+    ASSERT_EQ(sensor_buffer_dropped(&sa), 4);
+    ASSERT_TRUE(reg_read(&rf, REG_SENSOR_STATUS) & SENSOR_STATUS_OVERFLOW);
+    ASSERT_EQ(sensor_buffer_pop_bulk(&sa, out, 8), 8);
+    ASSERT_EQ(out[7], 7);
+    sensor_array_cleanup(&sa);
 
-    irq_enable_all(&ic);
-    irq_trigger(&ic, INT_MOTOR_FAULT);
-    irq_trigger(&ic, INT_SENSOR_READY);
+    /* Overwrite-oldest keeps the newest samples across partial evictions */
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 8, SENSOR_OVERFLOW_OVERWRITE_OLDEST), 0);
+    ASSERT_EQ(sensor_buffer_push_bulk(&sa, values, 5), 5);
+    ASSERT_EQ(sensor_buffer_push_bulk(&sa, values + 5, 7), 7);
+    ASSERT_EQ(sensor_buffer_dropped(&sa), 4);
+    ASSERT_EQ(sensor_buffer_pop_bulk(&sa, out, 8), 8);
+    for (int32_t i = 0; i < 8; i++) {
+        ASSERT_EQ(out[i], 4 + i);
+    }
 
-    uint32_t mask = irq_get_pending_mask(&ic);
-    ASSERT_TRUE(mask & (1 << INT_MOTOR_FAULT));
-    ASSERT_TRUE(mask & (1 << INT_SENSOR_READY));
+    /* A batch larger than the ring keeps only its tail */
+    ASSERT_EQ(sensor_buffer_push_bulk(&sa, values, 12), 8);
+    ASSERT_EQ(sensor_buffer_dropped(&sa), 8);
+    ASSERT_EQ(sensor_buffer_pop(&sa, &out[0]), 0);
+    ASSERT_EQ(out[0], 4);
+    sensor_array_cleanup(&sa);
 
-    irq_cleanup(&ic);
     return TEST_PASS;
 }
 
-int test_irq_clear(void) {
+int test_sensor_sample_tags(void) {
     register_file_t rf;
-    motor_controller_t mc;
     sensor_array_t sa;
-    interrupt_controller_t ic;
+    sensor_sample_t sample;
+    sensor_span_t spans[2];
 
     reg_init(&rf);
-    motor_init(&mc, &rf);
     sensor_array_init(&sa, &rf);
-    irq_init(&ic, &rf, &mc, &sa);
+    sensor_array_enable(&sa);
+    sensor_array_set_continuous(&sa, true);
 
-    irq_enable(&ic, INT_MOTOR_STALL);
-    irq_trigger(&ic, INT_MOTOR_STALL);
-    ASSERT_TRUE(irq_is_pending(&ic, INT_MOTOR_STALL));
+    sensor_set_simulated_value(&sa, 0, 1234);
+    sensor_set_simulated_value(&sa, 2, 500);    /* Above the 125 C limit */
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
 
-    irq_clear(&ic, INT_MOTOR_STALL);
-    ASSERT_TRUE(!irq_is_pending(&ic, INT_MOTOR_STALL));
+    /* One record per sensor, all stamped with the same update time */
+    ASSERT_EQ(sensor_buffer_peek_samples(&sa, spans, 16), SENSOR_COUNT);
+    ASSERT_EQ(spans[0].count, SENSOR_COUNT);
+    ASSERT_EQ(spans[1].count, 0);
+    ASSERT_EQ(spans[0].values[0], 1234);
+    ASSERT_EQ(spans[0].ids[3], 3);
+
+    uint64_t stamp = 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        ASSERT_EQ(sensor_buffer_pop_sample(&sa, &sample), 0);
+        ASSERT_EQ(sample.sensor_id, i);
+        if (i == 0) stamp = sample.timestamp_ns;
+        ASSERT_TRUE(stamp != 0 && sample.timestamp_ns == stamp);
+        ASSERT_EQ(sample.flags, i == 2 ? SENSOR_SAMPLE_CLAMPED : 0);
+    }
+    ASSERT_EQ(sample.value, 0);
 
-    irq_cleanup(&ic);
+    /* Untagged pushes are marked as such */
+    ASSERT_EQ(sensor_buffer_push(&sa, 7), 0);
+    ASSERT_EQ(sensor_buffer_pop_sample(&sa, &sample), 0);
+    ASSERT_EQ(sample.sensor_id, SENSOR_ID_NONE);
+    ASSERT_EQ(sample.value, 7);
+
+    sensor_array_cleanup(&sa);
     return TEST_PASS;
 }
 
-/*============================================================================
- * SHARED MEMORY TESTS (3 tests)
- *===========================================================================*/
-
-int test_shm_create_destroy(void) {
-    shared_mem_t *shm = shm_create();
-    ASSERT_TRUE(shm != NULL);
-
-    shared_mem_t *shm2 = shm_open_existing();
-    ASSERT_TRUE(shm2 != NULL);
+int test_sensor_sample_gap(void) {
+    register_file_t rf;
+    sensor_array_t sa;
+    sensor_sample_t sample;
 
-    shm_destroy(shm);
-    return TEST_PASS;
-}
+    /* Sensors whose samples were dropped flag their next sample */
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 4, SENSOR_OVERFLOW_DROP_NEWEST), 0);
+    sensor_array_enable(&sa);
+    sensor_array_set_continuous(&sa, true);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    sensor_array_update(&sa);                   /* Dropped: ring is full */
+    sensor_buffer_clear(&sa);
+    sensor_array_update(&sa);
 
-int test_shm_status_update(void) {
-    shared_mem_t *shm = shm_create();
-    ASSERT_TRUE(shm != NULL);
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        ASSERT_EQ(sensor_buffer_pop_sample(&sa, &sample), 0);
+        ASSERT_EQ(sample.sensor_id, i);
+        ASSERT_TRUE(sample.flags & SENSOR_SAMPLE_GAP);
+    }
+    sensor_array_cleanup(&sa);
 
-    int32_t sensors[4] = {100, 200, 300, 400};
-    ASSERT_EQ(shm_update_status(shm, 2, 5000, 1234, sensors, 0), 0);
+    /* Overwrite-oldest charges the evicted sample's sensor */
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 4, SENSOR_OVERFLOW_OVERWRITE_OLDEST), 0);
+    sample.timestamp_ns = 1;
+    sample.value = 0;
+    sample.sensor_id = 0;
+    sample.flags = 0;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(sensor_buffer_push_sample(&sa, &sample), 0);
+    }
+    sensor_array_enable(&sa);
+    sensor_array_set_continuous(&sa, true);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
 
-    ASSERT_EQ(shm->motor_state, 2);
-    ASSERT_EQ(shm->motor_speed, 5000);
-    ASSERT_EQ(shm->motor_position, 1234);
-    ASSERT_EQ(shm->sensor_values[0], 100);
+    ASSERT_EQ(sensor_get_drop_count(&sa, 0), 4);
+    ASSERT_EQ(sensor_get_drop_count(&sa, 1), 0);
+    ASSERT_EQ(sensor_buffer_pop_sample(&sa, &sample), 0);
+    ASSERT_EQ(sample.sensor_id, 0);
+    ASSERT_TRUE(sample.flags & SENSOR_SAMPLE_GAP);
 
-    shm_destroy(shm);
+    sensor_array_cleanup(&sa);
     return TEST_PASS;
 }
 
-int test_shm_shutdown(void) {
-    shared_mem_t *shm = shm_create();
-    ASSERT_TRUE(shm != NULL);
+#define SPSC_SAMPLES    200000
 
-    ASSERT_TRUE(!shm_is_shutdown_requested(shm));
-    shm_request_shutdown(shm);
-    ASSERT_TRUE(shm_is_shutdown_requested(shm));
+static void *sensor_consumer(void *arg) {
+    sensor_array_t *sa = (sensor_array_t*)arg;
+    int32_t expected = 0;
+    int32_t value;
 
-    shm_destroy(shm);
-    return TEST_PASS;
+    while (expected < SPSC_SAMPLES) {
+        if (sensor_buffer_pop(sa, &value) != 0) {
+            sched_yield();
+            continue;
+        }
+        if (value != expected) return (void*)1;  /* Lost or reordered */
+        expected++;
+    }
+    return NULL;
 }
 
-/*============================================================================
- * INTEGRATION TESTS (2 tests)
- *===========================================================================*/
-
-int test_integration_motor_sensor(void) {
+int test_sensor_buffer_spsc(void) {
     register_file_t rf;
-    motor_controller_t mc;
     sensor_array_t sa;
 
     reg_init(&rf);
-    motor_init(&mc, &rf);
     sensor_array_init(&sa, &rf);
-    sensor_array_enable(&sa);
-
-    /* Start motor and simulate sensor readings */
-    motor_start(&mc, 3000, MOTOR_DIR_CW);
+    ASSERT_EQ(sensor_buffer_configure(&sa, 1024, SENSOR_OVERFLOW_DROP_NEWEST), 0);
 
-    for (int i = 0; i < 20; i++) {
-        motor_update(&mc);
+    pthread_t consumer;
+    ASSERT_EQ(pthread_create(&consumer, NULL, sensor_consumer, &sa), 0);
 
-        /* Update velocity sensor with motor speed */
-        sensor_set_simulated_value(&sa, 1, (int32_t)motor_get_speed(&mc));
-        sensor_array_trigger(&sa);
-        sensor_array_update(&sa);
+    for (int32_t i = 0; i < SPSC_SAMPLES; i++) {
+        while (sensor_buffer_push(&sa, i) != 0) {
+            sched_yield();
+        }
     }
 
-    /* Verify sensor tracks motor speed */
-    ASSERT_EQ(sensor_read(&sa, 1), (int32_t)motor_get_speed(&mc));
+    void *result;
+    pthread_join(consumer, &result);
+    ASSERT_TRUE(result == NULL);
 
+    sensor_array_cleanup(&sa);
     return TEST_PASS;
 }
 
-int test_integration_fault_irq(void) {
+int test_sensor_filter_pipeline(void) {
     register_file_t rf;
-    motor_controller_t mc;
+    sensor_array_t sa;
+
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    sensor_array_enable(&sa);
+
+    sensor_filter_t bad = { SENSOR_SPIKE_MEDIAN, 4, 0, 1 };
+    ASSERT_EQ(sensor_set_filter(&sa, 1, &bad), -1);
+    bad.taps = SENSOR_FILTER_TAPS + 1;
+    ASSERT_EQ(sensor_set_filter(&sa, 1, &bad), -1);
+
+    /* Median of 3 drops a one-sample spike entirely */
+    sensor_filter_t median = { SENSOR_SPIKE_MEDIAN, 3, 0, 1 };
+    ASSERT_EQ(sensor_set_filter(&sa, 1, &median), 0);
+    const int32_t in[] = { 1000, 1000, 9000, 1000, 1000, 2000, 2000, 2000 };
+    const int32_t expect[] = { 1000, 1000, 1000, 1000, 1000, 1000, 2000, 2000 };
+    for (int i = 0; i < 8; i++) {
+        sensor_set_simulated_value(&sa, 1, in[i]);
+        sensor_array_trigger(&sa);
+        sensor_array_update(&sa);
+        ASSERT_EQ(sensor_read_filtered(&sa, 1), expect[i]);
+    }
+    ASSERT_EQ(sensor_read(&sa, 1), 2000);
+
+    /* EMA with weight 1/4 closes a quarter of the gap per sample */
+    sensor_filter_t ema = { SENSOR_SPIKE_NONE, 0, 2, 1 };
+    ASSERT_EQ(sensor_set_filter(&sa, 1, &ema), 0);
+    sensor_set_simulated_value(&sa, 1, 0);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    sensor_set_simulated_value(&sa, 1, 4096);
+    const int32_t ema_expect[] = { 1024, 1792, 2368 };
+    for (int i = 0; i < 3; i++) {
+        sensor_array_trigger(&sa);
+        sensor_array_update(&sa);
+        ASSERT_EQ(sensor_read_filtered(&sa, 1), ema_expect[i]);
+    }
+
+    /* Moving average of 2, then decimate by 4: one output per 4 samples */
+    sensor_filter_t decim = { SENSOR_SPIKE_MEAN, 2, 0, 4 };
+    ASSERT_EQ(sensor_set_filter(&sa, 0, &decim), 0);
+    for (int i = 0; i < 12; i++) {
+        sensor_set_simulated_value(&sa, 0, 100 * (i + 1));
+        sensor_array_trigger(&sa);
+        sensor_array_update(&sa);
+    }
+    ASSERT_EQ(sensor_filtered_count(&sa, 0), 3);
+    /* Last block averages the pair means 850, 950, 1050, 1150 */
+    ASSERT_EQ(sensor_read_filtered(&sa, 0), 1000);
+
+    ASSERT_EQ(sensor_set_filter(&sa, 0, NULL), 0);
+    ASSERT_EQ(sensor_filtered_count(&sa, 0), 0);
+
+    sensor_array_cleanup(&sa);
+    return TEST_PASS;
+}
+
+int test_sensor_running_stats(void) {
+    register_file_t rf;
+    sensor_array_t sa;
+    sensor_summary_t st;
+
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    sensor_array_enable(&sa);
+    ASSERT_EQ(sensor_get_stats(&sa, 2, &st), 0);
+    ASSERT_EQ(st.count, 0);
+    ASSERT_EQ(sensor_get_stats(&sa, SENSOR_COUNT, &st), -1);
+    ASSERT_EQ(sensor_set_stats_threshold(&sa, 2, 80), 0);
+
+    /* Temperature ramps 0..99, then one sample above the clamp range */
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    for (int i = 0; i < 100; i++) {
+        sensor_set_simulated_value(&sa, 2, i);
+        sensor_array_trigger(&sa);
+        sensor_array_update(&sa);
+        sum += i;
+        sum_sq += (double)i * i;
+    }
+    ASSERT_EQ(sensor_get_stats(&sa, 2, &st), 0);
+    ASSERT_EQ(st.count, 100);
+    double mean = sum / 100.0;
+    double var = sum_sq / 100.0 - mean * mean;
+    ASSERT_TRUE(st.mean > mean - 1e-9 && st.mean < mean + 1e-9);
+    ASSERT_TRUE(st.variance > var - 1e-6 && st.variance < var + 1e-6);
+    ASSERT_EQ(st.over_threshold, 19);
+
+    /* Min/max cover only the last SENSOR_STATS_WINDOW samples */
+    ASSERT_EQ(st.window_max, 99);
+    ASSERT_EQ(st.window_min, 100 - SENSOR_STATS_WINDOW);
+
+    sensor_set_simulated_value(&sa, 2, 500);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    sensor_get_stats(&sa, 2, &st);
+    ASSERT_EQ(st.window_max, 125);      /* Clamped value is what counts */
+    ASSERT_EQ(st.over_threshold, 20);
+
+    /* A falling sequence keeps the oldest in-window sample as the max */
+    sensor_stats_reset(&sa, 0);
+    for (int i = 0; i < 200; i++) {
+        sensor_set_simulated_value(&sa, 0, 1000 - i);
+        sensor_array_trigger(&sa);
+        sensor_array_update(&sa);
+    }
+    sensor_get_stats(&sa, 0, &st);
+    ASSERT_EQ(st.window_max, 1000 - (200 - SENSOR_STATS_WINDOW));
+    ASSERT_EQ(st.window_min, 801);
+
+    ASSERT_EQ(sensor_stats_reset(&sa, 2), 0);
+    sensor_get_stats(&sa, 2, &st);
+    ASSERT_EQ(st.count, 0);
+    ASSERT_EQ(st.over_threshold, 0);
+
+    sensor_array_cleanup(&sa);
+    return TEST_PASS;
+}
+
+int test_sensor_rate_dividers(void) {
+    register_file_t rf;
+    sensor_array_t sa;
+
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    ASSERT_EQ(sensor_array_tick(&sa), -2);
+    sensor_array_enable(&sa);
+
+    /* A divider beyond the wheel size takes several laps before it fires */
+    ASSERT_EQ(sensor_set_rate(&sa, 0, 1), 0);
+    ASSERT_EQ(sensor_set_rate(&sa, 1, 3), 0);
+    ASSERT_EQ(sensor_set_rate(&sa, 2, 100), 0);
+    ASSERT_EQ(sensor_set_rate(&sa, SENSOR_COUNT, 1), -1);
+
+    for (int i = 0; i < 300; i++) {
+        int started = sensor_array_tick(&sa);
+        ASSERT_TRUE(started >= 1 && started <= 3);
+        sensor_array_update(&sa);
+    }
+    ASSERT_EQ(sa.sensors[0].sample_count, 300);
+    ASSERT_EQ(sa.sensors[1].sample_count, 100);
+    ASSERT_EQ(sa.sensors[2].sample_count, 3);
+    ASSERT_EQ(sa.sensors[3].sample_count, 0);
+
+    /* Re-rating counts from the current tick; 0 takes a sensor off the wheel */
+    ASSERT_EQ(sensor_set_rate(&sa, 0, 0), 0);
+    ASSERT_EQ(sensor_set_rate(&sa, 3, 10), 0);
+    for (int i = 0; i < 30; i++) {
+        sensor_array_tick(&sa);
+        sensor_array_update(&sa);
+    }
+    ASSERT_EQ(sa.sensors[0].sample_count, 300);
+    ASSERT_EQ(sa.sensors[1].sample_count, 110);
+    ASSERT_EQ(sa.sensors[3].sample_count, 3);
+
+    /* A manual trigger still samples every channel */
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    ASSERT_EQ(sa.sensors[0].sample_count, 301);
+
+    sensor_array_cleanup(&sa);
+    return TEST_PASS;
+}
+
+int test_sensor_table_add(void) {
+    register_file_t rf;
+    sensor_array_t sa;
+
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    ASSERT_EQ(sensor_array_count(&sa), SENSOR_COUNT);
+
+    sensor_config_t bad = { SENSOR_TYPE_CURRENT, 10, 0, 1 };
+    ASSERT_EQ(sensor_array_add(&sa, &bad), -1);
+    ASSERT_EQ(sensor_array_add(&sa, NULL), -1);
+
+    sensor_config_t cfg = { SENSOR_TYPE_CURRENT, -500, 500, 2 };
+    for (int i = SENSOR_COUNT; i < SENSOR_MAX; i++) {
+        ASSERT_EQ(sensor_array_add(&sa, &cfg), i);
+    }
+    ASSERT_EQ(sensor_array_add(&sa, &cfg), -2);
+    ASSERT_EQ(sensor_array_count(&sa), SENSOR_MAX);
+    ASSERT_EQ(sensor_get_state(&sa, SENSOR_MAX - 1), SENSOR_STATE_DISABLED);
+
+    /* Added channels clamp, sample on their own rate and keep statistics */
+    sensor_array_enable(&sa);
+    sensor_set_simulated_value(&sa, SENSOR_MAX - 1, 9000);
+    for (int i = 0; i < 4; i++) {
+        sensor_array_tick(&sa);
+        sensor_array_update(&sa);
+    }
+    ASSERT_EQ(sensor_read(&sa, SENSOR_MAX - 1), 500);
+    ASSERT_EQ(sa.sensors[SENSOR_MAX - 1].sample_count, 2);
+    sensor_summary_t st;
+    ASSERT_EQ(sensor_get_stats(&sa, SENSOR_COUNT, &st), 0);
+    ASSERT_EQ(st.count, 2);
+    ASSERT_EQ(st.window_max, 0);
+
+    int32_t values[SENSOR_MAX + 4];
+    ASSERT_EQ(sensor_read_all(&sa, values, SENSOR_MAX + 4), SENSOR_MAX);
+    ASSERT_EQ(values[SENSOR_MAX - 1], 500);
+
+    sensor_array_cleanup(&sa);
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * INTERRUPT HANDLER TESTS (17 tests)
+ *===========================================================================*/
+
+int test_irq_init(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+
+    ASSERT_EQ(irq_init(&ic, &rf, &mc, &sa), 0);
+    ASSERT_EQ(irq_get_pending_mask(&ic), 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+int test_irq_enable_disable(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+
+    irq_enable(&ic, INT_MOTOR_FAULT);
+    ASSERT_TRUE(reg_read(&rf, REG_IRQ_ENABLE) & (1 << INT_MOTOR_FAULT));
+
+    irq_disable(&ic, INT_MOTOR_FAULT);
+    ASSERT_TRUE((reg_read(&rf, REG_IRQ_ENABLE) & (1 << INT_MOTOR_FAULT)) == 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+int test_irq_trigger(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+
+    irq_enable(&ic, INT_SENSOR_READY);
+    irq_trigger(&ic, INT_SENSOR_READY);
+
+    ASSERT_TRUE(irq_is_pending(&ic, INT_SENSOR_READY));
+    ASSERT_TRUE(reg_read(&rf, REG_IRQ_STATUS) & (1 << INT_SENSOR_READY));
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+int test_irq_handler_callback(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+
+    irq_callback_count = 0;
+    irq_register_handler(&ic, INT_MOTOR_FAULT, test_irq_callback, NULL);
+    irq_enable(&ic, INT_MOTOR_FAULT);
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+
+    irq_process_pending(&ic);
+    ASSERT_EQ(irq_callback_count, 1);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+int test_irq_pending_mask(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+
+    irq_enable_all(&ic);
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    irq_trigger(&ic, INT_SENSOR_READY);
+
+    uint32_t mask = irq_get_pending_mask(&ic);
+    ASSERT_TRUE(mask & (1 << INT_MOTOR_FAULT));
+    ASSERT_TRUE(mask & (1 << INT_SENSOR_READY));
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+int test_irq_clear(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+
+    irq_enable(&ic, INT_MOTOR_STALL);
+    irq_trigger(&ic, INT_MOTOR_STALL);
+    ASSERT_TRUE(irq_is_pending(&ic, INT_MOTOR_STALL));
+
+    irq_clear(&ic, INT_MOTOR_STALL);
+    ASSERT_TRUE(!irq_is_pending(&ic, INT_MOTOR_STALL));
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+/* Dispatch order log shared by the priority tests */
+static interrupt_source_t irq_order[16];
+static int irq_order_len = 0;
+
+static void log_irq(interrupt_source_t source, void *context) {
+    (void)context;
+    if (irq_order_len < 16) irq_order[irq_order_len++] = source;
+}
+
+int test_irq_priority_order(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable_all(&ic);
+    for (int i = 0; i < INT_COUNT; i++) {
+        irq_register_handler(&ic, (interrupt_source_t)i, log_irq, NULL);
+    }
+
+    /* Defaults: faults, then sensor errors, timer, sensor data */
+    irq_order_len = 0;
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_trigger(&ic, INT_TIMER);
+    irq_trigger(&ic, INT_MOTOR_STALL);
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    ASSERT_EQ(irq_process_pending(&ic), 4);
+    ASSERT_EQ(irq_order_len, 4);
+    ASSERT_EQ(irq_order[0], INT_MOTOR_FAULT);
+    ASSERT_EQ(irq_order[1], INT_MOTOR_STALL);
+    ASSERT_EQ(irq_order[2], INT_TIMER);
+    ASSERT_EQ(irq_order[3], INT_SENSOR_READY);
+    ASSERT_EQ(reg_read(&rf, REG_IRQ_STATUS), 0);
+
+    /* Reprioritise */
+    ASSERT_EQ(irq_set_priority(&ic, INT_SENSOR_READY, 0), 0);
+    ASSERT_EQ(irq_set_priority(&ic, INT_MOTOR_FAULT, 1), 0);
+    ASSERT_EQ(irq_set_priority(&ic, INT_TIMER, IRQ_PRIORITY_LEVELS), -1);
+    ASSERT_EQ(irq_get_priority(&ic, INT_SENSOR_READY), 0);
+    irq_order_len = 0;
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_process_pending(&ic);
+    ASSERT_EQ(irq_order[0], INT_SENSOR_READY);
+    ASSERT_EQ(irq_order[1], INT_MOTOR_FAULT);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+/* Sensor handler that raises a fault and itself while it runs */
+static void raise_during_handler(interrupt_source_t source, void *context) {
+    interrupt_controller_t *ic = (interrupt_controller_t*)context;
+    log_irq(source, NULL);
+    if (irq_order_len == 1) {
+        irq_trigger(ic, INT_SENSOR_READY);
+        irq_trigger(ic, INT_MOTOR_FAULT);
+    }
+    if (irq_order_len == 3) {
+        /* Nested dispatch only picks up levels above the sensor's */
+        irq_trigger(ic, INT_SENSOR_READY);
+        irq_trigger(ic, INT_TIMER);
+        irq_trigger(ic, INT_MOTOR_STALL);
+        irq_process_pending(ic);
+    }
+}
+
+int test_irq_preempt_and_nest(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable_all(&ic);
+    irq_register_handler(&ic, INT_MOTOR_FAULT, log_irq, NULL);
+    irq_register_handler(&ic, INT_MOTOR_STALL, log_irq, NULL);
+    irq_register_handler(&ic, INT_TIMER, log_irq, NULL);
+    irq_register_handler(&ic, INT_SENSOR_READY, raise_during_handler, &ic);
+
+    irq_order_len = 0;
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_process_pending(&ic);
+
+    /* Raised-while-running IRQs are kept, and the fault jumps the queue */
+    ASSERT_EQ(irq_order_len, 6);
+    ASSERT_EQ(irq_order[0], INT_SENSOR_READY);
+    ASSERT_EQ(irq_order[1], INT_MOTOR_FAULT);
+    ASSERT_EQ(irq_order[2], INT_SENSOR_READY);
+    ASSERT_EQ(irq_order[3], INT_MOTOR_STALL);
+    ASSERT_EQ(irq_order[4], INT_TIMER);
+    ASSERT_EQ(irq_order[5], INT_SENSOR_READY);  /* Same level: after unwinding */
+    ASSERT_EQ(irq_get_pending_mask(&ic), 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+static _Atomic int deferred_runs = 0;
+
+static void count_deferred(interrupt_source_t source, void *context) {
+    (void)source;
+    (void)context;
+    atomic_fetch_add(&deferred_runs, 1);
+}
+
+int test_irq_deferred(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_SENSOR_READY);
+
+    irq_callback_count = 0;
+    atomic_store(&deferred_runs, 0);
+    irq_register_handler(&ic, INT_SENSOR_READY, test_irq_callback, NULL);
+    irq_register_deferred(&ic, INT_SENSOR_READY, count_deferred, NULL);
+
+    /* Top half runs at dispatch; repeated IRQs fold into one bottom half */
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_process_pending(&ic);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_process_pending(&ic);
+    ASSERT_EQ(irq_callback_count, 2);
+    ASSERT_EQ(atomic_load(&deferred_runs), 0);
+    ASSERT_EQ(irq_run_deferred(&ic), 1);
+    ASSERT_EQ(atomic_load(&deferred_runs), 1);
+    ASSERT_EQ(irq_run_deferred(&ic), 0);
+
+    /* With the worker running, bottom halves happen off the dispatch path */
+    ASSERT_EQ(irq_start_worker(&ic), 0);
+    ASSERT_EQ(irq_start_worker(&ic), -2);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_process_pending(&ic);
+    for (int i = 0; i < 1000 && atomic_load(&deferred_runs) < 2; i++) {
+        usleep(1000);
+    }
+    ASSERT_EQ(atomic_load(&deferred_runs), 2);
+
+    irq_cleanup(&ic);   /* Stops the worker */
+    ASSERT_TRUE(!ic.worker_running);
+    return TEST_PASS;
+}
+
+int test_irq_coalesce(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable_all(&ic);
+    irq_register_handler(&ic, INT_SENSOR_READY, log_irq, NULL);
+    irq_register_handler(&ic, INT_MOTOR_FAULT, log_irq, NULL);
+
+    /* Once per 10 events; a held source does not hold up a fault */
+    ASSERT_EQ(irq_set_coalesce(&ic, INT_SENSOR_READY, 10, 0), 0);
+    irq_order_len = 0;
+    for (int i = 0; i < 9; i++) {
+        irq_trigger(&ic, INT_SENSOR_READY);
+        irq_process_pending(&ic);
+    }
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(irq_order_len, 1);
+    ASSERT_EQ(irq_order[0], INT_MOTOR_FAULT);
+    ASSERT_TRUE(irq_is_pending(&ic, INT_SENSOR_READY));
+    ASSERT_TRUE(reg_read(&rf, REG_IRQ_STATUS) & (1 << INT_SENSOR_READY));
+
+    irq_trigger(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(irq_order_len, 2);
+    ASSERT_EQ(irq_get_merged(&ic, INT_SENSOR_READY), 10);
+
+    /* Or at most once per 2 ms */
+    ASSERT_EQ(irq_set_coalesce(&ic, INT_SENSOR_READY, 0, 2000), 0);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(irq_process_pending(&ic), 0);
+    usleep(3000);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(irq_get_merged(&ic, INT_SENSOR_READY), 2);
+
+    /* The delay runs from the raise, so a late first pass delivers at once */
+    irq_trigger(&ic, INT_SENSOR_READY);
+    usleep(3000);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(irq_get_merged(&ic, INT_SENSOR_READY), 1);
+
+    irq_source_stats_t stats;
+    ASSERT_EQ(irq_get_source_stats(&ic, INT_SENSOR_READY, &stats), 0);
+    ASSERT_EQ(stats.events, 13);
+    ASSERT_EQ(stats.deliveries, 3);
+
+    /* Off again: every raise is delivered */
+    ASSERT_EQ(irq_set_coalesce(&ic, INT_SENSOR_READY, 0, 0), 0);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(irq_get_merged(&ic, INT_SENSOR_READY), 1);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+int test_irq_storm_throttle(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+    irq_source_stats_t stats;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_SENSOR_READY);
+    irq_register_handler(&ic, INT_SENSOR_READY, log_irq, NULL);
+    ASSERT_EQ(irq_set_storm_threshold(&ic, INT_SENSOR_READY, 100), 0);
+
+    /* A window is measured before the detector can trip */
+    irq_order_len = 0;
+    for (int i = 0; i < 500; i++) irq_trigger(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+
+    usleep(IRQ_STORM_WINDOW_US + 10000);
+    for (int i = 0; i < 500; i++) irq_trigger(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(irq_process_pending(&ic), 0);
+    ASSERT_EQ(irq_get_throttled_mask(&ic), 1u << INT_SENSOR_READY);
+    ASSERT_EQ(irq_get_source_stats(&ic, INT_SENSOR_READY, &stats), 0);
+    ASSERT_EQ(stats.storms, 1);
+    ASSERT_TRUE(stats.throttled);
+
+    /* Throttled: one delivery per holdoff, carrying every merged event */
+    usleep(IRQ_STORM_HOLDOFF_US + 1000);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(irq_get_merged(&ic, INT_SENSOR_READY), 500);
+
+    /* A quiet window lifts the throttle */
+    usleep(IRQ_STORM_WINDOW_US + 10000);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(irq_get_throttled_mask(&ic), 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+#define IRQ_STORM_EVENTS    100000
+
+static _Atomic uint32_t irq_raised_seq = 0;
+static _Atomic uint32_t irq_seen_seq = 0;
+static _Atomic bool irq_storm_done = false;
+
+static void record_seen(interrupt_source_t source, void *context) {
+    (void)source;
+    (void)context;
+    atomic_store(&irq_seen_seq, atomic_load(&irq_raised_seq));
+}
+
+static void *irq_storm_thread(void *arg) {
+    interrupt_controller_t *ic = (interrupt_controller_t*)arg;
+    for (uint32_t k = 1; k <= IRQ_STORM_EVENTS; k++) {
+        atomic_store(&irq_raised_seq, k);
+        irq_trigger(ic, INT_SENSOR_READY);
+        if ((k & 63) == 0) sched_yield();
+    }
+    atomic_store(&irq_storm_done, true);
+    return NULL;
+}
+
+int test_irq_atomic_intake(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_SENSOR_READY);
+    irq_register_handler(&ic, INT_SENSOR_READY, record_seen, NULL);
+
+    atomic_store(&irq_raised_seq, 0);
+    atomic_store(&irq_seen_seq, 0);
+    atomic_store(&irq_storm_done, false);
+
+    /* Another thread raises while this one drains */
+    pthread_t storm;
+    ASSERT_EQ(pthread_create(&storm, NULL, irq_storm_thread, &ic), 0);
+    while (!atomic_load(&irq_storm_done)) {
+        irq_process_pending(&ic);
+    }
+    pthread_join(storm, NULL);
+    irq_process_pending(&ic);
+
+    /* The last raise is never swallowed by a concurrent drain */
+    ASSERT_EQ(atomic_load(&irq_seen_seq), IRQ_STORM_EVENTS);
+    ASSERT_EQ(irq_get_pending_mask(&ic), 0);
+
+    /* Disabled sources are ignored by the signal path too */
+    irq_disable(&ic, INT_SENSOR_READY);
+    irq_signal_handler(SIGUSR2);
+    ASSERT_EQ(irq_get_pending_mask(&ic), 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+static _Atomic int storm_faults = 0;
+static _Atomic int storm_sensors = 0;
+
+static void count_storm(interrupt_source_t source, void *context) {
+    (void)context;
+    atomic_fetch_add(source == INT_MOTOR_FAULT ? &storm_faults : &storm_sensors, 1);
+}
+
+static void *signal_storm_thread(void *arg) {
+    pthread_t target = *(pthread_t*)arg;
+    for (int k = 0; k < 5000; k++) {
+        pthread_kill(target, (k & 1) ? SIGUSR2 : SIGUSR1);
+        if ((k & 15) == 0) sched_yield();
+    }
+    atomic_store(&irq_storm_done, true);
+    return NULL;
+}
+
+int test_irq_signal_storm(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_MOTOR_FAULT);
+    irq_enable(&ic, INT_SENSOR_READY);
+    irq_register_handler(&ic, INT_MOTOR_FAULT, count_storm, NULL);
+    irq_register_handler(&ic, INT_SENSOR_READY, count_storm, NULL);
+    ASSERT_EQ(irq_setup_signal_handler(&ic), 0);
+
+    atomic_store(&storm_faults, 0);
+    atomic_store(&storm_sensors, 0);
+    atomic_store(&irq_storm_done, false);
+
+    /* Signal handlers interrupt this thread in the middle of dispatch */
+    pthread_t self = pthread_self();
+    pthread_t storm;
+    ASSERT_EQ(pthread_create(&storm, NULL, signal_storm_thread, &self), 0);
+    while (!atomic_load(&irq_storm_done)) {
+        irq_process_pending(&ic);
+    }
+    pthread_join(storm, NULL);
+
+    /* Whatever arrived last is still pending, never dropped */
+    irq_process_pending(&ic);
+    ASSERT_TRUE(atomic_load(&storm_faults) > 0);
+    ASSERT_TRUE(atomic_load(&storm_sensors) > 0);
+    ASSERT_EQ(irq_get_pending_mask(&ic) & ~(1u << INT_TIMER), 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+static int chain_order[IRQ_MAX_HANDLERS];
+static int chain_order_len = 0;
+
+static void log_irq_ctx(interrupt_source_t source, void *context) {
+    (void)source;
+    if (chain_order_len < IRQ_MAX_HANDLERS) {
+        chain_order[chain_order_len++] = (int)(intptr_t)context;
+    }
+}
+
+int test_irq_handler_chain(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_MOTOR_FAULT);
+
+    /* Handlers on one source run in registration order */
+    for (intptr_t i = 1; i <= IRQ_MAX_HANDLERS; i++) {
+        ASSERT_EQ(irq_register_handler(&ic, INT_MOTOR_FAULT, log_irq_ctx, (void*)i), 0);
+    }
+    ASSERT_EQ(irq_register_handler(&ic, INT_MOTOR_FAULT, log_irq_ctx, (void*)(intptr_t)9), -2);
+    ASSERT_EQ(irq_register_handler(&ic, INT_MOTOR_FAULT, log_irq_ctx, (void*)(intptr_t)1), 0);
+    ASSERT_EQ(irq_handler_count(&ic, INT_MOTOR_FAULT), IRQ_MAX_HANDLERS);
+
+    chain_order_len = 0;
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    ASSERT_EQ(irq_process_pending(&ic), 1);
+    ASSERT_EQ(chain_order_len, IRQ_MAX_HANDLERS);
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        ASSERT_EQ(chain_order[i], i + 1);
+    }
+
+    /* Removing one from the middle keeps the others in order */
+    ASSERT_EQ(irq_remove_handler(&ic, INT_MOTOR_FAULT, log_irq_ctx, (void*)(intptr_t)2), 0);
+    ASSERT_EQ(irq_remove_handler(&ic, INT_MOTOR_FAULT, log_irq_ctx, (void*)(intptr_t)2), -3);
+
+    chain_order_len = 0;
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    irq_process_pending(&ic);
+    ASSERT_EQ(chain_order_len, IRQ_MAX_HANDLERS - 1);
+    ASSERT_EQ(chain_order[0], 1);
+    ASSERT_EQ(chain_order[1], 3);
+
+    ASSERT_EQ(irq_unregister_handler(&ic, INT_MOTOR_FAULT), 0);
+    ASSERT_EQ(irq_handler_count(&ic, INT_MOTOR_FAULT), 0);
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    ASSERT_EQ(irq_process_pending(&ic), 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+#define IRQ_CHAIN_ROUNDS 20000
+
+static _Atomic bool chain_churn_done;
+static _Atomic uint32_t chain_extra_calls;
+
+static void count_chain(interrupt_source_t source, void *context) {
+    (void)source;
+    (*(uint32_t*)context)++;
+}
+
+static void count_extra(interrupt_source_t source, void *context) {
+    (void)source;
+    (void)context;
+    atomic_fetch_add(&chain_extra_calls, 1);
+}
+
+/* Adds and removes a second handler while the main thread dispatches */
+static void *chain_churn_thread(void *arg) {
+    interrupt_controller_t *ic = (interrupt_controller_t*)arg;
+
+    while (!atomic_load(&chain_churn_done)) {
+        if (irq_register_handler(ic, INT_SENSOR_READY, count_extra, NULL) == 0) {
+            while (irq_remove_handler(ic, INT_SENSOR_READY, count_extra, NULL) == -2) {
+                sched_yield();
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int test_irq_chain_rcu(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+    uint32_t calls = 0;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(irq_register_handler(&ic, INT_SENSOR_READY, count_chain, &calls), 0);
+
+    atomic_store(&chain_churn_done, false);
+    atomic_store(&chain_extra_calls, 0);
+
+    pthread_t churn;
+    ASSERT_EQ(pthread_create(&churn, NULL, chain_churn_thread, &ic), 0);
+    for (int i = 0; i < IRQ_CHAIN_ROUNDS; i++) {
+        irq_trigger(&ic, INT_SENSOR_READY);
+        irq_process_pending(&ic);
+    }
+    atomic_store(&chain_churn_done, true);
+    pthread_join(churn, NULL);
+
+    /* The permanent handler never saw a torn or missing chain */
+    irq_source_stats_t stats;
+    irq_get_source_stats(&ic, INT_SENSOR_READY, &stats);
+    ASSERT_EQ(stats.deliveries, IRQ_CHAIN_ROUNDS);
+    ASSERT_EQ(calls, IRQ_CHAIN_ROUNDS);
+    ASSERT_TRUE(atomic_load(&chain_extra_calls) <= IRQ_CHAIN_ROUNDS);
+    ASSERT_EQ(irq_handler_count(&ic, INT_SENSOR_READY), 1);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+static void slow_handler(interrupt_source_t source, void *context) {
+    (void)source;
+    (void)context;
+    struct timespec ts = {0, 200000};   /* 200 us */
+    nanosleep(&ts, NULL);
+}
+
+int test_irq_latency_stats(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_MOTOR_FAULT);
+    irq_enable(&ic, INT_SENSOR_READY);
+    irq_register_handler(&ic, INT_MOTOR_FAULT, slow_handler, NULL);
+    irq_register_handler(&ic, INT_SENSOR_READY, test_irq_callback, NULL);
+
+    /* The fault waits behind nothing; its handler takes at least 200 us */
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    irq_process_pending(&ic);
+
+    const shm_irq_stats_t *st = irq_get_stats(&ic);
+    ASSERT_EQ(st->events[INT_MOTOR_FAULT], 1);
+    ASSERT_EQ(st->deliveries[INT_MOTOR_FAULT], 1);
+    ASSERT_EQ(st->raise_latency[INT_MOTOR_FAULT].count, 1);
+    ASSERT_EQ(st->handler_time[INT_MOTOR_FAULT].count, 1);
+    ASSERT_TRUE(st->handler_time[INT_MOTOR_FAULT].min_ns >= 200000);
+
+    /* Coalesced raises are timed once, from the first of them */
+    irq_set_coalesce(&ic, INT_SENSOR_READY, 4, 0);
+    for (int i = 0; i < 4; i++) {
+        irq_trigger(&ic, INT_SENSOR_READY);
+        irq_trigger(&ic, INT_MOTOR_FAULT);
+        irq_process_pending(&ic);
+    }
+    ASSERT_EQ(st->events[INT_SENSOR_READY], 4);
+    ASSERT_EQ(st->deliveries[INT_SENSOR_READY], 1);
+    ASSERT_EQ(st->raise_latency[INT_SENSOR_READY].count, 1);
+    ASSERT_TRUE(st->raise_latency[INT_SENSOR_READY].min_ns >= 3 * 200000);
+
+    /* A cleared IRQ leaves no stale stamp behind */
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_clear(&ic, INT_SENSOR_READY);
+    ASSERT_EQ(atomic_load(&ic.raised_ns[INT_SENSOR_READY]), 0);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+int test_irq_stats_shm(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    ASSERT_EQ(irq_set_stats(&ic, &shm->irq_stats), 0);
+    irq_enable(&ic, INT_MOTOR_FAULT);
+    irq_register_handler(&ic, INT_MOTOR_FAULT, test_irq_callback, NULL);
+    ASSERT_EQ(irq_setup_signal_handler(&ic), 0);
+
+    /* Raised from the signal path, read back by a shared memory client */
+    raise(SIGUSR1);
+    irq_process_pending(&ic);
+
+    shm_irq_stats_t out;
+    ASSERT_EQ(shm_read_irq_stats(shm, &out), 0);
+    ASSERT_EQ(out.events[INT_MOTOR_FAULT], 1);
+    ASSERT_EQ(out.deliveries[INT_MOTOR_FAULT], 1);
+    ASSERT_EQ(out.raise_latency[INT_MOTOR_FAULT].count, 1);
+    ASSERT_EQ(ic.local_stats.deliveries[INT_MOTOR_FAULT], 0);
+
+    shm_reset_irq_stats(shm);
+    shm_read_irq_stats(shm, &out);
+    ASSERT_EQ(out.raise_latency[INT_MOTOR_FAULT].count, 0);
+
+    irq_cleanup(&ic);
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * FAULT TRIP TESTS (3 tests)
+ *===========================================================================*/
+
+#define TRIP_AXES 3
+
+int test_fault_trip_reactions(void) {
+    static register_file_t regs[TRIP_AXES];
+    static motor_bank_t bank;
+    static fault_trip_t ft;
+
+    for (uint32_t i = 0; i < TRIP_AXES; i++) reg_init(&regs[i]);
+    motor_bank_init(&bank, regs, TRIP_AXES);
+    motor_lanes_t lanes = motor_bank_lanes(&bank);
+    ASSERT_EQ(fault_trip_init(&ft, &lanes, 0), -1);
+    ASSERT_EQ(fault_trip_init(&ft, &lanes, TRIP_AXES), 0);
+    ASSERT_EQ(fault_trip_set_reaction(&ft, 1, FAULT_REACT_COAST), 0);
+    ASSERT_EQ(fault_trip_set_reaction(&ft, 2, FAULT_REACT_STOP), 0);
+    ASSERT_EQ(fault_trip_set_reaction(&ft, 0, (fault_reaction_t)7), -1);
+    ASSERT_EQ(fault_trip_set_reaction(&ft, TRIP_AXES, FAULT_REACT_STOP), -1);
+
+    for (uint32_t i = 0; i < TRIP_AXES; i++) {
+        motor_bank_start(&bank, i, 3000, MOTOR_DIR_CW);
+    }
+    for (int i = 0; i < 10; i++) motor_bank_update(&bank);
+
+    for (uint32_t i = 0; i < TRIP_AXES; i++) {
+        ASSERT_EQ(fault_trip_axis(&ft, i, MOTOR_FAULT_OVERCURRENT), 1);
+        ASSERT_EQ(motor_bank_get_state(&bank, i), MOTOR_STATE_FAULT);
+        ASSERT_EQ(motor_bank_get_fault(&bank, i), MOTOR_FAULT_OVERCURRENT);
+        ASSERT_TRUE(reg_read(&regs[i], REG_MOTOR_STATUS) & MOTOR_STATUS_FAULT);
+    }
+
+    /* Brake: drive off and braking; coast: drive off; stop: drive on at zero */
+    uint32_t ctrl = reg_read(&regs[0], REG_MOTOR_CTRL);
+    ASSERT_TRUE((ctrl & MOTOR_CTRL_BRAKE) && !(ctrl & MOTOR_CTRL_ENABLE));
+    ASSERT_EQ(reg_read(&regs[0], REG_MOTOR_SPEED), 0);
+    ASSERT_EQ(motor_bank_get_speed(&bank, 0), 0);
+    ctrl = reg_read(&regs[1], REG_MOTOR_CTRL);
+    ASSERT_TRUE(!(ctrl & MOTOR_CTRL_BRAKE) && !(ctrl & MOTOR_CTRL_ENABLE));
+    ASSERT_EQ(reg_read(&regs[1], REG_MOTOR_SPEED), 3000);
+    ASSERT_TRUE(reg_read(&regs[2], REG_MOTOR_CTRL) & MOTOR_CTRL_ENABLE);
+    ASSERT_EQ(reg_read(&regs[2], REG_MOTOR_SPEED), 0);
+
+    /* The state machine keeps the lanes faulted and leaves the drives alone */
+    motor_bank_update(&bank);
+    ASSERT_EQ(motor_bank_get_state(&bank, 2), MOTOR_STATE_FAULT);
+    ASSERT_EQ(reg_read(&regs[2], REG_MOTOR_SPEED), 0);
+
+    /* A held axis re-applies its reaction without counting a new trip */
+    reg_write(&regs[2], REG_MOTOR_SPEED, 1234);
+    ASSERT_EQ(fault_trip_axis(&ft, 2, MOTOR_FAULT_OVERCURRENT), 0);
+    ASSERT_EQ(reg_read(&regs[2], REG_MOTOR_SPEED), 0);
+    ASSERT_EQ(atomic_load(&ft.trips), TRIP_AXES);
+    ASSERT_EQ(ft.reaction_ns.count, TRIP_AXES);
+
+    /* Clearing the fault re-arms the axis */
+    motor_bank_clear_fault(&bank, 0);
+    motor_bank_update(&bank);
+    ASSERT_EQ(motor_bank_start(&bank, 0, 3000, MOTOR_DIR_CW), 0);
+    ASSERT_EQ(fault_trip_axis(&ft, 0, MOTOR_FAULT_STALL), 1);
+    ASSERT_EQ(motor_bank_get_fault(&bank, 0), MOTOR_FAULT_STALL);
+    ASSERT_TRUE(reg_read(&regs[0], REG_MOTOR_STATUS) & MOTOR_STATUS_STALL);
+    ASSERT_EQ(fault_trip_axis(&ft, TRIP_AXES, MOTOR_FAULT_STALL), -1);
+
+    return TEST_PASS;
+}
+
+int test_fault_trip_irq_fast_path(void) {
+    static register_file_t regs[TRIP_AXES];
+    static motor_bank_t bank;
+    static fault_trip_t ft;
+    interrupt_controller_t ic;
+
+    for (uint32_t i = 0; i < TRIP_AXES; i++) reg_init(&regs[i]);
+    motor_bank_init(&bank, regs, TRIP_AXES);
+    motor_lanes_t lanes = motor_bank_lanes(&bank);
+    fault_trip_init(&ft, &lanes, TRIP_AXES);
+    irq_init(&ic, &regs[0], NULL, NULL);
+    ASSERT_EQ(irq_set_fast_handler(&ic, INT_COUNT, fault_trip_irq, &ft), -1);
+    ASSERT_EQ(irq_set_fast_handler(&ic, INT_MOTOR_FAULT, fault_trip_irq, &ft), 0);
+
+    for (uint32_t i = 0; i < TRIP_AXES; i++) {
+        motor_bank_start(&bank, i, 3000, MOTOR_DIR_CW);
+    }
+    for (int i = 0; i < 10; i++) motor_bank_update(&bank);
+
+    /* Masked sources do not reach the fast handler either */
+    reg_set_bits(&regs[1], REG_MOTOR_STATUS, MOTOR_STATUS_STALL);
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    ASSERT_EQ(motor_bank_get_state(&bank, 1), MOTOR_STATE_RUNNING);
+
+    /* The raise itself trips the axis with the latched cause, before dispatch */
+    irq_enable(&ic, INT_MOTOR_FAULT);
+    irq_trigger(&ic, INT_MOTOR_FAULT);
+    ASSERT_TRUE(irq_is_pending(&ic, INT_MOTOR_FAULT));
+    ASSERT_EQ(motor_bank_get_state(&bank, 1), MOTOR_STATE_FAULT);
+    ASSERT_EQ(motor_bank_get_fault(&bank, 1), MOTOR_FAULT_STALL);
+    ASSERT_EQ(reg_read(&regs[1], REG_MOTOR_SPEED), 0);
+    ASSERT_EQ(motor_bank_get_state(&bank, 0), MOTOR_STATE_RUNNING);
+    ASSERT_EQ(reg_read(&regs[0], REG_MOTOR_SPEED), 3000);
+    irq_process_pending(&ic);
+
+    /* A fault line with nothing latched behind it stops every axis */
+    motor_bank_reset(&bank, 1);
+    motor_bank_start(&bank, 1, 3000, MOTOR_DIR_CW);
+    for (int i = 0; i < 10; i++) motor_bank_update(&bank);
+    irq_signal_handler(SIGUSR1);
+    for (uint32_t i = 0; i < TRIP_AXES; i++) {
+        ASSERT_EQ(motor_bank_get_state(&bank, i), MOTOR_STATE_FAULT);
+        ASSERT_TRUE(!(reg_read(&regs[i], REG_MOTOR_CTRL) & MOTOR_CTRL_ENABLE));
+    }
+    ASSERT_EQ(atomic_load(&ft.trips), 1 + TRIP_AXES);
+
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+typedef struct {
+    fault_trip_t *ft;
+    int calls;
+    int32_t last;
+} trip_probe_t;
+
+static void probe_trip(uint8_t sensor_id, int32_t value, void *context) {
+    trip_probe_t *probe = (trip_probe_t*)context;
+    probe->calls++;
+    probe->last = value;
+    fault_trip_axis(probe->ft, 0, MOTOR_FAULT_OVERCURRENT);
+    (void)sensor_id;
+}
+
+int test_fault_trip_current_sensor(void) {
+    static register_file_t regs[1];
+    static motor_bank_t bank;
+    static fault_trip_t ft;
+    sensor_array_t sa;
+
+    reg_init(&regs[0]);
+    motor_bank_init(&bank, regs, 1);
+    motor_lanes_t lanes = motor_bank_lanes(&bank);
+    fault_trip_init(&ft, &lanes, 1);
+    sensor_array_init(&sa, &regs[0]);
+    sensor_array_enable(&sa);
+
+    trip_probe_t probe = { &ft, 0, 0 };
+    ASSERT_EQ(sensor_set_trip(&sa, SENSOR_COUNT, 100, probe_trip, &probe), -1);
+    ASSERT_EQ(sensor_set_trip(&sa, 3, 4500, probe_trip, &probe), 0);
+    motor_bank_start(&bank, 0, 3000, MOTOR_DIR_CW);
+    for (int i = 0; i < 10; i++) motor_bank_update(&bank);
+
+    sensor_set_simulated_value(&sa, 3, 4499);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    ASSERT_EQ(probe.calls, 0);
+
+    /* The trip sees the reading above the clamp range, on the same update */
+    sensor_set_simulated_value(&sa, 3, 9000);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    ASSERT_EQ(probe.calls, 1);
+    ASSERT_EQ(probe.last, 9000);
+    ASSERT_EQ(sensor_read(&sa, 3), 5000);
+    ASSERT_EQ(motor_bank_get_state(&bank, 0), MOTOR_STATE_FAULT);
+    ASSERT_EQ(reg_read(&regs[0], REG_MOTOR_SPEED), 0);
+
+    /* Every offending sample trips until it is disarmed */
+    sensor_set_simulated_value(&sa, 3, 4500);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    ASSERT_EQ(probe.calls, 2);
+    ASSERT_EQ(atomic_load(&ft.trips), 1);
+
+    ASSERT_EQ(sensor_set_trip(&sa, 3, 0, NULL, NULL), 0);
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    ASSERT_EQ(probe.calls, 2);
+
+    sensor_array_cleanup(&sa);
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * SHARED MEMORY TESTS (25 tests)
+ *===========================================================================*/
+
+int test_shm_create_destroy(void) {
+    shared_mem_t *shm = shm_create();
+    ASSERT_TRUE(shm != NULL);
+
+    shared_mem_t *shm2 = shm_open_existing();
+    ASSERT_TRUE(shm2 != NULL);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_status_update(void) {
+    shared_mem_t *shm = shm_create();
+    ASSERT_TRUE(shm != NULL);
+
+    int32_t sensors[4] = {100, 200, 300, 400};
+    ASSERT_EQ(shm_update_status(shm, 2, 5000, 1234, sensors, 0), 0);
+
+    shm_status_t status;
+    ASSERT_EQ(shm_read_status(shm, &status), 0);
+    ASSERT_EQ(status.motor_state, 2);
+    ASSERT_EQ(status.motor_speed, 5000);
+    ASSERT_EQ(status.motor_position, 1234);
+    ASSERT_EQ(status.sensor_values[0], 100);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_shutdown(void) {
+    shared_mem_t *shm = shm_create();
+    ASSERT_TRUE(shm != NULL);
+
+    ASSERT_TRUE(!shm_is_shutdown_requested(shm));
+    shm_request_shutdown(shm);
+    ASSERT_TRUE(shm_is_shutdown_requested(shm));
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_command_ring(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    uint32_t seq[3];
+    ASSERT_EQ(shm_submit_command(shm, CMD_MOTOR_START, 5000, 1, &seq[0]), 0);
+    ASSERT_EQ(shm_submit_command(shm, CMD_MOTOR_SET_SPEED, 3000, 0, &seq[1]), 0);
+    ASSERT_EQ(shm_submit_command(shm, CMD_GET_STATUS, 0, 0, &seq[2]), 0);
+    ASSERT_EQ(shm_pending_commands(shm), 3);
+    ASSERT_NE(seq[0], 0);
+    ASSERT_TRUE(seq[1] != seq[0] && seq[2] != seq[1]);
+
+    /* Commands drain in submission order with their sequence ids */
+    shm_command_t cmd;
+    ASSERT_EQ(shm_poll_command(shm, &cmd), 0);
+    ASSERT_EQ(cmd.cmd, CMD_MOTOR_START);
+    ASSERT_EQ(cmd.param1, 5000);
+    ASSERT_EQ(cmd.seq_id, seq[0]);
+    ASSERT_EQ(shm_poll_command(shm, &cmd), 0);
+    ASSERT_EQ(cmd.cmd, CMD_MOTOR_SET_SPEED);
+    ASSERT_EQ(cmd.seq_id, seq[1]);
+    ASSERT_EQ(shm_poll_command(shm, &cmd), 0);
+    ASSERT_EQ(cmd.cmd, CMD_GET_STATUS);
+    ASSERT_EQ(cmd.seq_id, seq[2]);
+
+    ASSERT_EQ(shm_poll_command(shm, &cmd), -1);
+    ASSERT_EQ(shm_pending_commands(shm), 0);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_command_ring_full(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    for (int i = 0; i < SHM_CMD_RING_DEPTH; i++) {
+        ASSERT_EQ(shm_send_command(shm, CMD_MOTOR_SET_SPEED, (uint32_t)i, 0), 0);
+    }
+
+    /* Full ring rejects instead of blocking */
+    ASSERT_EQ(shm_send_command(shm, CMD_MOTOR_STOP, 0, 0), -2);
+
+    /* Draining frees slots, and the ring keeps working across laps */
+    shm_command_t cmd;
+    for (int lap = 0; lap < 3; lap++) {
+        for (int i = 0; i < SHM_CMD_RING_DEPTH; i++) {
+            ASSERT_EQ(shm_poll_command(shm, &cmd), 0);
+            ASSERT_EQ(cmd.param1, (uint32_t)i);
+            ASSERT_EQ(shm_send_command(shm, CMD_MOTOR_SET_SPEED, (uint32_t)i, 0), 0);
+        }
+    }
+    ASSERT_EQ(shm_pending_commands(shm), SHM_CMD_RING_DEPTH);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+/* Ring positions and frame ids both cross UINT32_MAX; ids stay distinct */
+int test_shm_command_ring_seq_wrap(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    shm_cmd_ring_t *ring = &shm->cmd_ring;
+    uint32_t start = UINT32_MAX - 2;
+    atomic_store(&ring->head, start);
+    atomic_store(&ring->tail, start);
+    atomic_store(&ring->next_seq, start);
+    for (uint32_t i = 0; i < SHM_CMD_RING_DEPTH; i++) {
+        atomic_store(&ring->slots[(start + i) % SHM_CMD_RING_DEPTH].turn, start + i);
+    }
+
+    uint32_t seen[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        uint32_t seq;
+        ASSERT_EQ(shm_submit_command(shm, CMD_GET_STATUS, i, 0, &seq), 0);
+        ASSERT_NE(seq, 0);
+        for (uint32_t j = 0; j < i; j++) ASSERT_NE(seq, seen[j]);
+        seen[i] = seq;
+
+        shm_command_t cmd;
+        ASSERT_EQ(shm_poll_command(shm, &cmd), 0);
+        ASSERT_EQ(cmd.seq_id, seq);
+        ASSERT_EQ(cmd.param1, i);
+        int32_t data[1] = {(int32_t)i};
+        ASSERT_EQ(shm_complete_command(shm, seq, RESP_OK, data, 1), 0);
+    }
+
+    /* Each id still finds its own answer after the wrap */
+    for (uint32_t i = 0; i < 8; i++) {
+        response_status_t status;
+        int32_t out[1] = {-1};
+        ASSERT_EQ(shm_wait_completion(shm, seen[i], &status, out, 1), 0);
+        ASSERT_EQ(out[0], (int32_t)i);
+    }
+    ASSERT_EQ(shm_pending_commands(shm), 0);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+#define RING_PRODUCERS      4
+#define RING_PER_PRODUCER   1000
+
+static void *ring_producer(void *arg) {
+    shared_mem_t *shm = (shared_mem_t*)arg;
+    for (uint32_t i = 0; i < RING_PER_PRODUCER; i++) {
+        while (shm_send_command(shm, CMD_MOTOR_SET_SPEED, i, 0) != 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int test_shm_command_ring_mpsc(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    pthread_t producers[RING_PRODUCERS];
+    for (int i = 0; i < RING_PRODUCERS; i++) {
+        ASSERT_EQ(pthread_create(&producers[i], NULL, ring_producer, shm), 0);
+    }
+
+    /* Every command from every producer arrives exactly once */
+    int received = 0;
+    uint64_t sum = 0;
+    shm_command_t cmd;
+    while (received < RING_PRODUCERS * RING_PER_PRODUCER) {
+        if (shm_poll_command(shm, &cmd) == 0) {
+            sum += cmd.param1;
+            received++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    for (int i = 0; i < RING_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+
+    uint64_t expected = (uint64_t)RING_PRODUCERS *
+                        (RING_PER_PRODUCER - 1) * RING_PER_PRODUCER / 2;
+    ASSERT_TRUE(sum == expected);
+    ASSERT_EQ(shm_poll_command(shm, &cmd), -1);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+/* Blocking consumer for the wakeup test: sleeps in shm_wait_commands between commands */
+#define WAKEUP_ROUNDS       20000
+#define WAKEUP_TIMEOUT_NS   2000000000ULL
+
+typedef struct {
+    shared_mem_t *shm;
+    _Atomic uint32_t consumed;
+} wakeup_ctx_t;
+
+static void *wakeup_consumer(void *arg) {
+    wakeup_ctx_t *ctx = (wakeup_ctx_t*)arg;
+    shm_command_t ops[SHM_FRAME_MAX_OPS];
+
+    while (shm_wait_commands(ctx->shm) == 0) {
+        if (shm_poll_frame(ctx->shm, ops) > 0) {
+            atomic_fetch_add(&ctx->consumed, 1);
+        }
+    }
+    return NULL;
+}
+
+int test_shm_wakeup_stress(void) {
+    static wakeup_ctx_t ctx;
+    ctx.shm = shm_create_private();
+    ASSERT_TRUE(ctx.shm != NULL);
+    atomic_init(&ctx.consumed, 0);
+
+    pthread_t consumer;
+    ASSERT_EQ(pthread_create(&consumer, NULL, wakeup_consumer, &ctx), 0);
+
+    /*
+     * One command at a time, each submitted just as the consumer goes back
+     * to sleep. Nothing else wakes it, so a lost wakeup stalls the round.
+     */
+    int stalled = 0;
+    for (uint32_t i = 0; i < WAKEUP_ROUNDS && !stalled; i++) {
+        ASSERT_EQ(shm_post_command(ctx.shm, 0, CMD_NONE, i, 0), 0);
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t deadline = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec +
+                            WAKEUP_TIMEOUT_NS;
+        while (atomic_load(&ctx.consumed) != i + 1) {
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            if ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec > deadline) {
+                stalled = 1;
+                break;
+            }
+        }
+    }
+
+    shm_request_shutdown(ctx.shm);
+    pthread_join(consumer, NULL);
+    ASSERT_EQ(stalled, 0);
+    ASSERT_EQ(atomic_load(&ctx.consumed), WAKEUP_ROUNDS);
+
+    shm_destroy(ctx.shm);
+    return TEST_PASS;
+}
+
+int test_shm_command_frame(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    shm_op_t ops[SHM_FRAME_MAX_OPS + 1] = {
+        { CMD_MOTOR_START, 1, 5000, 1 },
+        { CMD_MOTOR_SET_SPEED, 2, 3000, 0 },
+        { CMD_GET_STATUS, 1, 0, 0 },
+    };
+    uint32_t seq, single;
+    ASSERT_EQ(shm_submit_frame(shm, ops, 0, 0, &seq), -1);
+    ASSERT_EQ(shm_submit_frame(shm, ops, SHM_FRAME_MAX_OPS + 1, 0, &seq), -1);
+    ASSERT_EQ(shm_submit_frame(shm, ops, 3, SHM_CMD_FRAME, &seq), -1);
+    ops[1].axis = SHM_MAX_AXES;
+    ASSERT_EQ(shm_submit_frame(shm, ops, 3, 0, &seq), -1);
+    ops[1].axis = 2;
+    ASSERT_EQ(shm_pending_commands(shm), 0);
+
+    ASSERT_EQ(shm_submit_command(shm, CMD_SENSOR_READ, 0, 0, &single), 0);
+    ASSERT_EQ(shm_submit_frame(shm, ops, 3, 0, &seq), 0);
+    ASSERT_EQ(shm_pending_commands(shm), 4);
+
+    /* A plain command is a frame of one; the frame comes out whole */
+    shm_command_t got[SHM_FRAME_MAX_OPS];
+    ASSERT_EQ(shm_poll_frame(shm, got), 1);
+    ASSERT_EQ(got[0].seq_id, single);
+    ASSERT_EQ(got[0].flags, 0);
+    ASSERT_EQ(shm_poll_frame(shm, got), 3);
+    ASSERT_EQ(got[0].frame_ops, 3);
+    ASSERT_EQ(got[2].frame_ops, 0);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(got[i].seq_id, seq);
+        ASSERT_EQ(got[i].cmd, ops[i].cmd);
+        ASSERT_EQ(got[i].axis, ops[i].axis);
+        ASSERT_EQ(got[i].flags, SHM_CMD_FRAME);
+    }
+    ASSERT_EQ(shm_poll_frame(shm, got), -1);
+
+    /* One aggregated answer */
+    shm_frame_result_t res;
+    memset(&res, 0, sizeof(res));
+    res.status = RESP_BUSY;
+    res.ops = 3;
+    res.op_status[1] = RESP_BUSY;
+    res.data[2][1] = 3000;
+    ASSERT_EQ(shm_complete_frame(shm, seq, &res), 0);
+    shm_frame_result_t out;
+    ASSERT_EQ(shm_wait_frame(shm, seq, &out), 0);
+    ASSERT_EQ(out.status, RESP_BUSY);
+    ASSERT_EQ(out.ops, 3);
+    ASSERT_EQ(out.op_status[0], RESP_OK);
+    ASSERT_EQ(out.op_status[1], RESP_BUSY);
+    ASSERT_EQ(out.data[2][1], 3000);
+
+    /* A frame is never split: without room for all of it, nothing is queued */
+    for (int i = 0; i < SHM_CMD_RING_DEPTH - 2; i++) {
+        ASSERT_EQ(shm_post_command(shm, 0, CMD_GET_STATUS, 0, 0), 0);
+    }
+    ASSERT_EQ(shm_submit_frame(shm, ops, 3, 0, &seq), -2);
+    ASSERT_EQ(shm_pending_commands(shm), SHM_CMD_RING_DEPTH - 2);
+    ASSERT_EQ(shm_submit_frame(shm, ops, 2, 0, &seq), 0);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_fire_and_forget(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    ASSERT_EQ(shm_post_command(shm, SHM_MAX_AXES, CMD_MOTOR_STOP, 0, 0), -1);
+    ASSERT_EQ(shm_post_command(shm, 3, CMD_MOTOR_SET_SPEED, 2500, 0), 0);
+    shm_op_t ops[2] = {
+        { CMD_MOTOR_SET_SPEED, 0, 1000, 0 },
+        { CMD_MOTOR_SET_SPEED, 1, 2000, 0 },
+    };
+    uint32_t seq;
+    ASSERT_EQ(shm_submit_frame(shm, ops, 2, SHM_CMD_NO_REPLY, &seq), 0);
+
+    shm_command_t got[SHM_FRAME_MAX_OPS];
+    ASSERT_EQ(shm_poll_frame(shm, got), 1);
+    ASSERT_EQ(got[0].axis, 3);
+    ASSERT_EQ(got[0].param1, 2500);
+    ASSERT_EQ(got[0].flags, SHM_CMD_NO_REPLY);
+    ASSERT_EQ(shm_poll_frame(shm, got), 2);
+    ASSERT_EQ(got[1].flags, SHM_CMD_NO_REPLY | SHM_CMD_FRAME);
+
+    /* Posted commands still get sequence ids, so later requests stay unique */
+    uint32_t next;
+    ASSERT_EQ(shm_submit_command(shm, CMD_GET_STATUS, 0, 0, &next), 0);
+    ASSERT_TRUE(next != seq && next != got[0].seq_id);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+#define FRAME_PRODUCERS     4
+#define FRAME_PER_PRODUCER  500
+#define FRAME_OPS           5
+
+static void *frame_producer(void *arg) {
+    shared_mem_t *shm = g_test_shm;
+    uint32_t id = (uint32_t)(intptr_t)arg;
+    shm_op_t ops[FRAME_OPS];
+
+    for (uint32_t f = 0; f < FRAME_PER_PRODUCER; f++) {
+        for (uint32_t i = 0; i < FRAME_OPS; i++) {
+            ops[i] = (shm_op_t){ CMD_MOTOR_SET_SPEED, 0, id, i };
+        }
+        while (shm_submit_frame(shm, ops, FRAME_OPS, SHM_CMD_NO_REPLY, NULL) != 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int test_shm_frame_mpsc(void) {
+    g_test_shm = shm_create_private();
+    ASSERT_TRUE(g_test_shm != NULL);
+
+    pthread_t producers[FRAME_PRODUCERS];
+    for (intptr_t i = 0; i < FRAME_PRODUCERS; i++) {
+        ASSERT_EQ(pthread_create(&producers[i], NULL, frame_producer, (void*)i), 0);
+    }
+
+    /* No other producer's ops ever land inside a frame */
+    int frames = 0;
+    int per_producer[FRAME_PRODUCERS] = {0};
+    shm_command_t got[SHM_FRAME_MAX_OPS];
+    while (frames < FRAME_PRODUCERS * FRAME_PER_PRODUCER) {
+        int n = shm_poll_frame(g_test_shm, got);
+        if (n < 0) {
+            sched_yield();
+            continue;
+        }
+        ASSERT_EQ(n, FRAME_OPS);
+        for (int i = 0; i < n; i++) {
+            ASSERT_EQ(got[i].param1, got[0].param1);
+            ASSERT_EQ(got[i].param2, (uint32_t)i);
+            ASSERT_EQ(got[i].seq_id, got[0].seq_id);
+        }
+        per_producer[got[0].param1]++;
+        frames++;
+    }
+
+    for (int i = 0; i < FRAME_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+        ASSERT_EQ(per_producer[i], FRAME_PER_PRODUCER);
+    }
+    ASSERT_EQ(shm_poll_frame(g_test_shm, got), -1);
+
+    shm_destroy(g_test_shm);
+    g_test_shm = NULL;
+    return TEST_PASS;
+}
+
+int test_shm_completion_slots(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    uint32_t seq_a, seq_b;
+    ASSERT_EQ(shm_submit_command(shm, CMD_GET_STATUS, 0, 0, &seq_a), 0);
+    ASSERT_EQ(shm_submit_command(shm, CMD_SENSOR_READ, 0, 0, &seq_b), 0);
+
+    /* Complete out of order; each request gets its own data */
+    int32_t data_b[SHM_RESP_WORDS] = {7, 8};
+    int32_t data_a[SHM_RESP_WORDS] = {1, 2};
+    ASSERT_EQ(shm_complete_command(shm, seq_b, RESP_ERROR, data_b, 2), 0);
+    ASSERT_EQ(shm_complete_command(shm, seq_a, RESP_OK, data_a, 2), 0);
+
+    response_status_t status;
+    int32_t out[SHM_RESP_WORDS];
+    ASSERT_EQ(shm_wait_completion(shm, seq_a, &status, out, SHM_RESP_WORDS), 0);
+    ASSERT_EQ(status, RESP_OK);
+    ASSERT_EQ(out[0], 1);
+    ASSERT_EQ(shm_wait_completion(shm, seq_b, &status, out, SHM_RESP_WORDS), 0);
+    ASSERT_EQ(status, RESP_ERROR);
+    ASSERT_EQ(out[1], 8);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_send_wait_response(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    ASSERT_EQ(shm_send_command(shm, CMD_MOTOR_SET_SPEED, 1234, 0), 0);
+
+    /* Driver side: take the command and answer it */
+    command_type_t cmd;
+    uint32_t p1, p2;
+    ASSERT_EQ(shm_try_get_command(shm, &cmd, &p1, &p2), 0);
+    ASSERT_EQ(cmd, CMD_MOTOR_SET_SPEED);
+    int32_t data[1] = {(int32_t)p1};
+    ASSERT_EQ(shm_send_response(shm, RESP_OK, data, 1), 0);
+
+    /* Client side: the legacy call waits on this thread's last command */
+    response_status_t status;
+    int32_t out[1] = {0};
+    ASSERT_EQ(shm_wait_response(shm, &status, out, 1), 0);
+    ASSERT_EQ(status, RESP_OK);
+    ASSERT_EQ(out[0], 1234);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+#define COMPLETION_CLIENTS  4
+#define COMPLETION_ROUNDS   200
+
+static void *completion_client(void *arg) {
+    shared_mem_t *shm = g_test_shm;
+    intptr_t id = (intptr_t)arg;
+
+    for (uint32_t i = 0; i < COMPLETION_ROUNDS; i++) {
+        uint32_t tag = (uint32_t)(id * 100000 + i);
+        while (shm_send_command(shm, CMD_GET_STATUS, tag, 0) != 0) {
+            sched_yield();
+        }
+
+        int32_t out[1];
+        response_status_t status;
+        if (shm_wait_response(shm, &status, out, 1) != 0 || out[0] != (int32_t)tag) {
+            return (void*)1;  /* Got someone else's response */
+        }
+    }
+    return NULL;
+}
+
+int test_shm_completion_many_clients(void) {
+    g_test_shm = shm_create_private();
+    ASSERT_TRUE(g_test_shm != NULL);
+
+    pthread_t clients[COMPLETION_CLIENTS];
+    for (intptr_t i = 0; i < COMPLETION_CLIENTS; i++) {
+        ASSERT_EQ(pthread_create(&clients[i], NULL, completion_client, (void*)i), 0);
+    }
+
+    /* Echo each command's tag back as its response */
+    int served = 0;
+    shm_command_t cmd;
+    while (served < COMPLETION_CLIENTS * COMPLETION_ROUNDS) {
+        if (shm_poll_command(g_test_shm, &cmd) == 0) {
+            int32_t data[1] = {(int32_t)cmd.param1};
+            shm_complete_command(g_test_shm, cmd.seq_id, RESP_OK, data, 1);
+            served++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    int failures = 0;
+    for (int i = 0; i < COMPLETION_CLIENTS; i++) {
+        void *result;
+        pthread_join(clients[i], &result);
+        if (result != NULL) failures++;
+    }
+    ASSERT_EQ(failures, 0);
+
+    shm_destroy(g_test_shm);
+    g_test_shm = NULL;
+    return TEST_PASS;
+}
+
+#define STATUS_PUBLISHES    20000
+
+static void *status_writer(void *arg) {
+    shared_mem_t *shm = (shared_mem_t*)arg;
+
+    /* Every field derives from i, so a torn read is detectable */
+    for (int32_t i = 1; i <= STATUS_PUBLISHES; i++) {
+        int32_t sensors[SHM_STATUS_SENSORS] = {i, i + 1, i + 2, i + 3};
+        shm_update_status(shm, (uint32_t)i, (uint32_t)i * 2, -i, sensors, (uint32_t)i);
+    }
+    return NULL;
+}
+
+int test_shm_status_snapshot(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    pthread_t writer;
+    ASSERT_EQ(pthread_create(&writer, NULL, status_writer, shm), 0);
+
+    shm_status_t st;
+    int torn = 0;
+    do {
+        if (shm_read_status(shm, &st) != 0) continue;
+        int32_t i = (int32_t)st.motor_state;
+        if (st.motor_speed != (uint32_t)i * 2 || st.motor_position != -i ||
+            st.sensor_values[3] != (i ? i + 3 : 0) || st.fault_code != (uint32_t)i) {
+            torn++;
+        }
+    } while (st.motor_state != STATUS_PUBLISHES);
+
+    pthread_join(writer, NULL);
+    ASSERT_EQ(torn, 0);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_loop_stats(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    shm->loop_stats.period_us = 1000;
+    lat_hist_record(&shm->loop_stats.phases[LOOP_PHASE_MOTOR], 1200);
+    lat_hist_record(&shm->loop_stats.phases[LOOP_PHASE_MOTOR], 800);
+    shm->loop_stats.ticks = 2;
+
+    shm_loop_stats_t stats;
+    ASSERT_EQ(shm_read_loop_stats(shm, &stats), 0);
+    ASSERT_EQ(stats.phases[LOOP_PHASE_MOTOR].count, 2);
+    ASSERT_EQ(stats.phases[LOOP_PHASE_MOTOR].max_ns, 1200);
+    ASSERT_EQ(stats.phases[LOOP_PHASE_IRQ].count, 0);
+
+    /* Reset clears counters but keeps the configured period */
+    shm_reset_loop_stats(shm);
+    ASSERT_EQ(shm_read_loop_stats(shm, &stats), 0);
+    ASSERT_EQ(stats.ticks, 0);
+    ASSERT_EQ(stats.phases[LOOP_PHASE_MOTOR].count, 0);
+    ASSERT_EQ(stats.period_us, 1000);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_axis_status(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    /* Commands carry the axis they address */
+    uint32_t seq;
+    ASSERT_EQ(shm_submit_axis_command(shm, 7, CMD_MOTOR_SET_SPEED, 2500, 0, &seq), 0);
+    ASSERT_EQ(shm_submit_command(shm, CMD_MOTOR_STOP, 0, 0, &seq), 0);
+    ASSERT_EQ(shm_submit_axis_command(shm, SHM_MAX_AXES, CMD_MOTOR_STOP, 0, 0, &seq), -1);
+
+    shm_command_t cmd;
+    ASSERT_EQ(shm_poll_command(shm, &cmd), 0);
+    ASSERT_EQ(cmd.axis, 7);
+    ASSERT_EQ(cmd.param1, 2500);
+    ASSERT_EQ(shm_poll_command(shm, &cmd), 0);
+    ASSERT_EQ(cmd.axis, 0);
+
+    shm_axes_status_t axes;
+    memset(&axes, 0, sizeof(axes));
+    axes.axes = 3;
+    for (uint32_t i = 0; i < 3; i++) {
+        axes.state[i] = MOTOR_STATE_RUNNING;
+        axes.speed[i] = 1000 * (i + 1);
+        axes.position[i] = -(int32_t)i;
+    }
+    ASSERT_EQ(shm_publish_axes(shm, &axes), 0);
+
+    shm_axes_status_t out;
+    ASSERT_EQ(shm_read_axes(shm, &out), 0);
+    ASSERT_EQ(out.axes, 3);
+    ASSERT_EQ(out.speed[2], 3000);
+    ASSERT_EQ(out.position[2], -2);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_sensor_stats(void) {
+    shared_mem_t *shm = shm_create();
+    ASSERT_NE(shm, NULL);
+
+    shm_sensor_stats_t in;
+    memset(&in, 0, sizeof(in));
+    in.count[3] = 1000;
+    in.mean[3] = 2500.5;
+    in.variance[3] = 42.25;
+    in.window_min[3] = 2400;
+    in.window_max[3] = 2600;
+    in.over_threshold[3] = 7;
+    ASSERT_EQ(shm_publish_sensor_stats(shm, &in), 0);
+
+    /* Readers in another process map the same region */
+    shared_mem_t *client = shm_open_existing();
+    ASSERT_NE(client, NULL);
+    shm_sensor_stats_t out;
+    ASSERT_EQ(shm_read_sensor_stats(client, &out), 0);
+    ASSERT_EQ(out.count[3], 1000);
+    ASSERT_TRUE(out.mean[3] == 2500.5);
+    ASSERT_TRUE(out.variance[3] == 42.25);
+    ASSERT_EQ(out.window_min[3], 2400);
+    ASSERT_EQ(out.window_max[3], 2600);
+    ASSERT_EQ(out.over_threshold[3], 7);
+
+    shm_close(client);
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_subscribe(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_NE(shm, NULL);
+
+    shm_sub_spec_t bad_axis = { SHM_SUB_FAULT, SHM_MAX_AXES, 0, 0 };
+    shm_sub_spec_t bad_band = { SHM_SUB_SENSOR_BAND, 0, 100, 50 };
+    shm_sub_spec_t bad_type = { (shm_sub_type_t)0, 0, 0, 0 };
+    ASSERT_EQ(shm_subscribe(shm, &bad_axis), -1);
+    ASSERT_EQ(shm_subscribe(shm, &bad_band), -1);
+    ASSERT_EQ(shm_subscribe(shm, &bad_type), -1);
+    ASSERT_EQ(shm_subscribe(shm, NULL), -1);
+
+    /* Fill the table, then free one slot and take it again */
+    shm_sub_spec_t spec = { SHM_SUB_STATE, 0, SHM_SUB_ANY, 0 };
+    for (int i = 0; i < SHM_MAX_SUBS; i++) {
+        ASSERT_EQ(shm_subscribe(shm, &spec), i);
+    }
+    ASSERT_EQ(shm_subscribe(shm, &spec), -2);
+    ASSERT_EQ(shm->subs.armed, 0xFFFFFFFFu);
+
+    ASSERT_EQ(shm_unsubscribe(shm, 5), 0);
+    ASSERT_EQ(shm_unsubscribe(shm, 5), -1);
+    ASSERT_EQ(shm->subs.armed & (1u << 5), 0);
+    shm_sub_event_t ev;
+    ASSERT_EQ(shm_read_event(shm, 5, &ev), -1);
+
+    /* The slot is only reusable once a driver pass has let go of it */
+    shm_axes_status_t axes;
+    memset(&axes, 0, sizeof(axes));
+    axes.axes = 1;
+    ASSERT_EQ(shm_subscribe(shm, &spec), -2);
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, NULL, 0, 1), 0);
+    ASSERT_EQ(shm->subs.draining, 0);
+    ASSERT_EQ(shm_subscribe(shm, &spec), 5);
+
+    for (int i = 0; i < SHM_MAX_SUBS; i++) {
+        ASSERT_EQ(shm_unsubscribe(shm, i), 0);
+    }
+    ASSERT_EQ(shm->subs.armed, 0);
+
+    /* Nothing subscribed: evaluation is a no-op */
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, NULL, 0, 2), 0);
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, NULL, 0, 3), 0);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_subscription_edges(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_NE(shm, NULL);
+
+    shm_axes_status_t axes;
+    memset(&axes, 0, sizeof(axes));
+    axes.axes = 2;
+    axes.state[1] = MOTOR_STATE_RUNNING;
+    axes.position[1] = 50;
+    int32_t sensors[4] = { 0, 0, 0, 2000 };
+
+    shm_sub_spec_t fault_spec = { SHM_SUB_FAULT, 1, 0, 0 };
+    shm_sub_spec_t state_spec = { SHM_SUB_STATE, 1, MOTOR_STATE_FAULT, 0 };
+    shm_sub_spec_t pos_spec = { SHM_SUB_POSITION, 1, 100, 0 };
+    shm_sub_spec_t band_spec = { SHM_SUB_SENSOR_BAND, 3, 0, 4000 };
+    shm_sub_spec_t far_spec = { SHM_SUB_STATE, 7, SHM_SUB_ANY, 0 };
+    int fault_id = shm_subscribe(shm, &fault_spec);
+    int state_id = shm_subscribe(shm, &state_spec);
+    int pos_id = shm_subscribe(shm, &pos_spec);
+    int band_id = shm_subscribe(shm, &band_spec);
+    int far_id = shm_subscribe(shm, &far_spec);
+    ASSERT_TRUE(fault_id >= 0 && state_id >= 0 && pos_id >= 0 && band_id >= 0 && far_id >= 0);
+
+    /* The first tick only records the current values */
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 1), 0);
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 2), 0);
+
+    /* Position crosses 100 upwards, then back down */
+    axes.position[1] = 150;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 3), 1);
+    axes.position[1] = 120;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 4), 0);
+    axes.position[1] = 90;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 5), 1);
+    shm_sub_event_t ev;
+    ASSERT_EQ(shm_read_event(shm, pos_id, &ev), 0);
+    ASSERT_EQ(ev.count, 2);
+    ASSERT_EQ(ev.value, 90);
+    ASSERT_EQ(ev.tick, 5);
+
+    /* A fault moves the axis into FAULT: both fire once */
+    axes.fault_code[1] = MOTOR_FAULT_OVERCURRENT;
+    axes.state[1] = MOTOR_STATE_FAULT;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 6), 2);
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 7), 0);
+    ASSERT_EQ(shm_read_event(shm, fault_id, &ev), 0);
+    ASSERT_EQ(ev.count, 1);
+    ASSERT_EQ(ev.value, MOTOR_FAULT_OVERCURRENT);
+    ASSERT_EQ(shm_read_event(shm, state_id, &ev), 0);
+    ASSERT_EQ(ev.value, MOTOR_STATE_FAULT);
+
+    /* Clearing is not an event for either */
+    axes.fault_code[1] = MOTOR_FAULT_NONE;
+    axes.state[1] = MOTOR_STATE_IDLE;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 8), 0);
+
+    /* The sensor leaving its band fires; coming back does not */
+    sensors[3] = 4500;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 9), 1);
+    sensors[3] = 4800;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 10), 0);
+    sensors[3] = 3000;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, sensors, 4, 11), 0);
+    ASSERT_EQ(shm_read_event(shm, band_id, &ev), 0);
+    ASSERT_EQ(ev.count, 1);
+    ASSERT_EQ(ev.value, 4500);
+
+    /* An axis the driver does not report never fires */
+    ASSERT_EQ(shm_read_event(shm, far_id, &ev), 0);
+    ASSERT_EQ(ev.count, 0);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+typedef struct {
+    shared_mem_t *shm;
+    int id;
+    uint32_t seen;
+    int ret;
+    shm_sub_event_t ev;
+} sub_waiter_t;
+
+static void *sub_waiter_thread(void *arg) {
+    sub_waiter_t *w = (sub_waiter_t*)arg;
+    w->ret = shm_wait_event(w->shm, w->id, w->seen, &w->ev);
+    return NULL;
+}
+
+int test_shm_subscription_wait(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_NE(shm, NULL);
+
+    shm_axes_status_t axes;
+    memset(&axes, 0, sizeof(axes));
+    axes.axes = 1;
+
+    shm_sub_spec_t spec = { SHM_SUB_STATE, 0, SHM_SUB_ANY, 0 };
+    sub_waiter_t fired = { shm, shm_subscribe(shm, &spec), 0, 1, { 0, 0, 0 } };
+    sub_waiter_t dropped = { shm, shm_subscribe(shm, &spec), 0, 1, { 0, 0, 0 } };
+    ASSERT_TRUE(fired.id >= 0 && dropped.id >= 0);
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, NULL, 0, 1), 0);
+
+    pthread_t t1, t2;
+    ASSERT_EQ(pthread_create(&t1, NULL, sub_waiter_thread, &fired), 0);
+    ASSERT_EQ(pthread_create(&t2, NULL, sub_waiter_thread, &dropped), 0);
+    usleep(20000);  /* Let both block */
+
+    ASSERT_EQ(shm_unsubscribe(shm, dropped.id), 0);
+    pthread_join(t2, NULL);
+    ASSERT_EQ(dropped.ret, -1);
+
+    axes.state[0] = MOTOR_STATE_STARTING;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, NULL, 0, 2), 1);
+    pthread_join(t1, NULL);
+    ASSERT_EQ(fired.ret, 0);
+    ASSERT_EQ(fired.ev.count, 1);
+    ASSERT_EQ(fired.ev.value, MOTOR_STATE_STARTING);
+    ASSERT_EQ(fired.ev.tick, 2);
+
+    /* Already-seen count: returns at once with the latest event */
+    shm_sub_event_t ev;
+    ASSERT_EQ(shm_wait_event(shm, fired.id, 0, &ev), 0);
+    ASSERT_EQ(ev.count, 1);
+
+    /* Shutdown releases a waiter that has nothing new */
+    fired.seen = 1;
+    fired.ret = 1;
+    ASSERT_EQ(pthread_create(&t1, NULL, sub_waiter_thread, &fired), 0);
+    usleep(20000);
+    shm_request_shutdown(shm);
+    pthread_join(t1, NULL);
+    ASSERT_EQ(fired.ret, -2);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_subscription_owner(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_NE(shm, NULL);
+
+    shm_sub_spec_t spec = { SHM_SUB_STATE, 0, SHM_SUB_ANY, 0 };
+    int id = shm_subscribe(shm, &spec);
+    ASSERT_TRUE(id >= 0);
+    uint32_t gen = atomic_load(&shm->subs.slots[id].gen);
+    ASSERT_EQ(gen & 1, 0);  /* Spec published */
+
+    /* Another process cannot drop it */
+    pid_t pid = fork();
+    ASSERT_TRUE(pid >= 0);
+    if (pid == 0) {
+        _exit(shm_unsubscribe(shm, id) == -1 ? 0 : 1);
+    }
+    int wstatus;
+    ASSERT_EQ(waitpid(pid, &wstatus, 0), pid);
+    ASSERT_TRUE(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+    shm_sub_event_t ev;
+    ASSERT_EQ(shm_read_event(shm, id, &ev), 0);
+
+    /* The owner can, once; taking the slot again republishes the spec */
+    ASSERT_EQ(shm_unsubscribe(shm, id), 0);
+    ASSERT_EQ(shm_unsubscribe(shm, id), -1);
+    ASSERT_EQ(shm_eval_subscriptions(shm, NULL, NULL, 0, 1), 0);
+    ASSERT_EQ(shm_subscribe(shm, &spec), id);
+    ASSERT_EQ(atomic_load(&shm->subs.slots[id].gen), gen + 2);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_saved_state(void) {
+    static shm_driver_state_t st, out;
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    /* A fresh segment holds no save */
+    ASSERT_EQ(shm_load_state(shm, &out), -3);
+
+    memset(&st, 0, sizeof(st));
+    st.axes = 2;
+    st.sensors = 4;
+    st.period_us = 1000;
+    st.tick = 10;
+    st.axis[1].position = -1234;
+    st.axis[1].integral = 1LL << 40;
+    ASSERT_EQ(shm_save_state(shm, &st), 0);
+    ASSERT_EQ(shm_load_state(shm, &out), 0);
+    ASSERT_EQ(out.version, SHM_STATE_VERSION);
+    ASSERT_TRUE(out.generation == 1 && out.tick == 10);
+    ASSERT_EQ(out.axes, 2);
+    ASSERT_EQ(out.axis[1].position, -1234);
+    ASSERT_TRUE(out.axis[1].integral == 1LL << 40);
+
+    st.tick = 11;
+    ASSERT_EQ(shm_save_state(shm, &st), 0);
+    ASSERT_EQ(shm_load_state(shm, &out), 0);
+    ASSERT_TRUE(out.generation == 2 && out.tick == 11);
+
+    /* A save torn by a crash falls back to the one before */
+    uint32_t cur = atomic_load(&shm->saved.current);
+    shm->saved.copy[cur].axis[1].position ^= 1;
+    ASSERT_EQ(shm_load_state(shm, &out), 0);
+    ASSERT_TRUE(out.tick == 10);
+
+    /* Neither copy usable: nothing to restore */
+    shm->saved.copy[cur ^ 1].version = SHM_STATE_VERSION + 1;
+    ASSERT_EQ(shm_load_state(shm, &out), -3);
+
+    st.axes = 0;
+    ASSERT_EQ(shm_save_state(shm, &st), -1);
+    st.axes = SHM_MAX_AXES + 1;
+    ASSERT_EQ(shm_save_state(shm, &st), -1);
+
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_shm_attach(void) {
+    static shm_driver_state_t st, out;
+    shared_mem_t *shm = shm_create();
+    ASSERT_TRUE(shm != NULL);
+    shared_mem_t *client = shm_open_existing();
+    ASSERT_TRUE(client != NULL);
+
+    /* What the old driver leaves behind: a subscription, a command it took, one queued */
+    shm_sub_spec_t spec = { SHM_SUB_POSITION, 0, 100, 0 };
+    int id = shm_subscribe(client, &spec);
+    ASSERT_TRUE(id >= 0);
+    uint32_t seq;
+    ASSERT_EQ(shm_submit_command(client, CMD_GET_STATUS, 0, 0, &seq), 0);
+    shm_command_t ops[SHM_FRAME_MAX_OPS];
+    ASSERT_EQ(shm_poll_frame(shm, ops), 1);
+    ASSERT_EQ(shm_post_command(client, 0, CMD_MOTOR_STOP, 0, 0), 0);
+
+    memset(&st, 0, sizeof(st));
+    st.axes = 1;
+    st.tick = 42;
+    ASSERT_EQ(shm_save_state(shm, &st), 0);
+    shm_close(shm);
+
+    /* The next driver gets the same segment back, untouched */
+    shm = shm_attach();
+    ASSERT_TRUE(shm != NULL);
+    ASSERT_EQ(shm->driver_pid, (int32_t)getpid());
+    ASSERT_TRUE(!shm_is_shutdown_requested(shm));
+    ASSERT_EQ(shm_load_state(shm, &out), 0);
+    ASSERT_TRUE(out.tick == 42);
+    ASSERT_EQ(atomic_load(&shm->subs.armed), 1u << id);
+    ASSERT_EQ(shm_pending_commands(shm), 1);
+    ASSERT_EQ(shm_poll_frame(shm, ops), 1);
+    ASSERT_EQ(ops[0].cmd, CMD_MOTOR_STOP);
+
+    /* The command lost with the old driver is answered, for the client to retry */
+    response_status_t status = RESP_OK;
+    ASSERT_EQ(shm_wait_completion(client, seq, &status, NULL, 0), 0);
+    ASSERT_EQ(status, RESP_BUSY);
+
+    /* The client's mapping still reaches the driver */
+    shm_axes_status_t axes;
+    memset(&axes, 0, sizeof(axes));
+    axes.axes = 1;
+    shm_eval_subscriptions(shm, &axes, NULL, 0, 42);
+    axes.position[0] = 150;
+    ASSERT_EQ(shm_eval_subscriptions(shm, &axes, NULL, 0, 43), 1);
+    shm_sub_event_t ev;
+    ASSERT_EQ(shm_read_event(client, id, &ev), 0);
+    ASSERT_TRUE(ev.count == 1 && ev.tick == 43);
+    shm_close(client);
+
+    /* A segment laid out by another build is not reused */
+    shm->layout_version++;
+    ASSERT_TRUE(shm_attach() == NULL);
+    shm->layout_version--;
+
+    shm_destroy(shm);
+    ASSERT_TRUE(shm_attach() == NULL);
+    return TEST_PASS;
+}
+
+static void *attach_consumer(void *arg) {
+    shared_mem_t *shm = (shared_mem_t*)arg;
+    command_type_t cmd = CMD_NONE;
+    uint32_t p1 = 0, p2 = 0;
+    if (shm_get_command(shm, &cmd, &p1, &p2) != 0) return (void*)1;
+    return (void*)(intptr_t)(cmd == CMD_MOTOR_SET_SPEED && p1 == 777 ? 0 : 1);
+}
+
+/* A driver killed asleep on the command wait leaves nothing that blocks the next */
+int test_shm_attach_after_waiter_died(void) {
+    shared_mem_t *shm = shm_create();
+    ASSERT_TRUE(shm != NULL);
+
+    pid_t pid = fork();
+    ASSERT_TRUE(pid >= 0);
+    if (pid == 0) {
+        shm_wait_commands(shm);
+        _exit(0);
+    }
+    for (int i = 0; i < 1000 && atomic_load(&shm->cmd_ring.waiters) == 0; i++) {
+        usleep(1000);
+    }
+    ASSERT_EQ(atomic_load(&shm->cmd_ring.waiters), 1);
+    kill(pid, SIGKILL);
+    ASSERT_EQ(waitpid(pid, NULL, 0), pid);
+    shm_close(shm);
+
+    /* The next driver sleeps, and a client's command wakes it */
+    shm = shm_attach();
+    ASSERT_TRUE(shm != NULL);
+    ASSERT_EQ(atomic_load(&shm->cmd_ring.waiters), 0);
+    shared_mem_t *client = shm_open_existing();
+    ASSERT_TRUE(client != NULL);
+
+    pthread_t consumer;
+    ASSERT_EQ(pthread_create(&consumer, NULL, attach_consumer, shm), 0);
+    usleep(20000);  /* Let it block */
+    ASSERT_EQ(shm_send_command(client, CMD_MOTOR_SET_SPEED, 777, 0), 0);
+    void *ret;
+    pthread_join(consumer, &ret);
+    ASSERT_TRUE(ret == NULL);
+
+    shm_close(client);
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * SAMPLE STREAM TESTS (4 tests)
+ *===========================================================================*/
+
+#define STREAM_SAMPLES  20000
+
+static void *stream_reader_thread(void *arg) {
+    sample_stream_reader_t *reader = (sample_stream_reader_t*)arg;
+    sensor_sample_t batch[64];
+    int32_t expected = 0;
+
+    while (expected < STREAM_SAMPLES) {
+        int n = sample_stream_read(reader, batch, 64);
+        if (n == 0) {
+            sample_stream_wait(reader, 100);
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (batch[i].value != expected++) return (void*)1;  /* Gap or reorder */
+        }
+    }
+    return NULL;
+}
+
+int test_stream_broadcast(void) {
+    sample_stream_t *stream = sample_stream_create_private();
+    ASSERT_NE(stream, NULL);
+
+    sample_stream_reader_t readers[2];
+    ASSERT_EQ(sample_stream_attach(stream, &readers[0]), 0);
+    ASSERT_EQ(sample_stream_attach(stream, &readers[1]), 0);
+    ASSERT_EQ(sample_stream_reader_count(stream), 2);
+
+    /* Both readers see every sample; a sleeping one is woken by publish */
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(pthread_create(&threads[i], NULL, stream_reader_thread, &readers[i]), 0);
+    }
+
+    /* Publish slower than the readers so nothing is lapped */
+    sensor_sample_t batch[16];
+    for (int32_t v = 0; v < STREAM_SAMPLES; ) {
+        for (int i = 0; i < 16; i++, v++) {
+            batch[i].timestamp_ns = (uint64_t)v;
+            batch[i].value = v;
+            batch[i].sensor_id = 0;
+            batch[i].flags = 0;
+        }
+        ASSERT_EQ(sample_stream_publish(stream, batch, 16), 16);
+        while (sample_stream_available(&readers[0]) > SAMPLE_STREAM_DEPTH / 2 ||
+               sample_stream_available(&readers[1]) > SAMPLE_STREAM_DEPTH / 2) {
+            sched_yield();
+        }
+    }
+
+    for (int i = 0; i < 2; i++) {
+        void *result;
+        pthread_join(threads[i], &result);
+        ASSERT_TRUE(result == NULL);
+        ASSERT_EQ(readers[i].lost, 0);
+        sample_stream_detach(&readers[i]);
+    }
+    ASSERT_EQ(sample_stream_reader_count(stream), 0);
+
+    sample_stream_destroy(stream);
+    return TEST_PASS;
+}
+
+int test_stream_overrun(void) {
+    sample_stream_t *stream = sample_stream_create_private();
+    ASSERT_NE(stream, NULL);
+
+    sample_stream_reader_t reader;
+    ASSERT_EQ(sample_stream_attach(stream, &reader), 0);
+
+    /* Lap a stalled reader; the writer never waits for it */
+    sensor_sample_t sample = {0, 0, 1, 0};
+    for (int32_t v = 0; v < SAMPLE_STREAM_DEPTH + 100; v++) {
+        sample.value = v;
+        ASSERT_EQ(sample_stream_publish(stream, &sample, 1), 1);
+    }
+    ASSERT_EQ(sample_stream_available(&reader), SAMPLE_STREAM_DEPTH);
+
+    /* It resumes at the oldest intact sample and counts the rest as lost */
+    ASSERT_EQ(sample_stream_read(&reader, &sample, 1), 1);
+    ASSERT_EQ(sample.value, 100);
+    ASSERT_EQ(reader.lost, 100);
+    ASSERT_EQ(atomic_load(&stream->readers[reader.index].lost), 100);
+
+    /* Nothing new: read returns nothing and wait times out */
+    sample_stream_reader_t idle;
+    ASSERT_EQ(sample_stream_attach(stream, &idle), 0);
+    ASSERT_EQ(sample_stream_read(&idle, &sample, 1), 0);
+    ASSERT_EQ(sample_stream_wait(&idle, 1), -2);
+
+    sample_stream_detach(&idle);
+    sample_stream_detach(&reader);
+    sample_stream_destroy(stream);
+    return TEST_PASS;
+}
+
+int test_stream_sensor_publish(void) {
+    register_file_t rf;
+    sensor_array_t sa;
+    sample_stream_t *stream = sample_stream_create_private();
+    ASSERT_NE(stream, NULL);
+
+    sample_stream_reader_t reader;
+    ASSERT_EQ(sample_stream_attach(stream, &reader), 0);
+
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    sensor_array_set_stream(&sa, stream);
+    sensor_array_enable(&sa);
+    sensor_set_simulated_value(&sa, 1, 4321);
+
+    /* Streaming does not depend on continuous mode or the local ring */
+    sensor_array_trigger(&sa);
+    sensor_array_update(&sa);
+    ASSERT_EQ(sensor_buffer_count(&sa), 0);
+
+    sensor_sample_t samples[8];
+    ASSERT_EQ(sample_stream_read(&reader, samples, 8), SENSOR_COUNT);
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        ASSERT_EQ(samples[i].sensor_id, i);
+    }
+    ASSERT_EQ(samples[1].value, 4321);
+
+    sample_stream_detach(&reader);
+    sensor_array_cleanup(&sa);
+    sample_stream_destroy(stream);
+    return TEST_PASS;
+}
+
+int test_stream_filtered_decimation(void) {
+    register_file_t rf;
+    sensor_array_t sa;
+    sample_stream_t *stream = sample_stream_create_private();
+    ASSERT_NE(stream, NULL);
+
+    sample_stream_reader_t reader;
+    ASSERT_EQ(sample_stream_attach(stream, &reader), 0);
+
+    reg_init(&rf);
+    sensor_array_init(&sa, &rf);
+    sensor_array_set_stream(&sa, stream);
+    sensor_array_set_continuous(&sa, true);
+    sensor_array_enable(&sa);
+
+    /* Velocity is decimated by 8; the other sensors still stream raw */
+    sensor_filter_t decim = { SENSOR_SPIKE_NONE, 0, 0, 8 };
+    ASSERT_EQ(sensor_set_filter(&sa, 1, &decim), 0);
+    sensor_set_simulated_value(&sa, 1, 3000);
+    sensor_array_trigger(&sa);
+    for (int i = 0; i < 64; i++) {
+        sensor_array_update(&sa);
+    }
+
+    sensor_sample_t samples[512];
+    int n = sample_stream_read(&reader, samples, 512);
+    int raw = 0;
+    int filtered = 0;
+    for (int i = 0; i < n; i++) {
+        if (samples[i].sensor_id == 1) {
+            ASSERT_TRUE(samples[i].flags & SENSOR_SAMPLE_FILTERED);
+            ASSERT_EQ(samples[i].value, 3000);
+            filtered++;
+        } else {
+            ASSERT_EQ(samples[i].flags & SENSOR_SAMPLE_FILTERED, 0);
+            raw++;
+        }
+    }
+    ASSERT_EQ(raw, 3 * 64);
+    ASSERT_EQ(filtered, 64 / 8);
+
+    /* The local buffer still has every raw sample */
+    ASSERT_EQ(sensor_buffer_count(&sa), SENSOR_COUNT * 64);
+
+    sample_stream_detach(&reader);
+    sensor_array_cleanup(&sa);
+    sample_stream_destroy(stream);
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * LATENCY HISTOGRAM TESTS (2 tests)
+ *===========================================================================*/
+
+int test_latency_hist_buckets(void) {
+    uint32_t prev = 0;
+
+    for (uint32_t v = 1; v < 100000000; v = v * 3 / 2 + 1) {
+        uint32_t idx = lat_hist_bucket_index(v);
+        uint32_t floor = lat_hist_bucket_floor(idx);
+
+        ASSERT_TRUE(idx < LAT_HIST_BUCKETS);
+        ASSERT_TRUE(idx >= prev);            /* Monotonic */
+        ASSERT_TRUE(floor <= v);
+        ASSERT_TRUE((uint64_t)(v - floor) * LAT_HIST_SUB_COUNT <= v);  /* <= 1/16 error */
+        prev = idx;
+    }
+
+    ASSERT_EQ(lat_hist_bucket_index(UINT32_MAX), LAT_HIST_BUCKETS - 1);
+    return TEST_PASS;
+}
+
+int test_latency_hist_percentile(void) {
+    lat_hist_t h;
+    lat_hist_reset(&h);
+
+    for (uint32_t v = 1; v <= 1000; v++) {
+        lat_hist_record(&h, v * 1000);
+    }
+
+    ASSERT_EQ(h.count, 1000);
+    ASSERT_EQ(h.min_ns, 1000);
+    ASSERT_EQ(h.max_ns, 1000000);
+    ASSERT_EQ(lat_hist_mean(&h), 500500);
+
+    uint32_t p50 = lat_hist_percentile(&h, 5000);
+    uint32_t p99 = lat_hist_percentile(&h, 9900);
+    ASSERT_TRUE(p50 >= 500000 && p50 <= 500000 + 500000 / 16 + 1);
+    ASSERT_TRUE(p99 >= 990000 && p99 <= 1000000);
+    ASSERT_EQ(lat_hist_percentile(&h, 10000), 1000000);
+
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * EVENT LOOP TESTS (4 tests)
+ *===========================================================================*/
+
+int test_event_loop_tick(void) {
+    event_loop_t loop;
+    ASSERT_EQ(event_loop_init(&loop, 1000, NULL, NULL), 0);
+
+    uint64_t start = event_loop_now_ns();
+    int ticks = 0;
+    while (ticks < 20) {
+        uint32_t events;
+        ASSERT_TRUE(event_loop_wait(&loop, &events) >= 0);
+        if (events & LOOP_EVENT_TICK) ticks++;
+    }
+    uint64_t elapsed = event_loop_now_ns() - start;
+
+    /* Ticks follow absolute deadlines: never early, counted exactly */
+    ASSERT_TRUE(loop.ticks >= 20);
+    ASSERT_TRUE(elapsed >= 19 * 1000000ULL);
+
+    event_loop_cleanup(&loop);
+    return TEST_PASS;
+}
+
+int test_event_loop_set_period(void) {
+    event_loop_t loop;
+    ASSERT_EQ(event_loop_init(&loop, EVENT_LOOP_DEFAULT_PERIOD_US, NULL, NULL), 0);
+
+    /* 10 kHz is accepted, anything faster is rejected */
+    ASSERT_EQ(event_loop_set_period(&loop, EVENT_LOOP_MIN_PERIOD_US), 0);
+    ASSERT_EQ(event_loop_set_period(&loop, EVENT_LOOP_MIN_PERIOD_US - 1), -1);
+    ASSERT_EQ(loop.period_us, EVENT_LOOP_MIN_PERIOD_US);
+
+    uint64_t start = event_loop_now_ns();
+    while (loop.ticks < 50) {
+        uint32_t events;
+        ASSERT_TRUE(event_loop_wait(&loop, &events) >= 0);
+    }
+
+    /* 50 ticks at 100 us must take well under one default period each */
+    ASSERT_TRUE(event_loop_now_ns() - start < 50ULL * EVENT_LOOP_DEFAULT_PERIOD_US * 1000);
+
+    event_loop_cleanup(&loop);
+    return TEST_PASS;
+}
+
+int test_event_loop_shutdown_flag(void) {
+    shared_mem_t *shm = shm_create_private();
+    ASSERT_TRUE(shm != NULL);
+
+    /* Commands do not wake the loop; a flagged shutdown shows on the next tick */
+    event_loop_t loop;
+    ASSERT_EQ(event_loop_init(&loop, 1000, shm, NULL), 0);
+
+    uint32_t events = 0;
+    shm_send_command(shm, CMD_GET_STATUS, 0, 0);
+    ASSERT_TRUE(event_loop_wait(&loop, &events) >= 0);
+    ASSERT_EQ(events, LOOP_EVENT_TICK);
+    ASSERT_EQ(shm_pending_commands(shm), 1);
+
+    shm_request_shutdown(shm);
+    ASSERT_TRUE(event_loop_wait(&loop, &events) >= 0);
+    ASSERT_TRUE(events & LOOP_EVENT_SHUTDOWN);
+
+    event_loop_cleanup(&loop);
+    shm_destroy(shm);
+    return TEST_PASS;
+}
+
+int test_event_loop_irq_signal(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_enable(&ic, INT_MOTOR_FAULT);
+
+    event_loop_t loop;
+    ASSERT_EQ(event_loop_init(&loop, 1000000, NULL, &ic), 0);
+
+    /* SIGUSR1 arrives through the signalfd; the fault IRQ is raised on delivery */
+    kill(getpid(), SIGUSR1);
+
+    uint32_t events = 0;
+    while (!(events & LOOP_EVENT_IRQ)) {
+        ASSERT_TRUE(event_loop_wait(&loop, &events) >= 0);
+    }
+    ASSERT_TRUE(!irq_is_pending(&ic, INT_MOTOR_FAULT));
+    ASSERT_EQ(event_loop_deliver_irqs(&loop), 1);
+    ASSERT_TRUE(irq_is_pending(&ic, INT_MOTOR_FAULT));
+    ASSERT_EQ(event_loop_deliver_irqs(&loop), 0);
+
+    event_loop_cleanup(&loop);
+    irq_cleanup(&ic);
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * RT THREAD TESTS (4 tests)
+ *===========================================================================*/
+
+int test_log_queue_order(void) {
+    static log_queue_t q;
+    log_queue_init(&q);
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(log_printf(&q, "line %d\n", i), 0);
+    }
+
+    char buf[1024];
+    FILE *out = fmemopen(buf, sizeof(buf), "w");
+    ASSERT_NE(out, NULL);
+    ASSERT_EQ(log_queue_drain(&q, out), 10);
+    ASSERT_EQ(log_queue_drain(&q, out), 0);
+    fclose(out);
+    ASSERT_TRUE(strncmp(buf, "line 0\nline 1\n", 14) == 0);
+    ASSERT_TRUE(strstr(buf, "line 9\n") != NULL);
+
+    /* Long lines are cut at LOG_LINE_MAX and still terminated */
+    char wide[LOG_LINE_MAX * 2];
+    memset(wide, 'x', sizeof(wide) - 1);
+    wide[sizeof(wide) - 1] = '\0';
+    ASSERT_EQ(log_printf(&q, "%s", wide), 0);
+    out = fmemopen(buf, sizeof(buf), "w");
+    ASSERT_EQ(log_queue_drain(&q, out), 1);
+    fclose(out);
+    ASSERT_EQ(strlen(buf), LOG_LINE_MAX - 1);
+
+    ASSERT_EQ(log_printf(NULL, "x"), -1);
+    return TEST_PASS;
+}
+
+int test_log_queue_full(void) {
+    static log_queue_t q;
+    log_queue_init(&q);
+
+    /* A full queue drops and counts instead of blocking the producer */
+    for (int i = 0; i < LOG_QUEUE_DEPTH; i++) {
+        ASSERT_EQ(log_printf(&q, "%d\n", i), 0);
+    }
+    ASSERT_EQ(log_printf(&q, "lost\n"), -2);
+    ASSERT_EQ(log_printf(&q, "lost\n"), -2);
+    ASSERT_EQ(log_queue_dropped(&q), 2);
+
+    FILE *out = fopen("/dev/null", "w");
+    ASSERT_NE(out, NULL);
+    ASSERT_EQ(log_queue_drain(&q, out), LOG_QUEUE_DEPTH);
+    ASSERT_EQ(log_printf(&q, "room again\n"), 0);
+    ASSERT_EQ(log_queue_wait(&q, 0), 1);
+    ASSERT_EQ(log_queue_drain(&q, out), 1);
+    fclose(out);
+
+    /* Nothing queued: the wait times out empty */
+    ASSERT_EQ(log_queue_wait(&q, 10), 0);
+    return TEST_PASS;
+}
+
+#define LOG_PRODUCERS       4
+#define LOG_LINES_EACH      5000
+
+static log_queue_t g_mpsc_log;
+
+static void *log_producer_thread(void *arg) {
+    int id = (int)(intptr_t)arg;
+    for (int i = 0; i < LOG_LINES_EACH; i++) {
+        while (log_printf(&g_mpsc_log, "%d %d\n", id, i) != 0) {
+            sched_yield();  /* Retry what a full queue dropped */
+        }
+    }
+    return NULL;
+}
+
+int test_log_queue_mpsc(void) {
+    log_queue_init(&g_mpsc_log);
+
+    pthread_t producers[LOG_PRODUCERS];
+    for (int i = 0; i < LOG_PRODUCERS; i++) {
+        ASSERT_EQ(pthread_create(&producers[i], NULL, log_producer_thread, (void*)(intptr_t)i), 0);
+    }
+
+    /* Every producer's lines arrive complete and in its own order */
+    int next[LOG_PRODUCERS] = {0};
+    int total = 0;
+    char *buf = malloc(LOG_QUEUE_DEPTH * LOG_LINE_MAX);
+    ASSERT_NE(buf, NULL);
+    while (total < LOG_PRODUCERS * LOG_LINES_EACH) {
+        log_queue_wait(&g_mpsc_log, 10);
+        FILE *out = fmemopen(buf, LOG_QUEUE_DEPTH * LOG_LINE_MAX, "w");
+        ASSERT_NE(out, NULL);
+        int n = log_queue_drain(&g_mpsc_log, out);
+        fclose(out);
+
+        char *line = buf;
+        for (int i = 0; i < n; i++) {
+            int id, seq;
+            ASSERT_EQ(sscanf(line, "%d %d", &id, &seq), 2);
+            ASSERT_TRUE(id >= 0 && id < LOG_PRODUCERS);
+            ASSERT_EQ(seq, next[id]);
+            next[id]++;
+            line = strchr(line, '\n') + 1;
+        }
+        total += n;
+    }
+    free(buf);
+
+    for (int i = 0; i < LOG_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    return TEST_PASS;
+}
+
+int test_rt_thread_attr(void) {
+    rt_thread_attr_t bad_cpu = { -2, 0 };
+    rt_thread_attr_t bad_prio = { RT_THREAD_ANY_CPU, RT_THREAD_MAX_PRIORITY + 1 };
+    ASSERT_EQ(rt_thread_apply(&bad_cpu), -1);
+    ASSERT_EQ(rt_thread_apply(&bad_prio), -1);
+    ASSERT_EQ(rt_thread_apply(NULL), -1);
+
+    /* Time-shared and unpinned always applies */
+    rt_thread_attr_t plain = { RT_THREAD_ANY_CPU, 0 };
+    ASSERT_EQ(rt_thread_apply(&plain), 0);
+
+    /* Pinning to a CPU this process may run on sticks */
+    cpu_set_t allowed, now;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) cpu++;
+    rt_thread_attr_t pinned = { cpu, 0 };
+    ASSERT_EQ(rt_thread_apply(&pinned), 0);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(now), &now), 0);
+    ASSERT_EQ(CPU_COUNT(&now), 1);
+    ASSERT_TRUE(CPU_ISSET(cpu, &now));
+    sched_setaffinity(0, sizeof(allowed), &allowed);
+
+    /* SCHED_FIFO needs privileges: either applied or cleanly refused */
+    rt_thread_attr_t fifo = { RT_THREAD_ANY_CPU, 10 };
+    int ret = rt_thread_apply(&fifo);
+    ASSERT_TRUE(ret == 0 || ret == -3);
+    if (ret == 0) {
+        ASSERT_EQ(sched_getscheduler(0), SCHED_FIFO);
+        ASSERT_EQ(rt_thread_apply(&plain), 0);
+    }
+    ASSERT_EQ(sched_getscheduler(0), SCHED_OTHER);
+
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * TRACE TESTS (4 tests)
+ *===========================================================================*/
+
+int test_trace_emit_read(void) {
+    trace_t t;
+    ASSERT_EQ(trace_open(&t, NULL, 12), -1);
+    ASSERT_EQ(trace_open(&t, NULL, 16), 0);
+    ASSERT_EQ(trace_head(&t), 0);
+
+    for (uint32_t i = 0; i < 5; i++) {
+        trace_emit(&t, TRACE_COMMAND, (uint16_t)(CMD_MOTOR_START + i), i, 10 * i, 20, 30);
+    }
+    ASSERT_EQ(trace_head(&t), 5);
+    ASSERT_EQ(trace_first(&t), 0);
+
+    trace_record_t r, prev;
+    memset(&prev, 0, sizeof(prev));
+    for (uint64_t i = 0; i < 5; i++) {
+        ASSERT_EQ(trace_read(&t, i, &r), 0);
+        ASSERT_EQ(r.type, TRACE_COMMAND);
+        ASSERT_EQ(r.id, (uint16_t)(CMD_MOTOR_START + i));
+        ASSERT_EQ(r.a, i);
+        ASSERT_EQ(r.b, 10 * i);
+        ASSERT_EQ(r.d, 30);
+        ASSERT_TRUE(r.time_ns >= prev.time_ns);
+        prev.time_ns = r.time_ns;
+    }
+
+    /* Not written yet */
+    ASSERT_EQ(trace_read(&t, 5, &r), -2);
+
+    trace_close(&t);
+    return TEST_PASS;
+}
+
+int test_trace_wrap(void) {
+    trace_t t;
+    ASSERT_EQ(trace_open(&t, NULL, 8), 0);
+
+    for (uint32_t i = 0; i < 20; i++) {
+        trace_emit(&t, TRACE_TICK, 0, i, 0, 0, 0);
+    }
+
+    /* The ring keeps the newest capacity records */
+    ASSERT_EQ(trace_head(&t), 20);
+    ASSERT_EQ(trace_first(&t), 12);
+    trace_record_t r;
+    ASSERT_EQ(trace_read(&t, 11, &r), -2);
+    for (uint64_t i = 12; i < 20; i++) {
+        ASSERT_EQ(trace_read(&t, i, &r), 0);
+        ASSERT_EQ(r.a, i);
+    }
+
+    trace_close(&t);
+    return TEST_PASS;
+}
+
+int test_trace_file_dump(void) {
+    const char *live = "/tmp/test_driver.trace";
+    const char *dump = "/tmp/test_driver.trace.fault";
+
+    trace_t t;
+    ASSERT_EQ(trace_open(&t, live, 64), 0);
+    for (uint32_t i = 0; i < 10; i++) {
+        trace_emit(&t, TRACE_STATE, 1, i, i + 1, 0, 0);
+    }
+    ASSERT_EQ(trace_dump(&t, dump), 0);
+    for (uint32_t i = 0; i < 100; i++) {
+        trace_emit(&t, TRACE_TICK, 0, i, 0, 0, 0);
+    }
+
+    /* The dump is frozen at the moment it was taken */
+    trace_t frozen;
+    ASSERT_EQ(trace_open_file(&frozen, dump), 0);
+    ASSERT_EQ(trace_head(&frozen), 10);
+    trace_record_t r;
+    ASSERT_EQ(trace_read(&frozen, 9, &r), 0);
+    ASSERT_EQ(r.type, TRACE_STATE);
+    ASSERT_EQ(r.b, 10);
+    trace_close(&frozen);
+
+    /* The live file is readable by another process while it is written */
+    trace_t reader;
+    ASSERT_EQ(trace_open_file(&reader, live), 0);
+    ASSERT_EQ(trace_head(&reader), 110);
+    ASSERT_EQ(trace_first(&reader), 46);
+    ASSERT_EQ(trace_read(&reader, 109, &r), 0);
+    ASSERT_EQ(r.a, 99);
+    trace_close(&reader);
+    trace_close(&t);
+
+    /* Anything else is rejected */
+    FILE *junk = fopen(dump, "w");
+    ASSERT_NE(junk, NULL);
+    fputs("not a trace\n", junk);
+    fclose(junk);
+    ASSERT_EQ(trace_open_file(&reader, dump), -3);
+    ASSERT_EQ(trace_open_file(&reader, "/tmp/no_such_trace"), -3);
+
+    unlink(live);
+    unlink(dump);
+    return TEST_PASS;
+}
+
+int test_trace_hooks(void) {
+    trace_t t;
+    ASSERT_EQ(trace_open(&t, NULL, 256), 0);
+
+    register_file_t rf;
+    reg_init(&rf);
+    reg_write(&rf, REG_MOTOR_SPEED, 1);
+    ASSERT_EQ(trace_head(&t), 0);
+
+    /* Register writes carry the file's id, offset, value and operation */
+    reg_set_trace(&rf, &t, 3);
+    reg_write(&rf, REG_MOTOR_SPEED, 1234);
+    reg_set_bits(&rf, REG_MOTOR_CTRL, MOTOR_CTRL_BRAKE);
+    ASSERT_EQ(reg_read(&rf, REG_MOTOR_SPEED), 1234);
+    ASSERT_EQ(trace_head(&t), 2);
+
+    trace_record_t r;
+    ASSERT_EQ(trace_read(&t, 0, &r), 0);
+    ASSERT_EQ(r.type, TRACE_REG_WRITE);
+    ASSERT_EQ(r.id, 3);
+    ASSERT_EQ(r.a, REG_MOTOR_SPEED);
+    ASSERT_EQ(r.b, 1234);
+    ASSERT_EQ(r.c, TRACE_REG_OP_WRITE);
+    ASSERT_EQ(trace_read(&t, 1, &r), 0);
+    ASSERT_EQ(r.a, REG_MOTOR_CTRL);
+    ASSERT_EQ(r.b, MOTOR_CTRL_BRAKE);
+    ASSERT_EQ(r.c, TRACE_REG_OP_SET);
+
+    /* Each IRQ delivery is one record with its source and priority */
+    motor_controller_t mc;
+    sensor_array_t sa;
+    interrupt_controller_t ic;
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    irq_init(&ic, &rf, &mc, &sa);
+    irq_set_trace(&ic, &t);
+    irq_callback_count = 0;
+    irq_register_handler(&ic, INT_SENSOR_READY, test_irq_callback, NULL);
+    irq_enable(&ic, INT_SENSOR_READY);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_trigger(&ic, INT_SENSOR_READY);
+    irq_process_pending(&ic);
+    ASSERT_EQ(irq_callback_count, 1);
+
+    int irqs = 0;
+    for (uint64_t i = trace_first(&t); i < trace_head(&t); i++) {
+        ASSERT_EQ(trace_read(&t, i, &r), 0);
+        if (r.type != TRACE_IRQ) continue;
+        ASSERT_EQ(r.id, INT_SENSOR_READY);
+        ASSERT_EQ(r.a, 2);
+        ASSERT_EQ(r.c, (uint32_t)irq_get_priority(&ic, INT_SENSOR_READY));
+        irqs++;
+    }
+    ASSERT_EQ(irqs, 1);
+
+    irq_cleanup(&ic);
+    sensor_array_cleanup(&sa);
+    trace_close(&t);
+    return TEST_PASS;
+}
+
+/*============================================================================
+ * INTEGRATION TESTS (7 tests)
+ *===========================================================================*/
+
+int test_integration_motor_sensor(void) {
+    register_file_t rf;
+    motor_controller_t mc;
+    sensor_array_t sa;
+
+    reg_init(&rf);
+    motor_init(&mc, &rf);
+    sensor_array_init(&sa, &rf);
+    sensor_array_enable(&sa);
+
+    /* Start motor and simulate sensor readings */
+    motor_start(&mc, 3000, MOTOR_DIR_CW);
+
+    for (int i = 0; i < 20; i++) {
+        motor_update(&mc);
+
+        /* Update velocity sensor with motor speed */
+        sensor_set_simulated_value(&sa, 1, (int32_t)motor_get_speed(&mc));
+        sensor_array_trigger(&sa);
+        sensor_array_update(&sa);
+    }
+
+    /* Verify sensor tracks motor speed */
+    ASSERT_EQ(sensor_read(&sa, 1), (int32_t)motor_get_speed(&mc));
+
+    return TEST_PASS;
+}
+
+int test_integration_fault_irq(void) {
+    register_file_t rf;
+    motor_controller_t mc;
     sensor_array_t sa;
     interrupt_controller_t ic;
 
@@ -747,6 +4151,440 @@ int test_integration_fault_irq(void) {
     return TEST_PASS;
 }
 
+/* Simulated time, against the host clock the simulation no longer uses */
+static uint64_t host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int sim_command(sim_t *sim, uint32_t axis, command_type_t cmd,
+                       uint32_t param1, uint32_t param2) {
+    sim_input_t in = { 0, SIM_INPUT_COMMAND, (uint16_t)cmd, axis, param1, param2, 0 };
+    return sim_input(sim, &in);
+}
+
+static int sim_sensor(sim_t *sim, uint8_t sensor, int32_t value) {
+    sim_input_t in = { 0, SIM_INPUT_SENSOR, sensor, 0, (uint32_t)value, 0, 0 };
+    return sim_input(sim, &in);
+}
+
+int test_integration_sim_virtual_time(void) {
+    static sim_t sim;
+
+    ASSERT_EQ(sim_init(&sim, 1, 1000), 0);
+    ASSERT_TRUE(sim_clock_is_virtual());
+    ASSERT_EQ(sim_init(&sim, 1, 1000), -2);     /* One simulation per process */
+
+    /* Ten minutes of 1 kHz ticks */
+    ASSERT_EQ(sim_command(&sim, 0, CMD_MOTOR_START, 3000, MOTOR_DIR_CW), RESP_OK);
+    uint64_t start = host_now_ns();
+    ASSERT_EQ(sim_run(&sim, 600000), 600000);
+    uint64_t wall = host_now_ns() - start;
+
+    ASSERT_EQ(sim_ticks(&sim), 600000);
+    ASSERT_TRUE(sim_now_ns(&sim) - SIM_START_NS == 600ULL * 1000000000ULL);
+    ASSERT_TRUE(wall < 120ULL * 1000000000ULL);
+    printf("(600 s in %llu ms) ", (unsigned long long)(wall / 1000000));
+
+    /* Nothing waits on the host: every tick fits its period */
+    shm_loop_stats_t stats;
+    ASSERT_EQ(shm_read_loop_stats(sim.drv.shm, &stats), 0);
+    ASSERT_TRUE(stats.ticks == 600000);
+    ASSERT_TRUE(stats.overruns == 0);
+    ASSERT_TRUE(stats.phases[LOOP_PHASE_SAVE].count == 600000);  /* Saved every tick */
+    ASSERT_EQ(motor_bank_get_state(&sim.drv.motors, 0), MOTOR_STATE_RUNNING);
+    ASSERT_EQ(motor_bank_get_speed(&sim.drv.motors, 0), 3000);
+
+    /* A period change moves virtual time by the new period */
+    ASSERT_EQ(sim_command(&sim, 0, CMD_SET_TICK_PERIOD, 500, 0), RESP_OK);
+    uint64_t before = sim_now_ns(&sim);
+    sim_run(&sim, 10);
+    ASSERT_TRUE(sim_now_ns(&sim) - before == 10 * 500000ULL);
+
+    sim_cleanup(&sim);
+    ASSERT_TRUE(!sim_clock_is_virtual());
+    return TEST_PASS;
+}
+
+/* A short run touching every input type: over-current trip, reset, IRQ, injected fault */
+static void sim_scripted_run(sim_t *sim) {
+    sim_command(sim, 0, CMD_MOTOR_START, 4000, MOTOR_DIR_CW);
+    sim_command(sim, 1, CMD_MOTOR_MOVE, 2500, MOTION_SCURVE);
+    sim_sensor(sim, 3, 2500);
+    sim_run(sim, 40);
+    sim_sensor(sim, 3, 5200);
+    sim_run(sim, 5);
+    sim_sensor(sim, 3, 2500);
+    sim_command(sim, 0, CMD_RESET, 0, 0);
+    sim_command(sim, 0, CMD_MOTOR_START, 2000, MOTOR_DIR_CCW);
+    sim_run(sim, 30);
+
+    sim_input_t irq = { 0, SIM_INPUT_IRQ, INT_SENSOR_READY, 0, 0, 0, 0 };
+    sim_input(sim, &irq);
+    sim_input_t stall = { 0, SIM_INPUT_FAULT, MOTOR_FAULT_STALL, 1, 0, 0, 0 };
+    sim_input(sim, &stall);
+    sim_run(sim, 25);
+}
+
+int test_integration_sim_record_replay(void) {
+    static sim_t sim;
+    sim_script_t recorded, loaded;
+    const char *path = "/tmp/test_driver.sim";
+
+    sim_script_init(&recorded);
+    sim_script_init(&loaded);
+
+    ASSERT_EQ(sim_init(&sim, 2, 1000), 0);
+    sim_record(&sim, &recorded);
+    sim_scripted_run(&sim);
+    uint64_t digest = sim_digest(&sim);
+    unsigned long ticks = sim_ticks(&sim);
+    ASSERT_EQ(motor_bank_get_state(&sim.drv.motors, 0), MOTOR_STATE_RUNNING);
+    ASSERT_EQ(motor_bank_get_fault(&sim.drv.motors, 1), MOTOR_FAULT_STALL);
+    ASSERT_TRUE(atomic_load(&sim.drv.trip.trips) == 2);
+    sim_cleanup(&sim);
+
+    /* Inputs are stamped with the tick they went in ahead of */
+    ASSERT_EQ(recorded.count, 9);
+    ASSERT_EQ(recorded.inputs[0].tick, 0);
+    ASSERT_EQ(recorded.inputs[3].tick, 40);
+    ASSERT_EQ(recorded.inputs[recorded.count - 1].tick, 75);
+
+    ASSERT_EQ(sim_script_save(&recorded, path), 0);
+    ASSERT_EQ(sim_script_load(&loaded, path), 0);
+    ASSERT_EQ(loaded.count, recorded.count);
+    ASSERT_TRUE(memcmp(loaded.inputs, recorded.inputs,
+                       recorded.count * sizeof(sim_input_t)) == 0);
+
+    /* Replaying the file lands on the same state, tick for tick */
+    ASSERT_EQ(sim_init(&sim, 2, 1000), 0);
+    sim_play(&sim, &loaded);
+    sim_run(&sim, (uint32_t)ticks);
+    ASSERT_TRUE(sim_digest(&sim) == digest);
+    ASSERT_EQ(motor_bank_get_fault(&sim.drv.motors, 1), MOTOR_FAULT_STALL);
+    sim_cleanup(&sim);
+
+    /* Without the over-current sample the run diverges */
+    loaded.inputs[3].a = 2500;
+    ASSERT_EQ(sim_init(&sim, 2, 1000), 0);
+    sim_play(&sim, &loaded);
+    sim_run(&sim, (uint32_t)ticks);
+    ASSERT_TRUE(sim_digest(&sim) != digest);
+    ASSERT_TRUE(atomic_load(&sim.drv.trip.trips) == 1);
+    sim_cleanup(&sim);
+
+    /* Scripts are in tick order, and only script files load */
+    sim_input_t late = { 10, SIM_INPUT_IRQ, INT_TIMER, 0, 0, 0, 0 };
+    sim_input_t early = { 5, SIM_INPUT_IRQ, INT_TIMER, 0, 0, 0, 0 };
+    ASSERT_EQ(sim_script_add(&recorded, &late), -1);
+    sim_script_free(&recorded);
+    ASSERT_EQ(sim_script_add(&recorded, &late), 0);
+    ASSERT_EQ(sim_script_add(&recorded, &early), -1);
+    trace_t t;
+    ASSERT_EQ(trace_open(&t, path, 64), 0);
+    trace_close(&t);
+    ASSERT_EQ(sim_script_load(&loaded, path), -3);
+
+    unlink(path);
+    sim_script_free(&recorded);
+    sim_script_free(&loaded);
+    return TEST_PASS;
+}
+
+int test_integration_sim_trace_replay(void) {
+    static sim_t sim;
+    trace_t t;
+    sim_script_t script;
+
+    /* A run driven by commands only, traced as a live driver would be */
+    ASSERT_EQ(trace_open(&t, NULL, 4096), 0);
+    ASSERT_EQ(sim_init(&sim, 1, 1000), 0);
+    driver_set_trace(&sim.drv, &t);
+    sim_command(&sim, 0, CMD_SET_FAULT_REACTION, FAULT_REACT_COAST, 0);
+    sim_command(&sim, 0, CMD_MOTOR_START, 3000, MOTOR_DIR_CW);
+    sim_run(&sim, 20);
+    sim_command(&sim, 0, CMD_MOTOR_SET_SPEED, 1200, 0);
+    sim_run(&sim, 15);
+    sim_command(&sim, 0, CMD_MOTOR_STOP, 0, 0);
+    sim_command(&sim, 0, CMD_MOTOR_MOVE, 800, MOTION_TRAPEZOID);
+    sim_run(&sim, 40);
+    uint64_t digest = sim_digest(&sim);
+    unsigned long ticks = sim_ticks(&sim);
+    driver_set_trace(&sim.drv, NULL);
+    sim_cleanup(&sim);
+
+    /* Every command comes back at the tick it ran ahead of */
+    sim_script_init(&script);
+    ASSERT_EQ(sim_script_from_trace(&script, &t), 0);
+    ASSERT_EQ(script.count, 5);
+    ASSERT_EQ(script.inputs[0].id, CMD_SET_FAULT_REACTION);
+    ASSERT_EQ(script.inputs[0].a, FAULT_REACT_COAST);
+    ASSERT_EQ(script.inputs[1].tick, 0);
+    ASSERT_EQ(script.inputs[2].tick, 20);
+    ASSERT_EQ(script.inputs[2].a, 1200);
+    ASSERT_EQ(script.inputs[4].tick, 35);
+    ASSERT_EQ(script.inputs[4].id, CMD_MOTOR_MOVE);
+    trace_close(&t);
+
+    ASSERT_EQ(sim_init(&sim, 1, 1000), 0);
+    sim_play(&sim, &script);
+    sim_run(&sim, (uint32_t)ticks);
+    ASSERT_TRUE(sim_digest(&sim) == digest);
+    ASSERT_EQ(motor_bank_get_position(&sim.drv.motors, 0), 800);
+    sim_cleanup(&sim);
+
+    sim_script_free(&script);
+    return TEST_PASS;
+}
+
+/* xorshift32: scenarios are reproducible from their seed */
+static uint32_t scenario_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* What every faulted axis must look like once the tick that faulted it is over */
+static int check_faulted_axes(sim_t *sim, const fault_reaction_t *reaction) {
+    motor_bank_t *bank = &sim->drv.motors;
+
+    for (uint32_t axis = 0; axis < bank->axes; axis++) {
+        register_file_t *regs = &sim->drv.regs[axis];
+        uint32_t status = reg_read(regs, REG_MOTOR_STATUS);
+        uint32_t ctrl = reg_read(regs, REG_MOTOR_CTRL);
+
+        if (status & (MOTOR_STATUS_FAULT | MOTOR_STATUS_STALL | MOTOR_STATUS_OVERHEAT)) {
+            ASSERT_EQ(bank->state[axis], MOTOR_STATE_FAULT);
+        }
+        if (bank->state[axis] != MOTOR_STATE_FAULT) continue;
+
+        ASSERT_NE(bank->fault_code[axis], MOTOR_FAULT_NONE);
+        ASSERT_TRUE(bank->target_speed[axis] == 0);
+        ASSERT_TRUE(atomic_load(&sim->drv.trip.tripped) & (1ULL << axis));
+        switch (reaction[axis]) {
+            case FAULT_REACT_BRAKE:
+                ASSERT_TRUE(!(ctrl & MOTOR_CTRL_ENABLE) && (ctrl & MOTOR_CTRL_BRAKE));
+                ASSERT_TRUE(bank->current_speed[axis] == 0);
+                break;
+            case FAULT_REACT_COAST:
+                ASSERT_TRUE(!(ctrl & MOTOR_CTRL_ENABLE));
+                break;
+            case FAULT_REACT_STOP:
+                ASSERT_TRUE(reg_read(regs, REG_MOTOR_SPEED) == 0);
+                break;
+        }
+    }
+
+    return TEST_PASS;
+}
+
+#define SIM_SCENARIOS       1000
+#define SIM_SCENARIO_TICKS  200
+
+/*
+ * One randomised fault scenario: up to four axes with random reactions,
+ * driven by random commands, over-current samples, injected faults and
+ * external trips. After every tick, each fault the tick saw must have
+ * reached its drive.
+ */
+static int run_fault_scenario(uint32_t seed, sim_script_t *record, uint64_t *digest) {
+    static sim_t sim;
+    fault_reaction_t reaction[4];
+    uint32_t rng = seed;
+    uint32_t axes = 1 + scenario_rand(&rng) % 4;
+
+    ASSERT_EQ(sim_init(&sim, axes, 1000), 0);
+    sim_record(&sim, record);
+    for (uint32_t axis = 0; axis < axes; axis++) {
+        reaction[axis] = (fault_reaction_t)(scenario_rand(&rng) % 3);
+        sim_command(&sim, axis, CMD_SET_FAULT_REACTION, reaction[axis], 0);
+        sim_command(&sim, axis, CMD_MOTOR_START, 1000 + scenario_rand(&rng) % 5000,
+                    scenario_rand(&rng) % 2);
+    }
+    sim_sensor(&sim, 3, 2500);
+
+    for (uint32_t tick = 0; tick < SIM_SCENARIO_TICKS; tick++) {
+        uint32_t roll = scenario_rand(&rng) % 32;
+        uint32_t axis = scenario_rand(&rng) % axes;
+        uint64_t must_fault = 0;
+
+        if (roll == 0) {
+            sim_input_t fault = { 0, SIM_INPUT_FAULT,
+                                  (uint16_t)(MOTOR_FAULT_STALL + scenario_rand(&rng) % 3),
+                                  axis, 0, 0, 0 };
+            ASSERT_EQ(sim_input(&sim, &fault), 0);
+            must_fault = 1ULL << axis;
+        } else if (roll == 1) {
+            int32_t current = 3000 + (int32_t)(scenario_rand(&rng) % 3000);
+            sim_sensor(&sim, 3, current);
+            if (current >= 4500) must_fault = 1;
+        } else if (roll == 2) {
+            /* A fault line with no latched cause is an external trip */
+            bool latched = false;
+            for (uint32_t i = 0; i < axes; i++) {
+                latched |= (reg_read(&sim.drv.regs[i], REG_MOTOR_STATUS) &
+                            (MOTOR_STATUS_FAULT | MOTOR_STATUS_STALL | MOTOR_STATUS_OVERHEAT)) != 0;
+            }
+            sim_input_t irq = { 0, SIM_INPUT_IRQ, INT_MOTOR_FAULT, 0, 0, 0, 0 };
+            sim_input(&sim, &irq);
+            if (!latched) must_fault = (1ULL << axes) - 1;
+        } else if (roll == 3) {
+            sim_sensor(&sim, 3, 2500);
+            sim_command(&sim, axis, CMD_RESET, 0, 0);
+        } else if (roll == 4) {
+            sim_command(&sim, axis, CMD_MOTOR_START, 1000 + scenario_rand(&rng) % 5000,
+                        scenario_rand(&rng) % 2);
+        } else if (roll == 5) {
+            sim_command(&sim, axis, CMD_MOTOR_SET_SPEED, scenario_rand(&rng) % 6000, 0);
+        } else if (roll == 6) {
+            sim_command(&sim, axis, CMD_MOTOR_MOVE, scenario_rand(&rng) % 20000,
+                        scenario_rand(&rng) % 2);
+        } else if (roll == 7) {
+            sim_command(&sim, axis, CMD_MOTOR_STOP, 0, 0);
+        }
+
+        sim_run(&sim, 1);
+        for (uint32_t i = 0; i < axes; i++) {
+            if (must_fault & (1ULL << i)) {
+                ASSERT_EQ(motor_bank_get_state(&sim.drv.motors, i), MOTOR_STATE_FAULT);
+            }
+        }
+        if (check_faulted_axes(&sim, reaction) != TEST_PASS) {
+            printf("  scenario seed %u, tick %u\n", seed, tick);
+            sim_cleanup(&sim);
+            return TEST_FAIL;
+        }
+    }
+
+    *digest = sim_digest(&sim);
+    sim_cleanup(&sim);
+    return TEST_PASS;
+}
+
+int test_integration_sim_fault_scenarios(void) {
+    static sim_t sim;
+    uint64_t start = host_now_ns();
+
+    for (uint32_t n = 0; n < SIM_SCENARIOS; n++) {
+        uint32_t seed = 0x9e3779b9u * (n + 1);
+        sim_script_t record;
+        uint64_t digest = 0;
+
+        sim_script_init(&record);
+        int result = run_fault_scenario(seed, &record, &digest);
+        if (result != TEST_PASS) {
+            sim_script_free(&record);
+            return result;
+        }
+
+        /* Whatever a scenario did, its recording replays to the same state */
+        if (n % 50 == 0) {
+            uint32_t rng = seed;
+            ASSERT_EQ(sim_init(&sim, 1 + scenario_rand(&rng) % 4, 1000), 0);
+            sim_play(&sim, &record);
+            sim_run(&sim, SIM_SCENARIO_TICKS);
+            ASSERT_TRUE(sim_digest(&sim) == digest);
+            sim_cleanup(&sim);
+        }
+        sim_script_free(&record);
+    }
+
+    printf("(%u scenarios in %llu ms) ", SIM_SCENARIOS,
+           (unsigned long long)((host_now_ns() - start) / 1000000));
+    return TEST_PASS;
+}
+
+/*
+ * Closed-loop speed, tuned gains, a coast reaction, an over-current trip
+ * and a stall, with a warm restart between phases when restart is set.
+ * A subscription and a queued command live on the segment throughout.
+ */
+static int warm_restart_run(sim_t *sim, bool restart) {
+    shm_sub_spec_t spec = { SHM_SUB_STATE, 1, MOTOR_STATE_FAULT, 0 };
+    int id = shm_subscribe(sim->drv.shm, &spec);
+    ASSERT_TRUE(id >= 0);
+
+    sim_command(sim, 0, CMD_SET_PID_GAIN, SHM_PID_KI, MOTOR_PID_ONE / 10);
+    sim_command(sim, 0, CMD_SET_CLOSED_LOOP, 1, 0);
+    sim_command(sim, 1, CMD_SET_FAULT_REACTION, FAULT_REACT_COAST, 0);
+    sim_command(sim, 0, CMD_SET_SENSOR_RATE, 2, 5000);
+    sim_command(sim, 0, CMD_MOTOR_START, 3000, MOTOR_DIR_CW);
+    sim_command(sim, 1, CMD_MOTOR_START, 2000, MOTOR_DIR_CCW);
+    sim_run(sim, 60);
+    if (restart) ASSERT_EQ(sim_restart(sim), 0);
+
+    /* Queued while the driver is down, run by the one that comes back */
+    ASSERT_EQ(shm_post_command(sim->drv.shm, 0, CMD_MOTOR_SET_SPEED, 4000, 0), 0);
+    shm_command_t ops[SHM_FRAME_MAX_OPS];
+    int count = shm_poll_frame(sim->drv.shm, ops);
+    ASSERT_EQ(count, 1);
+    driver_process(&sim->drv, ops, count);
+    sim_sensor(sim, 3, 5200);
+    sim_run(sim, 5);
+    sim_sensor(sim, 3, 2500);
+    sim_command(sim, 0, CMD_RESET, 0, 0);
+    sim_command(sim, 0, CMD_MOTOR_START, 2000, MOTOR_DIR_CCW);
+    sim_run(sim, 40);
+    if (restart) ASSERT_EQ(sim_restart(sim), 0);
+
+    sim_input_t stall = { 0, SIM_INPUT_FAULT, MOTOR_FAULT_STALL, 1, 0, 0, 0 };
+    sim_input(sim, &stall);
+    sim_run(sim, 20);
+    if (restart) ASSERT_EQ(sim_restart(sim), 0);
+    sim_run(sim, 30);
+
+    /* The stall fired the subscription once, whichever driver saw it */
+    shm_sub_event_t ev;
+    ASSERT_EQ(shm_read_event(sim->drv.shm, id, &ev), 0);
+    ASSERT_EQ(ev.count, 1);
+    ASSERT_TRUE(ev.tick == 105);
+    return TEST_PASS;
+}
+
+int test_integration_sim_warm_restart(void) {
+    static sim_t sim;
+
+    ASSERT_EQ(sim_init(&sim, 2, 1000), 0);
+    ASSERT_EQ(warm_restart_run(&sim, false), TEST_PASS);
+    uint64_t digest = sim_digest(&sim);
+    ASSERT_TRUE(atomic_load(&sim.drv.trip.trips) == 2);
+    sim_cleanup(&sim);
+
+    /* Three restarts on the way, and every tick still matches */
+    ASSERT_EQ(sim_init(&sim, 2, 1000), 0);
+    ASSERT_EQ(warm_restart_run(&sim, true), TEST_PASS);
+    ASSERT_TRUE(sim_digest(&sim) == digest);
+    ASSERT_TRUE(atomic_load(&sim.drv.trip.trips) == 2);
+    ASSERT_TRUE(sim.drv.motors.pid[0].enabled);
+    ASSERT_EQ(sim.drv.trip.reaction[1], FAULT_REACT_COAST);
+    ASSERT_EQ(sim.drv.sensor_interval_us[2], 5000);
+    ASSERT_EQ(motor_bank_get_fault(&sim.drv.motors, 1), MOTOR_FAULT_STALL);
+
+    /* A move in flight does not survive: its axis ramps down where it got to */
+    ASSERT_EQ(sim_command(&sim, 0, CMD_MOTOR_MOVE, 20000, MOTION_TRAPEZOID), RESP_OK);
+    sim_run(&sim, 50);
+    int32_t position = motor_bank_get_position(&sim.drv.motors, 0);
+    ASSERT_EQ(sim_restart(&sim), 0);
+    ASSERT_EQ(motor_bank_get_position(&sim.drv.motors, 0), position);
+    ASSERT_EQ(motor_bank_get_state(&sim.drv.motors, 0), MOTOR_STATE_STOPPING);
+    sim_run(&sim, 100);
+    ASSERT_EQ(motor_bank_get_state(&sim.drv.motors, 0), MOTOR_STATE_IDLE);
+    ASSERT_TRUE(motor_bank_get_position(&sim.drv.motors, 0) < 20000);
+    ASSERT_EQ(sim_command(&sim, 0, CMD_MOTOR_MOVE, 20000, MOTION_TRAPEZOID), RESP_OK);
+
+    /* Nothing saved for a different axis count is applied */
+    shm_driver_state_t state;
+    ASSERT_EQ(shm_load_state(sim.drv.shm, &state), 0);
+    state.axes = 1;
+    ASSERT_EQ(driver_restore_state(&sim.drv, &state), -1);
+
+    sim_cleanup(&sim);
+    return TEST_PASS;
+}
+
 /*============================================================================
  * TEST RUNNER
  *===========================================================================*/
@@ -762,6 +4600,8 @@ static test_case_t all_tests[] = {
     {"test_reg_read_write", test_reg_read_write},
     {"test_reg_set_clear_bits", test_reg_set_clear_bits},
     {"test_reg_invalid_offset", test_reg_invalid_offset},
+    {"test_reg_shm_backend", test_reg_shm_backend},
+    {"test_reg_mmio_backend", test_reg_mmio_backend},
 
     /* Motor controller tests */
     {"test_motor_init", test_motor_init},
@@ -776,6 +4616,16 @@ static test_case_t all_tests[] = {
     {"test_motor_fault_recovery", test_motor_fault_recovery},
     {"test_motor_reset", test_motor_reset},
     {"test_motor_max_speed", test_motor_max_speed},
+    {"test_motor_bank_matches_single", test_motor_bank_matches_single},
+    {"test_motor_bank_axes", test_motor_bank_axes},
+    {"test_motor_pid_converges", test_motor_pid_converges},
+    {"test_motor_pid_antiwindup", test_motor_pid_antiwindup},
+
+    /* Motion profile tests */
+    {"test_motion_trapezoid", test_motion_trapezoid},
+    {"test_motion_scurve", test_motion_scurve},
+    {"test_motion_blend", test_motion_blend},
+    {"test_motion_follow_motor", test_motion_follow_motor},
 
     /* Sensor array tests */
     {"test_sensor_init", test_sensor_init},
@@ -788,6 +4638,18 @@ static test_case_t all_tests[] = {
     {"test_sensor_buffer_overflow", test_sensor_buffer_overflow},
     {"test_sensor_buffer_clear", test_sensor_buffer_clear},
     {"test_sensor_value_clamping", test_sensor_value_clamping},
+    {"test_sensor_buffer_configure", test_sensor_buffer_configure},
+    {"test_sensor_buffer_overwrite_oldest", test_sensor_buffer_overwrite_oldest},
+    {"test_sensor_drop_counters", test_sensor_drop_counters},
+    {"test_sensor_buffer_bulk_wrap", test_sensor_buffer_bulk_wrap},
+    {"test_sensor_buffer_bulk_overflow", test_sensor_buffer_bulk_overflow},
+    {"test_sensor_sample_tags", test_sensor_sample_tags},
+    {"test_sensor_sample_gap", test_sensor_sample_gap},
+    {"test_sensor_buffer_spsc", test_sensor_buffer_spsc},
+    {"test_sensor_filter_pipeline", test_sensor_filter_pipeline},
+    {"test_sensor_running_stats", test_sensor_running_stats},
+    {"test_sensor_rate_dividers", test_sensor_rate_dividers},
+    {"test_sensor_table_add", test_sensor_table_add},
 
     /* IRQ tests */
     {"test_irq_init", test_irq_init},
@@ -796,15 +4658,84 @@ static test_case_t all_tests[] = {
     {"test_irq_handler_callback", test_irq_handler_callback},
     {"test_irq_pending_mask", test_irq_pending_mask},
     {"test_irq_clear", test_irq_clear},
+    {"test_irq_priority_order", test_irq_priority_order},
+    {"test_irq_preempt_and_nest", test_irq_preempt_and_nest},
+    {"test_irq_deferred", test_irq_deferred},
+    {"test_irq_coalesce", test_irq_coalesce},
+    {"test_irq_storm_throttle", test_irq_storm_throttle},
+    {"test_irq_atomic_intake", test_irq_atomic_intake},
+    {"test_irq_signal_storm", test_irq_signal_storm},
+    {"test_irq_handler_chain", test_irq_handler_chain},
+    {"test_irq_chain_rcu", test_irq_chain_rcu},
+    {"test_irq_latency_stats", test_irq_latency_stats},
+    {"test_irq_stats_shm", test_irq_stats_shm},
 
     /* Shared memory tests */
+    {"test_fault_trip_reactions", test_fault_trip_reactions},
+    {"test_fault_trip_irq_fast_path", test_fault_trip_irq_fast_path},
+    {"test_fault_trip_current_sensor", test_fault_trip_current_sensor},
     {"test_shm_create_destroy", test_shm_create_destroy},
     {"test_shm_status_update", test_shm_status_update},
     {"test_shm_shutdown", test_shm_shutdown},
+    {"test_shm_command_ring", test_shm_command_ring},
+    {"test_shm_command_ring_full", test_shm_command_ring_full},
+    {"test_shm_command_ring_seq_wrap", test_shm_command_ring_seq_wrap},
+    {"test_shm_command_ring_mpsc", test_shm_command_ring_mpsc},
+    {"test_shm_wakeup_stress", test_shm_wakeup_stress},
+    {"test_shm_command_frame", test_shm_command_frame},
+    {"test_shm_fire_and_forget", test_shm_fire_and_forget},
+    {"test_shm_frame_mpsc", test_shm_frame_mpsc},
+    {"test_shm_completion_slots", test_shm_completion_slots},
+    {"test_shm_send_wait_response", test_shm_send_wait_response},
+    {"test_shm_completion_many_clients", test_shm_completion_many_clients},
+    {"test_shm_status_snapshot", test_shm_status_snapshot},
+    {"test_shm_loop_stats", test_shm_loop_stats},
+    {"test_shm_axis_status", test_shm_axis_status},
+    {"test_shm_sensor_stats", test_shm_sensor_stats},
+    {"test_shm_subscribe", test_shm_subscribe},
+    {"test_shm_subscription_edges", test_shm_subscription_edges},
+    {"test_shm_subscription_wait", test_shm_subscription_wait},
+    {"test_shm_subscription_owner", test_shm_subscription_owner},
+    {"test_shm_saved_state", test_shm_saved_state},
+    {"test_shm_attach", test_shm_attach},
+    {"test_shm_attach_after_waiter_died", test_shm_attach_after_waiter_died},
+
+    /* Sample stream tests */
+    {"test_stream_broadcast", test_stream_broadcast},
+    {"test_stream_overrun", test_stream_overrun},
+    {"test_stream_sensor_publish", test_stream_sensor_publish},
+    {"test_stream_filtered_decimation", test_stream_filtered_decimation},
+
+    /* Latency histogram tests */
+    {"test_latency_hist_buckets", test_latency_hist_buckets},
+    {"test_latency_hist_percentile", test_latency_hist_percentile},
+
+    /* Event loop tests */
+    {"test_event_loop_tick", test_event_loop_tick},
+    {"test_event_loop_set_period", test_event_loop_set_period},
+    {"test_event_loop_shutdown_flag", test_event_loop_shutdown_flag},
+    {"test_event_loop_irq_signal", test_event_loop_irq_signal},
+
+    /* RT thread tests */
+    {"test_log_queue_order", test_log_queue_order},
+    {"test_log_queue_full", test_log_queue_full},
+    {"test_log_queue_mpsc", test_log_queue_mpsc},
+    {"test_rt_thread_attr", test_rt_thread_attr},
+
+    /* Trace tests */
+    {"test_trace_emit_read", test_trace_emit_read},
+    {"test_trace_wrap", test_trace_wrap},
+    {"test_trace_file_dump", test_trace_file_dump},
+    {"test_trace_hooks", test_trace_hooks},
 
     /* Integration tests */
     {"test_integration_motor_sensor", test_integration_motor_sensor},
     {"test_integration_fault_irq", test_integration_fault_irq},
+    {"test_integration_sim_virtual_time", test_integration_sim_virtual_time},
+    {"test_integration_sim_record_replay", test_integration_sim_record_replay},
+    {"test_integration_sim_trace_replay", test_integration_sim_trace_replay},
+    {"test_integration_sim_fault_scenarios", test_integration_sim_fault_scenarios},
+    {"test_integration_sim_warm_restart", test_integration_sim_warm_restart},
 };
 
 static int run_test(const char *name) {
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "trace.h"
+#include "device_registers.h"
+#include "interrupt_handler.h"
+#include "shared_mem.h"
+
+/*
+ * Offline decoder for driver traces and fault dumps. CSV keeps every field
+ * of every record; Perfetto output is Chrome trace-event JSON, which the
+ * Perfetto UI opens directly: register writes become counter tracks, ticks
+ * and IRQ handlers become slices, everything else instant events.
+ */
+
+typedef enum { FORMAT_CSV, FORMAT_PERFETTO } format_t;
+
+/* Perfetto thread ids for the non-axis tracks */
+#define TID_CONTROL     1000
+#define TID_IRQ         1001
+#define TID_COMMANDS    1002
+
+static const char *const type_names[TRACE_TYPE_COUNT] = {
+    [TRACE_REG_WRITE] = "reg_write",
+    [TRACE_STATE]     = "state",
+    [TRACE_IRQ]       = "irq",
+    [TRACE_COMMAND]   = "command",
+    [TRACE_FAULT]     = "fault",
+    [TRACE_TICK]      = "tick",
+};
+
+static const char *const reg_names[REGISTER_FILE_SIZE / 4] = {
+    "MOTOR_CTRL", "MOTOR_STATUS", "MOTOR_SPEED", "MOTOR_POSITION", "SENSOR_CTRL",
+    "SENSOR_DATA", "SENSOR_STATUS", "IRQ_STATUS", "IRQ_ENABLE",
+};
+
+static const char *const irq_names[INT_COUNT] = {
+    "MOTOR_FAULT", "MOTOR_STALL", "SENSOR_READY", "SENSOR_ERROR", "TIMER",
+};
+
+static const char *const state_names[] = {
+    "IDLE", "STARTING", "RUNNING", "STOPPING", "FAULT", "RECOVERY",
+};
+
+static const char *const command_names[] = {
+    [CMD_NONE]                 = "NONE",
+    [CMD_MOTOR_START]          = "MOTOR_START",
+    [CMD_MOTOR_STOP]           = "MOTOR_STOP",
+    [CMD_MOTOR_SET_SPEED]      = "MOTOR_SET_SPEED",
+    [CMD_SENSOR_READ]          = "SENSOR_READ",
+    [CMD_GET_STATUS]           = "GET_STATUS",
+    [CMD_RESET]                = "RESET",
+    [CMD_SET_TICK_PERIOD]      = "SET_TICK_PERIOD",
+    [CMD_RESET_LOOP_STATS]     = "RESET_LOOP_STATS",
+    [CMD_MOTOR_MOVE]           = "MOTOR_MOVE",
+    [CMD_SET_PID_GAIN]         = "SET_PID_GAIN",
+    [CMD_SET_CLOSED_LOOP]      = "SET_CLOSED_LOOP",
+    [CMD_SET_SENSOR_THRESHOLD] = "SET_SENSOR_THRESHOLD",
+    [CMD_RESET_SENSOR_STATS]   = "RESET_SENSOR_STATS",
+    [CMD_SET_SENSOR_RATE]      = "SET_SENSOR_RATE",
+    [CMD_SET_FAULT_REACTION]   = "SET_FAULT_REACTION",
+};
+
+#define NAME_OF(table, i) \
+    ((size_t)(i) < sizeof(table) / sizeof(table[0]) && (table)[i] ? (table)[i] : "?")
+
+/* What the record is about: a register, IRQ source, command or axis */
+static void subject_name(const trace_record_t *r, char *buf, size_t len) {
+    switch (r->type) {
+        case TRACE_REG_WRITE:
+            snprintf(buf, len, "regs%u.%s", r->id, NAME_OF(reg_names, r->a / 4));
+            break;
+        case TRACE_IRQ:
+            snprintf(buf, len, "%s", NAME_OF(irq_names, r->id));
+            break;
+        case TRACE_COMMAND:
+            snprintf(buf, len, "%s", NAME_OF(command_names, r->id));
+            break;
+        case TRACE_TICK:
+            snprintf(buf, len, "tick");
+            break;
+        default:
+            snprintf(buf, len, "axis%u", r->id);
+            break;
+    }
+}
+
+static void emit_csv(FILE *out, uint64_t index, const trace_record_t *r, uint64_t t0) {
+    char subject[64];
+    subject_name(r, subject, sizeof(subject));
+    fprintf(out, "%llu,%llu,%s,%u,%s,%u,%u,%u,%u\n",
+            (unsigned long long)index, (unsigned long long)(r->time_ns - t0),
+            NAME_OF(type_names, r->type), r->id, subject, r->a, r->b, r->c, r->d);
+}
+
+static void emit_perfetto(FILE *out, const trace_record_t *r, uint64_t t0, bool *first) {
+    char subject[64];
+    subject_name(r, subject, sizeof(subject));
+    double ts = (double)(r->time_ns - t0) / 1000.0;
+
+    fprintf(out, "%s\n    ", *first ? "" : ",");
+    *first = false;
+
+    switch (r->type) {
+        case TRACE_REG_WRITE:
+            if (r->c == TRACE_REG_OP_WRITE) {
+                fprintf(out, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,"
+                        "\"args\":{\"value\":%d}}", subject, ts, (int32_t)r->b);
+            } else {
+                fprintf(out, "{\"name\":\"%s %s 0x%x\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                        "\"pid\":1,\"tid\":%u}", subject,
+                        r->c == TRACE_REG_OP_SET ? "|=" : "&= ~", r->b, ts, r->id);
+            }
+            break;
+        case TRACE_STATE:
+            fprintf(out, "{\"name\":\"%s -> %s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                    "\"pid\":1,\"tid\":%u,\"args\":{\"fault\":%u}}",
+                    NAME_OF(state_names, r->a), NAME_OF(state_names, r->b), ts, r->id, r->c);
+            break;
+        case TRACE_IRQ:
+            fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,"
+                    "\"tid\":%d,\"args\":{\"merged\":%u,\"priority\":%u}}",
+                    subject, ts - r->b / 1000.0, r->b / 1000.0, TID_IRQ, r->a, r->c);
+            break;
+        case TRACE_COMMAND:
+            fprintf(out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,"
+                    "\"tid\":%d,\"args\":{\"axis\":%u,\"param1\":%u,\"param2\":%u,\"status\":%u}}",
+                    subject, ts, TID_COMMANDS, r->a, r->b, r->c, r->d);
+            break;
+        case TRACE_FAULT:
+            fprintf(out, "{\"name\":\"fault %s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,"
+                    "\"tid\":%u,\"args\":{\"fault\":%u,\"reaction\":%u,\"reaction_ns\":%u}}",
+                    subject, ts, r->id, r->a, r->b, r->c);
+            break;
+        default:
+            fprintf(out, "{\"name\":\"tick %u\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,"
+                    "\"tid\":%d,\"args\":{\"period_us\":%u}}",
+                    r->a, ts - r->b / 1000.0, r->b / 1000.0, TID_CONTROL, r->c);
+            break;
+    }
+}
+
+static void perfetto_thread_name(FILE *out, int tid, const char *name) {
+    fprintf(out, ",\n    {\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}", tid, name);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-f csv|perfetto] [-o output] trace_file\n", prog);
+    printf("  -f  output format (default csv)\n");
+    printf("  -o  write to a file instead of stdout\n");
+}
+
+int main(int argc, char *argv[]) {
+    format_t format = FORMAT_CSV;
+    const char *output = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:o:h")) != -1) {
+        switch (opt) {
+            case 'f':
+                if (strcmp(optarg, "csv") == 0) {
+                    format = FORMAT_CSV;
+                } else if (strcmp(optarg, "perfetto") == 0) {
+                    format = FORMAT_PERFETTO;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    trace_t trace;
+    if (trace_open_file(&trace, argv[optind]) < 0) {
+        fprintf(stderr, "%s: not a driver trace\n", argv[optind]);
+        return 1;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        perror(output);
+        trace_close(&trace);
+        return 1;
+    }
+
+    uint64_t first = trace_first(&trace);
+    uint64_t head = trace_head(&trace);
+    uint64_t t0 = 0, decoded = 0, skipped = 0;
+    bool first_event = true;
+
+    if (format == FORMAT_CSV) {
+        fprintf(out, "index,time_ns,event,id,subject,a,b,c,d\n");
+    } else {
+        fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    }
+
+    for (uint64_t i = first; i < head; i++) {
+        trace_record_t r;
+        if (trace_read(&trace, i, &r) < 0 || r.type == 0 || r.type >= TRACE_TYPE_COUNT) {
+            skipped++;  /* In flight when the file was written */
+            continue;
+        }
+        if (decoded++ == 0) t0 = r.time_ns;
+
+        if (format == FORMAT_CSV) {
+            emit_csv(out, i, &r, t0);
+        } else {
+            emit_perfetto(out, &r, t0, &first_event);
+        }
+    }
+
+    if (format == FORMAT_PERFETTO) {
+        if (!first_event) {
+            perfetto_thread_name(out, TID_CONTROL, "control tick");
+            perfetto_thread_name(out, TID_IRQ, "irq dispatch");
+            perfetto_thread_name(out, TID_COMMANDS, "commands");
+        }
+        fprintf(out, "\n]}\n");
+    }
+
+    fprintf(stderr, "%llu records decoded, %llu skipped (records %llu..%llu)\n",
+            (unsigned long long)decoded, (unsigned long long)skipped,
+            (unsigned long long)first, (unsigned long long)head);
+
+    if (output) fclose(out);
+    trace_close(&trace);
+    return 0;
+}